@@ -0,0 +1,269 @@
+/*
+ * $Id$
+ */
+
+/*
+ * throughput of GFS_PROTO_PWRITE and GFS_PROTO_PREAD RPCs
+ * on the gfp_xdr layer.
+ *
+ * a child process acts as a gfsd which doesn't touch any file,
+ * thus this measures the cost of encoding, buffering and sending
+ * the payload, over a TCP connection on the loopback interface.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libgen.h>
+
+#include <gfarm/gfarm.h>
+
+#include "context.h"
+#include "gfp_xdr.h"
+#include "io_fd.h"
+#include "gfs_proto.h"
+
+#define MIN_IOSIZE	(4 * 1024)
+
+static char *program_name = "thput-gfpxdr";
+
+static char buffer[GFS_PROTO_MAX_IOSIZE];
+
+static void
+check(gfarm_error_t e, const char *diag)
+{
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: %s: %s\n", program_name, diag,
+		    gfarm_error_string(e));
+		exit(1);
+	}
+}
+
+static gfarm_error_t
+server_get_request(struct gfp_xdr *conn, size_t size, const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e;
+
+	va_start(ap, format);
+	e = gfp_xdr_vrecv_request_parameters(conn, 0, &size, format, &ap);
+	va_end(ap);
+	return (e);
+}
+
+static gfarm_error_t
+server_put_reply(struct gfp_xdr *conn, gfp_xdr_xid_t xid,
+	const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e;
+
+	va_start(ap, format);
+	e = gfp_xdr_vsend_async_result(conn, xid, GFARM_ERR_NO_ERROR,
+	    format, &ap);
+	va_end(ap);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_flush(conn);
+	return (e);
+}
+
+static void
+server(int sock)
+{
+	gfarm_error_t e;
+	struct gfp_xdr *conn;
+	enum gfp_xdr_msg_type type;
+	gfp_xdr_xid_t xid;
+	size_t size, n;
+	gfarm_int32_t command, fd, iosize;
+	gfarm_int64_t offset;
+
+	check(gfp_xdr_new_socket(sock, &conn), "server connection");
+	for (;;) {
+		e = gfp_xdr_recv_async_header(conn, 0, 1, &type, &xid, &size);
+		if (e == GFARM_ERR_UNEXPECTED_EOF)
+			break;
+		check(e, "server receive header");
+		check(gfp_xdr_recv_request_command(conn, 0, &size, &command),
+		    "server receive command");
+		switch (command) {
+		case GFS_PROTO_PWRITE:
+			check(server_get_request(conn, size, "ibl", &fd,
+			    sizeof(buffer), &n, buffer, &offset),
+			    "server receive pwrite");
+			check(server_put_reply(conn, xid, "i",
+			    (gfarm_int32_t)n), "server reply pwrite");
+			break;
+		case GFS_PROTO_PREAD:
+			check(server_get_request(conn, size, "iil", &fd,
+			    &iosize, &offset), "server receive pread");
+			if (iosize > sizeof(buffer))
+				iosize = sizeof(buffer);
+			check(server_put_reply(conn, xid, "b",
+			    (size_t)iosize, buffer), "server reply pread");
+			break;
+		default:
+			fprintf(stderr, "%s: unknown command %d\n",
+			    program_name, (int)command);
+			exit(1);
+		}
+	}
+	gfp_xdr_free(conn);
+}
+
+static gfarm_error_t
+client_rpc(struct gfp_xdr *conn, int command, const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e;
+	gfarm_int32_t errcode;
+
+	va_start(ap, format);
+	e = gfp_xdr_vrpc(conn, 0, 1, command, &errcode, &format, &ap);
+	va_end(ap);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = errcode;
+	return (e);
+}
+
+static double
+measure(struct gfp_xdr *conn, int command, size_t iosize, gfarm_off_t total)
+{
+	struct timespec start, end;
+	gfarm_off_t offset;
+	gfarm_int32_t n;
+	size_t sz;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (offset = 0; offset < total; offset += iosize) {
+		if (command == GFS_PROTO_PWRITE)
+			check(client_rpc(conn, command, "ibl/i",
+			    (gfarm_int32_t)0, iosize, buffer, offset, &n),
+			    "pwrite");
+		else
+			check(client_rpc(conn, command, "iil/b",
+			    (gfarm_int32_t)0, (gfarm_int32_t)iosize, offset,
+			    sizeof(buffer), &sz, buffer), "pread");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start.tv_sec) +
+	    (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+static int
+connect_server(void)
+{
+	int lsock, sock, csock, one = 1;
+	struct sockaddr_in sin;
+	socklen_t slen = sizeof(sin);
+	pid_t pid;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = 0;
+	if ((lsock = socket(PF_INET, SOCK_STREAM, 0)) == -1 ||
+	    bind(lsock, (struct sockaddr *)&sin, sizeof(sin)) == -1 ||
+	    listen(lsock, 1) == -1 ||
+	    getsockname(lsock, (struct sockaddr *)&sin, &slen) == -1 ||
+	    (csock = socket(PF_INET, SOCK_STREAM, 0)) == -1 ||
+	    connect(csock, (struct sockaddr *)&sin, sizeof(sin)) == -1 ||
+	    (sock = accept(lsock, NULL, NULL)) == -1) {
+		perror(program_name);
+		exit(1);
+	}
+	close(lsock);
+	/* same as gfsd and gfarm clients */
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	setsockopt(csock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if ((pid = fork()) == -1) {
+		perror("fork");
+		exit(1);
+	} else if (pid == 0) {
+		close(csock);
+		server(sock);
+		exit(0);
+	}
+	close(sock);
+	return (csock);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-r] [-w] [-s total_MiB] [-b iosize]\n",
+	    program_name);
+	fprintf(stderr, "\t-r\tmeasure pread only\n");
+	fprintf(stderr, "\t-w\tmeasure pwrite only\n");
+	fprintf(stderr, "\t-b\tmeasure the iosize only, "
+	    "instead of from 4KiB to 1MiB\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct gfp_xdr *conn;
+	int c, do_read = 1, do_write = 1;
+	size_t iosize, min_iosize = MIN_IOSIZE, max_iosize = sizeof(buffer);
+	gfarm_off_t total = 1024 * 1024 * 1024;
+	double t;
+
+	if (argc > 0)
+		program_name = basename(argv[0]);
+	while ((c = getopt(argc, argv, "b:rs:w")) != -1) {
+		switch (c) {
+		case 'b':
+			min_iosize = max_iosize = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			do_write = 0;
+			break;
+		case 's':
+			total = strtol(optarg, NULL, 0) * 1024 * 1024;
+			break;
+		case 'w':
+			do_read = 0;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (min_iosize <= 0 || max_iosize > sizeof(buffer) || total <= 0)
+		usage();
+
+	check(gfarm_context_init(), "gfarm_context_init");
+	gfarm_ctxp->network_receive_timeout = 60;
+	check(gfp_xdr_new_client_socket(connect_server(), &conn),
+	    "client connection");
+
+	printf("%8s %12s %12s\n", "iosize", "pwrite MB/s", "pread MB/s");
+	for (iosize = min_iosize; iosize <= max_iosize; iosize *= 2) {
+		printf("%8lu", (unsigned long)iosize);
+		if (do_write) {
+			t = measure(conn, GFS_PROTO_PWRITE, iosize, total);
+			printf(" %12.1f", total / t / 1e6);
+		} else
+			printf(" %12s", "-");
+		if (do_read) {
+			t = measure(conn, GFS_PROTO_PREAD, iosize, total);
+			printf(" %12.1f", total / t / 1e6);
+		} else
+			printf(" %12s", "-");
+		printf("\n");
+		fflush(stdout);
+	}
+	gfp_xdr_free(conn);
+	wait(NULL);
+	return (0);
+}
@@ -0,0 +1,301 @@
+/*
+ * $Id$
+ *
+ * microbenchmark of job dispatching of the gfmd thread pool.
+ *
+ * producer threads add jobs to a thread pool, and each job spins
+ * a while and reports its completion to its producer.
+ * this compares server/gfmd/thrpool.c with the legacy thread pool,
+ * which has one job queue shared by all worker threads.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "thrsubr.h"
+
+#include "thrpool.h"
+
+char *program_name = "thrpool-dispatch";
+
+/*
+ * stubs of gfmd functions which are called from thrpool.o
+ */
+
+gfarm_error_t
+create_detached_thread(void *(*thread_main)(void *), void *arg)
+{
+	int err;
+	pthread_t thread_id;
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&thread_id, &attr, thread_main, arg);
+	pthread_attr_destroy(&attr);
+	return (err == 0 ? GFARM_ERR_NO_ERROR : gfarm_errno_to_error(err));
+}
+
+int
+giant_stat_owner_set(int owner)
+{
+	return (owner);
+}
+
+void
+rpcstat_job_enqueued(struct timespec *queued_atp)
+{
+	queued_atp->tv_nsec = -1; /* not measured */
+}
+
+void
+rpcstat_job_started(struct timespec *queued_atp)
+{
+}
+
+/*
+ * the legacy thread pool, i.e. thrpool.c before work-stealing
+ */
+
+struct legacy_job {
+	void *(*thread_main)(void *);
+	void *arg;
+};
+
+struct legacy_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t nonfull, nonempty;
+	int size, n, in, out;
+	struct legacy_job *entries;
+	int pool_size, threads, idles;
+};
+
+static void *
+legacy_worker(void *arg)
+{
+	struct legacy_pool *p = arg;
+	struct legacy_job job;
+	static const char diag[] = "legacy_worker";
+
+	for (;;) {
+		gfarm_mutex_lock(&p->mutex, diag, "legacy");
+		p->idles++;
+		while (p->n <= 0)
+			gfarm_cond_wait(&p->nonempty, &p->mutex, diag,
+			    "nonempty");
+		job = p->entries[p->out++];
+		if (p->out >= p->size)
+			p->out = 0;
+		p->n--;
+		p->idles--;
+		gfarm_cond_signal(&p->nonfull, diag, "nonfull");
+		gfarm_mutex_unlock(&p->mutex, diag, "legacy");
+
+		(*job.thread_main)(job.arg);
+	}
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+static struct legacy_pool *
+legacy_new(int pool_size, int queue_length)
+{
+	struct legacy_pool *p;
+	static const char diag[] = "legacy_new";
+
+	GFARM_MALLOC(p);
+	if (p == NULL)
+		return (NULL);
+	GFARM_MALLOC_ARRAY(p->entries, queue_length);
+	if (p->entries == NULL) {
+		free(p);
+		return (NULL);
+	}
+	gfarm_mutex_init(&p->mutex, diag, "legacy");
+	gfarm_cond_init(&p->nonempty, diag, "nonempty");
+	gfarm_cond_init(&p->nonfull, diag, "nonfull");
+	p->size = queue_length;
+	p->n = p->in = p->out = 0;
+	p->pool_size = pool_size;
+	p->threads = p->idles = 0;
+	return (p);
+}
+
+static void
+legacy_add_job(struct legacy_pool *p, void *(*thread_main)(void *), void *arg)
+{
+	static const char diag[] = "legacy_add_job";
+
+	gfarm_mutex_lock(&p->mutex, diag, "legacy");
+	if (p->threads < p->pool_size && p->idles <= 0 &&
+	    create_detached_thread(legacy_worker, p) == GFARM_ERR_NO_ERROR)
+		p->threads++;
+	while (p->n >= p->size)
+		gfarm_cond_wait(&p->nonfull, &p->mutex, diag, "nonfull");
+	p->entries[p->in].thread_main = thread_main;
+	p->entries[p->in].arg = arg;
+	if (++p->in >= p->size)
+		p->in = 0;
+	p->n++;
+	gfarm_cond_signal(&p->nonempty, diag, "nonempty");
+	gfarm_mutex_unlock(&p->mutex, diag, "legacy");
+}
+
+/*
+ * benchmark
+ */
+
+static int work_loops = 100;
+static int use_affinity = 0;
+static int use_legacy = 0;
+static int njobs = 100000;
+
+static struct thread_pool *pool;
+static struct legacy_pool *lpool;
+
+struct producer {
+	pthread_t thread;
+	int index;
+	pthread_mutex_t mutex;
+	pthread_cond_t done_cond;
+	int done;
+};
+
+static void *
+job_main(void *arg)
+{
+	struct producer *pr = arg;
+	volatile int i, x = 0;
+	static const char diag[] = "job_main";
+
+	for (i = 0; i < work_loops; i++)
+		x += i;
+
+	gfarm_mutex_lock(&pr->mutex, diag, "producer");
+	if (++pr->done == njobs)
+		gfarm_cond_signal(&pr->done_cond, diag, "done");
+	gfarm_mutex_unlock(&pr->mutex, diag, "producer");
+	return (NULL);
+}
+
+static void *
+producer_main(void *arg)
+{
+	struct producer *pr = arg;
+	int i;
+	static const char diag[] = "producer_main";
+
+	for (i = 0; i < njobs; i++) {
+		if (use_legacy)
+			legacy_add_job(lpool, job_main, pr);
+		else if (use_affinity)
+			thrpool_add_job_with_affinity(pool, job_main, pr,
+			    pr->index);
+		else
+			thrpool_add_job(pool, job_main, pr);
+	}
+
+	gfarm_mutex_lock(&pr->mutex, diag, "producer");
+	while (pr->done < njobs)
+		gfarm_cond_wait(&pr->done_cond, &pr->mutex, diag, "done");
+	gfarm_mutex_unlock(&pr->mutex, diag, "producer");
+	return (NULL);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-aL] [-n jobs_per_producer] "
+	    "[-p producers]\n"
+	    "\t[-q queue_length] [-t threads] [-w work_loops]\n",
+	    program_name);
+	fprintf(stderr, "\t-a\tadd jobs with the producer as the affinity\n");
+	fprintf(stderr, "\t-L\tuse the legacy thread pool\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	int c, i, nproducers = 4, pool_size = 16, queue_length = 16000;
+	struct producer *producers;
+	struct timespec start, end;
+	double t;
+	static const char diag[] = "main";
+
+	while ((c = getopt(argc, argv, "aLn:p:q:t:w:")) != -1) {
+		switch (c) {
+		case 'a':
+			use_affinity = 1;
+			break;
+		case 'L':
+			use_legacy = 1;
+			break;
+		case 'n':
+			njobs = atoi(optarg);
+			break;
+		case 'p':
+			nproducers = atoi(optarg);
+			break;
+		case 'q':
+			queue_length = atoi(optarg);
+			break;
+		case 't':
+			pool_size = atoi(optarg);
+			break;
+		case 'w':
+			work_loops = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (njobs <= 0 || nproducers <= 0 || queue_length <= 0 ||
+	    pool_size <= 0)
+		usage();
+
+	if (use_legacy)
+		lpool = legacy_new(pool_size, queue_length);
+	else
+		pool = thrpool_new(pool_size, queue_length, "benchmark");
+	GFARM_MALLOC_ARRAY(producers, nproducers);
+	if ((use_legacy ? (void *)lpool : (void *)pool) == NULL ||
+	    producers == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		return (1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < nproducers; i++) {
+		producers[i].index = i;
+		producers[i].done = 0;
+		gfarm_mutex_init(&producers[i].mutex, diag, "producer");
+		gfarm_cond_init(&producers[i].done_cond, diag, "done");
+		if (pthread_create(&producers[i].thread, NULL,
+		    producer_main, &producers[i]) != 0) {
+			fprintf(stderr, "%s: cannot create a producer\n",
+			    program_name);
+			return (1);
+		}
+	}
+	for (i = 0; i < nproducers; i++)
+		pthread_join(producers[i].thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	t = (end.tv_sec - start.tv_sec) +
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%s%s: threads %d, producers %d, %d jobs in %.3f sec, "
+	    "%.0f jobs/sec\n",
+	    use_legacy ? "legacy" : "work-stealing",
+	    !use_legacy && use_affinity ? " (affinity)" : "",
+	    pool_size, nproducers, njobs * nproducers, t,
+	    njobs * nproducers / t);
+	return (0);
+}
@@ -0,0 +1,212 @@
+/*
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libgen.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfarm_path.h"
+
+#define DAY	(24 * 60 * 60)
+
+static char *program_name = "gffind";
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-n name] [-t type] [-s min:max] "
+	    "[-m days] [-M days]\n"
+	    "\t[-a days] [-A days] [-u user] [-g group] [-c min:max] "
+	    "[-d maxdepth] [-l] path\n", program_name);
+	fprintf(stderr, "\t-n\tname matches the glob pattern\n");
+	fprintf(stderr, "\t-t\ttype is one of f (file), d (directory) "
+	    "or l (symlink)\n");
+	fprintf(stderr, "\t-s\tsize in bytes is in the range\n");
+	fprintf(stderr, "\t-m\tmodified within the days\n");
+	fprintf(stderr, "\t-M\tnot modified within the days\n");
+	fprintf(stderr, "\t-a\taccessed within the days\n");
+	fprintf(stderr, "\t-A\tnot accessed within the days\n");
+	fprintf(stderr, "\t-u\towned by the user\n");
+	fprintf(stderr, "\t-g\towned by the group\n");
+	fprintf(stderr, "\t-c\tnumber of replicas of a file is in the range\n");
+	fprintf(stderr, "\t-d\tdescend at most maxdepth levels\n");
+	fprintf(stderr, "\t-l\tprint mode, number of replicas and size, too\n");
+	exit(2);
+}
+
+static gfarm_int64_t
+parse_int(const char *s, const char *opt)
+{
+	char *ep;
+	long long v = strtoll(s, &ep, 10);
+
+	if (*s == '\0' || *ep != '\0' || v < 0) {
+		fprintf(stderr, "%s: %s: invalid argument: %s\n",
+		    program_name, opt, s);
+		exit(2);
+	}
+	return (v);
+}
+
+/* "min:max", either of them may be omitted */
+static void
+parse_range(char *s, const char *opt, gfarm_int64_t *minp,
+	gfarm_int64_t *maxp)
+{
+	char *colon = strchr(s, ':');
+
+	if (colon == NULL) {
+		*minp = *maxp = parse_int(s, opt);
+		return;
+	}
+	*colon = '\0';
+	*minp = s[0] == '\0' ? 0 : parse_int(s, opt);
+	*maxp = colon[1] == '\0' ? GFARM_INT64_MAX : parse_int(colon + 1, opt);
+}
+
+static void
+parse_type(const char *s, int *typesp)
+{
+	switch (s[0] == '\0' || s[1] != '\0' ? '\0' : s[0]) {
+	case 'f':
+		*typesp |= GFS_FIND_TYPE_BIT(GFS_DT_REG);
+		break;
+	case 'd':
+		*typesp |= GFS_FIND_TYPE_BIT(GFS_DT_DIR);
+		break;
+	case 'l':
+		*typesp |= GFS_FIND_TYPE_BIT(GFS_DT_LNK);
+		break;
+	default:
+		fprintf(stderr, "%s: -t: invalid argument: %s\n",
+		    program_name, s);
+		exit(2);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e, e2;
+	struct gfs_find_cond cond;
+	GFS_Find find;
+	char *path, *realpath = NULL, *fpath;
+	struct gfs_stat *st;
+	gfarm_int64_t days;
+	time_t now = time(NULL);
+	int c, long_format = 0;
+
+	if (argc > 0)
+		program_name = basename(argv[0]);
+
+	memset(&cond, 0, sizeof(cond));
+	cond.maxdepth = -1;
+	cond.mtime_max = cond.atime_max = GFARM_INT64_MAX;
+	while ((c = getopt(argc, argv, "a:A:c:d:g:lm:M:n:s:t:u:h?")) != -1) {
+		switch (c) {
+		case 'a':
+		case 'A':
+		case 'm':
+		case 'M':
+			days = parse_int(optarg, c == 'a' ? "-a" :
+			    c == 'A' ? "-A" : c == 'm' ? "-m" : "-M");
+			if (c == 'a' || c == 'A')
+				cond.flags |= GFS_FIND_ATIME;
+			else
+				cond.flags |= GFS_FIND_MTIME;
+			if (c == 'a')
+				cond.atime_min = now - days * DAY;
+			else if (c == 'A')
+				cond.atime_max = now - days * DAY - 1;
+			else if (c == 'm')
+				cond.mtime_min = now - days * DAY;
+			else
+				cond.mtime_max = now - days * DAY - 1;
+			break;
+		case 'c':
+			cond.flags |= GFS_FIND_NCOPY;
+			parse_range(optarg, "-c", &cond.ncopy_min,
+			    &cond.ncopy_max);
+			break;
+		case 'd':
+			cond.maxdepth = parse_int(optarg, "-d");
+			break;
+		case 'g':
+			cond.flags |= GFS_FIND_GROUP;
+			cond.group = optarg;
+			break;
+		case 'l':
+			long_format = 1;
+			break;
+		case 'n':
+			cond.flags |= GFS_FIND_NAME;
+			cond.name = optarg;
+			break;
+		case 's':
+			cond.flags |= GFS_FIND_SIZE;
+			parse_range(optarg, "-s", &cond.size_min,
+			    &cond.size_max);
+			break;
+		case 't':
+			cond.flags |= GFS_FIND_TYPE;
+			parse_type(optarg, &cond.types);
+			break;
+		case 'u':
+			cond.flags |= GFS_FIND_USER;
+			cond.user = optarg;
+			break;
+		case 'h':
+		case '?':
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	e = gfarm_initialize(NULL, NULL);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: %s\n", program_name,
+		    gfarm_error_string(e));
+		exit(1);
+	}
+	e = gfarm_realpath_by_gfarm2fs(argv[0], &realpath);
+	path = e == GFARM_ERR_NO_ERROR ? realpath : argv[0];
+
+	e = gfs_find_open(path, &cond, &find);
+	if (e == GFARM_ERR_NO_ERROR) {
+		while ((e = gfs_find_read(find, &fpath, &st)) ==
+		    GFARM_ERR_NO_ERROR && fpath != NULL) {
+			if (long_format)
+				printf("%06o %3lld %12lld %s\n",
+				    (unsigned int)st->st_mode,
+				    (long long)st->st_ncopy,
+				    (long long)st->st_size, fpath);
+			else
+				printf("%s\n", fpath);
+		}
+		e2 = gfs_find_close(find);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = e2;
+	}
+	if (e != GFARM_ERR_NO_ERROR)
+		fprintf(stderr, "%s: %s: %s\n", program_name, argv[0],
+		    gfarm_error_string(e));
+	free(realpath);
+
+	e2 = gfarm_terminate();
+	if (e2 != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: %s\n", program_name,
+		    gfarm_error_string(e2));
+		exit(1);
+	}
+	return (e == GFARM_ERR_NO_ERROR ? 0 : 1);
+}
@@ -32,13 +32,15 @@ struct gfm_connection *gfm_conn = NULL;
 #define OP_MODIFY_ENTRY		'm'
 #define OP_DELETE_ENTRY		'd'
 #define OP_NOP			'N'
+#define OP_LOCK_STAT		'L'
 
 
 static void
 usage(void)
 {
 	fprintf(stderr, "Usage:"
-	    "\t%s %s\n" "\t%s %s\n" "\t%s %s\n" "\t%s %s\n" "\t%s %s\n",
+	    "\t%s %s\n" "\t%s %s\n" "\t%s %s\n" "\t%s %s\n" "\t%s %s\n"
+	    "\t%s %s\n",
 	    program_name,
 	    "[-l] [-P <path>] [-1]",
 	    program_name,
@@ -50,7 +52,9 @@ usage(void)
 	    "-m   [-P <path>] [-1] "
 	    "[-p <port>] [-C <clustername>] [-t <m|c|s>] <hostname>",
 	    program_name,
-	    "-d   [-P <path>] [-1] <hostname> ...");
+	    "-d   [-P <path>] [-1] <hostname> ...",
+	    program_name,
+	    "-L   [-P <path>] [-1] [-v] [-Z]");
 	exit(EXIT_FAILURE);
 }
 
@@ -250,6 +254,98 @@ do_list(int detail)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static int
+compare_giant_lock_stat(const void *a, const void *b)
+{
+	const struct gfm_giant_lock_stat *sa =
+		*(const struct gfm_giant_lock_stat **)a;
+	const struct gfm_giant_lock_stat *sb =
+		*(const struct gfm_giant_lock_stat **)b;
+
+	/* the most waited first */
+	if (sa->wait_total > sb->wait_total)
+		return (-1);
+	if (sa->wait_total < sb->wait_total)
+		return (1);
+	return (strcmp(sa->name, sb->name));
+}
+
+static void
+print_giant_lock_histogram(const char *title, int nbuckets,
+	gfarm_uint64_t *hist)
+{
+	int i;
+
+	printf("\t%s:", title);
+	for (i = 0; i < nbuckets; i++) {
+		if (hist[i] == 0)
+			continue;
+		/* bucket i counts [2^(i-1), 2^i) usec */
+		if (i == 0)
+			printf(" <1us:%llu", (unsigned long long)hist[i]);
+		else if (i == nbuckets - 1)
+			printf(" >=%lluus:%llu", 1ULL << (i - 1),
+			    (unsigned long long)hist[i]);
+		else
+			printf(" %lluus:%llu", 1ULL << (i - 1),
+			    (unsigned long long)hist[i]);
+	}
+	printf("\n");
+}
+
+static gfarm_error_t
+do_lock_stat(int verbose, int reset)
+{
+	gfarm_error_t e;
+	int i, n, nbuckets;
+	struct gfm_giant_lock_stat *gs, *stats, **pstats;
+
+	if ((e = gfm_client_giant_lock_stat_get(gfm_conn,
+	    reset ? GFM_PROTO_GIANT_LOCK_STAT_RESET : 0,
+	    &n, &nbuckets, &stats)) != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (n == 0)
+		return (GFARM_ERR_NO_ERROR);
+
+	GFARM_MALLOC_ARRAY(pstats, n);
+	if (pstats == NULL) {
+		gfm_client_giant_lock_stat_free(n, stats);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	for (i = 0; i < n; ++i)
+		pstats[i] = &stats[i];
+	qsort(pstats, n, sizeof(*pstats), compare_giant_lock_stat);
+
+	printf("%10s %10s %12s %9s %9s %12s %9s %9s %s\n",
+	    "count", "shared", "wait-total", "wait-avg", "wait-max",
+	    "hold-total", "hold-avg", "hold-max", "owner");
+	for (i = 0; i < n; ++i) {
+		gs = pstats[i];
+		/* totals are in milliseconds, others are in microseconds */
+		printf("%10llu %10llu %12llu %9llu %9llu "
+		    "%12llu %9llu %9llu %s\n",
+		    (unsigned long long)gs->count,
+		    (unsigned long long)gs->shared_count,
+		    (unsigned long long)gs->wait_total / 1000,
+		    (unsigned long long)gs->wait_total / gs->count,
+		    (unsigned long long)gs->wait_max,
+		    (unsigned long long)gs->hold_total / 1000,
+		    (unsigned long long)gs->hold_total / gs->count,
+		    (unsigned long long)gs->hold_max,
+		    gs->name);
+		if (verbose) {
+			print_giant_lock_histogram("wait", nbuckets,
+			    gs->wait_hist);
+			print_giant_lock_histogram("hold", nbuckets,
+			    gs->hold_hist);
+		}
+	}
+	free(pstats);
+	gfm_client_giant_lock_stat_free(n, stats);
+
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static gfarm_error_t
 do_nop(void)
 {
@@ -346,12 +442,12 @@ main(int argc, char **argv)
 	char *realpath = NULL, *opt_clustername = NULL;
 	int cname_is_set = 0, opt_port = -1, opt_def_master = -1;
 	int opt_master_candidate = -1;
-	int multi_conn_mode = 1;
+	int multi_conn_mode = 1, opt_verbose = 0, opt_reset = 0;
 	int i, c;
 
 	if (argc > 0)
 		program_name = basename(argv[0]);
-	while ((c = getopt(argc, argv, "1C:NP:cdlmp:t:?"))
+	while ((c = getopt(argc, argv, "1C:LNP:Zcdlmp:t:v?"))
 	    != -1) {
 		switch (c) {
 		case '1':
@@ -383,6 +479,7 @@ main(int argc, char **argv)
 		case 'd':
 		case 'l':
 		case 'm':
+		case 'L':
 		case 'N':
 			if (opt_operation != '\0' && opt_operation != c)
 				inconsistent_option(opt_operation, c);
@@ -391,6 +488,12 @@ main(int argc, char **argv)
 		case 'p':
 			opt_port = parse_opt_long(optarg, c, "<port>");
 			break;
+		case 'v':
+			opt_verbose = 1;
+			break;
+		case 'Z':
+			opt_reset = 1;
+			break;
 		case '?':
 			usage();
 		}
@@ -405,6 +508,12 @@ main(int argc, char **argv)
 		usage();
 	}
 
+	if (opt_operation != OP_LOCK_STAT && (opt_verbose || opt_reset)) {
+		fprintf(stderr, "%s: option -v and -Z are only available "
+		    "with -%c\n", program_name, OP_LOCK_STAT);
+		usage();
+	}
+
 	argc -= optind;
 	argv += optind;
 
@@ -429,6 +538,7 @@ main(int argc, char **argv)
 		break;
 	case OP_LIST:
 	case OP_LIST_DETAIL:
+	case OP_LOCK_STAT:
 	case OP_NOP:
 		if (argc > 0) {
 			fprintf(stderr, "%s: too many arguments specified\n",
@@ -504,6 +614,12 @@ main(int argc, char **argv)
 			fprintf(stderr, "%s: %s\n", program_name,
 			    gfarm_error_string(e));
 		break;
+	case OP_LOCK_STAT:
+		if ((e = do_lock_stat(opt_verbose, opt_reset))
+		    != GFARM_ERR_NO_ERROR)
+			fprintf(stderr, "%s: %s\n", program_name,
+			    gfarm_error_string(e));
+		break;
 	case OP_NOP:
 		do_nop();
 		break;
@@ -11,6 +11,8 @@
 #include <gfarm/gfarm.h>
 #include "gfarm_foreach.h"
 #include "gfarm_path.h"
+#include "gfm_client.h"
+#include "gfs_misc.h"
 
 char *program_name = "gfrm";
 
@@ -154,6 +156,32 @@ skip_directory_remove:
 	return (nerr == 0 ? GFARM_ERR_NO_ERROR : e2);
 }
 
+/*
+ * returns GFARM_ERR_FUNCTION_NOT_IMPLEMENTED,
+ * if gfmd doesn't support GFM_PROTO_REMOVE_RECURSIVE
+ */
+static gfarm_error_t
+remove_recursive_by_gfmd(char *file, struct options *options)
+{
+	gfarm_error_t e;
+	static int not_supported = 0;
+
+	if (not_supported)
+		return (GFARM_ERR_FUNCTION_NOT_IMPLEMENTED);
+
+	e = gfs_remove_recursive(file, NULL, NULL);
+	if (gfm_client_is_connection_error(e)) {
+		/* old gfmd closes the connection for an unknown request */
+		not_supported = 1;
+		return (GFARM_ERR_FUNCTION_NOT_IMPLEMENTED);
+	}
+	if (e != GFARM_ERR_NO_ERROR &&
+	    (!options->force || e != GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY))
+		fprintf(stderr, "%s: %s: %s\n",
+		    program_name, file, gfarm_error_string(e));
+	return (e);
+}
+
 static int
 error_check(gfarm_error_t e)
 {
@@ -238,6 +266,18 @@ main(int argc, char **argv)
 		e = gfarm_realpath_by_gfarm2fs(file, &realpath);
 		if (e == GFARM_ERR_NO_ERROR)
 			file = realpath;
+		/* gfmd removes the whole tree, if only names are removed */
+		if (options.recursive && !options.noexecute &&
+		    options.host == NULL && options.domain == NULL &&
+		    (e = remove_recursive_by_gfmd(file, &options)) !=
+		    GFARM_ERR_FUNCTION_NOT_IMPLEMENTED) {
+			if (e != GFARM_ERR_NO_ERROR &&
+			    (!options.force ||
+			     e != GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY))
+				status = 1;
+			free(realpath);
+			continue;
+		}
 		e = gfarm_foreach_directory_hierarchy(
 			add_file, op_dir_before, add_dir, file, &files);
 
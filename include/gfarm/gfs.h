@@ -225,6 +225,36 @@ gfarm_error_t gfs_closedirplus(GFS_DirPlus);
 gfarm_error_t gfs_readdirplus(GFS_DirPlus,
 	struct gfs_dirent **, struct gfs_stat **);
 
+/* directory tree walk done by gfmd, conditions are ANDed */
+#define GFS_FIND_NAME	0x01	/* name matches glob pattern */
+#define GFS_FIND_TYPE	0x02	/* GFS_FIND_TYPE_BIT(type) is in types */
+#define GFS_FIND_SIZE	0x04	/* ranges are inclusive */
+#define GFS_FIND_MTIME	0x08
+#define GFS_FIND_ATIME	0x10
+#define GFS_FIND_USER	0x20
+#define GFS_FIND_GROUP	0x40
+#define GFS_FIND_NCOPY	0x80	/* regular files only */
+#define GFS_FIND_TYPE_BIT(type)	(1 << (type))
+
+struct gfs_find_cond {
+	int flags;
+	char *name;
+	int types;
+	gfarm_off_t size_min, size_max;
+	gfarm_time_t mtime_min, mtime_max;
+	gfarm_time_t atime_min, atime_max;
+	char *user, *group;
+	gfarm_int64_t ncopy_min, ncopy_max;
+	int maxdepth;	/* levels below the starting directory, -1: infinite */
+};
+
+typedef struct gfs_find *GFS_Find;
+
+gfarm_error_t gfs_find_open(const char *, const struct gfs_find_cond *,
+	GFS_Find *);
+gfarm_error_t gfs_find_close(GFS_Find);
+gfarm_error_t gfs_find_read(GFS_Find, char **, struct gfs_stat **);
+
 gfarm_error_t gfs_realpath(const char *, char **);
 
 /*
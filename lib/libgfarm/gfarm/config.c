@@ -59,6 +59,8 @@
 #define LISTEN_BACKLOG_DEFAULT	5
 #endif
 
+#define GFARM_SPOOL_SERVER_WORKER_PROCESSES_DEFAULT	0 /* fork per client */
+
 #define staticp	(gfarm_ctxp->config_static)
 
 #define MAX_CONFIG_LINE_LENGTH	1023
@@ -837,6 +839,7 @@ gfarm_set_local_user_for_this_uid(uid_t uid)
  */
 /* GFS dependent */
 int gfarm_spool_server_listen_backlog = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_spool_server_worker_processes = GFARM_CONFIG_MISC_DEFAULT;
 char *gfarm_spool_server_listen_address = NULL;
 char *gfarm_spool_root = NULL;
 static struct {
@@ -920,17 +923,29 @@ int	gfarm_iostat_max_client = GFARM_CONFIG_MISC_DEFAULT;
 #define GFS_PROTO_FHREMOVE_REQUEST_WINDOW_DEFAULT		50
 #define GFS_PROTO_REPLICATION_REQUEST_WINDOW_DEFAULT		20
 #define GFARM_OUTSTANDING_FILE_REPLICATION_LIMIT_DEFAULT	4194304 /* 512MB / (sizeof(file_replication), i.e. 128B) */
+#define GFARM_FILE_REPLICATION_SOURCE_LIMIT_DEFAULT	0 /* unlimited */
+#define GFARM_FILE_REPLICATION_TOTAL_LIMIT_DEFAULT	0 /* unlimited */
+#define GFARM_FILE_REPLICATION_BANDWIDTH_LIMIT_DEFAULT	0 /* unlimited */
+#define GFARM_FILE_REPLICATION_HOST_BANDWIDTH_LIMIT_DEFAULT 0 /* unlimited */
 #define GFARM_GFSD_CONNECTION_CACHE_DEFAULT 16 /* 16 free connections */
 #define GFARM_GFMD_CONNECTION_CACHE_DEFAULT  8 /*  8 free connections */
 #define GFARM_METADB_MAX_DESCRIPTORS_DEFAULT	(2*65536)
 #define GFARM_CLIENT_FILE_BUFSIZE_DEFAULT	(1024 * 1024)
 #define GFARM_CLIENT_PARALLEL_COPY_DEFAULT	4
+#define GFARM_CLIENT_BULKREAD_WINDOW_DEFAULT	0 /* disabled */
+#define GFARM_CLIENT_READAHEAD_DEFAULT		8
 #define GFARM_PROFILE_DEFAULT 0 /* disable */
 #define GFARM_METADB_REPLICATION_ENABLED_DEFAULT	0
 #define GFARM_JOURNAL_MAX_SIZE_DEFAULT		(32 * 1024 * 1024) /* 32MB */
 #define GFARM_JOURNAL_RECVQ_SIZE_DEFAULT	100000
 #define GFARM_JOURNAL_SYNC_FILE_DEFAULT		1
 #define GFARM_JOURNAL_SYNC_SLAVE_TIMEOUT_DEFAULT 10 /* 10 second */
+#define GFARM_JOURNAL_GROUP_COMMIT_DEFAULT	0 /* disable */
+#define GFARM_JOURNAL_GROUP_COMMIT_WINDOW_DEFAULT 0 /* microsecond */
+#define GFARM_JOURNAL_GROUP_COMMIT_MAX_BATCH_DEFAULT 64
+#define GFARM_METADB_SNAPSHOT_INTERVAL_DEFAULT	0 /* disable */
+#define GFARM_METADB_SERVER_LOAD_THREADS_DEFAULT	1 /* sequential */
+#define GFARM_JOURNAL_REPLAY_THREADS_DEFAULT	0 /* not pipelined */
 #define GFARM_METADB_SERVER_SLAVE_MAX_SIZE_DEFAULT	16
 #define GFARM_METADB_SERVER_FORCE_SLAVE_DEFAULT		0
 #define GFARM_METADB_SERVER_SLAVE_LISTEN_DEFAULT	0
@@ -941,12 +956,19 @@ int	gfarm_iostat_max_client = GFARM_CONFIG_MISC_DEFAULT;
 #define GFARM_REPLICA_CHECK_HOST_DOWN_THRESH_DEFAULT 10800 /* 3 hours */
 #define GFARM_REPLICA_CHECK_SLEEP_TIME_DEFAULT 100000 /* nanosec. */
 #define GFARM_REPLICA_CHECK_MINIMUM_INTERVAL_DEFAULT 10 /* 10 sec. */
+#define GFARM_REPLICA_CHECK_AUDIT_INTERVAL_DEFAULT 604800 /* 1 week */
+#define GFARM_REPLICA_CHECK_AUDIT_RATE_DEFAULT 10000 /* files/sec. */
 #ifdef not_def_REPLY_QUEUE
 int gfm_proto_reply_to_gfsd_window = GFARM_CONFIG_MISC_DEFAULT;
 #endif
 int gfs_proto_fhremove_request_window = GFARM_CONFIG_MISC_DEFAULT;
 int gfs_proto_replication_request_window = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_outstanding_file_replication_limit = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_file_replication_source_limit = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_file_replication_total_limit = GFARM_CONFIG_MISC_DEFAULT;
+gfarm_off_t gfarm_file_replication_bandwidth_limit = GFARM_CONFIG_MISC_DEFAULT;
+gfarm_off_t gfarm_file_replication_host_bandwidth_limit =
+	GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_xattr_size_limit = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_xmlattr_size_limit = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_max_descriptors = GFARM_CONFIG_MISC_DEFAULT;
@@ -955,12 +977,20 @@ int gfarm_metadb_thread_pool_size = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_job_queue_length = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_heartbeat_interval = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_dbq_size = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_shared_giant_lock = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_giant_lock_profile = GFARM_CONFIG_MISC_DEFAULT;
 static int metadb_replication_enabled = GFARM_CONFIG_MISC_DEFAULT;
 static char *journal_dir = NULL;
 static int journal_max_size = GFARM_CONFIG_MISC_DEFAULT;
 static int journal_recvq_size = GFARM_CONFIG_MISC_DEFAULT;
 static int journal_sync_file = GFARM_CONFIG_MISC_DEFAULT;
 static int journal_sync_slave_timeout = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_group_commit = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_group_commit_window = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_group_commit_max_batch = GFARM_CONFIG_MISC_DEFAULT;
+static int metadb_snapshot_interval = GFARM_CONFIG_MISC_DEFAULT;
+static int metadb_server_load_threads = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_replay_threads = GFARM_CONFIG_MISC_DEFAULT;
 static int metadb_server_slave_max_size = GFARM_CONFIG_MISC_DEFAULT;
 static int metadb_server_force_slave = GFARM_CONFIG_MISC_DEFAULT;
 static int metadb_server_slave_listen = GFARM_CONFIG_MISC_DEFAULT;
@@ -968,6 +998,8 @@ int gfarm_replica_check = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_host_down_thresh = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_sleep_time = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_minimum_interval = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_replica_check_audit_interval = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_replica_check_audit_rate = GFARM_CONFIG_MISC_DEFAULT;
 
 void
 gfarm_config_clear(void)
@@ -1237,6 +1269,42 @@ gfarm_get_journal_sync_slave_timeout(void)
 	return (journal_sync_slave_timeout);
 }
 
+int
+gfarm_get_journal_group_commit(void)
+{
+	return (journal_group_commit);
+}
+
+int
+gfarm_get_journal_group_commit_window(void)
+{
+	return (journal_group_commit_window);
+}
+
+int
+gfarm_get_journal_group_commit_max_batch(void)
+{
+	return (journal_group_commit_max_batch);
+}
+
+int
+gfarm_get_metadb_snapshot_interval(void)
+{
+	return (metadb_snapshot_interval);
+}
+
+int
+gfarm_get_metadb_server_load_threads(void)
+{
+	return (metadb_server_load_threads);
+}
+
+int
+gfarm_get_journal_replay_threads(void)
+{
+	return (journal_replay_threads);
+}
+
 int
 gfarm_get_metadb_server_slave_max_size(void)
 {
@@ -2732,6 +2800,9 @@ parse_one_line(char *s, char *p, char **op)
 		e = parse_set_var(p, &gfarm_spool_server_listen_address);
 	} else if (strcmp(s, o = "spool_server_listen_backlog") == 0) {
 		e = parse_set_misc_int(p, &gfarm_spool_server_listen_backlog);
+	} else if (strcmp(s, o = "spool_server_worker_processes") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_spool_server_worker_processes);
 	} else if (strcmp(s, o = "spool_server_cred_type") == 0) {
 		e = parse_cred_config(p, GFS_SERVICE_TAG,
 		    gfarm_auth_server_cred_type_set_by_string);
@@ -2935,6 +3006,19 @@ parse_one_line(char *s, char *p, char **op)
 	} else if (strcmp(s, o = "outstanding_file_replication_limit") == 0) {
 		e = parse_set_misc_int(p,
 		    &gfarm_outstanding_file_replication_limit);
+	} else if (strcmp(s, o = "file_replication_source_limit") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_file_replication_source_limit);
+	} else if (strcmp(s, o = "file_replication_total_limit") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_file_replication_total_limit);
+	} else if (strcmp(s, o = "file_replication_bandwidth_limit") == 0) {
+		e = parse_set_misc_offset(p,
+		    &gfarm_file_replication_bandwidth_limit);
+	} else if (strcmp(s, o = "file_replication_host_bandwidth_limit")
+	    == 0) {
+		e = parse_set_misc_offset(p,
+		    &gfarm_file_replication_host_bandwidth_limit);
 	} else if (strcmp(s, o = "gfsd_connection_cache") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->gfsd_connection_cache);
 	} else if (strcmp(s, o = "gfmd_connection_cache") == 0) {
@@ -2965,6 +3049,10 @@ parse_one_line(char *s, char *p, char **op)
 		e = parse_set_misc_int(p, &gfarm_metadb_heartbeat_interval);
 	} else if (strcmp(s, o = "metadb_server_dbq_size") == 0) {
 		e = parse_set_misc_int(p, &gfarm_metadb_dbq_size);
+	} else if (strcmp(s, o = "metadb_server_shared_giant_lock") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_metadb_shared_giant_lock);
+	} else if (strcmp(s, o = "metadb_server_giant_lock_profile") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_metadb_giant_lock_profile);
 	} else if (strcmp(s, o = "record_atime") == 0) {
 		int record_atime;
 
@@ -2978,6 +3066,11 @@ parse_one_line(char *s, char *p, char **op)
 	} else if (strcmp(s, o = "client_parallel_copy") == 0) {
 		e = parse_set_misc_int(p,
 		    &gfarm_ctxp->client_parallel_copy);
+	} else if (strcmp(s, o = "client_bulkread_window") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_ctxp->client_bulkread_window);
+	} else if (strcmp(s, o = "client_readahead") == 0) {
+		e = parse_set_misc_int(p, &gfarm_ctxp->client_readahead);
 	} else if (strcmp(s, o = "profile") == 0) {
 		e = parse_profile(p, &staticp->profile);
 	} else if (strcmp(s, o = "iostat_gfmd_path") == 0) {
@@ -2998,6 +3091,19 @@ parse_one_line(char *s, char *p, char **op)
 		e = parse_set_misc_enabled(p, &journal_sync_file);
 	} else if (strcmp(s, o = "synchronous_replication_timeout") == 0) {
 		e = parse_set_misc_int(p, &journal_sync_slave_timeout);
+	} else if (strcmp(s, o = "metadb_journal_group_commit") == 0) {
+		e = parse_set_misc_enabled(p, &journal_group_commit);
+	} else if (strcmp(s, o = "metadb_journal_group_commit_window") == 0) {
+		e = parse_set_misc_int(p, &journal_group_commit_window);
+	} else if (strcmp(s, o = "metadb_journal_group_commit_max_batch")
+	    == 0) {
+		e = parse_set_misc_int(p, &journal_group_commit_max_batch);
+	} else if (strcmp(s, o = "metadb_snapshot_interval") == 0) {
+		e = parse_set_misc_int(p, &metadb_snapshot_interval);
+	} else if (strcmp(s, o = "metadb_server_load_threads") == 0) {
+		e = parse_set_misc_int(p, &metadb_server_load_threads);
+	} else if (strcmp(s, o = "metadb_journal_replay_threads") == 0) {
+		e = parse_set_misc_int(p, &journal_replay_threads);
 	} else if (strcmp(s, o = "metadb_server_slave_max_size") == 0) {
 		e = parse_set_misc_int(p, &metadb_server_slave_max_size);
 	} else if (strcmp(s, o = "metadb_server_force_slave") == 0) {
@@ -3024,6 +3130,11 @@ parse_one_line(char *s, char *p, char **op)
 	} else if (strcmp(s, o = "replica_check_minimum_interval") == 0) {
 		e = parse_set_misc_int(
 		    p, &gfarm_replica_check_minimum_interval);
+	} else if (strcmp(s, o = "replica_check_audit_interval") == 0) {
+		e = parse_set_misc_int(
+		    p, &gfarm_replica_check_audit_interval);
+	} else if (strcmp(s, o = "replica_check_audit_rate") == 0) {
+		e = parse_set_misc_int(p, &gfarm_replica_check_audit_rate);
 
 	} else {
 		o = s;
@@ -3175,6 +3286,9 @@ gfarm_config_set_default_misc(void)
 
 	if (gfarm_spool_server_listen_backlog == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_spool_server_listen_backlog = LISTEN_BACKLOG_DEFAULT;
+	if (gfarm_spool_server_worker_processes == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_spool_server_worker_processes =
+		    GFARM_SPOOL_SERVER_WORKER_PROCESSES_DEFAULT;
 	if (gfarm_metadb_server_listen_backlog == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_metadb_server_listen_backlog = LISTEN_BACKLOG_DEFAULT;
 
@@ -3251,6 +3365,20 @@ gfarm_config_set_default_misc(void)
 	    GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_outstanding_file_replication_limit =
 		    GFARM_OUTSTANDING_FILE_REPLICATION_LIMIT_DEFAULT;
+	if (gfarm_file_replication_source_limit == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_file_replication_source_limit =
+		    GFARM_FILE_REPLICATION_SOURCE_LIMIT_DEFAULT;
+	if (gfarm_file_replication_total_limit == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_file_replication_total_limit =
+		    GFARM_FILE_REPLICATION_TOTAL_LIMIT_DEFAULT;
+	if (gfarm_file_replication_bandwidth_limit ==
+	    GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_file_replication_bandwidth_limit =
+		    GFARM_FILE_REPLICATION_BANDWIDTH_LIMIT_DEFAULT;
+	if (gfarm_file_replication_host_bandwidth_limit ==
+	    GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_file_replication_host_bandwidth_limit =
+		    GFARM_FILE_REPLICATION_HOST_BANDWIDTH_LIMIT_DEFAULT;
 	if (gfarm_ctxp->gfsd_connection_cache == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->gfsd_connection_cache =
 		    GFARM_GFSD_CONNECTION_CACHE_DEFAULT;
@@ -3277,6 +3405,12 @@ gfarm_config_set_default_misc(void)
 		    GFARM_METADB_HEARTBEAT_INTERVAL_DEFAULT;
 	if (gfarm_metadb_dbq_size == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_metadb_dbq_size = GFARM_METADB_DBQ_SIZE_DEFAULT;
+	if (gfarm_metadb_shared_giant_lock == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_shared_giant_lock =
+		    GFARM_METADB_SHARED_GIANT_LOCK_DEFAULT;
+	if (gfarm_metadb_giant_lock_profile == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_giant_lock_profile =
+		    GFARM_METADB_GIANT_LOCK_PROFILE_DEFAULT;
 	if (gfarm_atime_type == GFARM_ATIME_DEFAULT)
 		(void)gfarm_atime_type_set(GFARM_ATIME_RELATIVE);
 	if (gfarm_ctxp->client_file_bufsize == GFARM_CONFIG_MISC_DEFAULT)
@@ -3285,6 +3419,11 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_ctxp->client_parallel_copy == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->client_parallel_copy =
 		    GFARM_CLIENT_PARALLEL_COPY_DEFAULT;
+	if (gfarm_ctxp->client_bulkread_window == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->client_bulkread_window =
+		    GFARM_CLIENT_BULKREAD_WINDOW_DEFAULT;
+	if (gfarm_ctxp->client_readahead == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->client_readahead = GFARM_CLIENT_READAHEAD_DEFAULT;
 	if (staticp->profile == GFARM_CONFIG_MISC_DEFAULT)
 		staticp->profile = GFARM_PROFILE_DEFAULT;
 	if (metadb_replication_enabled == GFARM_CONFIG_MISC_DEFAULT)
@@ -3299,6 +3438,22 @@ gfarm_config_set_default_misc(void)
 	if (journal_sync_slave_timeout == GFARM_CONFIG_MISC_DEFAULT)
 		journal_sync_slave_timeout =
 		    GFARM_JOURNAL_SYNC_SLAVE_TIMEOUT_DEFAULT;
+	if (journal_group_commit == GFARM_CONFIG_MISC_DEFAULT)
+		journal_group_commit = GFARM_JOURNAL_GROUP_COMMIT_DEFAULT;
+	if (journal_group_commit_window == GFARM_CONFIG_MISC_DEFAULT)
+		journal_group_commit_window =
+		    GFARM_JOURNAL_GROUP_COMMIT_WINDOW_DEFAULT;
+	if (journal_group_commit_max_batch == GFARM_CONFIG_MISC_DEFAULT)
+		journal_group_commit_max_batch =
+		    GFARM_JOURNAL_GROUP_COMMIT_MAX_BATCH_DEFAULT;
+	if (metadb_snapshot_interval == GFARM_CONFIG_MISC_DEFAULT)
+		metadb_snapshot_interval =
+		    GFARM_METADB_SNAPSHOT_INTERVAL_DEFAULT;
+	if (metadb_server_load_threads == GFARM_CONFIG_MISC_DEFAULT)
+		metadb_server_load_threads =
+		    GFARM_METADB_SERVER_LOAD_THREADS_DEFAULT;
+	if (journal_replay_threads == GFARM_CONFIG_MISC_DEFAULT)
+		journal_replay_threads = GFARM_JOURNAL_REPLAY_THREADS_DEFAULT;
 	if (metadb_server_slave_max_size == GFARM_CONFIG_MISC_DEFAULT)
 		metadb_server_slave_max_size =
 		    GFARM_METADB_SERVER_SLAVE_MAX_SIZE_DEFAULT;
@@ -3326,6 +3481,12 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_replica_check_minimum_interval == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_replica_check_minimum_interval =
 		    GFARM_REPLICA_CHECK_MINIMUM_INTERVAL_DEFAULT;
+	if (gfarm_replica_check_audit_interval == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_replica_check_audit_interval =
+		    GFARM_REPLICA_CHECK_AUDIT_INTERVAL_DEFAULT;
+	if (gfarm_replica_check_audit_rate == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_replica_check_audit_rate =
+		    GFARM_REPLICA_CHECK_AUDIT_RATE_DEFAULT;
 
 	if (gfarm_iostat_max_client == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_iostat_max_client = GFARM_IOSTAT_MAX_CLIENT;
@@ -5,6 +5,7 @@
 /* gfsd dependent */
 /* GFS dependent */
 extern int gfarm_spool_server_listen_backlog;
+extern int gfarm_spool_server_worker_processes;
 extern char *gfarm_spool_server_listen_address;
 extern char *gfarm_spool_root;
 enum gfarm_spool_check_level {
@@ -48,17 +49,25 @@ extern int gfarm_metadb_thread_pool_size;
 extern int gfarm_metadb_job_queue_length;
 extern int gfarm_metadb_heartbeat_interval;
 extern int gfarm_metadb_dbq_size;
+extern int gfarm_metadb_shared_giant_lock;
+extern int gfarm_metadb_giant_lock_profile;
 #ifdef not_def_REPLY_QUEUE
 extern int gfm_proto_reply_to_gfsd_window;
 #endif
 extern int gfs_proto_fhremove_request_window;
 extern int gfs_proto_replication_request_window;
 extern int gfarm_outstanding_file_replication_limit;
+extern int gfarm_file_replication_source_limit;
+extern int gfarm_file_replication_total_limit;
+extern gfarm_off_t gfarm_file_replication_bandwidth_limit;
+extern gfarm_off_t gfarm_file_replication_host_bandwidth_limit;
 extern int gfarm_relatime;
 extern int gfarm_replica_check;
 extern int gfarm_replica_check_host_down_thresh;
 extern int gfarm_replica_check_sleep_time;
 extern int gfarm_replica_check_minimum_interval;
+extern int gfarm_replica_check_audit_interval;
+extern int gfarm_replica_check_audit_rate;
 #define GFARM_METADB_STACK_SIZE_DEFAULT 0 /* use OS default */
 #define GFARM_METADB_THREAD_POOL_SIZE_DEFAULT	16  /* quadcore, quadsocket */
 #if 0
@@ -68,6 +77,8 @@ extern int gfarm_replica_check_minimum_interval;
 #endif
 #define GFARM_METADB_HEARTBEAT_INTERVAL_DEFAULT 180 /* 3 min */
 #define GFARM_METADB_DBQ_SIZE_DEFAULT	65536
+#define GFARM_METADB_SHARED_GIANT_LOCK_DEFAULT	1 /* enable */
+#define GFARM_METADB_GIANT_LOCK_PROFILE_DEFAULT	1 /* enable */
 #define GFARM_SYMLINK_LEVEL_MAX			20
 
 /* LDAP dependent */
@@ -118,6 +129,12 @@ int gfarm_get_journal_max_size(void);
 int gfarm_get_journal_recvq_size(void);
 int gfarm_get_journal_sync_file(void);
 int gfarm_get_journal_sync_slave_timeout(void);
+int gfarm_get_journal_group_commit(void);
+int gfarm_get_journal_group_commit_window(void);
+int gfarm_get_journal_group_commit_max_batch(void);
+int gfarm_get_metadb_snapshot_interval(void);
+int gfarm_get_metadb_server_load_threads(void);
+int gfarm_get_journal_replay_threads(void);
 int gfarm_get_metadb_server_slave_max_size(void);
 int gfarm_get_metadb_server_force_slave(void);
 void gfarm_set_metadb_server_force_slave(int);
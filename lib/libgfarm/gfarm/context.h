@@ -27,6 +27,8 @@ struct gfarm_context {
 	int gfsd_connection_cache;
 	int client_file_bufsize;
 	int client_parallel_copy;
+	int client_bulkread_window;
+	int client_readahead;
 	int on_demand_replication;
 	int call_rpc_instead_syscall;
 	int network_receive_timeout;
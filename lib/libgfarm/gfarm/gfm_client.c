@@ -3030,6 +3030,92 @@ gfm_client_statfs(struct gfm_connection *gfm_server,
 		    GFM_PROTO_STATFS, "/lll", used, avail, files));
 }
 
+/* called by gftool/gfmdhost */
+gfarm_error_t
+gfm_client_giant_lock_stat_get(struct gfm_connection *gfm_server,
+	gfarm_int32_t flags, int *np, int *nbucketsp,
+	struct gfm_giant_lock_stat **statsp)
+{
+	gfarm_error_t e, e2;
+	struct gfp_xdr_xid_record *xidr;
+	size_t size;
+	gfarm_int32_t n, nbuckets;
+	int i, j;
+	struct gfm_giant_lock_stat *stats = NULL, *gs;
+	static const char diag[] = "gfm_client_giant_lock_stat_get";
+
+	if ((e = gfm_client_rpc_request_and_result_begin(gfm_server,
+	    &xidr, &size, GFM_PROTO_GIANT_LOCK_STAT_GET, "i/ii", flags,
+	    &n, &nbuckets)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "%s: gfm_client_rpc() failed: %s",
+		    diag, gfarm_error_string(e));
+		return (e);
+	}
+	if (n < 0 || nbuckets <= 0 || nbuckets > 64 /* sanity check */) {
+		e = GFARM_ERR_PROTOCOL;
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: n=%d, nbuckets=%d: %s",
+		    diag, (int)n, (int)nbuckets, gfarm_error_string(e));
+		n = 0;
+	} else if (n > 0) {
+		GFARM_CALLOC_ARRAY(stats, n);
+		if (stats == NULL) {
+			e = GFARM_ERR_NO_MEMORY;
+			gflog_debug(GFARM_MSG_UNFIXED, "%s: %s",
+			    diag, gfarm_error_string(e));
+			n = 0;
+		}
+	}
+	for (i = 0; i < n && e == GFARM_ERR_NO_ERROR; i++) {
+		gs = &stats[i];
+		GFARM_MALLOC_ARRAY(gs->wait_hist, nbuckets * 2);
+		if (gs->wait_hist == NULL) {
+			e = GFARM_ERR_NO_MEMORY;
+			gflog_debug(GFARM_MSG_UNFIXED, "%s: %s",
+			    diag, gfarm_error_string(e));
+			break;
+		}
+		gs->hold_hist = gs->wait_hist + nbuckets;
+		e = gfm_client_xdr_recv(gfm_server, &size, "sllllll",
+		    &gs->name, &gs->count, &gs->shared_count,
+		    &gs->wait_total, &gs->wait_max,
+		    &gs->hold_total, &gs->hold_max);
+		/* wait_hist[] and hold_hist[] are contiguous */
+		for (j = 0; j < nbuckets * 2 && e == GFARM_ERR_NO_ERROR; j++)
+			e = gfm_client_xdr_recv(gfm_server, &size, "l",
+			    &gs->wait_hist[j]);
+		if (e != GFARM_ERR_NO_ERROR)
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "%s: gfm_client_xdr_recv() failed: %s",
+			    diag, gfarm_error_string(e));
+	}
+	e2 = gfm_client_rpc_raw_result_end(gfm_server, xidr, size);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = e2;
+	if (e != GFARM_ERR_NO_ERROR) {
+		gfm_client_giant_lock_stat_free(n, stats);
+		return (e);
+	}
+	*np = n;
+	*nbucketsp = nbuckets;
+	*statsp = stats;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+void
+gfm_client_giant_lock_stat_free(int n, struct gfm_giant_lock_stat *stats)
+{
+	int i;
+
+	if (stats == NULL)
+		return;
+	for (i = 0; i < n; i++) {
+		free(stats[i].name);
+		free(stats[i].wait_hist);
+	}
+	free(stats);
+}
+
 gfarm_error_t
 gfm_client_remove_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx, const char *name)
@@ -3045,6 +3131,24 @@ gfm_client_remove_result(struct gfm_connection *gfm_server,
 	return (gfm_client_rpc_result(gfm_server, ctx, ""));
 }
 
+gfarm_error_t
+gfm_client_remove_recursive_request(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, const char *name, gfarm_int32_t limit)
+{
+	return (gfm_client_rpc_request(gfm_server, ctx,
+	    GFM_PROTO_REMOVE_RECURSIVE, "si", name, limit));
+}
+
+gfarm_error_t
+gfm_client_remove_recursive_result(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, gfarm_int32_t *donep,
+	gfarm_int32_t *first_errorp,
+	gfarm_uint64_t *nfilesp, gfarm_uint64_t *ndirsp)
+{
+	return (gfm_client_rpc_result(gfm_server, ctx, "iill",
+	    donep, first_errorp, nfilesp, ndirsp));
+}
+
 gfarm_error_t
 gfm_client_rename_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx,
@@ -3397,6 +3501,92 @@ gfm_client_getdirentsplusxattr_result(struct gfm_connection *gfm_server,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+gfarm_error_t
+gfm_client_find_request(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, const struct gfs_find_cond *cond,
+	gfarm_int32_t n_entries, const char *cookie)
+{
+	return (gfm_client_rpc_request(gfm_server, ctx,
+	    GFM_PROTO_FIND, "isiillllllllssis",
+	    cond->flags, cond->name == NULL ? "" : cond->name,
+	    cond->types, cond->maxdepth,
+	    (gfarm_int64_t)cond->size_min, (gfarm_int64_t)cond->size_max,
+	    (gfarm_int64_t)cond->mtime_min, (gfarm_int64_t)cond->mtime_max,
+	    (gfarm_int64_t)cond->atime_min, (gfarm_int64_t)cond->atime_max,
+	    cond->ncopy_min, cond->ncopy_max,
+	    cond->user == NULL ? "" : cond->user,
+	    cond->group == NULL ? "" : cond->group,
+	    n_entries, cookie));
+}
+
+/* *pathsp and *stvp have to be freed by the caller, even if *np is 0 */
+gfarm_error_t
+gfm_client_find_result(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, int *eofp, char **cookiep,
+	int *np, char ***pathsp, struct gfs_stat **stvp)
+{
+	gfarm_error_t e;
+	int i;
+	gfarm_int32_t eof, n;
+	char *cookie, **paths = NULL;
+	struct gfs_stat *stv = NULL;
+	size_t size;
+
+	e = gfm_client_rpc_result_begin(gfm_server, ctx, &size, "isi",
+	    &eof, &cookie, &n);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfm_client_rpc_result() failed: %s",
+		    gfarm_error_string(e));
+		return (e);
+	}
+	if (n < 0 || n > GFM_PROTO_MAX_DIRENT)
+		e = GFARM_ERR_PROTOCOL;
+	else if (GFARM_MALLOC_ARRAY(paths, n > 0 ? n : 1) == NULL ||
+	    GFARM_MALLOC_ARRAY(stv, n > 0 ? n : 1) == NULL)
+		e = GFARM_ERR_NO_MEMORY;
+	for (i = 0; e == GFARM_ERR_NO_ERROR && i < n; i++) {
+		struct gfs_stat *st = &stv[i];
+
+		e = gfm_client_xdr_recv(gfm_server, &size, "sllilsslllilili",
+		    &paths[i],
+		    &st->st_ino, &st->st_gen, &st->st_mode, &st->st_nlink,
+		    &st->st_user, &st->st_group, &st->st_size,
+		    &st->st_ncopy,
+		    &st->st_atimespec.tv_sec, &st->st_atimespec.tv_nsec,
+		    &st->st_mtimespec.tv_sec, &st->st_mtimespec.tv_nsec,
+		    &st->st_ctimespec.tv_sec, &st->st_ctimespec.tv_nsec);
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "receiving find response failed: %s",
+			    gfarm_error_string(e));
+			break;
+		}
+	}
+	if (e == GFARM_ERR_NO_ERROR &&
+	    (e = gfm_client_rpc_result_end(gfm_server, ctx, size)) !=
+	    GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "get_client_rpc_result_end() failed: %s",
+		    gfarm_error_string(e));
+	if (e != GFARM_ERR_NO_ERROR) {
+		while (--i >= 0) {
+			free(paths[i]);
+			gfs_stat_free(&stv[i]);
+		}
+		free(paths);
+		free(stv);
+		free(cookie);
+		return (e);
+	}
+	*eofp = eof;
+	*cookiep = cookie;
+	*np = n;
+	*pathsp = paths;
+	*stvp = stv;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfm_client_seek_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx, gfarm_off_t offset, gfarm_int32_t whence)
@@ -4053,10 +4243,12 @@ gfm_client_replica_list_by_name_result(struct gfm_connection *gfm_server,
 gfarm_error_t
 gfm_client_replica_list_by_host_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx,
-	const char *host, gfarm_int32_t port)
+	const char *host, gfarm_int32_t port,
+	gfarm_ino_t start_inum, gfarm_int32_t n_req)
 {
 	return (gfm_client_rpc_request(gfm_server, ctx,
-	    GFM_PROTO_REPLICA_LIST_BY_HOST, "si", host, port));
+	    GFM_PROTO_REPLICA_LIST_BY_HOST, "sili",
+	    host, port, start_inum, n_req));
 }
 
 gfarm_error_t
@@ -4109,17 +4301,21 @@ gfm_client_replica_list_by_host_result(struct gfm_connection *gfm_server,
 gfarm_error_t
 gfm_client_replica_remove_by_host_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx,
-	const char *host, gfarm_int32_t port)
+	const char *host, gfarm_int32_t port,
+	gfarm_ino_t start_inum, gfarm_int32_t n_req)
 {
 	return (gfm_client_rpc_request(gfm_server, ctx,
-	    GFM_PROTO_REPLICA_REMOVE_BY_HOST, "si", host, port));
+	    GFM_PROTO_REPLICA_REMOVE_BY_HOST, "sili",
+	    host, port, start_inum, n_req));
 }
 
 gfarm_error_t
 gfm_client_replica_remove_by_host_result(struct gfm_connection *gfm_server,
-	struct gfp_xdr_context *ctx)
+	struct gfp_xdr_context *ctx,
+	gfarm_int32_t *n_removedp, gfarm_ino_t *next_inump)
 {
-	return (gfm_client_rpc_result(gfm_server, ctx, ""));
+	return (gfm_client_rpc_result(gfm_server, ctx, "il",
+	    n_removedp, next_inump));
 }
 
 gfarm_error_t
@@ -4411,7 +4607,12 @@ gfm_client_process_alloc_child(struct gfm_connection *gfm_server,
 gfarm_error_t
 gfm_client_process_free(struct gfm_connection *gfm_server)
 {
-	return (gfm_client_rpc(gfm_server, GFM_PROTO_PROCESS_FREE, "/"));
+	gfarm_error_t e;
+
+	e = gfm_client_rpc(gfm_server, GFM_PROTO_PROCESS_FREE, "/");
+	if (e == GFARM_ERR_NO_ERROR)
+		gfm_server->pid = 0; /* gfm_client_process_is_set() is false */
+	return (e);
 }
 
 #ifndef __KERNEL__      /* gfsd only */
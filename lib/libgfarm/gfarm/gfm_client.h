@@ -1,5 +1,6 @@
 struct gfm_connection;
 struct gfs_dirent;
+struct gfs_find_cond;
 
 struct gfarm_host_info;
 struct gfarm_fsngroup_info;
@@ -292,6 +293,11 @@ gfarm_error_t gfm_client_remove_request(struct gfm_connection *,
 	struct gfp_xdr_context *, const char *);
 gfarm_error_t gfm_client_remove_result(struct gfm_connection *,
 	struct gfp_xdr_context *);
+gfarm_error_t gfm_client_remove_recursive_request(struct gfm_connection *,
+	struct gfp_xdr_context *, const char *, gfarm_int32_t);
+gfarm_error_t gfm_client_remove_recursive_result(struct gfm_connection *,
+	struct gfp_xdr_context *, gfarm_int32_t *, gfarm_int32_t *,
+	gfarm_uint64_t *, gfarm_uint64_t *);
 gfarm_error_t gfm_client_rename_request(struct gfm_connection *,
 	struct gfp_xdr_context *, const char *, const char *);
 gfarm_error_t gfm_client_rename_result(struct gfm_connection *,
@@ -331,6 +337,12 @@ gfarm_error_t gfm_client_getdirentsplusxattr_result(struct gfm_connection *,
 	struct gfp_xdr_context *,
 	int *, struct gfs_dirent *, struct gfs_stat *,
 	int *, char ***, void ***, size_t **);
+gfarm_error_t gfm_client_find_request(struct gfm_connection *,
+	struct gfp_xdr_context *, const struct gfs_find_cond *, gfarm_int32_t,
+	const char *);
+gfarm_error_t gfm_client_find_result(struct gfm_connection *,
+	struct gfp_xdr_context *, int *, char **, int *, char ***,
+	struct gfs_stat **);
 gfarm_error_t gfm_client_seek_request(struct gfm_connection *,
 	struct gfp_xdr_context *, gfarm_off_t, gfarm_int32_t);
 gfarm_error_t gfm_client_seek_result(struct gfm_connection *,
@@ -338,6 +350,17 @@ gfarm_error_t gfm_client_seek_result(struct gfm_connection *,
 gfarm_error_t gfm_client_statfs(struct gfm_connection *,
 	gfarm_off_t *, gfarm_off_t *, gfarm_off_t *);
 
+struct gfm_giant_lock_stat {
+	char *name;		/* request name, or (background activity) */
+	gfarm_uint64_t count, shared_count;
+	gfarm_uint64_t wait_total, wait_max; /* microseconds */
+	gfarm_uint64_t hold_total, hold_max; /* microseconds */
+	gfarm_uint64_t *wait_hist, *hold_hist; /* [nbuckets] */
+};
+gfarm_error_t gfm_client_giant_lock_stat_get(struct gfm_connection *,
+	gfarm_int32_t, int *, int *, struct gfm_giant_lock_stat **);
+void gfm_client_giant_lock_stat_free(int, struct gfm_giant_lock_stat *);
+
 gfarm_error_t gfm_client_setxattr_request(struct gfm_connection *,
 	struct gfp_xdr_context *,
 	int, const char *, const void *, size_t, int);
@@ -434,14 +457,16 @@ gfarm_error_t gfm_client_replica_list_by_name_request(struct gfm_connection *,
 gfarm_error_t gfm_client_replica_list_by_name_result(struct gfm_connection *,
 	struct gfp_xdr_context *, gfarm_int32_t *, char ***);
 gfarm_error_t gfm_client_replica_list_by_host_request(struct gfm_connection *,
-	struct gfp_xdr_context *, const char *, gfarm_int32_t);
+	struct gfp_xdr_context *, const char *, gfarm_int32_t,
+	gfarm_ino_t, gfarm_int32_t);
 gfarm_error_t gfm_client_replica_list_by_host_result(struct gfm_connection *,
 	struct gfp_xdr_context *, gfarm_int32_t *, gfarm_ino_t **);
 gfarm_error_t gfm_client_replica_remove_by_host_request(
 	struct gfm_connection *, struct gfp_xdr_context *,
-	const char *, gfarm_int32_t);
+	const char *, gfarm_int32_t, gfarm_ino_t, gfarm_int32_t);
 gfarm_error_t gfm_client_replica_remove_by_host_result(
-	struct gfm_connection *, struct gfp_xdr_context *);
+	struct gfm_connection *, struct gfp_xdr_context *,
+	gfarm_int32_t *, gfarm_ino_t *);
 gfarm_error_t gfm_client_replica_remove_by_file_request(
 	struct gfm_connection *, struct gfp_xdr_context *, const char *);
 gfarm_error_t gfm_client_replica_remove_by_file_result(
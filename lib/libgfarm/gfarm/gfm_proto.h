@@ -139,8 +139,8 @@ enum gfm_proto_command {
 	GFM_PROTO_SEEK,
 	GFM_PROTO_GETDIRENTSPLUS,
 	GFM_PROTO_GETDIRENTSPLUSXATTR,
-	GFM_PROTO_DIR_OP_RESERVE11,
-	GFM_PROTO_DIR_OP_RESERVE12,
+	GFM_PROTO_REMOVE_RECURSIVE,
+	GFM_PROTO_FIND,
 	GFM_PROTO_DIR_OP_RESERVE13,
 	GFM_PROTO_DIR_OP_RESERVE14,
 	GFM_PROTO_DIR_OP_RESERVE15,
@@ -203,7 +203,7 @@ enum gfm_proto_command {
 	GFM_PROTO_HOSTNAME_SET,
 	GFM_PROTO_SCHEDULE_HOST_DOMAIN,
 	GFM_PROTO_STATFS,
-	GFM_PROTO_MISC_RESERVE3,
+	GFM_PROTO_GIANT_LOCK_STAT_GET,
 	GFM_PROTO_MISC_RESERVE4,
 	GFM_PROTO_MISC_RESERVE5,
 	GFM_PROTO_MISC_RESERVE6,
@@ -413,6 +413,12 @@ enum gfm_proto_command {
 /* output of GFM_PROTO_CLOSE_WRITE_V2_4 */
 #define	GFM_PROTO_CLOSE_WRITE_GENERATION_UPDATE_NEEDED	1
 
+/* input of GFM_PROTO_GIANT_LOCK_STAT_GET */
+#define GFM_PROTO_GIANT_LOCK_STAT_RESET		1
+
+/* output of GFM_PROTO_GIANT_LOCK_STAT_GET */
+#define GFM_PROTO_GIANT_LOCK_STAT_NBUCKETS	32
+
 /* output of GFM_PROTO_REPLICA_INFO_GET */
 #define GFM_PROTO_REPLICA_FLAG_INCOMPLETE	1
 #define GFM_PROTO_REPLICA_FLAG_DEAD_HOST	2
@@ -35,6 +35,12 @@
 
 #define GFP_XDR_BUFSIZE	16384
 
+/*
+ * a byte array of this size or more is not copied into the sendbuffer,
+ * but written out together with the buffered data by writev(2).
+ */
+#define GFP_XDR_GATHER_MIN	(64 * 1024)
+
 struct gfp_xdr {
 	struct gfarm_iobuffer *recvbuffer;
 	struct gfarm_iobuffer *sendbuffer;
@@ -45,6 +51,9 @@ struct gfp_xdr {
 
 	/* XXX currently used by client only, but should be used by servers */
 	struct gfp_xdr_async_server *async;
+
+	/* bytes of asynchronous protocol messages, for statistics */
+	gfarm_uint64_t async_sent_bytes;
 };
 
 /*
@@ -65,9 +74,12 @@ gfp_xdr_set(struct gfp_xdr *conn,
 		gfarm_iobuffer_set_read_notimeout(conn->recvbuffer,
 		    ops->blocking_read_notimeout, cookie, fd);
 	}
-	if (conn->sendbuffer)
+	if (conn->sendbuffer) {
 		gfarm_iobuffer_set_write(conn->sendbuffer, ops->blocking_write,
 		    cookie, fd);
+		gfarm_iobuffer_set_writev(conn->sendbuffer,
+		    ops->blocking_writev);
+	}
 }
 
 gfarm_error_t
@@ -111,6 +123,7 @@ gfp_xdr_new(struct gfp_iobuffer_ops *ops, void *cookie, int fd,
 		}
 	} else
 		conn->sendbuffer = NULL;
+	conn->async_sent_bytes = 0;
 
 	gfp_xdr_set(conn, ops, cookie, fd);
 	conn->async = NULL;
@@ -212,6 +225,30 @@ gfp_xdr_flush(struct gfp_xdr *conn)
 	return (gfarm_iobuffer_get_error(conn->sendbuffer));
 }
 
+/*
+ * zero-copy transfer from a file to the connection.
+ * the caller must check gfp_xdr_sendfile_is_available() beforehand.
+ */
+int
+gfp_xdr_sendfile_is_available(struct gfp_xdr *conn)
+{
+	return (conn->sendbuffer != NULL && conn->iob_ops->sendfile != NULL);
+}
+
+/* (*sentp) may be less than `len', if `src_fd' reaches EOF */
+gfarm_error_t
+gfp_xdr_sendfile(struct gfp_xdr *conn, int src_fd, gfarm_int64_t offset,
+	size_t len, size_t *sentp)
+{
+	gfarm_error_t e;
+
+	/* data already in the sendbuffer precedes */
+	if ((e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR)
+		return (e);
+	return ((*conn->iob_ops->sendfile)(conn->cookie, conn->fd,
+	    src_fd, offset, len, sentp));
+}
+
 gfarm_error_t
 gfp_xdr_purge_sized(struct gfp_xdr *conn, int just, int len, size_t *sizep)
 {
@@ -366,6 +403,15 @@ gfp_xdr_vsend_size_add(size_t *sizep, const char **formatp, va_list *app)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static void
+gfp_xdr_put_bytes(struct gfp_xdr *conn, const void *s, int n)
+{
+	if (n >= GFP_XDR_GATHER_MIN)
+		gfarm_iobuffer_put_write_gather(conn->sendbuffer, s, n);
+	else
+		gfarm_iobuffer_put_write(conn->sendbuffer, s, n);
+}
+
 gfarm_error_t
 gfp_xdr_vsend(struct gfp_xdr *conn,
 	const char **formatp, va_list *app)
@@ -465,14 +511,12 @@ gfp_xdr_vsend(struct gfp_xdr *conn,
 			s = va_arg(*app, const char *);
 			gfarm_iobuffer_put_write(conn->sendbuffer,
 			    &i, sizeof(i));
-			gfarm_iobuffer_put_write(conn->sendbuffer,
-			    s, n);
+			gfp_xdr_put_bytes(conn, s, n);
 			continue;
 		case 'r':
 			n = va_arg(*app, size_t);
 			s = va_arg(*app, const char *);
-			gfarm_iobuffer_put_write(conn->sendbuffer,
-			    s, n);
+			gfp_xdr_put_bytes(conn, s, n);
 			continue;
 		case 'f':
 #ifndef __KERNEL__	/* double */
@@ -713,8 +757,7 @@ gfp_xdr_vsend_ref(struct gfp_xdr *conn,
 			s = va_arg(*app, const char *);
 			gfarm_iobuffer_put_write(conn->sendbuffer,
 			    &i, sizeof(i));
-			gfarm_iobuffer_put_write(conn->sendbuffer,
-			    s, n);
+			gfp_xdr_put_bytes(conn, s, n);
 			continue;
 		case 'B':
 			gflog_fatal(GFARM_MSG_UNFIXED,
@@ -1383,6 +1426,43 @@ gfp_xdr_vrpc_send_request_begin(struct gfp_xdr *conn,
 	    xid | XID_TYPE_REQUEST, size_posp, command, formatp, app));
 }
 	
+/*
+ * same as gfp_xdr_vrpc_send_request_begin() + gfp_xdr_rpc_send_end(),
+ * but the size is calculated beforehand instead of pinning down the
+ * sendbuffer, thus a large byte array isn't staged in the sendbuffer.
+ */
+gfarm_error_t
+gfp_xdr_vrpc_send_request(struct gfp_xdr *conn, gfp_xdr_xid_t xid,
+	gfarm_int32_t command, const char **formatp, va_list *app)
+{
+	gfarm_error_t e;
+	size_t size = 0;
+	const char *fmt = *formatp;
+	va_list ap;
+
+	e = gfp_xdr_send_size_add(&size, "i", command);
+	if (e == GFARM_ERR_NO_ERROR) {
+		va_copy(ap, *app);
+		e = gfp_xdr_vsend_size_add(&size, &fmt, &ap);
+		va_end(ap);
+	}
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send(conn, ASYNC_REQUEST_HEADER_FORMAT,
+		    xid | XID_TYPE_REQUEST, (gfarm_int32_t)size);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send(conn, "i", command);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_vsend(conn, formatp, app);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "sending request (%d) failed: %s",
+		    command, gfarm_error_string(e));
+		return (e);
+	}
+	gfp_xdr_async_sent_bytes_add(conn, size);
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfp_xdr_vrpc_send_result_begin(struct gfp_xdr *conn,
 	gfp_xdr_xid_t xid, int *size_posp,
@@ -1421,6 +1501,7 @@ gfp_xdr_rpc_send_end(struct gfp_xdr *conn, int size_pos)
 
 	gfp_xdr_sendbuffer_get_pos(conn, &current_pos);
 	size = current_pos - size_pos - ASYNC_REQUEST_HEADER_SIZE_SIZE;
+	gfp_xdr_async_sent_bytes_add(conn, size);
 	size = ntohl(size);
 	gfp_xdr_sendbuffer_overwrite_at(conn,
 	    &size, ASYNC_REQUEST_HEADER_SIZE_SIZE, size_pos);
@@ -1651,6 +1732,23 @@ gfp_xdr_end_sendbuffer_pindown(struct gfp_xdr *conn)
 	gfarm_iobuffer_end_pindown(conn->sendbuffer);
 }
 
+/*
+ * the following counter is not protected by any lock,
+ * thus it's only accurate when the caller is the only sender of the conn.
+ */
+void
+gfp_xdr_async_sent_bytes_add(struct gfp_xdr *conn, size_t payload_size)
+{
+	conn->async_sent_bytes += ASYNC_REQUEST_HEADER_SIZE_TYPE_XID +
+	    ASYNC_REQUEST_HEADER_SIZE_SIZE + payload_size;
+}
+
+gfarm_uint64_t
+gfp_xdr_async_sent_bytes(struct gfp_xdr *conn)
+{
+	return (conn->async_sent_bytes);
+}
+
 void
 gfp_xdr_sendbuffer_get_pos(struct gfp_xdr *conn, int *posp)
 {
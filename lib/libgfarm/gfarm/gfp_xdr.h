@@ -1,5 +1,7 @@
 struct gfarm_iobuffer;
 
+struct iovec;
+
 struct gfp_iobuffer_ops {
 	gfarm_error_t (*close)(void *, int);
 	gfarm_error_t (*export_credential)(void *);
@@ -11,6 +13,12 @@ struct gfp_iobuffer_ops {
 	    void *, int);
 	int (*blocking_write)(struct gfarm_iobuffer *, void *, int,
 	    void *, int);
+	/* NULL, if not supported */
+	int (*blocking_writev)(struct gfarm_iobuffer *, void *, int,
+	    const struct iovec *, int);
+	/* NULL, if data cannot be sent as is. e.g. encrypted connection */
+	gfarm_error_t (*sendfile)(void *, int, int, gfarm_int64_t, size_t,
+	    size_t *);
 };
 
 #define GFP_XDR_NEW_RECV		1
@@ -59,6 +67,9 @@ void gfarm_iobuffer_set_nonblocking_write_xxx(struct gfarm_iobuffer *,
 
 int gfp_xdr_recv_is_ready(struct gfp_xdr *);
 gfarm_error_t gfp_xdr_flush(struct gfp_xdr *);
+int gfp_xdr_sendfile_is_available(struct gfp_xdr *);
+gfarm_error_t gfp_xdr_sendfile(struct gfp_xdr *, int, gfarm_int64_t, size_t,
+	size_t *);
 gfarm_error_t gfp_xdr_purge(struct gfp_xdr *, int, int);
 void gfp_xdr_purge_all(struct gfp_xdr *);
 gfarm_error_t gfp_xdr_vsend_size_add(size_t *, const char **, va_list *);
@@ -120,6 +131,8 @@ typedef void (*disconnect_callback_t)(void *, void *);
 
 gfarm_error_t gfp_xdr_vrpc_send_request_begin(struct gfp_xdr *,
 	gfp_xdr_xid_t, int *, gfarm_int32_t, const char **, va_list *);
+gfarm_error_t gfp_xdr_vrpc_send_request(struct gfp_xdr *,
+	gfp_xdr_xid_t, gfarm_int32_t, const char **, va_list *);
 gfarm_error_t gfp_xdr_vrpc_send_result_begin(struct gfp_xdr *,
 	gfp_xdr_xid_t, int *, gfarm_int32_t, const char **, va_list *);
 gfarm_error_t gfp_xdr_rpc_send_result_begin(struct gfp_xdr *,
@@ -166,6 +179,8 @@ gfarm_error_t gfp_xdr_send_async_result_header(struct gfp_xdr *,
 	gfarm_int32_t, size_t);
 void gfp_xdr_begin_sendbuffer_pindown(struct gfp_xdr *);
 void gfp_xdr_end_sendbuffer_pindown(struct gfp_xdr *);
+void gfp_xdr_async_sent_bytes_add(struct gfp_xdr *, size_t);
+gfarm_uint64_t gfp_xdr_async_sent_bytes(struct gfp_xdr *);
 void gfp_xdr_sendbuffer_get_pos(struct gfp_xdr *, int *);
 void gfp_xdr_sendbuffer_overwrite_at(struct gfp_xdr *, const void *, int, int);
 
@@ -134,13 +134,26 @@ gfp_xdr_vrpc_raw_request(struct gfp_xdr *conn,
 	struct gfp_xdr_xid_record **xidrp, gfarm_int32_t command,
 	const char **formatp, va_list *app)
 {
-	int size_pos;
-	gfarm_error_t e = gfp_xdr_vrpc_raw_request_begin(conn,
-	    xidrp, &size_pos, command, formatp, app);
+	gfarm_error_t e;
+	struct gfp_xdr_async_server *async_server = gfp_xdr_async(conn);
+	struct gfp_xdr_xid_record *xidr;
+	gfp_xdr_xid_t xid;
 
-	if (e == GFARM_ERR_NO_ERROR)
-		gfp_xdr_rpc_raw_request_end(conn, *xidrp, size_pos);
-	return (e);
+	assert(async_server != NULL);
+	xidr = gfarm_id_alloc(async_server->idtab, &xid);
+	if (xidr == NULL) {
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	xidr->xid = xid;
+
+	/* unlike gfp_xdr_vrpc_raw_request_begin(), don't pin down */
+	e = gfp_xdr_vrpc_send_request(conn, xid, command, formatp, app);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gfp_xdr_client_request_free(async_server, xid);
+		return (e);
+	}
+	*xidrp = xidr;
+	return (GFARM_ERR_NO_ERROR);
 }
 
 /*
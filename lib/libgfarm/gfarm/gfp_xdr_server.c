@@ -143,6 +143,7 @@ gfp_xdr_send_async_request_header(struct gfp_xdr *server,
 		gfp_xdr_send_async_request_error(async_server, xid, diag);
 		return (e);
 	}
+	gfp_xdr_async_sent_bytes_add(server, size);
 	*xidp = xid;
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -330,9 +331,14 @@ gfarm_error_t
 gfp_xdr_send_async_result_header(struct gfp_xdr *server,
 	gfarm_int32_t xid, size_t size)
 {
+	gfarm_error_t e;
+
 	xid = (xid | XID_TYPE_RESULT);
-	return (gfp_xdr_send(server, ASYNC_REQUEST_HEADER_FORMAT,
-	    xid, (gfarm_int32_t)size));
+	e = gfp_xdr_send(server, ASYNC_REQUEST_HEADER_FORMAT,
+	    xid, (gfarm_int32_t)size);
+	if (e == GFARM_ERR_NO_ERROR)
+		gfp_xdr_async_sent_bytes_add(server, size);
+	return (e);
 }
 
 /*
@@ -69,6 +69,43 @@
 
 #define XAUTH_NEXTRACT_MAXLEN	512
 
+/* GFS_PROTO_BULKREAD stream in progress, see gfs_client_bulkread() */
+struct gfs_client_bulkread {
+	struct gfp_xdr_xid_record *xidr;
+	gfarm_int32_t fd;
+	gfarm_off_t offset;	/* offset of the next byte to receive */
+	gfarm_off_t end;	/* end of the range, -1 means EOF */
+	gfarm_int32_t window;
+	gfarm_int32_t unacked;	/* received, but not granted again */
+	gfarm_int32_t residual;	/* bytes remaining in the current chunk */
+	int started;		/* any chunk is received */
+};
+
+/* gfsd which doesn't support GFS_PROTO_BULKREAD */
+struct gfs_client_nobulkread {
+	struct gfs_client_nobulkread *next;
+	char *hostname;
+	int port;
+};
+
+/* outstanding GFS_PROTO_PREAD requests, see gfs_client_readahead() */
+struct gfs_client_readahead {
+	gfarm_int32_t fd;
+	size_t iosize;		/* size of each request */
+	gfarm_off_t offset;	/* offset of the oldest outstanding request */
+	int head, n;		/* ring of the outstanding requests */
+	int window;		/* number of requests to keep outstanding */
+	int max;		/* client_readahead, size of the ring */
+	struct gfp_xdr_xid_record **xidrs;
+
+	/* each round consists of `window' replies, to adapt the window */
+	int round;		/* replies left in this round */
+	int stalled;		/* waited for a reply in this round */
+	gfarm_uint64_t round_bytes;
+	struct timespec round_start;
+	gfarm_uint64_t rate;	/* bytes/ms in the previous round */
+};
+
 struct gfs_connection {
 	struct gfp_cached_connection *cache_entry;
 
@@ -85,6 +122,9 @@ struct gfs_connection {
 	void *context; /* work area for RPC (esp. GFS_PROTO_COMMAND) */
 
 	int failover_count; /* compare to gfm_connection.failover_count */
+
+	struct gfs_client_bulkread *bulkread; /* NULL, if not streaming */
+	struct gfs_client_readahead *readahead; /* NULL, if none */
 };
 
 #define staticp	(gfarm_ctxp->gfs_client_static)
@@ -97,11 +137,15 @@ struct gfs_client_static {
 	int self_ip_asked;
 	int self_ip_count;
 	struct in_addr *self_ip_list;
+
+	/* see gfs_client_bulkread_is_available() */
+	struct gfs_client_nobulkread *nobulkread_hosts;
 };
 
 #define SERVER_HASHTAB_SIZE	3079	/* prime number */
 
 static gfarm_error_t gfs_client_connection_dispose(void *);
+static gfarm_error_t gfs_client_pending_read_end(struct gfs_connection *);
 
 gfarm_error_t
 gfs_client_static_init(struct gfarm_context *ctxp)
@@ -121,6 +165,7 @@ gfs_client_static_init(struct gfarm_context *ctxp)
 	s->self_ip_asked = 0;
 	s->self_ip_count = 0;
 	s->self_ip_list = NULL;
+	s->nobulkread_hosts = NULL;
 
 	ctxp->gfs_client_static = s;
 	return (GFARM_ERR_NO_ERROR);
@@ -130,12 +175,18 @@ void
 gfs_client_static_term(struct gfarm_context *ctxp)
 {
 	struct gfs_client_static *s = ctxp->gfs_client_static;
+	struct gfs_client_nobulkread *nb, *next;
 
 	if (s == NULL)
 		return;
 
 	gfp_conn_cache_term(&s->server_cache);
 	free(staticp->self_ip_list);
+	for (nb = s->nobulkread_hosts; nb != NULL; nb = next) {
+		next = nb->next;
+		free(nb->hostname);
+		free(nb);
+	}
 	free(s);
 }
 
@@ -446,6 +497,8 @@ gfs_client_connection_alloc(const char *canonical_hostname,
 	gfs_server->context = NULL;
 	gfs_server->opened = 0;
 	gfs_server->failover_count = failover_count;
+	gfs_server->bulkread = NULL;
+	gfs_server->readahead = NULL;
 
 	gfs_server->cache_entry = cache_entry;
 	gfp_cached_connection_set_data(cache_entry, gfs_server);
@@ -575,6 +628,8 @@ gfsk_client_connection_alloc_and_auth(struct gfarm_eventqueue *q,
 	gfs_server->context = NULL;
 	gfs_server->opened = 0;
 	gfs_server->failover_count = failover_count;
+	gfs_server->bulkread = NULL;
+	gfs_server->readahead = NULL;
 
 	gfs_server->cache_entry = cache_entry;
 	gfp_cached_connection_set_data(cache_entry, gfs_server);
@@ -604,6 +659,10 @@ gfs_client_connection_dispose(void *connection_data)
 	gfp_uncached_connection_dispose(gfs_server->cache_entry);
 	free(gfs_server->hostname);
 	/* XXX - gfs_server->context should be NULL here */
+	free(gfs_server->bulkread);
+	if (gfs_server->readahead != NULL)
+		free(gfs_server->readahead->xidrs);
+	free(gfs_server->readahead);
 	free(gfs_server);
 	return (e);
 }
@@ -1308,6 +1367,10 @@ gfs_client_rpc_request(struct gfs_connection *gfs_server,
 	va_list ap;
 	gfarm_error_t e;
 
+	if ((e = gfs_client_pending_read_end(gfs_server)) !=
+	    GFARM_ERR_NO_ERROR)
+		return (e);
+
 	va_start(ap, format);
 	e = gfp_xdr_vrpc_raw_request(gfs_server->conn, xidrp,
 	    command, &format, &ap);
@@ -1383,6 +1446,10 @@ gfs_client_vrpc(struct gfs_connection *gfs_server, int just, int do_timeout,
 
 	gfs_client_connection_used(gfs_server);
 
+	if ((e = gfs_client_pending_read_end(gfs_server)) !=
+	    GFARM_ERR_NO_ERROR)
+		return (e);
+
 	e = gfp_xdr_vrpc(gfs_server->conn, just, do_timeout,
 	    command, &errcode, &format, app);
 	if (IS_CONNECTION_ERROR(e)) {
@@ -1599,6 +1666,584 @@ gfs_client_pread(struct gfs_connection *gfs_server,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * GFS_PROTO_BULKREAD
+ */
+
+/* the window grows from this, up to client_bulkread_window */
+#define GFS_CLIENT_BULKREAD_WINDOW_INITIAL	GFS_PROTO_MAX_IOSIZE
+
+/* the connection is out of sync, thus cannot be used anymore */
+static gfarm_error_t
+gfs_client_bulkread_abort(struct gfs_connection *gfs_server, gfarm_error_t e)
+{
+	free(gfs_server->bulkread);
+	gfs_server->bulkread = NULL;
+	if (IS_CONNECTION_ERROR(e))
+		gfs_client_execute_hook_for_connection_error(gfs_server);
+	gfs_client_purge_from_cache(gfs_server);
+	gflog_debug(GFARM_MSG_UNFIXED, "GFS_PROTO_BULKREAD: %s",
+	    gfarm_error_string(e));
+	return (e);
+}
+
+static gfarm_error_t
+gfs_client_bulkread_begin(struct gfs_connection *gfs_server,
+	gfarm_int32_t fd, gfarm_off_t off, gfarm_off_t length)
+{
+	gfarm_error_t e;
+	struct gfs_client_bulkread *br;
+
+	GFARM_MALLOC(br);
+	if (br == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	br->fd = fd;
+	br->offset = off;
+	br->end = length < 0 ? -1 : off + length;
+	br->window = gfarm_ctxp->client_bulkread_window;
+	if (br->window > GFS_CLIENT_BULKREAD_WINDOW_INITIAL)
+		br->window = GFS_CLIENT_BULKREAD_WINDOW_INITIAL;
+	br->unacked = 0;
+	br->residual = 0;
+	br->started = 0;
+
+	e = gfs_client_rpc_request(gfs_server, &br->xidr, GFS_PROTO_BULKREAD,
+	    "iill", fd, br->window, off, length);
+	if (e == GFARM_ERR_NO_ERROR) {
+		e = gfp_xdr_flush(gfs_server->conn);
+		if (IS_CONNECTION_ERROR(e)) {
+			gfs_client_execute_hook_for_connection_error(
+			    gfs_server);
+			gfs_client_purge_from_cache(gfs_server);
+		}
+	}
+	if (e != GFARM_ERR_NO_ERROR) {
+		free(br);
+		return (e);
+	}
+	gfs_server->bulkread = br;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_client_bulkread_recv_chunk(struct gfs_connection *gfs_server,
+	gfarm_int32_t *lenp)
+{
+	gfarm_error_t e;
+	int eof;
+
+	e = gfp_xdr_recv(gfs_server->conn, 0, &eof, "i", lenp);
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	else if (e == GFARM_ERR_NO_ERROR && *lenp < 0)
+		e = GFARM_ERR_PROTOCOL;
+	return (e);
+}
+
+/*
+ * send the stop, and receive the reply.
+ * if `drain' is set, the data which is already sent is discarded.
+ * the result of gfsd is returned to `*errcodep'.
+ */
+static gfarm_error_t
+gfs_client_bulkread_finish(struct gfs_connection *gfs_server, int drain,
+	gfarm_int32_t *errcodep)
+{
+	struct gfs_client_bulkread *br = gfs_server->bulkread;
+	gfarm_error_t e;
+	gfarm_int32_t len = -1;
+	size_t size;
+
+	e = gfp_xdr_send(gfs_server->conn, "i", (gfarm_int32_t)0);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_flush(gfs_server->conn);
+	while (e == GFARM_ERR_NO_ERROR && drain && len != 0) {
+		if (br->residual > 0)
+			e = gfp_xdr_purge(gfs_server->conn, 0, br->residual);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = gfs_client_bulkread_recv_chunk(gfs_server, &len);
+		br->residual = len;
+	}
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_rpc_raw_result_begin(gfs_server->conn, 0, 1,
+		    br->xidr, &size, errcodep, "");
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_rpc_raw_result_end(gfs_server->conn, 0,
+		    br->xidr, size);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (gfs_client_bulkread_abort(gfs_server, e));
+	free(br);
+	gfs_server->bulkread = NULL;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static int
+gfs_client_bulkread_is_supported(struct gfs_connection *gfs_server)
+{
+	struct gfs_client_nobulkread *nb;
+
+	for (nb = staticp->nobulkread_hosts; nb != NULL; nb = nb->next) {
+		if (nb->port == gfs_server->port &&
+		    strcmp(nb->hostname, gfs_server->hostname) == 0)
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * gfsd of version 2.5.8 or earlier exits at an unknown request,
+ * thus the gfsd is remembered, and the caller reads the file again
+ * by another way after the reconnection.
+ */
+static void
+gfs_client_bulkread_set_unsupported(struct gfs_connection *gfs_server)
+{
+	struct gfs_client_nobulkread *nb;
+
+	gflog_notice(GFARM_MSG_UNFIXED,
+	    "%s:%d: GFS_PROTO_BULKREAD isn't supported, disabled",
+	    gfs_server->hostname, gfs_server->port);
+	GFARM_MALLOC(nb);
+	if (nb == NULL)
+		return;
+	nb->hostname = strdup(gfs_server->hostname);
+	if (nb->hostname == NULL) {
+		free(nb);
+		return;
+	}
+	nb->port = gfs_server->port;
+	nb->next = staticp->nobulkread_hosts;
+	staticp->nobulkread_hosts = nb;
+}
+
+/*
+ * reads of the other files opened on the connection would end
+ * the stream each time, thus a stream is only used for a single file.
+ */
+int
+gfs_client_bulkread_is_available(struct gfs_connection *gfs_server)
+{
+	int available;
+
+	gfs_client_connection_lock(gfs_server);
+	available = gfs_server->opened <= 1 &&
+	    gfs_client_bulkread_is_supported(gfs_server);
+	gfs_client_connection_unlock(gfs_server);
+	return (available);
+}
+
+static gfarm_error_t
+gfs_client_bulkread_end(struct gfs_connection *gfs_server)
+{
+	gfarm_error_t e;
+	gfarm_int32_t errcode;
+
+	if (gfs_server->bulkread == NULL)
+		return (GFARM_ERR_NO_ERROR);
+	e = gfs_client_bulkread_finish(gfs_server, 1, &errcode);
+	if (e == GFARM_ERR_NO_ERROR && errcode != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "GFS_PROTO_BULKREAD: the rest is discarded: %s",
+		    gfarm_error_string(errcode));
+	return (e);
+}
+
+/*
+ * a stream started by this function continues over the calls,
+ * as long as each call reads from where the previous call ended,
+ * and no other RPC is sent on the connection.
+ * `length' is the range requested when a new stream is started,
+ * -1 means until EOF.
+ */
+gfarm_error_t
+gfs_client_bulkread(struct gfs_connection *gfs_server,
+	gfarm_int32_t fd, void *buffer, size_t size,
+	gfarm_off_t off, gfarm_off_t length, size_t *np)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	gfarm_int32_t errcode = GFARM_ERR_NO_ERROR, len, growth;
+	struct gfs_client_bulkread *br;
+	char *p = buffer;
+	size_t n = 0, sz, rest;
+	int eof;
+
+	gfs_client_connection_lock(gfs_server);
+	gfs_client_connection_used(gfs_server);
+
+	br = gfs_server->bulkread;
+	if (br != NULL && (br->fd != fd || br->offset != off ||
+	    (br->end >= 0 && br->offset >= br->end)))
+		e = gfs_client_bulkread_end(gfs_server);
+	if (e == GFARM_ERR_NO_ERROR && gfs_server->bulkread == NULL)
+		e = gfs_client_bulkread_begin(gfs_server, fd, off, length);
+	br = gfs_server->bulkread;
+
+	while (e == GFARM_ERR_NO_ERROR && n < size) {
+		if (br->residual == 0) {
+			e = gfs_client_bulkread_recv_chunk(gfs_server, &len);
+			if (e != GFARM_ERR_NO_ERROR) {
+				if (!br->started &&
+				    e == GFARM_ERR_UNEXPECTED_EOF)
+					gfs_client_bulkread_set_unsupported(
+					    gfs_server);
+				e = gfs_client_bulkread_abort(gfs_server, e);
+				break;
+			}
+			br->started = 1;
+			if (len == 0) { /* end mark */
+				e = gfs_client_bulkread_finish(gfs_server, 0,
+				    &errcode);
+				break;
+			}
+			br->residual = len;
+		}
+		sz = size - n < br->residual ? size - n : br->residual;
+		rest = sz;
+		e = gfp_xdr_recv(gfs_server->conn, 1, &eof, "r",
+		    sz, &rest, p + n);
+		if (e == GFARM_ERR_NO_ERROR && eof)
+			e = GFARM_ERR_UNEXPECTED_EOF;
+		if (e != GFARM_ERR_NO_ERROR) {
+			e = gfs_client_bulkread_abort(gfs_server, e);
+			break;
+		}
+		n += sz;
+		br->offset += sz;
+		br->residual -= sz;
+		br->unacked += sz;
+		if (br->unacked < br->window / 2)
+			continue;
+
+		/* grant what is consumed, and widen the window by that */
+		growth = gfarm_ctxp->client_bulkread_window - br->window;
+		if (growth > br->window)
+			growth = br->window;
+		else if (growth < 0)
+			growth = 0;
+		e = gfp_xdr_send(gfs_server->conn, "i",
+		    br->unacked + growth);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = gfp_xdr_flush(gfs_server->conn);
+		if (e != GFARM_ERR_NO_ERROR) {
+			e = gfs_client_bulkread_abort(gfs_server, e);
+			break;
+		}
+		br->unacked = 0;
+		br->window += growth;
+	}
+	gfs_client_connection_unlock(gfs_server);
+
+	if (e == GFARM_ERR_NO_ERROR)
+		e = errcode;
+	if (n > 0) /* the error will be reported by the next call */
+		e = GFARM_ERR_NO_ERROR;
+	else if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfs_client_bulkread: %s", gfarm_error_string(e));
+		return (e);
+	}
+	*np = n;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * GFS_PROTO_PREAD readahead
+ *
+ * unlike GFS_PROTO_BULKREAD, this works with any gfsd.
+ * the replies are received in the order of the requests,
+ * because gfsd processes the requests on a connection one by one.
+ */
+
+/* the window starts from this, and adapts up to client_readahead */
+#define GFS_CLIENT_READAHEAD_WINDOW_INITIAL	2
+
+/*
+ * as GFS_PROTO_BULKREAD, reads of the other files opened on
+ * the connection would discard the requests sent ahead each time.
+ */
+int
+gfs_client_readahead_is_available(struct gfs_connection *gfs_server)
+{
+	int available;
+
+	gfs_client_connection_lock(gfs_server);
+	available = gfs_server->opened <= 1;
+	gfs_client_connection_unlock(gfs_server);
+	return (available);
+}
+
+static void
+gfs_client_readahead_free(struct gfs_connection *gfs_server)
+{
+	struct gfs_client_readahead *ra = gfs_server->readahead;
+
+	free(ra->xidrs);
+	free(ra);
+	gfs_server->readahead = NULL;
+}
+
+/* the connection is out of sync, thus cannot be used anymore */
+static gfarm_error_t
+gfs_client_readahead_abort(struct gfs_connection *gfs_server, gfarm_error_t e)
+{
+	gfs_client_readahead_free(gfs_server);
+	if (IS_CONNECTION_ERROR(e))
+		gfs_client_execute_hook_for_connection_error(gfs_server);
+	gfs_client_purge_from_cache(gfs_server);
+	gflog_debug(GFARM_MSG_UNFIXED, "GFS_PROTO_PREAD readahead: %s",
+	    gfarm_error_string(e));
+	return (e);
+}
+
+static void
+gfs_client_readahead_new_round(struct gfs_client_readahead *ra)
+{
+	ra->round = ra->window;
+	ra->stalled = 0;
+	ra->round_bytes = 0;
+	gfarm_gettime(&ra->round_start);
+}
+
+static gfarm_error_t
+gfs_client_readahead_begin(struct gfs_connection *gfs_server,
+	gfarm_int32_t fd, size_t iosize, gfarm_off_t off)
+{
+	struct gfs_client_readahead *ra;
+	int max = gfarm_ctxp->client_readahead;
+
+	GFARM_MALLOC(ra);
+	if (ra == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	GFARM_MALLOC_ARRAY(ra->xidrs, max);
+	if (ra->xidrs == NULL) {
+		free(ra);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	ra->fd = fd;
+	ra->iosize = iosize;
+	ra->offset = off;
+	ra->head = ra->n = 0;
+	ra->max = max;
+	ra->window = max < GFS_CLIENT_READAHEAD_WINDOW_INITIAL ?
+	    max : GFS_CLIENT_READAHEAD_WINDOW_INITIAL;
+	ra->rate = 0;
+	gfs_client_readahead_new_round(ra);
+	gfs_server->readahead = ra;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* unlike gfs_client_rpc_request(), the outstanding requests are kept */
+static gfarm_error_t
+gfs_client_readahead_request(struct gfs_connection *gfs_server,
+	struct gfp_xdr_xid_record **xidrp, const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e;
+
+	va_start(ap, format);
+	e = gfp_xdr_vrpc_raw_request(gfs_server->conn, xidrp,
+	    GFS_PROTO_PREAD, &format, &ap);
+	va_end(ap);
+	return (e);
+}
+
+/* keep `window' requests outstanding */
+static gfarm_error_t
+gfs_client_readahead_fill(struct gfs_connection *gfs_server)
+{
+	gfarm_error_t e;
+	struct gfs_client_readahead *ra = gfs_server->readahead;
+	int i, sent = 0;
+
+	while (ra->n < ra->window) {
+		i = (ra->head + ra->n) % ra->max;
+		e = gfs_client_readahead_request(gfs_server, &ra->xidrs[i],
+		    "iil", ra->fd, (gfarm_int32_t)ra->iosize,
+		    ra->offset + (gfarm_off_t)ra->n * ra->iosize);
+		if (e != GFARM_ERR_NO_ERROR)
+			return (e);
+		ra->n++;
+		sent = 1;
+	}
+	return (sent ? gfp_xdr_flush(gfs_server->conn) : GFARM_ERR_NO_ERROR);
+}
+
+/* receive the reply to the oldest request, and discard it */
+static gfarm_error_t
+gfs_client_readahead_skip(struct gfs_connection *gfs_server)
+{
+	gfarm_error_t e;
+	struct gfs_client_readahead *ra = gfs_server->readahead;
+	gfarm_int32_t errcode;
+	size_t size;
+
+	e = gfp_xdr_rpc_raw_result_begin(gfs_server->conn, 0, 1,
+	    ra->xidrs[ra->head], &size, &errcode, "");
+	ra->head = (ra->head + 1) % ra->max;
+	ra->n--;
+	if (e == GFARM_ERR_NO_ERROR && size > 0)
+		e = gfp_xdr_purge(gfs_server->conn, 0, size);
+	return (e);
+}
+
+static gfarm_error_t
+gfs_client_readahead_end(struct gfs_connection *gfs_server)
+{
+	gfarm_error_t e;
+
+	if (gfs_server->readahead == NULL)
+		return (GFARM_ERR_NO_ERROR);
+	while (gfs_server->readahead->n > 0) {
+		if ((e = gfs_client_readahead_skip(gfs_server)) !=
+		    GFARM_ERR_NO_ERROR)
+			return (gfs_client_readahead_abort(gfs_server, e));
+	}
+	gfs_client_readahead_free(gfs_server);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* this is called before any other RPC on the connection */
+static gfarm_error_t
+gfs_client_pending_read_end(struct gfs_connection *gfs_server)
+{
+	gfarm_error_t e = gfs_client_bulkread_end(gfs_server);
+
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	return (gfs_client_readahead_end(gfs_server));
+}
+
+static int
+gfs_client_is_readable(struct gfs_connection *gfs_server)
+{
+	struct pollfd fds[1];
+
+	if (gfp_xdr_recv_is_ready(gfs_server->conn))
+		return (1);
+	fds[0].fd = gfp_xdr_fd(gfs_server->conn);
+	fds[0].events = POLLIN;
+	return (poll(fds, 1, 0) > 0);
+}
+
+/*
+ * the window is adapted at the end of each round, by the throughput.
+ * if the reader never waited for a reply, fewer requests are enough.
+ * if it waited, and doubling the window in the previous round paid off,
+ * the window is doubled again.
+ */
+static void
+gfs_client_readahead_adapt(struct gfs_client_readahead *ra, size_t len)
+{
+	struct timespec now;
+	gfarm_int64_t usec;
+	gfarm_uint64_t rate;
+
+	ra->round_bytes += len;
+	if (--ra->round > 0)
+		return;
+
+	gfarm_gettime(&now);
+	usec = ((gfarm_int64_t)(now.tv_sec - ra->round_start.tv_sec) *
+	    GFARM_SECOND_BY_NANOSEC + (now.tv_nsec - ra->round_start.tv_nsec))
+	    / GFARM_MICROSEC_BY_NANOSEC;
+	rate = ra->round_bytes * 1000 / (usec + 1);
+	if (!ra->stalled) {
+		if (ra->window > GFS_CLIENT_READAHEAD_WINDOW_INITIAL)
+			ra->window--;
+	} else if (rate > ra->rate + ra->rate / 8) {
+		ra->window *= 2;
+		if (ra->window > ra->max)
+			ra->window = ra->max;
+	}
+	ra->rate = rate;
+	gfs_client_readahead_new_round(ra);
+}
+
+/*
+ * this reads by the oldest outstanding GFS_PROTO_PREAD request,
+ * and keeps requests for the following data outstanding.
+ * the requests continue over the calls, as long as each call reads
+ * `size' bytes from where the previous call ended,
+ * and no other RPC is sent on the connection.
+ */
+gfarm_error_t
+gfs_client_readahead(struct gfs_connection *gfs_server,
+	gfarm_int32_t fd, void *buffer, size_t size,
+	gfarm_off_t off, size_t *np)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	gfarm_int32_t errcode = GFARM_ERR_NO_ERROR;
+	struct gfs_client_readahead *ra;
+	struct gfp_xdr_xid_record *xidr;
+	size_t rsize;
+
+	/* gfsd truncates a larger request */
+	if (size > GFS_PROTO_MAX_IOSIZE)
+		size = GFS_PROTO_MAX_IOSIZE;
+
+	gfs_client_connection_lock(gfs_server);
+	gfs_client_connection_used(gfs_server);
+
+	ra = gfs_server->readahead;
+	if (ra != NULL &&
+	    (ra->fd != fd || ra->offset != off || ra->iosize != size))
+		e = gfs_client_readahead_end(gfs_server);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfs_client_bulkread_end(gfs_server);
+	if (e == GFARM_ERR_NO_ERROR && gfs_server->readahead == NULL)
+		e = gfs_client_readahead_begin(gfs_server, fd, size, off);
+	if (e == GFARM_ERR_NO_ERROR) {
+		ra = gfs_server->readahead;
+		e = gfs_client_readahead_fill(gfs_server);
+		if (e != GFARM_ERR_NO_ERROR)
+			e = gfs_client_readahead_abort(gfs_server, e);
+	}
+	if (e == GFARM_ERR_NO_ERROR) {
+		if (!ra->stalled && !gfs_client_is_readable(gfs_server))
+			ra->stalled = 1;
+		xidr = ra->xidrs[ra->head];
+		ra->head = (ra->head + 1) % ra->max;
+		ra->n--;
+		e = gfp_xdr_rpc_raw_result_begin(gfs_server->conn, 0, 1,
+		    xidr, &rsize, &errcode, "b", size, np, buffer);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = gfp_xdr_rpc_raw_result_end(gfs_server->conn, 0,
+			    xidr, rsize);
+		if (e != GFARM_ERR_NO_ERROR)
+			e = gfs_client_readahead_abort(gfs_server, e);
+		else if (errcode != GFARM_ERR_NO_ERROR || *np < size)
+			/* error or EOF, the following requests are useless */
+			e = gfs_client_readahead_end(gfs_server);
+		else {
+			ra->offset += size;
+			gfs_client_readahead_adapt(ra, size);
+			/* keep gfsd busy, while the caller consumes this */
+			e = gfs_client_readahead_fill(gfs_server);
+			if (e != GFARM_ERR_NO_ERROR) {
+				/* will be reported by the next call */
+				(void)gfs_client_readahead_abort(gfs_server, e);
+				e = GFARM_ERR_NO_ERROR;
+			}
+		}
+	}
+	gfs_client_connection_unlock(gfs_server);
+
+	if (e == GFARM_ERR_NO_ERROR)
+		e = errcode;
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfs_client_readahead: %s", gfarm_error_string(e));
+		return (e);
+	}
+	if (*np > size) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"Protocol error in client readahead (%llu)>(%llu)",
+			(unsigned long long)*np, (unsigned long long)size);
+		return (GFARM_ERRMSG_GFS_PROTO_PREAD_PROTOCOL);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfs_client_pwrite(struct gfs_connection *gfs_server,
 	gfarm_int32_t fd, const void *buffer, size_t size,
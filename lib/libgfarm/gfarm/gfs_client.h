@@ -66,6 +66,12 @@ gfarm_error_t gfs_client_open_local(struct gfs_connection *, gfarm_int32_t,
 gfarm_error_t gfs_client_close(struct gfs_connection *, gfarm_int32_t);
 gfarm_error_t gfs_client_pread(struct gfs_connection *,
 		       gfarm_int32_t, void *, size_t, gfarm_off_t, size_t *);
+int gfs_client_bulkread_is_available(struct gfs_connection *);
+gfarm_error_t gfs_client_bulkread(struct gfs_connection *,
+	gfarm_int32_t, void *, size_t, gfarm_off_t, gfarm_off_t, size_t *);
+int gfs_client_readahead_is_available(struct gfs_connection *);
+gfarm_error_t gfs_client_readahead(struct gfs_connection *,
+	gfarm_int32_t, void *, size_t, gfarm_off_t, size_t *);
 gfarm_error_t gfs_client_pwrite(struct gfs_connection *,
 			gfarm_int32_t, const void *, size_t, gfarm_off_t,
 			size_t *);
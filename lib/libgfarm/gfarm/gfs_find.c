@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+
+#include "gfm_client.h"
+#include "lookup.h"
+#include "gfs_io.h"
+#include "gfs_failover.h"
+
+/*
+ * gfs_find_open()/find_read()/find_close()
+ *
+ * the directory tree is walked by gfmd, and only matching entries
+ * are returned.  gfmd doesn't keep any state between RPCs, a cookie
+ * returned by the previous RPC tells where to restart.
+ */
+
+#define FIND_BUFCOUNT	1000
+
+struct gfs_find {
+	struct gfm_connection *gfm_server;
+	int fd;
+	/* remember opened url */
+	char *url;
+	/* remember opened inode num */
+	gfarm_ino_t ino;
+
+	char *path;
+	struct gfs_find_cond cond;
+	char *cookie;
+	int eof;
+
+	char **paths;
+	struct gfs_stat *stv;
+	int n, index;
+	char *workpath;
+};
+
+static struct gfm_connection *
+find_metadb(struct gfs_failover_file *super)
+{
+	return (((struct gfs_find *)super)->gfm_server);
+}
+
+static void
+find_set_metadb(struct gfs_failover_file *super,
+	struct gfm_connection *gfm_server)
+{
+	((struct gfs_find *)super)->gfm_server = gfm_server;
+}
+
+static gfarm_int32_t
+find_fileno(struct gfs_failover_file *super)
+{
+	return (((struct gfs_find *)super)->fd);
+}
+
+static void
+find_set_fileno(struct gfs_failover_file *super, gfarm_int32_t fd)
+{
+	((struct gfs_find *)super)->fd = fd;
+}
+
+static const char *
+find_url(struct gfs_failover_file *super)
+{
+	return (((struct gfs_find *)super)->url);
+}
+
+static gfarm_ino_t
+find_ino(struct gfs_failover_file *super)
+{
+	return (((struct gfs_find *)super)->ino);
+}
+
+static struct gfs_failover_file_ops failover_file_ops = {
+	GFS_DT_DIR,
+	find_metadb,
+	find_set_metadb,
+	find_fileno,
+	find_set_fileno,
+	find_url,
+	find_ino,
+};
+
+static char *
+strdup_or_null(const char *s)
+{
+	return (s == NULL ? NULL : strdup(s));
+}
+
+static void
+gfs_find_clear(GFS_Find find)
+{
+	int i;
+
+	for (i = 0; i < find->n; i++) {
+		free(find->paths[i]);
+		gfs_stat_free(&find->stv[i]);
+	}
+	free(find->paths);
+	free(find->stv);
+	find->paths = NULL;
+	find->stv = NULL;
+	find->n = find->index = 0;
+}
+
+static void
+gfs_find_free(GFS_Find find)
+{
+	gfs_find_clear(find);
+	free(find->cond.name);
+	free(find->cond.user);
+	free(find->cond.group);
+	free(find->cookie);
+	free(find->workpath);
+	free(find->path);
+	free(find->url);
+	free(find);
+}
+
+gfarm_error_t
+gfs_find_open(const char *path, const struct gfs_find_cond *cond,
+	GFS_Find *findp)
+{
+	gfarm_error_t e;
+	struct gfm_connection *gfm_server;
+	int fd, type;
+	char *url;
+	gfarm_ino_t ino;
+	GFS_Find find;
+
+	if ((e = gfm_open_fd_with_ino(path, GFARM_FILE_RDONLY, &gfm_server,
+	    &fd, &type, &url, &ino)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfm_open_fd(%s) failed: %s",
+		    path, gfarm_error_string(e));
+		return (e);
+	}
+	if (type != GFS_DT_DIR) {
+		free(url);
+		e = GFARM_ERR_NOT_A_DIRECTORY;
+	} else if (GFARM_MALLOC(find) == NULL) {
+		free(url);
+		e = GFARM_ERR_NO_MEMORY;
+	} else {
+		find->gfm_server = gfm_server;
+		find->fd = fd;
+		find->url = url;
+		find->ino = ino;
+		find->path = strdup(path);
+		find->cond = *cond;
+		find->cond.name = strdup_or_null(cond->name);
+		find->cond.user = strdup_or_null(cond->user);
+		find->cond.group = strdup_or_null(cond->group);
+		find->cookie = strdup("");
+		find->eof = 0;
+		find->paths = NULL;
+		find->stv = NULL;
+		find->n = find->index = 0;
+		find->workpath = NULL;
+		if ((cond->name != NULL && find->cond.name == NULL) ||
+		    (cond->user != NULL && find->cond.user == NULL) ||
+		    (cond->group != NULL && find->cond.group == NULL) ||
+		    find->cookie == NULL || find->path == NULL) {
+			gfs_find_free(find);
+			e = GFARM_ERR_NO_MEMORY;
+		} else {
+			*findp = find;
+			return (GFARM_ERR_NO_ERROR);
+		}
+	}
+	gflog_debug(GFARM_MSG_UNFIXED, "gfs_find_open(%s): %s",
+	    path, gfarm_error_string(e));
+	(void)gfm_close_fd(gfm_server, fd); /* ignore result */
+	gfm_client_connection_free(gfm_server);
+	return (e);
+}
+
+static gfarm_error_t
+gfm_find_request(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, void *closure)
+{
+	GFS_Find find = closure;
+	gfarm_error_t e = gfm_client_find_request(gfm_server, ctx,
+	    &find->cond, FIND_BUFCOUNT, find->cookie);
+
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_warning(GFARM_MSG_UNFIXED, "find request: %s",
+		    gfarm_error_string(e));
+	return (e);
+}
+
+static gfarm_error_t
+gfm_find_result(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, void *closure)
+{
+	GFS_Find find = closure;
+	char *cookie;
+	gfarm_error_t e = gfm_client_find_result(gfm_server, ctx,
+	    &find->eof, &cookie, &find->n, &find->paths, &find->stv);
+
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_warning(GFARM_MSG_UNFIXED, "find result: %s",
+		    gfarm_error_string(e));
+		return (e);
+	}
+	free(find->cookie);
+	find->cookie = cookie;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * both (*pathp) and (*stp) shouldn't be freed,
+ * and they are valid until the next gfs_find_read() call.
+ * (*pathp) is the path given to gfs_find_open() followed by
+ * the relative path of the entry.
+ * both are set to NULL at the end.
+ */
+gfarm_error_t
+gfs_find_read(GFS_Find find, char **pathp, struct gfs_stat **stp)
+{
+	gfarm_error_t e;
+	char *relpath, *p;
+	size_t pathlen, sz;
+	int overflow = 0;
+
+	/* gfmd may return no entry without eof, if nothing matches */
+	while (find->index >= find->n) {
+		gfs_find_clear(find);
+		if (find->eof) {
+			*pathp = NULL;
+			*stp = NULL;
+			return (GFARM_ERR_NO_ERROR);
+		}
+		e = gfm_client_compound_fd_op_readonly(
+		    (struct gfs_failover_file *)find,
+		    &failover_file_ops,
+		    gfm_find_request,
+		    gfm_find_result,
+		    NULL,
+		    find);
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "gfm_client_compound_readonly_fd_op: %s",
+			    gfarm_error_string(e));
+			return (e);
+		}
+	}
+	relpath = find->paths[find->index];
+	pathlen = strlen(find->path);
+	if (pathlen > 0 && find->path[pathlen - 1] == '/')
+		pathlen--;
+	sz = gfarm_size_add(&overflow, pathlen, strlen(relpath));
+	sz = gfarm_size_add(&overflow, sz, 2);
+	if (overflow || (p = realloc(find->workpath, sz)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	find->workpath = p;
+	memcpy(p, find->path, pathlen);
+	p[pathlen] = '/';
+	strcpy(p + pathlen + 1, relpath);
+
+	*pathp = find->workpath;
+	*stp = &find->stv[find->index];
+	find->index++;
+
+	if (GFARM_S_IS_SUGID_PROGRAM((*stp)->st_mode) &&
+	    !gfm_is_mounted(find->gfm_server)) {
+		/* for safety of gfarm2fs "suid" option. */
+		(*stp)->st_mode &= ~(GFARM_S_ISUID|GFARM_S_ISGID);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+gfs_find_close(GFS_Find find)
+{
+	gfarm_error_t e;
+
+	if ((e = gfm_close_fd(find->gfm_server, find->fd)) !=
+	    GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfm_close_fd: %s",
+		    gfarm_error_string(e));
+	gfm_client_connection_free(find->gfm_server);
+	gfs_find_free(find);
+	/* ignore result */
+	return (GFARM_ERR_NO_ERROR);
+}
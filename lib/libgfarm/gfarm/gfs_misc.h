@@ -3,3 +3,7 @@ struct gfm_connection;
 /* gfs_pio.c */
 struct gfm_connection *gfs_pio_metadb(GFS_File);
 int gfs_pio_fileno(GFS_File);
+
+/* gfs_remove.c */
+gfarm_error_t gfs_remove_recursive(const char *,
+	void (*)(void *, gfarm_uint64_t, gfarm_uint64_t), void *);
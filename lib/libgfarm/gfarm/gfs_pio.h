@@ -123,6 +123,10 @@ struct gfs_file_section_context {
 	int fd; /* local file descriptor. i.e. never used in remote case */
 	pid_t pid;
 
+	/* remote case only, see gfs_pio_remote_storage_pread() */
+	gfarm_off_t seq_offset; /* where the last read ended */
+	gfarm_off_t seq_length; /* length of the sequential reads until there */
+
 #ifdef EVP_MD_CTX_FLAG_ONESHOT /* for kernel mode */
 	/* for checksum, maintained only if GFS_FILE_MODE_CALC_DIGEST */
 	EVP_MD_CTX md_ctx;
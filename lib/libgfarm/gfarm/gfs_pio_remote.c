@@ -14,6 +14,7 @@
 
 #include "queue.h"
 
+#include "context.h"
 #include "host.h"
 #include "config.h"
 #include "gfs_proto.h"	/* GFS_PROTO_FSYNC_* */
@@ -97,17 +98,51 @@ static gfarm_error_t
 gfs_pio_remote_storage_pread(GFS_File gf,
 	char *buffer, size_t size, gfarm_off_t offset, size_t *lengthp)
 {
+	gfarm_error_t e;
 	struct gfs_file_section_context *vc = gf->view_context;
 	struct gfs_connection *gfs_server = vc->storage_context;
+	size_t bufsize = gf->bufsize > 0 ? gf->bufsize : GFS_PROTO_MAX_IOSIZE;
+	int bulkread = gfarm_ctxp->client_bulkread_window > 0 &&
+	    gfs_client_bulkread_is_available(gfs_server);
+
+	if (offset != vc->seq_offset)
+		vc->seq_length = 0;
 
 	/*
-	 * Unlike gfs_pio_remote_storage_write(), we don't care
-	 * buffer size here, because automatic i/o size truncation
-	 * performed by gfsd isn't inefficient for read case.
-	 * Note that upper gfs_pio layer should care the partial read.
+	 * once sequential reads exceed the buffer, the rest of the file is
+	 * streamed by GFS_PROTO_BULKREAD, instead of a round trip for each.
+	 * a single read larger than GFS_PROTO_MAX_IOSIZE is streamed too.
+	 * if the streaming is not used, GFS_PROTO_PREAD requests for
+	 * the following reads are sent ahead instead.
 	 */
-	return (gfs_client_pread(gfs_server, gf->fd, buffer, size, offset,
-	    lengthp));
+	if (!bulkread) {
+		if (gfarm_ctxp->client_readahead > 0 && vc->seq_length > 0 &&
+		    gfs_client_readahead_is_available(gfs_server))
+			e = gfs_client_readahead(gfs_server, gf->fd,
+			    buffer, size, offset, lengthp);
+		else
+			e = gfs_client_pread(gfs_server, gf->fd,
+			    buffer, size, offset, lengthp);
+	} else if (vc->seq_length >= bufsize)
+		e = gfs_client_bulkread(gfs_server, gf->fd, buffer, size,
+		    offset, -1, lengthp);
+	else if (size > GFS_PROTO_MAX_IOSIZE)
+		e = gfs_client_bulkread(gfs_server, gf->fd, buffer, size,
+		    offset, size, lengthp);
+	else
+		/*
+		 * Unlike gfs_pio_remote_storage_write(), we don't care
+		 * buffer size here, because automatic i/o size truncation
+		 * performed by gfsd isn't inefficient for read case.
+		 * Note that upper gfs_pio layer should care the partial read.
+		 */
+		e = gfs_client_pread(gfs_server, gf->fd, buffer, size, offset,
+		    lengthp);
+	if (e == GFARM_ERR_NO_ERROR) {
+		vc->seq_offset = offset + *lengthp;
+		vc->seq_length += *lengthp;
+	}
+	return (e);
 }
 
 static gfarm_error_t
@@ -192,5 +227,6 @@ gfs_pio_open_remote_section(GFS_File gf, struct gfs_connection *gfs_server)
 	vc->storage_context = gfs_server;
 	vc->fd = -1; /* not used */
 	vc->pid = getpid();
+	vc->seq_offset = vc->seq_length = 0;
 	return (GFARM_ERR_NO_ERROR);
 }
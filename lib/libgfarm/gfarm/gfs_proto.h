@@ -8,10 +8,14 @@
 /*
  * 1: protocol until gfarm 2.3
  * 2: protocol since gfarm 2.4
+ * 3: protocol since gfarm 2.5.8, GFS_PROTO_FHREMOVE_BATCH is added
+ * 4: protocol since gfarm 2.6, GFS_PROTO_BULKREAD is added
  */
 #define GFS_PROTOCOL_VERSION_V2_3	1
 #define GFS_PROTOCOL_VERSION_V2_4	2
-#define GFS_PROTOCOL_VERSION		GFS_PROTOCOL_VERSION_V2_4
+#define GFS_PROTOCOL_VERSION_V2_5_8	3
+#define GFS_PROTOCOL_VERSION_V2_6	4
+#define GFS_PROTOCOL_VERSION		GFS_PROTOCOL_VERSION_V2_6
 
 enum gfs_proto_command {
 	/* from client */
@@ -55,10 +59,43 @@ enum gfs_proto_command {
 	/* from client */
 	GFS_PROTO_PROCESS_RESET,
 	GFS_PROTO_WRITE,
+
+	/* from gfmd */
+	GFS_PROTO_FHREMOVE_BATCH,
+
+	/* from client */
+	GFS_PROTO_BULKREAD,
 };
 
 #define GFS_PROTO_MAX_IOSIZE	(1024 * 1024)
 
+/*
+ * GFS_PROTO_FHREMOVE_BATCH
+ *
+ * request: "i" number of files n,
+ *	then "ll" inode number and generation, n times
+ * reply:   "i" n, then "i" gfarm_error_t for each file, n times
+ */
+#define GFS_PROTO_FHREMOVE_BATCH_MAX	256
+
+/*
+ * GFS_PROTO_BULKREAD
+ *
+ * request: "iill", fd, window, offset, length
+ *	length < 0 means until EOF.
+ * then gfsd sends the data without waiting for further requests,
+ * as a sequence of chunks, each of which is encoded as format "b".
+ * a zero-length chunk is the end mark, which is sent at the end of
+ * the range, at EOF, on an error, or when the client stops the stream.
+ * gfsd doesn't send more than `window' bytes beyond what the client
+ * granted, and the client grants more by sending "i":
+ *	> 0: number of bytes which may be sent additionally
+ *	0: stop.  this is always sent once, even after the end mark,
+ *	   and nothing is sent by the client after this.
+ * reply:   "" after both the end mark and the stop are sent.
+ * no other request can be sent on the connection in the meantime.
+ */
+
 /*
  * sub protocols of GFS_PROTO_COMMAND
  */
@@ -9,6 +9,7 @@
 #include "context.h"
 #include "gfm_client.h"
 #include "lookup.h"
+#include "gfs_misc.h"
 
 struct gfm_remove_closure {
 	/* input */
@@ -82,3 +83,90 @@ gfs_remove(const char *path)
 	    gfm_remove_must_be_warned,
 	    &closure));
 }
+
+struct gfm_remove_recursive_closure {
+	/* output */
+	gfarm_int32_t done, first_error;
+	gfarm_uint64_t nfiles, ndirs;
+};
+
+static gfarm_error_t
+gfm_remove_recursive_request(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, void *closure,
+	const char *base)
+{
+	gfarm_error_t e;
+
+	/* 0: up to the default limit of gfmd */
+	if ((e = gfm_client_remove_recursive_request(gfm_server, ctx, base, 0))
+	    != GFARM_ERR_NO_ERROR) {
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "remove_recursive request: %s", gfarm_error_string(e));
+	}
+	return (e);
+}
+
+static gfarm_error_t
+gfm_remove_recursive_result(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, void *closure)
+{
+	struct gfm_remove_recursive_closure *c = closure;
+	gfarm_error_t e;
+
+	if ((e = gfm_client_remove_recursive_result(gfm_server, ctx,
+	    &c->done, &c->first_error, &c->nfiles, &c->ndirs)) !=
+	    GFARM_ERR_NO_ERROR) {
+#if 0 /* DEBUG */
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "remove_recursive result: %s", gfarm_error_string(e));
+#endif
+	}
+	return (e);
+}
+
+/*
+ * remove the directory tree by GFM_PROTO_REMOVE_RECURSIVE.
+ * gfmd removes a limited number of entries per RPC, thus this calls
+ * the RPC until all entries are removed, and `progress' is called
+ * with the number of files and directories removed so far.
+ *
+ * gfmd which doesn't support the RPC closes the connection,
+ * so the caller should fall back to remove entries one by one,
+ * if gfm_client_is_connection_error() is true for the returned error.
+ */
+gfarm_error_t
+gfs_remove_recursive(const char *path,
+	void (*progress)(void *, gfarm_uint64_t, gfarm_uint64_t), void *arg)
+{
+	gfarm_error_t e, first_error = GFARM_ERR_NO_ERROR;
+	struct gfm_remove_recursive_closure closure;
+	gfarm_uint64_t nfiles = 0, ndirs = 0;
+
+	for (;;) {
+		e = gfm_name_op_modifiable(path,
+		    GFARM_ERR_OPERATION_NOT_PERMITTED,
+		    gfm_remove_recursive_request,
+		    gfm_remove_recursive_result,
+		    gfm_name_success_op_connection_free,
+		    gfm_remove_must_be_warned,
+		    &closure);
+		if (e != GFARM_ERR_NO_ERROR)
+			return (e);
+
+		if (first_error == GFARM_ERR_NO_ERROR)
+			first_error = closure.first_error;
+		nfiles += closure.nfiles;
+		ndirs += closure.ndirs;
+		if (progress != NULL)
+			(*progress)(arg, nfiles, ndirs);
+		if (closure.done)
+			break;
+		if (closure.nfiles + closure.ndirs == 0) {
+			/* no progress, all remaining entries are failed */
+			if (first_error == GFARM_ERR_NO_ERROR)
+				first_error = GFARM_ERR_OPERATION_TIMED_OUT;
+			break;
+		}
+	}
+	return (first_error);
+}
@@ -11,6 +11,10 @@
 #include <sys/time.h>
 #endif
 #include <sys/socket.h>
+#include <sys/uio.h>
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
 #include <netinet/in.h>
 #include <unistd.h>
 #include <stdarg.h>
@@ -148,6 +152,25 @@ gfarm_iobuffer_blocking_read_notimeout_fd_op(struct gfarm_iobuffer *b,
 	}
 }
 
+static void
+wait_writable(int fd)
+{
+#ifdef HAVE_POLL
+	struct pollfd fds[1];
+
+	fds[0].fd = fd;
+	fds[0].events = POLLOUT;
+	fds[0].revents = 0;
+	poll(fds, 1, -1);
+#else
+	fd_set writable;
+
+	FD_ZERO(&writable);
+	FD_SET(fd, &writable);
+	select(fd + 1, NULL, &writable, NULL, NULL);
+#endif
+}
+
 int
 gfarm_iobuffer_blocking_write_socket_op(struct gfarm_iobuffer *b,
 	void *cookie, int fd, void *data, int length)
@@ -160,20 +183,29 @@ gfarm_iobuffer_blocking_write_socket_op(struct gfarm_iobuffer *b,
 			if (errno == EINTR)
 				continue;
 			if (errno == EAGAIN) {
-#ifdef HAVE_POLL
-				struct pollfd fds[1];
+				wait_writable(fd);
+				continue;
+			}
+			gfarm_iobuffer_set_error(b,
+			    gfarm_errno_to_error(errno));
+		}
+		return (rv);
+	}
+}
 
-				fds[0].fd = fd;
-				fds[0].events = POLLOUT;
-				fds[0].revents = 0;
-				poll(fds, 1, -1);
-#else
-				fd_set writable;
+int
+gfarm_iobuffer_blocking_writev_socket_op(struct gfarm_iobuffer *b,
+	void *cookie, int fd, const struct iovec *iov, int iovcnt)
+{
+	ssize_t rv;
 
-				FD_ZERO(&writable);
-				FD_SET(fd, &writable);
-				select(fd + 1, NULL, &writable, NULL, NULL);
-#endif
+	for (;;) {
+		rv = gfarm_sendv_no_sigpipe(fd, iov, iovcnt);
+		if (rv == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				wait_writable(fd);
 				continue;
 			}
 			gfarm_iobuffer_set_error(b,
@@ -183,6 +215,41 @@ gfarm_iobuffer_blocking_write_socket_op(struct gfarm_iobuffer *b,
 	}
 }
 
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+/*
+ * send `len' bytes at `offset' of `src_fd' to the socket
+ * without copying them to the user space.
+ * (*sentp) may be less than `len', if `src_fd' reaches EOF.
+ */
+gfarm_error_t
+gfp_iobuffer_sendfile_socket_op(void *cookie, int fd, int src_fd,
+	gfarm_int64_t offset, size_t len, size_t *sentp)
+{
+	ssize_t rv;
+	off_t off = offset;
+	size_t sent = 0;
+
+	while (sent < len) {
+		rv = sendfile(fd, src_fd, &off, len - sent);
+		if (rv == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				wait_writable(fd);
+				continue;
+			}
+			*sentp = sent;
+			return (gfarm_errno_to_error(errno));
+		}
+		if (rv == 0) /* EOF */
+			break;
+		sent += rv;
+	}
+	*sentp = sent;
+	return (GFARM_ERR_NO_ERROR);
+}
+#endif /* defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H) */
+
 /*
  * an option for gfarm_iobuffer_set_write_close()
  */
@@ -235,7 +302,9 @@ struct gfp_iobuffer_ops gfp_xdr_socket_iobuffer_ops = {
 	gfp_iobuffer_env_for_credential_fd_op,
 	gfarm_iobuffer_blocking_read_timeout_fd_op,
 	gfarm_iobuffer_blocking_read_notimeout_fd_op,
-	gfarm_iobuffer_blocking_write_socket_op
+	gfarm_iobuffer_blocking_write_socket_op,
+	gfarm_iobuffer_blocking_writev_socket_op,
+	GFP_IOBUFFER_SENDFILE_SOCKET_OP
 };
 
 gfarm_error_t
@@ -19,3 +19,13 @@ int gfarm_iobuffer_blocking_read_notimeout_fd_op(struct gfarm_iobuffer *,
 	void *, int, void *, int);
 int gfarm_iobuffer_blocking_write_socket_op(struct gfarm_iobuffer *,
 	void *, int, void *, int);
+struct iovec;
+int gfarm_iobuffer_blocking_writev_socket_op(struct gfarm_iobuffer *,
+	void *, int, const struct iovec *, int);
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+gfarm_error_t gfp_iobuffer_sendfile_socket_op(void *, int, int, gfarm_int64_t,
+	size_t, size_t *);
+#define GFP_IOBUFFER_SENDFILE_SOCKET_OP	gfp_iobuffer_sendfile_socket_op
+#else
+#define GFP_IOBUFFER_SENDFILE_SOCKET_OP	NULL
+#endif
@@ -216,7 +216,9 @@ struct gfp_iobuffer_ops gfp_xdr_secsession_iobuffer_ops = {
 	gfp_iobuffer_env_for_credential_secsession_op,
 	gfarm_iobuffer_read_timeout_secsession_op,
 	gfarm_iobuffer_read_notimeout_secsession_op,
-	gfarm_iobuffer_write_secsession_op
+	gfarm_iobuffer_write_secsession_op,
+	NULL,
+	NULL
 };
 
 gfarm_error_t
@@ -281,7 +283,9 @@ static struct gfp_iobuffer_ops gfp_xdr_insecure_gsi_session_iobuffer_ops = {
 	/* NOTE: the following assumes that these functions don't use cookie */
 	gfarm_iobuffer_blocking_read_timeout_fd_op,
 	gfarm_iobuffer_blocking_read_notimeout_fd_op,
-	gfarm_iobuffer_blocking_write_socket_op
+	gfarm_iobuffer_blocking_write_socket_op,
+	gfarm_iobuffer_blocking_writev_socket_op,
+	GFP_IOBUFFER_SENDFILE_SOCKET_OP
 };
 
 /*
@@ -1,6 +1,8 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <gfarm/error.h>
 #include <gfarm/gflog.h>
 #include <gfarm/gfarm_misc.h>
@@ -22,6 +24,8 @@ struct gfarm_iobuffer {
 	int read_fd; /* for file descriptor i/o */
 
 	int (*write_func)(struct gfarm_iobuffer *, void *, int, void *, int);
+	int (*writev_func)(struct gfarm_iobuffer *, void *, int,
+			   const struct iovec *, int);
 	void *write_cookie;
 	int write_fd; /* for file descriptor i/o */
 
@@ -69,6 +73,7 @@ gfarm_iobuffer_alloc(int bufsize)
 	b->read_fd = -1;
 
 	b->write_func = NULL;
+	b->writev_func = NULL;
 	b->write_cookie = NULL;
 	b->write_fd = -1;
 
@@ -194,6 +199,15 @@ gfarm_iobuffer_set_write(struct gfarm_iobuffer *b,
 	b->write_fd = fd;
 }
 
+/* optional. without this, gfarm_iobuffer_put_write_gather() calls write_func */
+void
+gfarm_iobuffer_set_writev(struct gfarm_iobuffer *b,
+	int (*wvf)(struct gfarm_iobuffer *, void *, int,
+		   const struct iovec *, int))
+{
+	b->writev_func = wvf;
+}
+
 void *
 gfarm_iobuffer_get_write_cookie(struct gfarm_iobuffer *b)
 {
@@ -544,6 +558,57 @@ gfarm_iobuffer_put_write(struct gfarm_iobuffer *b, const void *data, int len)
 	return (len - residual);
 }
 
+/*
+ * same as gfarm_iobuffer_put_write(), but `data' is not copied into
+ * the buffer.  the buffered data and `data' are written out together
+ * before return, thus the caller may reuse `data' after that.
+ */
+int
+gfarm_iobuffer_put_write_gather(struct gfarm_iobuffer *b,
+	const void *data, int len)
+{
+	const char *p = data;
+	int rv, avail, residual = len;
+	struct iovec iov[2];
+
+	/* the buffered data may be overwritten later */
+	if (b->pindown)
+		return (gfarm_iobuffer_put_write(b, data, len));
+
+	while (residual > 0 && b->error == 0) {
+		avail = IOBUFFER_AVAIL_LENGTH(b);
+		if (avail > 0 && b->writev_func == NULL) {
+			gfarm_iobuffer_flush_write(b);
+			continue;
+		}
+		if (avail > 0) {
+			iov[0].iov_base = b->buffer + b->head;
+			iov[0].iov_len = avail;
+			iov[1].iov_base = (void *)p;
+			iov[1].iov_len = residual;
+			rv = (*b->writev_func)(b, b->write_cookie, b->write_fd,
+			    iov, 2);
+		} else {
+			rv = (*b->write_func)(b, b->write_cookie, b->write_fd,
+			    (void *)p, residual);
+		}
+		if (rv <= 0) {
+			/* write_func should have set the error */
+			if (b->error == 0)
+				b->error = GFARM_ERR_INPUT_OUTPUT;
+			break;
+		}
+		if (rv < avail) {
+			b->head += rv;
+			continue;
+		}
+		b->head = b->tail = 0;
+		p += rv - avail;
+		residual -= rv - avail;
+	}
+	return (len - residual);
+}
+
 int
 gfarm_iobuffer_purge_read_x(struct gfarm_iobuffer *b, int len, int just,
 			    int do_timeout)
@@ -96,6 +96,10 @@ void gfarm_iobuffer_set_write_close(struct gfarm_iobuffer *,
 void gfarm_iobuffer_set_write(struct gfarm_iobuffer *,
 	int (*)(struct gfarm_iobuffer *, void *, int, void *, int),
 	void *, int);
+struct iovec;
+void gfarm_iobuffer_set_writev(struct gfarm_iobuffer *,
+	int (*)(struct gfarm_iobuffer *, void *, int,
+		const struct iovec *, int));
 void *gfarm_iobuffer_get_write_cookie(struct gfarm_iobuffer *);
 int gfarm_iobuffer_get_write_fd(struct gfarm_iobuffer *);
 int gfarm_iobuffer_purge(struct gfarm_iobuffer *, int *);
@@ -103,6 +107,9 @@ void gfarm_iobuffer_flush_write(struct gfarm_iobuffer *);
 
 /* enqueue by memory copy, dequeue by write */
 int gfarm_iobuffer_put_write(struct gfarm_iobuffer *, const void *, int);
+/* enqueue by reference, dequeue by write immediately */
+int gfarm_iobuffer_put_write_gather(struct gfarm_iobuffer *, const void *,
+	int);
 /* enqueue by read, dequeue by purge */
 int gfarm_iobuffer_purge_read_x(struct gfarm_iobuffer *, int, int, int);
 /* enqueue by read, dequeue by memory copy */
@@ -51,9 +51,15 @@ gfarm_iostat_static_term(struct gfarm_context *ctxp)
 }
 
 
+/*
+ * create an iostat file, and map it.
+ * this is used for a statistics file other than the per-process one too.
+ */
 gfarm_error_t
-gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
-		unsigned int nitem, unsigned int row)
+gfarm_iostat_mmap_file(char *path, struct gfarm_iostat_spec *specp,
+		unsigned int nitem, unsigned int row,
+		struct gfarm_iostat_head **hpp,
+		struct gfarm_iostat_items **sipp, gfarm_off_t *sizep)
 {
 	int fd;
 	gfarm_error_t e;
@@ -120,12 +126,20 @@ gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
 		return (e);
 	}
 	close(fd);
-	staticp->stat_hp = (struct gfarm_iostat_head *)addr;
-	staticp->stat_sip = (struct gfarm_iostat_items *)((char *)addr + off);
-	staticp->stat_size = size;
+	*hpp = (struct gfarm_iostat_head *)addr;
+	*sipp = (struct gfarm_iostat_items *)((char *)addr + off);
+	*sizep = size;
 
 	return (GFARM_ERR_NO_ERROR);
 }
+
+gfarm_error_t
+gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
+		unsigned int nitem, unsigned int row)
+{
+	return (gfarm_iostat_mmap_file(path, specp, nitem, row,
+	    &staticp->stat_hp, &staticp->stat_sip, &staticp->stat_size));
+}
 void
 gfarm_iostat_sync(void)
 {
@@ -1,5 +1,10 @@
 gfarm_error_t gfarm_iostat_mmap(char *path,  struct gfarm_iostat_spec *specp,
 		unsigned int nitem, unsigned int row);
+gfarm_error_t gfarm_iostat_mmap_file(char *path,
+		struct gfarm_iostat_spec *specp,
+		unsigned int nitem, unsigned int row,
+		struct gfarm_iostat_head **hpp,
+		struct gfarm_iostat_items **sipp, gfarm_off_t *sizep);
 void gfarm_iostat_clear_id(gfarm_uint64_t id, unsigned int hint);
 void gfarm_iostat_clear_ip(struct gfarm_iostat_items *ip);
 struct gfarm_iostat_items *gfarm_iostat_find_space(unsigned int hint);
@@ -37,6 +37,8 @@ long gfarm_random(void);
 
 void gfarm_sigpipe_ignore(void);
 ssize_t gfarm_send_no_sigpipe(int, const void *, size_t);
+struct iovec;
+ssize_t gfarm_sendv_no_sigpipe(int, const struct iovec *, int);
 
 /* sleep */
 
@@ -1,5 +1,6 @@
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
@@ -16,17 +17,22 @@ gfarm_sigpipe_ignore(void)
 #endif /* __KERNEL__ */
 
 ssize_t
-gfarm_send_no_sigpipe(int fd, const void *data, size_t length)
+gfarm_sendv_no_sigpipe(int fd, const struct iovec *iov, int iovcnt)
 {
 #ifdef MSG_NOSIGNAL
-	return (send(fd, data, length, MSG_NOSIGNAL));
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = iovcnt;
+	return (sendmsg(fd, &msg, MSG_NOSIGNAL));
 #else /* !defined(MSG_NOSIGNAL) */
 	if (sigpipe_is_ignored) {
-		return (write(fd, data, length));
+		return (writev(fd, iov, iovcnt));
 	} else {
 		/*
 		 * This code assumes that SIGPIPE is posted synchronously
-		 * in write(2) operation, instead of asynchronously.
+		 * in writev(2) operation, instead of asynchronously.
 		 */
 		ssize_t rv;
 		int old_is_set;
@@ -38,7 +44,7 @@ gfarm_send_no_sigpipe(int fd, const void *data, size_t length)
 			old_is_set = 0;
 		else
 			old_is_set = 1;
-		rv = write(fd, data, length);
+		rv = writev(fd, iov, iovcnt);
 		if (old_is_set)
 			sigaction(SIGPIPE, &sigpipe_old, NULL);
 		return (rv);
@@ -46,3 +52,16 @@ gfarm_send_no_sigpipe(int fd, const void *data, size_t length)
 #endif /* !defined(MSG_NOSIGNAL) */
 }
 
+ssize_t
+gfarm_send_no_sigpipe(int fd, const void *data, size_t length)
+{
+#ifdef MSG_NOSIGNAL
+	return (send(fd, data, length, MSG_NOSIGNAL));
+#else /* !defined(MSG_NOSIGNAL) */
+	struct iovec iov;
+
+	iov.iov_base = (void *)data;
+	iov.iov_len = length;
+	return (gfarm_sendv_no_sigpipe(fd, &iov, 1));
+#endif /* !defined(MSG_NOSIGNAL) */
+}
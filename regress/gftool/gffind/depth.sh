@@ -0,0 +1,18 @@
+#!/bin/sh
+
+. ./regress.conf
+. $testbase/gffind-common.sh
+
+if gffind_setup &&
+   gffind_check -- -d 0 $gftmp &&
+   gffind_check d1 empty file0 -- -d 1 $gftmp &&
+   gffind_check d1 d1/d2 d1/file1 d1/link1 empty file0 -- -d 2 $gftmp &&
+   gffind_check d1/d2/file2 d1/file1 file0 -- -d 3 -t f $gftmp &&
+   gffind_check d1/d2/d3/file3 d1/d2/file2 d1/file1 file0 -- \
+	-d 4 -t f $gftmp
+then
+	exit_code=$exit_pass
+fi
+
+gffind_cleanup
+exit $exit_code
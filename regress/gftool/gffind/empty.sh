@@ -0,0 +1,15 @@
+#!/bin/sh
+
+. ./regress.conf
+. $testbase/gffind-common.sh
+
+if gffind_setup &&
+   gffind_check -- $gftmp/empty &&
+   gffind_check -- -t f $gftmp/empty &&
+   gffind_check -- -d 1 $gftmp/empty
+then
+	exit_code=$exit_pass
+fi
+
+gffind_cleanup
+exit $exit_code
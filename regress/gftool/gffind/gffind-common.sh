@@ -0,0 +1,49 @@
+# this file is sourced from the gffind tests, after ./regress.conf
+#
+#	$gftmp/d1/d2/d3/file3
+#	$gftmp/d1/d2/file2
+#	$gftmp/d1/file1
+#	$gftmp/d1/link1 -> file1
+#	$gftmp/empty/
+#	$gftmp/file0
+
+expected=$localtmp.expected
+
+trap 'gfrm -rf $gftmp; rm -f $localtmp $expected; exit $exit_trap' \
+	$trap_sigs
+
+gffind_setup()
+{
+	gfmkdir -p $gftmp/d1/d2/d3 $gftmp/empty &&
+	gfreg $data/1byte $gftmp/file0 &&
+	gfreg $data/1byte $gftmp/d1/file1 &&
+	gfreg $data/0byte $gftmp/d1/d2/file2 &&
+	gfreg $data/0byte $gftmp/d1/d2/d3/file3 &&
+	gfln -s file1 $gftmp/d1/link1
+}
+
+# gffind_check expected_path... -- gffind_option...
+gffind_check()
+{
+	while [ $# -gt 0 ] && [ x"$1" != x"--" ]; do
+		echo "$gftmp/$1"
+		shift
+	done | sort >$expected
+	while [ $# -gt 0 ] && [ x"$1" != x"--" ]; do
+		shift
+	done
+	shift
+	if gffind "$@" | sort >$localtmp && cmp -s $localtmp $expected
+	then
+		return 0
+	fi
+	echo "gffind $*:"
+	diff $expected $localtmp
+	return 1
+}
+
+gffind_cleanup()
+{
+	gfrm -rf $gftmp
+	rm -f $localtmp $expected
+}
@@ -0,0 +1,16 @@
+#!/bin/sh
+
+. ./regress.conf
+. $testbase/gffind-common.sh
+
+if gffind_setup &&
+   gffind_check d1/d2/d3/file3 d1/d2/file2 d1/file1 file0 -- \
+	-n 'file*' $gftmp &&
+   gffind_check d1/file1 -- -n file1 $gftmp &&
+   gffind_check -- -n nomatch $gftmp
+then
+	exit_code=$exit_pass
+fi
+
+gffind_cleanup
+exit $exit_code
@@ -0,0 +1,17 @@
+#!/bin/sh
+
+. ./regress.conf
+. $testbase/gffind-common.sh
+
+if gffind_setup &&
+   gffind_check d1 d1/d2 d1/d2/d3 empty -- -t d $gftmp &&
+   gffind_check d1/d2/d3/file3 d1/d2/file2 d1/file1 file0 -- \
+	-t f $gftmp &&
+   gffind_check d1/link1 -- -t l $gftmp &&
+   gffind_check d1/link1 empty -- -t l -t d -n '[el]*' $gftmp
+then
+	exit_code=$exit_pass
+fi
+
+gffind_cleanup
+exit $exit_code
@@ -0,0 +1,54 @@
+#!/bin/sh
+
+# the argument is the configuration directives of the read to test,
+# separated by ";"
+
+. ./regress.conf
+
+gfs_pio_test=$testbin/gfs_pio_test
+rc=$localtmp.rc
+src=$localtmp.src
+expected=$localtmp.expected
+
+trap 'gfrm -f $gftmp; rm -f $localtmp $rc $src $expected; exit $exit_trap' $trap_sigs
+
+# the first lines have precedence over the configuration of the user
+{
+	echo "$1" | tr ';' '\n'
+	echo "client_file_bufsize 65536"
+	if [ -n "$GFARM_CONFIG_FILE" ]; then
+		cat "$GFARM_CONFIG_FILE"
+	elif [ -f "$HOME/.gfarm2rc" ]; then
+		cat "$HOME/.gfarm2rc"
+	fi
+} >$rc
+GFARM_CONFIG_FILE=$rc
+export GFARM_CONFIG_FILE
+
+# several times of the file buffer, and not a multiple of it
+dd if=/dev/urandom of=$src bs=1000 count=300 2>/dev/null
+
+# -R options to read sequentially beyond the file buffer
+# (the size of each read is limited to BUFSIZ by gfs_pio_test)
+reads=
+i=0
+while [ $i -lt 80 ]; do
+	reads="$reads -R 1024"
+	i=`expr $i + 1`
+done
+
+# read_test <gfs_pio_test options>...
+# passes, if the output of the options is same with $expected
+read_test()
+{
+	if gfreg $src $gftmp &&
+	   $gfs_pio_test "$@" $gftmp >$localtmp &&
+	   cmp -s $localtmp $expected
+	then
+		exit_code=$exit_pass
+	fi
+
+	gfrm $gftmp
+	rm -f $localtmp $rc $src $expected
+	exit $exit_code
+}
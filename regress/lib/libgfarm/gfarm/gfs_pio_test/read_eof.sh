@@ -0,0 +1,7 @@
+#!/bin/sh
+
+. `dirname $0`/read-common.sh
+
+# a read at EOF returns nothing, and the file can be read again after that
+cat $src $src >$expected
+read_test -r -I -R 1024 -S 0 -I
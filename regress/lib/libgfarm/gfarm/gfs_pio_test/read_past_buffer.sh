@@ -0,0 +1,6 @@
+#!/bin/sh
+
+. `dirname $0`/read-common.sh
+
+cp $src $expected
+read_test -r -I
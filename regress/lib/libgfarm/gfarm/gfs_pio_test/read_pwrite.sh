@@ -0,0 +1,8 @@
+#!/bin/sh
+
+. `dirname $0`/read-common.sh
+
+# overwrite the range which is being read ahead, and read it
+{ head -c 81920 $src; head -c 200000 $src | tail -c +131073
+  printf abcde; tail -c +200006 $src; } >$expected
+echo abcde | read_test $reads -S 200000 -W 5 -F -S 131072 -I
@@ -0,0 +1,7 @@
+#!/bin/sh
+
+. `dirname $0`/read-common.sh
+
+# seek back, while the rest is being read ahead
+{ head -c 81920 $src; tail -c +16385 $src; } >$expected
+read_test -r $reads -S 16384 -I
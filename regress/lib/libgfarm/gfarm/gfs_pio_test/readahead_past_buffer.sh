@@ -0,0 +1,5 @@
+#!/bin/sh
+
+. ./regress.conf
+
+$testbase/read_past_buffer.sh "client_bulkread_window 0;client_readahead 8"
@@ -0,0 +1,194 @@
+/*
+ * $Id$
+ */
+
+/*
+ * check that giant_lock can be acquired, i.e. a request can be processed,
+ * while db_snapshot_write() is dumping the tables.
+ * the functions which db_snapshot.c calls are replaced by the stubs below.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/param.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+
+#include "config.h"
+#include "gfm_proto.h"
+#include "gfp_xdr.h"
+
+#include "subr.h"
+#include "giant_stat.h"
+#include "mdhost.h"
+#include "inode.h"
+#include "db_journal.h"
+#include "db_snapshot.h"
+
+#define TEST_SEQNUM		12345
+#define TEST_DUMP_SECONDS	3	/* time to dump the tables */
+#define TEST_LOCK_SECONDS	1	/* time limit to acquire giant_lock */
+
+char *program_name = "db_snapshot_test";
+
+static pthread_mutex_t giant_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* the child process which dumps the tables notifies by this */
+static int dump_started[2];
+
+/* the child process exits with an error instead of dumping */
+static int dump_fails;
+
+static int write_done;
+static gfarm_error_t write_result;
+
+void
+giant_lock(void)
+{
+	pthread_mutex_lock(&giant_mutex);
+}
+
+void
+giant_unlock(void)
+{
+	pthread_mutex_unlock(&giant_mutex);
+}
+
+void
+giant_set_shared_mode(int shared)
+{
+}
+
+void
+giant_shared_update_begin(void)
+{
+}
+
+void
+giant_shared_update_end(void)
+{
+}
+
+int
+giant_stat_owner_set(int owner)
+{
+	return (0);
+}
+
+int
+mdhost_self_is_master(void)
+{
+	return (1);
+}
+
+gfarm_uint64_t
+db_journal_get_current_seqnum(void)
+{
+	return (TEST_SEQNUM);
+}
+
+/* a slow dump of the root directory */
+void
+inode_snapshot(struct db_snapshot_writer *w)
+{
+	struct gfs_stat st;
+
+	if (dump_fails)
+		_exit(1);
+	memset(&st, 0, sizeof(st));
+	st.st_ino = 1;
+	st.st_gen = 0;
+	st.st_nlink = 2;
+	st.st_mode = GFARM_S_IFDIR | 0755;
+	st.st_user = "root";
+	st.st_group = "root";
+	db_snapshot_section_begin(w, DB_SNAPSHOT_INODE);
+	db_snapshot_put_inode(w, &st);
+
+	(void)write(dump_started[1], "", 1);
+	sleep(TEST_DUMP_SECONDS);
+}
+
+static void *
+write_thread(void *arg)
+{
+	write_result = db_snapshot_write();
+	write_done = 1;
+	return (NULL);
+}
+
+static void
+fail(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", program_name, msg);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	pthread_t t;
+	struct timespec start, end;
+	gfarm_uint64_t seqnum;
+	char c, path[MAXPATHLEN + 1];
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <gfmd.conf>\n", program_name);
+		return (EXIT_FAILURE);
+	}
+	/* the snapshot is written to metadb_journal_dir */
+	e = gfarm_server_initialize(argv[1], &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR)
+		fail(gfarm_error_string(e));
+
+	if (pipe(dump_started) == -1)
+		fail("pipe failed");
+	if (pthread_create(&t, NULL, write_thread, NULL) != 0)
+		fail("pthread_create failed");
+	if (read(dump_started[0], &c, 1) != 1)
+		fail("the dump didn't start");
+
+	/* this is what a request does */
+	gfarm_gettime(&start);
+	giant_lock();
+	giant_unlock();
+	gfarm_gettime(&end);
+	if (end.tv_sec - start.tv_sec >= TEST_LOCK_SECONDS)
+		fail("giant_lock is held while dumping");
+	if (write_done)
+		fail("the dump finished too early");
+
+	pthread_join(t, NULL);
+	if (write_result != GFARM_ERR_NO_ERROR)
+		fail(gfarm_error_string(write_result));
+	e = db_snapshot_open(TEST_SEQNUM, &seqnum);
+	if (e != GFARM_ERR_NO_ERROR)
+		fail(gfarm_error_string(e));
+	if (seqnum != TEST_SEQNUM)
+		fail("unexpected seqnum");
+	db_snapshot_close(0);
+
+	/* a failure of the child process leaves the previous snapshot */
+	dump_fails = 1;
+	if (db_snapshot_write() == GFARM_ERR_NO_ERROR)
+		fail("the failure of the dump isn't reported");
+	snprintf(path, sizeof(path), "%s/snapshot.gms.tmp",
+	    gfarm_get_journal_dir());
+	if (access(path, F_OK) == 0)
+		fail("the temporary file is left");
+	e = db_snapshot_open(TEST_SEQNUM, &seqnum);
+	if (e != GFARM_ERR_NO_ERROR)
+		fail(gfarm_error_string(e));
+	db_snapshot_close(0);
+
+	printf("ok\n");
+	return (EXIT_SUCCESS);
+}
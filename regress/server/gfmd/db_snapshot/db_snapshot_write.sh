@@ -0,0 +1,21 @@
+#!/bin/sh
+
+. ./regress.conf
+
+tmpdir=$localtmp
+conf=$localtmp/gfmd.conf
+
+clean() {
+	rm -rf $tmpdir
+}
+
+trap 'clean; exit $exit_trap' $trap_sigs
+
+mkdir $tmpdir &&
+printf "metadb_server_host localhost\nmetadb_journal_dir $tmpdir\n" \
+	>$conf &&
+$testbin/db_snapshot_test $conf &&
+	exit_code=$exit_pass
+
+clean
+exit $exit_code
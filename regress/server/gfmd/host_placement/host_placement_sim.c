@@ -0,0 +1,312 @@
+/*
+ * $Id$
+ */
+
+/*
+ * replay a trace of replica placements offline,
+ * with the same algorithm as gfmd (server/gfmd/host_placement.c).
+ *
+ * trace format (one command per line, '#' starts a comment):
+ *	host NAME NCPU LOADAVG DISK_USED DISK_AVAIL [FSNGROUP]
+ *		define a filesystem node.  disk sizes are in KiB.
+ *	load NAME LOADAVG
+ *		update loadavg of the node.
+ *	place SIZE NCOPY HOST...
+ *		replicate a file of SIZE KiB, which has replicas on HOST...,
+ *		until it has NCOPY replicas.
+ *	complete N
+ *		complete the oldest N ongoing replications.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gfarm/gfarm.h>
+
+#include "host_placement.h"
+
+#define MAX_HOSTS	4096
+#define MAX_ARGS	64
+#define MAX_ONGOING	(1024 * 1024)
+
+struct sim_host {
+	char *name, *fsngroup;
+	int ncpu;
+	double loadavg;
+	gfarm_off_t disk_used, disk_avail;
+	int n_replications, max_replications;
+	long long n_placed;
+	gfarm_off_t placed_size;
+};
+
+static struct sim_host hosts[MAX_HOSTS];
+static int nhosts;
+
+/* FIFO of ongoing replications */
+static struct ongoing {
+	struct sim_host *src, *dst;
+} ongoing[MAX_ONGOING];
+static int ongoing_head, ongoing_n;
+
+static int random_mode;
+static const char *program_name = "host_placement_sim";
+
+static long
+sim_random(void)
+{
+	return (random());
+}
+
+static struct sim_host *
+host_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < nhosts; i++) {
+		if (strcmp(hosts[i].name, name) == 0)
+			return (&hosts[i]);
+	}
+	return (NULL);
+}
+
+static void
+replication_start(struct sim_host *src, struct sim_host *dst,
+	gfarm_off_t size)
+{
+	struct ongoing *o;
+
+	if (ongoing_n >= MAX_ONGOING) {
+		fprintf(stderr, "%s: too many ongoing replications\n",
+		    program_name);
+		exit(EXIT_FAILURE);
+	}
+	o = &ongoing[(ongoing_head + ongoing_n++) % MAX_ONGOING];
+	o->src = src;
+	o->dst = dst;
+	src->n_replications++;
+	dst->n_replications++;
+	if (src->max_replications < src->n_replications)
+		src->max_replications = src->n_replications;
+	if (dst->max_replications < dst->n_replications)
+		dst->max_replications = dst->n_replications;
+	dst->disk_used += size;
+	dst->disk_avail -= size;
+	dst->n_placed++;
+	dst->placed_size += size;
+}
+
+static void
+replication_complete(int n)
+{
+	struct ongoing *o;
+
+	for (; n > 0 && ongoing_n > 0; n--, ongoing_n--) {
+		o = &ongoing[ongoing_head];
+		ongoing_head = (ongoing_head + 1) % MAX_ONGOING;
+		o->src->n_replications--;
+		o->dst->n_replications--;
+	}
+}
+
+static int
+is_existing(struct sim_host *h, int n_existing, struct sim_host **existing)
+{
+	int i;
+
+	for (i = 0; i < n_existing; i++) {
+		if (existing[i] == h)
+			return (1);
+	}
+	return (0);
+}
+
+static void
+place(long long seq, gfarm_off_t size, int ncopy,
+	int n_existing, struct sim_host **existing)
+{
+	static struct host_placement_candidate cands[MAX_HOSTS];
+	static const char *groups[MAX_HOSTS + MAX_ARGS];
+	struct sim_host *h, *tmp;
+	int i, j, ncands = 0, n_shortage = ncopy - n_existing, n;
+
+	for (i = 0; i < nhosts; i++) {
+		h = &hosts[i];
+		if (is_existing(h, n_existing, existing) ||
+		    h->disk_avail < size)
+			continue;
+		cands[ncands].host = h;
+		cands[ncands].fsngroup = h->fsngroup;
+		cands[ncands].ncpu = h->ncpu;
+		cands[ncands].loadavg = h->loadavg;
+		cands[ncands].disk_used = h->disk_used;
+		cands[ncands].disk_avail = h->disk_avail;
+		cands[ncands].n_replications = h->n_replications;
+		ncands++;
+	}
+	if (n_shortage <= 0)
+		n = 0;
+	else if (ncands <= n_shortage)
+		n = ncands;
+	else if (random_mode) { /* the algorithm before the cost-based one */
+		for (n = 0; n < n_shortage; n++) {
+			j = n + random() % (ncands - n);
+			tmp = cands[n].host;
+			cands[n].host = cands[j].host;
+			cands[j].host = tmp;
+		}
+	} else {
+		for (i = 0; i < n_existing; i++)
+			groups[i] = existing[i]->fsngroup;
+		n = host_placement_select(ncands, cands, n_existing, groups,
+		    n_shortage, sim_random);
+	}
+
+	printf("place %lld:", seq);
+	for (i = 0; i < n; i++) {
+		h = cands[i].host;
+		printf(" %s", h->name);
+		replication_start(existing[i % n_existing], h, size);
+	}
+	if (n < n_shortage)
+		printf(" (short of %d)", n_shortage - n);
+	printf("\n");
+}
+
+static void
+summary(void)
+{
+	int i, max = 0;
+	struct sim_host *h;
+
+	printf("%-20s %-10s %10s %14s %6s %6s\n", "host", "fsngroup",
+	    "placed", "placed(KiB)", "maxrep", "used%");
+	for (i = 0; i < nhosts; i++) {
+		h = &hosts[i];
+		printf("%-20s %-10s %10lld %14lld %6d %5.1f%%\n", h->name,
+		    h->fsngroup[0] == '\0' ? "-" : h->fsngroup,
+		    h->n_placed, (long long)h->placed_size,
+		    h->max_replications,
+		    h->disk_used + h->disk_avail == 0 ? 0.0 :
+		    100.0 * h->disk_used / (h->disk_used + h->disk_avail));
+		if (max < h->max_replications)
+			max = h->max_replications;
+	}
+	printf("max ongoing replications of a host: %d\n", max);
+}
+
+static void
+parse_error(long long lineno, const char *msg)
+{
+	fprintf(stderr, "%s: line %lld: %s\n", program_name, lineno, msg);
+	exit(EXIT_FAILURE);
+}
+
+static void
+replay(FILE *fp)
+{
+	char line[4096], *argv[MAX_ARGS], *s;
+	struct sim_host *h, *existing[MAX_ARGS];
+	long long lineno = 0, seq = 0;
+	int argc, i;
+
+	while (fgets(line, sizeof line, fp) != NULL) {
+		lineno++;
+		if ((s = strchr(line, '#')) != NULL)
+			*s = '\0';
+		argc = 0;
+		for (s = strtok(line, " \t\n"); s != NULL && argc < MAX_ARGS;
+		    s = strtok(NULL, " \t\n"))
+			argv[argc++] = s;
+		if (argc == 0)
+			continue;
+
+		if (strcmp(argv[0], "host") == 0) {
+			if (argc < 6 || argc > 7)
+				parse_error(lineno, "host: wrong arguments");
+			if (host_lookup(argv[1]) != NULL)
+				parse_error(lineno, "host: already defined");
+			if (nhosts >= MAX_HOSTS)
+				parse_error(lineno, "host: too many hosts");
+			h = &hosts[nhosts++];
+			memset(h, 0, sizeof(*h));
+			h->name = strdup(argv[1]);
+			h->ncpu = atoi(argv[2]);
+			h->loadavg = atof(argv[3]);
+			h->disk_used = atoll(argv[4]);
+			h->disk_avail = atoll(argv[5]);
+			h->fsngroup = strdup(argc > 6 ? argv[6] : "");
+			if (h->name == NULL || h->fsngroup == NULL)
+				parse_error(lineno, "no memory");
+		} else if (strcmp(argv[0], "load") == 0) {
+			if (argc != 3)
+				parse_error(lineno, "load: wrong arguments");
+			if ((h = host_lookup(argv[1])) == NULL)
+				parse_error(lineno, "load: unknown host");
+			h->loadavg = atof(argv[2]);
+		} else if (strcmp(argv[0], "place") == 0) {
+			if (argc < 4)
+				parse_error(lineno, "place: wrong arguments");
+			for (i = 3; i < argc; i++) {
+				existing[i - 3] = host_lookup(argv[i]);
+				if (existing[i - 3] == NULL)
+					parse_error(lineno,
+					    "place: unknown host");
+			}
+			place(++seq, atoll(argv[1]), atoi(argv[2]),
+			    argc - 3, existing);
+		} else if (strcmp(argv[0], "complete") == 0) {
+			if (argc != 2)
+				parse_error(lineno,
+				    "complete: wrong arguments");
+			replication_complete(atoi(argv[1]));
+		} else
+			parse_error(lineno, "unknown command");
+	}
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-r] [-s seed] [tracefile]\n",
+	    program_name);
+	fprintf(stderr, "\t-r\tselect targets randomly, for comparison\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	int c;
+	FILE *fp = stdin;
+
+	if (argc > 0)
+		program_name = argv[0];
+	srandom(1);
+	while ((c = getopt(argc, argv, "rs:")) != -1) {
+		switch (c) {
+		case 'r':
+			random_mode = 1;
+			break;
+		case 's':
+			srandom(atoi(optarg));
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc > 1)
+		usage();
+	if (argc == 1 && (fp = fopen(argv[0], "r")) == NULL) {
+		perror(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	replay(fp);
+	if (fp != stdin)
+		fclose(fp);
+	summary();
+	return (0);
+}
@@ -912,6 +912,78 @@ async_client_send_raw_request(struct abstract_host *host,
 	return (e);
 }
 
+/*
+ * same as async_client_vsend_wrapped_request(), but the parameters of
+ * the request are sent by `send_params' instead of a format string,
+ * for a request which has a variable number of parameters.
+ * `size' is the size of the parameters.
+ */
+gfarm_error_t
+async_client_vsend_wrapped_params_request(struct abstract_host *host,
+	struct peer *peer0, const char *diag,
+	result_callback_t result_callback,
+	disconnect_callback_t disconnect_callback, void *closure,
+	const char *wrapping_format, va_list *wrapping_app,
+	gfarm_int32_t command, size_t size,
+	gfarm_error_t (*send_params)(struct gfp_xdr *, void *), void *params)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	struct peer *peer;
+	gfp_xdr_async_peer_t async;
+	struct gfp_xdr *server;
+	gfarm_int32_t xid;
+	const char *fmt;
+	va_list ap;
+
+	if (debug_mode)
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "%s: <%s> channel sending request(%d)",
+		    abstract_host_get_name(host), diag, command);
+
+	if (wrapping_format != NULL) {
+		va_copy(ap, *wrapping_app);
+		fmt = wrapping_format;
+		e = gfp_xdr_vsend_size_add(&size, &fmt, &ap);
+		va_end(ap);
+	}
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send_size_add(&size, "i", command);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+
+	if ((e = async_client_sender_lock(host, peer0, &peer, command,
+	    diag)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s", gfarm_error_string(e));
+		return (e);
+	}
+
+	async = peer_get_async(peer);
+	server = peer_get_conn(peer);
+	assert(async != NULL);
+
+	e = gfp_xdr_send_async_request_header(server, async, size,
+	    result_callback, disconnect_callback, closure, &xid);
+	if (e == GFARM_ERR_NO_ERROR) {
+		if (wrapping_format != NULL)
+			e = gfp_xdr_vsend(server, &wrapping_format,
+			    wrapping_app);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = gfp_xdr_send(server, "i", command);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = (*send_params)(server, params);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = gfp_xdr_flush(server);
+		if (e != GFARM_ERR_NO_ERROR)
+			gfp_xdr_send_async_request_error(async, xid, diag);
+	}
+	if (e != GFARM_ERR_NO_ERROR) /* must be IS_CONNECTION_ERROR(e) */
+		async_server_disconnect_request(host, peer,
+		    diag, "request", gfarm_error_string(e));
+
+	async_client_sender_unlock(host, peer, diag);
+	return (e);
+}
+
 /* abstract_host_receiver_lock() must be already called here by
  * channel_main() */
 gfarm_error_t
@@ -94,6 +94,11 @@ gfarm_error_t async_client_vsend_request(struct abstract_host *,
 gfarm_error_t async_client_send_raw_request(struct abstract_host *,
 	struct peer *, const char *, result_callback_t,
 	disconnect_callback_t, void *, size_t, void *);
+gfarm_error_t async_client_vsend_wrapped_params_request(
+	struct abstract_host *, struct peer *, const char *,
+	result_callback_t, disconnect_callback_t, void *,
+	const char *, va_list *, gfarm_int32_t, size_t,
+	gfarm_error_t (*)(struct gfp_xdr *, void *), void *);
 gfarm_error_t async_client_vrecv_result(struct peer *,
 	struct abstract_host *, size_t, const char *, const char **,
 	gfarm_error_t *, va_list *);
@@ -159,6 +159,45 @@ gfs_client_send_request(struct host *host,
 	return (e);
 }
 
+/*
+ * same as gfs_client_send_request(), but the parameters are sent by
+ * `send_params' instead of a format string, e.g. for a variable length
+ * array.  `size' is the size of the parameters.
+ */
+gfarm_error_t
+gfs_client_send_params_request(struct host *host,
+	struct peer *peer0, const char *diag,
+	gfarm_int32_t (*result_callback)(void *, void *, size_t),
+	void (*disconnect_callback)(void *, void *),
+	void *closure, gfarm_int32_t command, size_t size,
+	gfarm_error_t (*send_params)(struct gfp_xdr *, void *), void *params)
+{
+	gfarm_error_t e;
+	struct peer *peer;
+
+	if (peer0 == NULL)
+		peer = host_get_peer(host);  /* increment refcount */
+	else
+		peer = peer0;
+
+	if (peer == NULL || peer_get_parent(peer) == NULL) {
+		e = async_client_vsend_wrapped_params_request(
+		    host_to_abstract_host(host), peer, diag,
+		    result_callback, disconnect_callback, closure,
+		    NULL, NULL, command, size, send_params, params);
+	} else {
+		e = gfmdc_master_client_remote_gfs_params_rpc(
+		    host_to_abstract_host(host), peer, diag, result_callback,
+		    disconnect_callback, closure, command, size,
+		    send_params, params);
+	}
+
+	if (peer0 == NULL)
+		host_put_peer(host, peer);  /* decrement refcount */
+
+	return (e);
+}
+
 gfarm_error_t
 gfs_client_recv_result_and_error(struct peer *peer, struct host *host,
 	size_t size, gfarm_error_t *errcodep,
@@ -12,6 +12,10 @@ gfarm_error_t gfm_async_server_put_reply(struct host *, struct peer *,
 gfarm_error_t gfs_client_send_request(struct host *,
 	struct peer *, const char *, gfarm_int32_t (*)(void *, void *, size_t),
 	void (*)(void *, void *), void *, gfarm_int32_t, const char *, ...);
+gfarm_error_t gfs_client_send_params_request(struct host *,
+	struct peer *, const char *, gfarm_int32_t (*)(void *, void *, size_t),
+	void (*)(void *, void *), void *, gfarm_int32_t, size_t,
+	gfarm_error_t (*)(struct gfp_xdr *, void *), void *);
 gfarm_error_t gfs_client_recv_result_and_error(struct peer *, struct host *,
 	size_t, gfarm_error_t *, const char *, const char *, ...);
 gfarm_error_t gfs_client_recv_result(struct peer *, struct host *,
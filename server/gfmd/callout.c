@@ -14,15 +14,39 @@
 #include "subr.h"
 #include "thrpool.h"
 
+/*
+ * pending callouts are kept in a hierarchical timer wheel,
+ * like the callout(9) implementation of NetBSD,
+ * thus, both callout_schedule() and callout_stop() are O(1).
+ *
+ * time is measured by CALLOUT_TICK, and a callout is never invoked
+ * before its target time.
+ * a callout whose target time is more than CALLOUT_WHEEL_RANGE ticks
+ * later is kept in the last bucket of the last wheel, and is re-inserted
+ * when the bucket is cascaded.
+ */
+#define CALLOUT_TICK		(10 * GFARM_MILLISEC_BY_NANOSEC)
+#define CALLOUT_WHEEL_BITS	6
+#define CALLOUT_WHEEL_SIZE	(1 << CALLOUT_WHEEL_BITS)
+#define CALLOUT_WHEEL_MASK	(CALLOUT_WHEEL_SIZE - 1)
+#define CALLOUT_NWHEELS		4
+#define CALLOUT_WHEEL_RANGE \
+	((gfarm_uint64_t)1 << (CALLOUT_WHEEL_BITS * CALLOUT_NWHEELS))
+
+/* doubly linked circular list */
+struct callout_link {
+	struct callout_link *prev, *next;
+};
+
 struct callout {
-	struct callout *prev, *next;
+	struct callout_link link; /* must be first member */
 
 #define CALLOUT_PENDING		1
 #define CALLOUT_FIRED		2
 #define CALLOUT_INVOKING	4
 	int state;
 
-	struct timespec target_time;
+	gfarm_uint64_t target_tick;
 
 	struct thread_pool *thrpool;
 	void *(*func)(void *);
@@ -33,24 +57,155 @@ struct callout_module {
 	pthread_mutex_t mutex;
 	pthread_cond_t have_things_to_run;
 
-	/* dummy head of doubly linked circular list */
-	struct callout pendings;
+	struct timespec base_time;	/* time of tick 0 */
+	gfarm_uint64_t ticks;		/* all ticks <= this are processed */
+	gfarm_uint64_t wakeup_tick;	/* callout_main() sleeps until this */
+	int npendings;
+
+	struct callout_link wheels[CALLOUT_NWHEELS][CALLOUT_WHEEL_SIZE];
+	struct callout_link expired;	/* to be invoked */
 } callout_module;
 
 static const char module_name[] = "callout_module";
 
-int
-timespec_cmp(const struct timespec *t1, const struct timespec *t2)
+static void
+callout_link_init(struct callout_link *l)
+{
+	l->prev = l;
+	l->next = l;
+}
+
+static void
+callout_link_insert_tail(struct callout_link *head, struct callout_link *l)
+{
+	l->prev = head->prev;
+	l->next = head;
+	head->prev->next = l;
+	head->prev = l;
+}
+
+static void
+callout_link_remove(struct callout_link *l)
+{
+	l->prev->next = l->next;
+	l->next->prev = l->prev;
+	/* clear the pointers to be sure */
+	callout_link_init(l);
+}
+
+/* elapsed time since callout_module.base_time */
+static gfarm_int64_t
+callout_elapsed_nsec(struct callout_module *cm)
 {
-	if (t1->tv_sec > t2->tv_sec)
-		return (1);
-	if (t1->tv_sec < t2->tv_sec)
-		return (-1);
-	if (t1->tv_nsec > t2->tv_nsec)
-		return (1);
-	if (t1->tv_nsec < t2->tv_nsec)
-		return (-1);
-	return (0);
+	struct timespec now;
+
+	gfarm_gettime(&now);
+	return ((gfarm_int64_t)(now.tv_sec - cm->base_time.tv_sec) *
+	    GFARM_SECOND_BY_NANOSEC + (now.tv_nsec - cm->base_time.tv_nsec));
+}
+
+static void
+callout_tick_to_time(struct callout_module *cm, gfarm_uint64_t tick,
+	struct timespec *ts)
+{
+	gfarm_uint64_t nsec = tick * CALLOUT_TICK;
+
+	*ts = cm->base_time;
+	ts->tv_sec += nsec / GFARM_SECOND_BY_NANOSEC;
+	ts->tv_nsec += nsec % GFARM_SECOND_BY_NANOSEC;
+	if (ts->tv_nsec >= GFARM_SECOND_BY_NANOSEC) {
+		ts->tv_sec++;
+		ts->tv_nsec -= GFARM_SECOND_BY_NANOSEC;
+	}
+}
+
+/* PREREQUISITE: callout_module.mutex */
+static void
+callout_wheel_insert(struct callout_module *cm, struct callout *c)
+{
+	gfarm_uint64_t delta, target;
+	int level;
+
+	if (c->target_tick <= cm->ticks) {
+		callout_link_insert_tail(&cm->expired, &c->link);
+		return;
+	}
+	delta = c->target_tick - cm->ticks;
+	target = c->target_tick;
+	if (delta >= CALLOUT_WHEEL_RANGE) {
+		delta = CALLOUT_WHEEL_RANGE - 1;
+		target = cm->ticks + delta;
+	}
+	for (level = 0; level < CALLOUT_NWHEELS - 1; level++) {
+		if (delta < ((gfarm_uint64_t)1 <<
+		    (CALLOUT_WHEEL_BITS * (level + 1))))
+			break;
+	}
+	callout_link_insert_tail(&cm->wheels[level][
+	    (target >> (CALLOUT_WHEEL_BITS * level)) & CALLOUT_WHEEL_MASK],
+	    &c->link);
+}
+
+/* PREREQUISITE: callout_module.mutex */
+static void
+callout_wheel_cascade(struct callout_module *cm, int level)
+{
+	struct callout_link *bucket = &cm->wheels[level][
+	    (cm->ticks >> (CALLOUT_WHEEL_BITS * level)) & CALLOUT_WHEEL_MASK];
+	struct callout_link *l;
+
+	while ((l = bucket->next) != bucket) {
+		callout_link_remove(l);
+		callout_wheel_insert(cm, (struct callout *)l);
+	}
+}
+
+/*
+ * move callouts whose target time has come to callout_module.expired.
+ * PREREQUISITE: callout_module.mutex
+ */
+static void
+callout_wheel_advance(struct callout_module *cm, gfarm_uint64_t now)
+{
+	struct callout_link *bucket, *l;
+	int level;
+
+	if (cm->npendings == 0 && now > cm->ticks) {
+		cm->ticks = now; /* nothing to do */
+		return;
+	}
+	while (cm->ticks < now) {
+		cm->ticks++;
+		for (level = 1; level < CALLOUT_NWHEELS; level++) {
+			if ((cm->ticks & (((gfarm_uint64_t)1 <<
+			    (CALLOUT_WHEEL_BITS * level)) - 1)) != 0)
+				break;
+			callout_wheel_cascade(cm, level);
+		}
+		bucket = &cm->wheels[0][cm->ticks & CALLOUT_WHEEL_MASK];
+		while ((l = bucket->next) != bucket) {
+			callout_link_remove(l);
+			callout_link_insert_tail(&cm->expired, l);
+		}
+	}
+}
+
+/*
+ * the tick at which callout_main() has to wake up next.
+ * this may be earlier than the next target time, to cascade.
+ * PREREQUISITE: callout_module.mutex
+ */
+static gfarm_uint64_t
+callout_wheel_next_tick(struct callout_module *cm)
+{
+	gfarm_uint64_t t;
+
+	for (t = cm->ticks + 1; (t & CALLOUT_WHEEL_MASK) != 0; t++) {
+		if (cm->wheels[0][t & CALLOUT_WHEEL_MASK].next !=
+		    &cm->wheels[0][t & CALLOUT_WHEEL_MASK])
+			return (t);
+	}
+	return (t);
 }
 
 void *
@@ -62,46 +217,46 @@ callout_main(void *arg)
 	void *(*func)(void *);
 	void *closure;
 	int rv;
-	struct timespec now;
+	gfarm_int64_t nsec;
+	struct timespec wakeup;
 
-#ifdef __GNUC__ /* shut up stupid warning by gcc */
-	thrpool = NULL;
-	closure = NULL;
-#endif
 	for (;;) {
 		gfarm_mutex_lock(&cm->mutex, module_name, "main lock");
-		c = cm->pendings.next;
-		if (c == &cm->pendings)
-			rv = pthread_cond_wait(&cm->have_things_to_run,
-			    &cm->mutex);
-		else
-			rv = pthread_cond_timedwait(&cm->have_things_to_run,
-			    &cm->mutex, &c->target_time);
-		if (rv != 0 && rv != ETIMEDOUT) {
-			gflog_fatal(GFARM_MSG_1001490, "s: %s cond wait: %s",
-			    module_name, strerror(rv));
-		}
-
-		func = NULL;
-
-		/* cm->pendings may be changed while cond_wait */
-		c = cm->pendings.next;
-		if (c != &cm->pendings) {
-			gfarm_gettime(&now);
-			if (timespec_cmp(&c->target_time, &now) <= 0) {
-				/* remove the head of the list */
-				c->prev->next = c->next;
-				c->next->prev = c->prev;
-				/* clear the pointers to be sure */
-				c->next = c;
-				c->prev = c;
-				c->state &= ~CALLOUT_PENDING;
-				c->state |= (CALLOUT_FIRED | CALLOUT_INVOKING);
-				thrpool = c->thrpool;
-				func = c->func;
-				closure = c->closure;
+		for (;;) {
+			nsec = callout_elapsed_nsec(cm);
+			if (nsec > 0)
+				callout_wheel_advance(cm, nsec / CALLOUT_TICK);
+			if (cm->expired.next != &cm->expired)
+				break;
+
+			if (cm->npendings == 0) {
+				cm->wakeup_tick = ~(gfarm_uint64_t)0;
+				rv = pthread_cond_wait(&cm->have_things_to_run,
+				    &cm->mutex);
+			} else {
+				cm->wakeup_tick = callout_wheel_next_tick(cm);
+				callout_tick_to_time(cm, cm->wakeup_tick,
+				    &wakeup);
+				rv = pthread_cond_timedwait(
+				    &cm->have_things_to_run,
+				    &cm->mutex, &wakeup);
+			}
+			if (rv != 0 && rv != ETIMEDOUT) {
+				gflog_fatal(GFARM_MSG_1001490,
+				    "s: %s cond wait: %s",
+				    module_name, strerror(rv));
 			}
 		}
+
+		/* remove the head of the expired list */
+		c = (struct callout *)cm->expired.next;
+		callout_link_remove(&c->link);
+		cm->npendings--;
+		c->state &= ~CALLOUT_PENDING;
+		c->state |= (CALLOUT_FIRED | CALLOUT_INVOKING);
+		thrpool = c->thrpool;
+		func = c->func;
+		closure = c->closure;
 		gfarm_mutex_unlock(&cm->mutex, module_name, "main lock");
 
 		if (func != NULL) {
@@ -123,12 +278,18 @@ callout_module_init(int nthreads)
 {
 	gfarm_error_t e;
 	struct callout_module *cm = &callout_module;
-	int i;
+	int i, j;
 
 	gfarm_mutex_init(&cm->mutex, module_name, "init");
 	gfarm_cond_init(&cm->have_things_to_run, module_name, "init");
-	cm->pendings.prev = &cm->pendings;
-	cm->pendings.next = &cm->pendings;
+	gfarm_gettime(&cm->base_time);
+	cm->ticks = 0;
+	cm->wakeup_tick = ~(gfarm_uint64_t)0;
+	cm->npendings = 0;
+	for (i = 0; i < CALLOUT_NWHEELS; i++)
+		for (j = 0; j < CALLOUT_WHEEL_SIZE; j++)
+			callout_link_init(&cm->wheels[i][j]);
+	callout_link_init(&cm->expired);
 
 	for (i = 0; i < nthreads; i++) {
 		e = create_detached_thread(callout_main, &callout_module);
@@ -148,8 +309,7 @@ callout_new(void)
 	GFARM_MALLOC(c);
 	if (c == NULL)
 		return (NULL);
-	c->prev = c;
-	c->next = c;
+	callout_link_init(&c->link);
 	c->state = 0;
 	c->func = NULL;
 	c->closure = NULL;
@@ -172,42 +332,33 @@ static void
 callout_schedule_common(struct callout *n, int microseconds)
 {
 	struct callout_module *cm = &callout_module;
-	struct callout *c;
-	struct timeval now;
+	gfarm_int64_t now, nsec;
 
 	/* callout_module.mutex must be already locked here */
 
-	gettimeofday(&now, NULL);
-	gfarm_timeval_add_microsec(&now, microseconds);
-	n->target_time.tv_sec = now.tv_sec;
-	n->target_time.tv_nsec = now.tv_usec * GFARM_MICROSEC_BY_NANOSEC;
-	n->state &= ~(CALLOUT_FIRED | CALLOUT_INVOKING);
-
-	if ((n->state & CALLOUT_PENDING) != 0) {
-		/* remove from the pending list */
-		n->prev->next = n->next;
-		n->next->prev = n->prev;
-	}
-
+	now = callout_elapsed_nsec(cm);
 	/*
-	 * Since currently all callouts are scheduled with same interval
-	 * (i.e. gfarm_metadb_heartbeat_interval), searching from the tail
-	 * is most efficient.
-	 * XXX If we use another interval for something, this implementation
-	 * should be changed to use buckets for efficiency.
+	 * the wheel is empty, fast-forward it after an idle period.
+	 * otherwise, `n' would be inserted relative to the stale ticks,
+	 * and callout_wheel_advance() would have to step through all the
+	 * ticks elapsed while idle.
 	 */
-	for (c = cm->pendings.prev; c != &cm->pendings;
-	     c = c->prev) {
-		if (timespec_cmp(&n->target_time, &c->target_time) >= 0)
-			break;
-	}
-	/* insert n as the successor of c */
-	n->prev = c;
-	n->next = c->next;
-	c->next->prev = n;
-	c->next = n;
+	if (cm->npendings == 0 && now > 0 &&
+	    (gfarm_uint64_t)now / CALLOUT_TICK > cm->ticks)
+		cm->ticks = now / CALLOUT_TICK;
+	nsec = now + (gfarm_int64_t)microseconds * GFARM_MICROSEC_BY_NANOSEC;
+	/* round up, not to be invoked earlier than the specified time */
+	n->target_tick = nsec <= 0 ? 0 :
+	    (nsec + CALLOUT_TICK - 1) / CALLOUT_TICK;
+	n->state &= ~(CALLOUT_FIRED | CALLOUT_INVOKING);
+
+	if ((n->state & CALLOUT_PENDING) != 0)
+		callout_link_remove(&n->link);
+	else
+		cm->npendings++;
+	callout_wheel_insert(cm, n);
 	n->state |= CALLOUT_PENDING;
-	if (n->prev == &cm->pendings)
+	if (n->target_tick < cm->wakeup_tick)
 		gfarm_cond_signal(&cm->have_things_to_run, module_name,
 		    "scheduling singal");
 }
@@ -259,12 +410,8 @@ callout_stop(struct callout *c)
 
 	gfarm_mutex_lock(&cm->mutex, module_name, "stop lock");
 	if ((c->state & CALLOUT_PENDING) != 0) {
-		/* remove the head of the list */
-		c->prev->next = c->next;
-		c->next->prev = c->prev;
-		/* clear the pointers to be sure */
-		c->next = c;
-		c->prev = c;
+		callout_link_remove(&c->link);
+		cm->npendings--;
 	}
 	expired = (c->state & CALLOUT_FIRED) != 0;
 	c->state &= ~(CALLOUT_PENDING | CALLOUT_FIRED);
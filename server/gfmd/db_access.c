@@ -415,6 +415,72 @@ get_db_access_mutex(void)
 	return (&db_access_mutex);
 }
 
+/*
+ * a loading thread at startup may have its own connection to the backend,
+ * then its *_load() don't have to be serialized by db_access_mutex.
+ */
+
+static pthread_key_t db_load_thread_key;
+static pthread_once_t db_load_thread_key_once = PTHREAD_ONCE_INIT;
+
+static void
+db_load_thread_key_create(void)
+{
+	int err = pthread_key_create(&db_load_thread_key, NULL);
+
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "db_load_thread_key_create: %s", strerror(err));
+}
+
+static int
+db_load_thread_is_self(void)
+{
+	pthread_once(&db_load_thread_key_once, db_load_thread_key_create);
+	return (pthread_getspecific(db_load_thread_key) != NULL);
+}
+
+gfarm_error_t
+db_load_thread_begin(void)
+{
+	gfarm_error_t e;
+	const struct db_ops *o = db_get_ops();
+
+	pthread_once(&db_load_thread_key_once, db_load_thread_key_create);
+	if (o->load_thread_begin == NULL)
+		return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
+	if ((e = (*o->load_thread_begin)()) == GFARM_ERR_NO_ERROR)
+		pthread_setspecific(db_load_thread_key, (void *)o); /*UNCONST*/
+	return (e);
+}
+
+void
+db_load_thread_end(void)
+{
+	const struct db_ops *o;
+
+	pthread_once(&db_load_thread_key_once, db_load_thread_key_create);
+	if ((o = pthread_getspecific(db_load_thread_key)) == NULL)
+		return;
+	(*o->load_thread_end)();
+	pthread_setspecific(db_load_thread_key, NULL);
+}
+
+static void
+db_load_lock(const char *diag)
+{
+	if (!db_load_thread_is_self())
+		gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+}
+
+static void
+db_load_unlock(const char *diag)
+{
+	if (!db_load_thread_is_self())
+		gfarm_mutex_unlock(&db_access_mutex, diag,
+		    DB_ACCESS_MUTEX_DIAG);
+}
+
 void *
 db_thread(void *arg)
 {
@@ -1111,9 +1177,9 @@ db_inode_load(void *closure, void (*callback)(void *, struct gfs_stat *))
 	gfarm_error_t e;
 	static const char diag[] = "db_inode_load";
 
-	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_lock(diag);
 	e = ((*ops->inode_load)(closure, callback));
-	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_unlock(diag);
 	return (e);
 }
 
@@ -1200,9 +1266,9 @@ db_inode_cksum_load(void *closure,
 	gfarm_error_t e;
 	static const char diag[] = "db_inode_cksum_load";
 
-	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_lock(diag);
 	e = ((*ops->inode_cksum_load)(closure, callback));
-	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_unlock(diag);
 	return (e);
 }
 
@@ -1268,9 +1334,9 @@ db_filecopy_load(void *closure,
 	gfarm_error_t e;
 	static const char diag[] = "db_filecopy_load";
 
-	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_lock(diag);
 	e = ((*ops->filecopy_load)(closure, callback));
-	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_unlock(diag);
 	return (e);
 }
 
@@ -1414,9 +1480,9 @@ db_direntry_load(void *closure,
 	gfarm_error_t e;
 	static const char diag[] = "db_direntry_load";
 
-	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_lock(diag);
 	e = ((*ops->direntry_load)(closure, callback));
-	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_unlock(diag);
 	return (e);
 }
 
@@ -1480,9 +1546,9 @@ db_symlink_load(void *closure, void (*callback)(void *, gfarm_ino_t, char *))
 	gfarm_error_t e;
 	static const char diag[] = "db_symlink_load";
 
-	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_lock(diag);
 	e = ((*ops->symlink_load)(closure, callback));
-	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_unlock(diag);
 	return (e);
 }
 
@@ -1647,9 +1713,9 @@ db_xattr_load(void *closure,
 	gfarm_error_t e;
 	static const char diag[] = "db_xattr_load";
 
-	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_lock(diag);
 	e = ((*ops->xattr_load)(closure, callback));
-	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	db_load_unlock(diag);
 	return (e);
 }
 
@@ -120,6 +120,8 @@ gfarm_error_t db_seqnum_remove(char *);
 gfarm_error_t db_seqnum_load(void *,
 	void (*)(void *, struct db_seqnum_arg *));
 pthread_mutex_t *get_db_access_mutex(void);
+gfarm_error_t db_load_thread_begin(void);
+void db_load_thread_end(void);
 
 struct gfarm_metadb_server;
 gfarm_error_t db_mdhost_add(const struct gfarm_metadb_server *);
@@ -22,6 +22,7 @@
 
 #include "queue.h"
 #include "gfutil.h"
+#include "nanosec.h"
 #include "thrsubr.h"
 #ifdef DEBUG_JOURNAL
 #include "timer.h"
@@ -40,6 +41,7 @@
 #include "gfm_proto.h"
 
 #include "subr.h"
+#include "giant_stat.h"
 #include "quota.h"
 #include "journal_file.h"
 #include "db_common.h"
@@ -105,6 +107,10 @@ db_seqnum_load_callback(void *closure, struct db_seqnum_arg *a)
 	free(a->name);
 }
 
+static void db_journal_group_commit_init(void);
+static void db_journal_pipeline_init(void);
+static void db_journal_pipeline_wait(void);
+
 static gfarm_error_t
 db_journal_noaction(void)
 {
@@ -124,6 +130,7 @@ db_journal_init_status(void)
 	    RECVQ_NONEMPTY_COND_DIAG);
 	gfarm_cond_init(&journal_recvq_cancel_cond, diag,
 	    RECVQ_CANCEL_COND_DIAG);
+	db_journal_pipeline_init();
 
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -189,6 +196,8 @@ db_journal_init(void)
 		    "db_journal_init_status : %s",
 		    gfarm_error_string(e));
 	}
+	if (gfarm_get_journal_sync_file() && gfarm_get_journal_group_commit())
+		db_journal_group_commit_init();
 }
 
 void
@@ -567,6 +576,208 @@ db_journal_file_writer_sync(void)
 	return (journal_file_writer_sync(journal_file_writer(self_jf)));
 }
 
+/*
+ * group commit of the journal file.
+ *
+ * when "metadb_journal_group_commit enable" is specified,
+ * a transaction which doesn't have to wait for synchronous slaves
+ * doesn't call fdatasync(2) under giant_lock.
+ * instead, it requests that its sequence number be made durable,
+ * and waits for that in giant_unlock(), i.e. before replying.
+ * the committer thread makes all records which have been written by then
+ * durable by one fdatasync(2), and releases the waiters covered by it.
+ */
+
+struct db_journal_group_commit_waiter {
+	int pending;
+	gfarm_uint64_t seqnum;
+};
+
+static struct db_journal_group_commit {
+	int enabled;
+	pthread_key_t waiter_key;
+	pthread_mutex_t mutex;
+	pthread_cond_t requested, committed;
+	gfarm_uint64_t requested_seqnum, committed_seqnum;
+	int npending; /* number of transactions which are not synced yet */
+
+	/* statistics */
+	gfarm_uint64_t ntransactions, nsyncs;
+} group_commit;
+
+static const char GROUP_COMMIT_MUTEX_DIAG[]	= "group_commit_mutex";
+static const char GROUP_COMMIT_REQUESTED_DIAG[]	= "group_commit_requested";
+static const char GROUP_COMMIT_COMMITTED_DIAG[]	= "group_commit_committed";
+
+static void *
+db_journal_group_commit_thread(void *arg)
+{
+	struct db_journal_group_commit *gc = &group_commit;
+	long window = gfarm_get_journal_group_commit_window();
+	int max_batch = gfarm_get_journal_group_commit_max_batch();
+	int npending;
+	gfarm_uint64_t seqnum;
+	gfarm_error_t e;
+	struct timespec deadline;
+	static const char diag[] = "db_journal_group_commit_thread";
+
+	for (;;) {
+		gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+		while (gc->npending == 0)
+			gfarm_cond_wait(&gc->requested, &gc->mutex,
+			    diag, GROUP_COMMIT_REQUESTED_DIAG);
+		if (window > 0 && gc->npending < max_batch) {
+			/* wait for more transactions to share fdatasync */
+			gfarm_gettime(&deadline);
+			deadline.tv_sec += window / GFARM_SECOND_BY_MICROSEC;
+			deadline.tv_nsec += (window % GFARM_SECOND_BY_MICROSEC)
+			    * GFARM_MICROSEC_BY_NANOSEC;
+			if (deadline.tv_nsec >= GFARM_SECOND_BY_NANOSEC) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= GFARM_SECOND_BY_NANOSEC;
+			}
+			while (gc->npending < max_batch &&
+			    gfarm_cond_timedwait(&gc->requested, &gc->mutex,
+			    &deadline, diag, GROUP_COMMIT_REQUESTED_DIAG))
+				;
+		}
+		seqnum = gc->requested_seqnum;
+		npending = gc->npending;
+		gc->npending = 0;
+		gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+
+		/* records up to `seqnum' have already been written */
+		if ((e = db_journal_file_writer_sync()) != GFARM_ERR_NO_ERROR)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "failed to sync the journal file: %s",
+			    gfarm_error_string(e));
+
+		gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+		gc->committed_seqnum = seqnum;
+		gc->ntransactions += npending;
+		gc->nsyncs++;
+		gfarm_cond_broadcast(&gc->committed, diag,
+		    GROUP_COMMIT_COMMITTED_DIAG);
+		gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	}
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+static void
+db_journal_group_commit_waiter_free(void *p)
+{
+	free(p);
+}
+
+static void
+db_journal_group_commit_init(void)
+{
+	struct db_journal_group_commit *gc = &group_commit;
+	int err;
+	gfarm_error_t e;
+	static const char diag[] = "db_journal_group_commit_init";
+
+	err = pthread_key_create(&gc->waiter_key,
+	    db_journal_group_commit_waiter_free);
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: key create: %s",
+		    diag, strerror(err));
+	gfarm_mutex_init(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	gfarm_cond_init(&gc->requested, diag, GROUP_COMMIT_REQUESTED_DIAG);
+	gfarm_cond_init(&gc->committed, diag, GROUP_COMMIT_COMMITTED_DIAG);
+	gc->requested_seqnum = gc->committed_seqnum =
+	    GFARM_METADB_SERVER_SEQNUM_INVALID;
+	gc->npending = 0;
+	gc->ntransactions = gc->nsyncs = 0;
+	if ((e = create_detached_thread(db_journal_group_commit_thread, NULL))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: create_detached_thread: %s",
+		    diag, gfarm_error_string(e));
+	gc->enabled = 1;
+}
+
+/*
+ * PREREQUISITE: giant_lock
+ * returns 0, if group commit is disabled and the caller has to sync.
+ */
+int
+db_journal_group_commit_request(gfarm_uint64_t seqnum)
+{
+	struct db_journal_group_commit *gc = &group_commit;
+	struct db_journal_group_commit_waiter *w;
+	int err;
+	static const char diag[] = "db_journal_group_commit_request";
+
+	if (!gc->enabled)
+		return (0);
+	if ((w = pthread_getspecific(gc->waiter_key)) == NULL) {
+		GFARM_MALLOC(w);
+		if (w == NULL)
+			return (0);
+		if ((err = pthread_setspecific(gc->waiter_key, w)) != 0) {
+			gflog_warning(GFARM_MSG_UNFIXED, "%s: setspecific: %s",
+			    diag, strerror(err));
+			free(w);
+			return (0);
+		}
+	}
+	w->pending = 1;
+	w->seqnum = seqnum;
+
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	if (gc->requested_seqnum < seqnum)
+		gc->requested_seqnum = seqnum;
+	if (++gc->npending == 1 ||
+	    gc->npending >= gfarm_get_journal_group_commit_max_batch())
+		gfarm_cond_signal(&gc->requested, diag,
+		    GROUP_COMMIT_REQUESTED_DIAG);
+	gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	return (1);
+}
+
+/*
+ * wait until the transaction requested by this thread becomes durable.
+ * this is called by giant_unlock() after releasing giant_lock.
+ */
+void
+db_journal_group_commit_wait(void)
+{
+	struct db_journal_group_commit *gc = &group_commit;
+	struct db_journal_group_commit_waiter *w;
+	static const char diag[] = "db_journal_group_commit_wait";
+
+	if (!gc->enabled ||
+	    (w = pthread_getspecific(gc->waiter_key)) == NULL || !w->pending)
+		return;
+	w->pending = 0;
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	while (gc->committed_seqnum < w->seqnum)
+		gfarm_cond_wait(&gc->committed, &gc->mutex,
+		    diag, GROUP_COMMIT_COMMITTED_DIAG);
+	gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+}
+
+void
+db_journal_group_commit_info(void)
+{
+	struct db_journal_group_commit *gc = &group_commit;
+	gfarm_uint64_t ntransactions, nsyncs;
+	static const char diag[] = "db_journal_group_commit_info";
+
+	if (!gc->enabled)
+		return;
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	ntransactions = gc->ntransactions;
+	nsyncs = gc->nsyncs;
+	gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "journal group commit: %llu transactions by %llu syncs, "
+	    "%.2f transactions per sync", (unsigned long long)ntransactions,
+	    (unsigned long long)nsyncs,
+	    nsyncs == 0 ? 0.0 : (double)ntransactions / nsyncs);
+}
+
 static gfarm_error_t
 db_journal_write_string_size_add(enum journal_operation ope,
 	size_t *sizep, void *arg)
@@ -3502,6 +3713,8 @@ struct db_journal_rec {
 	gfarm_uint64_t seqnum;
 	enum journal_operation ope;
 	void *obj;
+	char *data; /* not decoded yet, only used by the replay pipeline */
+	size_t data_len;
 	GFARM_STAILQ_ENTRY(db_journal_rec) next;
 };
 
@@ -3539,6 +3752,7 @@ db_journal_apply_op(void *op_arg, gfarm_uint64_t seqnum,
 	ai->seqnum = seqnum;
 	ai->ope = ope;
 	ai->obj = obj;
+	ai->data = NULL;
 	GFARM_STAILQ_INSERT_TAIL(c, ai, next);
 	if (ope != GFM_JOURNAL_END)
 		return (GFARM_ERR_NO_ERROR);
@@ -3616,6 +3830,7 @@ db_journal_wait_for_apply_thread(void)
 {
 	journal_file_wait_for_read_completion(
 		journal_file_main_reader(self_jf));
+	db_journal_pipeline_wait();
 }
 
 static gfarm_error_t
@@ -3636,6 +3851,7 @@ db_journal_add_rec(void *op_arg, gfarm_uint64_t seqnum,
 	rec->seqnum = seqnum;
 	rec->ope = ope;
 	rec->obj = obj;
+	rec->data = NULL;
 	GFARM_STAILQ_INSERT_TAIL(recs, rec, next);
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -3646,11 +3862,491 @@ db_journal_free_rec_list(struct db_journal_rec_list *recs)
 	struct db_journal_rec *rec, *rec2;
 
 	GFARM_STAILQ_FOREACH_SAFE(rec, recs, next, rec2) {
-		db_journal_ops_free(NULL, rec->ope, rec->obj);
+		if (rec->obj != NULL)
+			db_journal_ops_free(NULL, rec->ope, rec->obj);
+		free(rec->data);
 		free(rec);
 	}
 }
 
+/* store the records of a transaction to the db, retrying if needed */
+static gfarm_error_t
+db_journal_store_rec_list(struct db_journal_rec_list *recs, const char *diag)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	struct db_journal_rec *rec;
+
+retry:
+	GFARM_STAILQ_FOREACH(rec, recs, next) {
+#ifdef DEBUG_JOURNAL
+		gflog_info(GFARM_MSG_1003187,
+		    "store seqnum=%" GFARM_PRId64 " ope=%s",
+		    rec->seqnum, journal_operation_name(rec->ope));
+#endif
+		if ((e = db_journal_ops_call(store_ops, rec->seqnum,
+		    rec->ope, rec->obj, diag))
+		    == GFARM_ERR_DB_ACCESS_SHOULD_BE_RETRIED) {
+			if (!db_journal_is_rec_stored(rec))
+				goto retry;
+			gflog_info(GFARM_MSG_1003327,
+			    "db seems to have been committed the "
+			    "last operation, no retry is needed");
+			e = GFARM_ERR_NO_ERROR;
+		} else if (e != GFARM_ERR_NO_ERROR) {
+			gflog_error(GFARM_MSG_1003188,
+			    "failed to store to db : %s",
+			    gfarm_error_string(e));
+			return (e);
+		}
+	}
+	return (e);
+}
+
+/*
+ * statistics of the journal replay
+ */
+
+#define DB_JOURNAL_APPLY_STAT_INTERVAL	60 /* seconds */
+
+struct db_journal_apply_stat {
+	gfarm_uint64_t nrecs;
+	struct timespec start;
+};
+
+static void
+db_journal_apply_stat_reset(struct db_journal_apply_stat *stat)
+{
+	stat->nrecs = 0;
+	gfarm_gettime(&stat->start);
+}
+
+static double
+db_journal_apply_stat_elapsed(struct db_journal_apply_stat *stat)
+{
+	struct timespec now;
+
+	gfarm_gettime(&now);
+	return ((now.tv_sec - stat->start.tv_sec) +
+	    (now.tv_nsec - stat->start.tv_nsec) / 1e9);
+}
+
+static void
+db_journal_apply_stat_report(struct db_journal_apply_stat *stat,
+	const char *what)
+{
+	double sec = db_journal_apply_stat_elapsed(stat);
+
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "%s: %llu records in %.3f sec (%.0f records/sec)", what,
+	    (unsigned long long)stat->nrecs, sec,
+	    sec > 0 ? stat->nrecs / sec : 0.0);
+}
+
+/* report the apply rate of a slave periodically */
+static void
+db_journal_apply_stat_tick(struct db_journal_apply_stat *stat)
+{
+	if (db_journal_apply_stat_elapsed(stat) <
+	    DB_JOURNAL_APPLY_STAT_INTERVAL)
+		return;
+	db_journal_apply_stat_report(stat, "journal applied");
+	db_journal_apply_stat_reset(stat);
+}
+
+/*
+ * pipelined replay of the journal file,
+ * enabled by "metadb_journal_replay_threads" in gfmd.conf.
+ *
+ * the reader thread reads raw records with a large read-ahead,
+ * and groups them into transactions.
+ * the decoder threads decode the transactions in parallel.
+ * the caller of db_journal_pipeline_run() stores (and applies)
+ * the decoded transactions in order of seqnum,
+ * and commits the read position of the journal file transaction by
+ * transaction.
+ */
+
+#define DB_JOURNAL_PIPELINE_READ_AHEAD	(1024 * 1024)
+#define DB_JOURNAL_PIPELINE_MAX_TXS	1024
+#define DB_JOURNAL_PIPELINE_BATCH	32 /* transactions taken at once */
+
+struct db_journal_tx {
+	struct db_journal_rec_list recs;
+	int nrecs;
+	size_t len; /* length of the records in the journal file */
+	int decoded;
+	gfarm_error_t error;
+	GFARM_STAILQ_ENTRY(db_journal_tx) next;
+};
+
+static struct db_journal_pipeline {
+	pthread_mutex_t mutex;
+	pthread_cond_t nonfull_cond, decodable_cond, decoded_cond;
+	pthread_cond_t exit_cond;
+
+	struct journal_file_reader *reader;
+
+	/* transactions in order of seqnum */
+	GFARM_STAILQ_HEAD(db_journal_tx_list, db_journal_tx) txs;
+	struct db_journal_tx *to_decode; /* the first one not being decoded */
+	int ntxs;
+
+	int running, nthreads, read_done, quit;
+	gfarm_error_t read_error;
+} pipeline;
+
+static const char PIPELINE_MUTEX_DIAG[] = "journal_pipeline_mutex";
+static const char PIPELINE_NONFULL_COND_DIAG[] =
+	"journal_pipeline_nonfull_cond";
+static const char PIPELINE_DECODABLE_COND_DIAG[] =
+	"journal_pipeline_decodable_cond";
+static const char PIPELINE_DECODED_COND_DIAG[] =
+	"journal_pipeline_decoded_cond";
+static const char PIPELINE_EXIT_COND_DIAG[] = "journal_pipeline_exit_cond";
+
+static void
+db_journal_pipeline_init(void)
+{
+	static const char diag[] = "db_journal_pipeline_init";
+
+	gfarm_mutex_init(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	gfarm_cond_init(&pipeline.nonfull_cond, diag,
+	    PIPELINE_NONFULL_COND_DIAG);
+	gfarm_cond_init(&pipeline.decodable_cond, diag,
+	    PIPELINE_DECODABLE_COND_DIAG);
+	gfarm_cond_init(&pipeline.decoded_cond, diag,
+	    PIPELINE_DECODED_COND_DIAG);
+	gfarm_cond_init(&pipeline.exit_cond, diag, PIPELINE_EXIT_COND_DIAG);
+	GFARM_STAILQ_INIT(&pipeline.txs);
+}
+
+static void
+db_journal_tx_free(struct db_journal_tx *tx)
+{
+	db_journal_free_rec_list(&tx->recs);
+	free(tx);
+}
+
+/* PREREQUISITE: pipeline.mutex */
+static void
+db_journal_pipeline_thread_exit(const char *diag)
+{
+	if (--pipeline.nthreads == 0)
+		gfarm_cond_broadcast(&pipeline.exit_cond, diag,
+		    PIPELINE_EXIT_COND_DIAG);
+}
+
+static void *
+db_journal_pipeline_reader(void *arg)
+{
+	gfarm_error_t e;
+	gfarm_uint64_t seqnum;
+	enum journal_operation ope;
+	char *data;
+	size_t data_len, rec_len;
+	int eof, quit = 0;
+	struct db_journal_rec *rec;
+	struct db_journal_tx *tx = NULL;
+	static const char diag[] = "db_journal_pipeline_reader";
+
+	for (;;) {
+		if ((e = journal_file_read_raw(pipeline.reader,
+		    DB_JOURNAL_PIPELINE_READ_AHEAD, &seqnum, &ope,
+		    &data, &data_len, &rec_len, &eof)) != GFARM_ERR_NO_ERROR)
+			break;
+		if (eof || journal_file_is_closed(self_jf))
+			break;
+		GFARM_MALLOC(rec);
+		if (tx == NULL) {
+			if (ope != GFM_JOURNAL_BEGIN)
+				gflog_fatal(GFARM_MSG_UNFIXED,
+				    "invalid journal record: seqnum=%llu "
+				    "ope=%s", (unsigned long long)seqnum,
+				    journal_operation_name(ope)); /* exit */
+			GFARM_MALLOC(tx);
+			if (tx != NULL) {
+				GFARM_STAILQ_INIT(&tx->recs);
+				tx->nrecs = 0;
+				tx->len = 0;
+				tx->decoded = 0;
+				tx->error = GFARM_ERR_NO_ERROR;
+			}
+		}
+		if (rec == NULL || tx == NULL) {
+			e = GFARM_ERR_NO_MEMORY;
+			gflog_error(GFARM_MSG_UNFIXED, "%s: %s",
+			    diag, gfarm_error_string(e));
+			free(rec);
+			free(data);
+			break;
+		}
+		rec->seqnum = seqnum;
+		rec->ope = ope;
+		rec->obj = NULL;
+		rec->data = data;
+		rec->data_len = data_len;
+		GFARM_STAILQ_INSERT_TAIL(&tx->recs, rec, next);
+		tx->nrecs++;
+		tx->len += rec_len;
+		if (ope != GFM_JOURNAL_END)
+			continue;
+
+		gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+		while (pipeline.ntxs >= DB_JOURNAL_PIPELINE_MAX_TXS &&
+		    !pipeline.quit)
+			gfarm_cond_wait(&pipeline.nonfull_cond,
+			    &pipeline.mutex, diag, PIPELINE_NONFULL_COND_DIAG);
+		quit = pipeline.quit;
+		if (!quit) {
+			GFARM_STAILQ_INSERT_TAIL(&pipeline.txs, tx, next);
+			pipeline.ntxs++;
+			if (pipeline.to_decode == NULL)
+				pipeline.to_decode = tx;
+			tx = NULL;
+			gfarm_cond_signal(&pipeline.decodable_cond, diag,
+			    PIPELINE_DECODABLE_COND_DIAG);
+		}
+		gfarm_mutex_unlock(&pipeline.mutex, diag,
+		    PIPELINE_MUTEX_DIAG);
+		if (quit)
+			break;
+	}
+	/* an incomplete transaction is discarded, as the legacy reader does */
+	if (tx != NULL)
+		db_journal_tx_free(tx);
+
+	gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	pipeline.read_error = e;
+	pipeline.read_done = 1;
+	gfarm_cond_broadcast(&pipeline.decodable_cond, diag,
+	    PIPELINE_DECODABLE_COND_DIAG);
+	gfarm_cond_signal(&pipeline.decoded_cond, diag,
+	    PIPELINE_DECODED_COND_DIAG);
+	db_journal_pipeline_thread_exit(diag);
+	gfarm_mutex_unlock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	return (NULL);
+}
+
+static void *
+db_journal_pipeline_decoder(void *arg)
+{
+	gfarm_error_t e;
+	int i, n;
+	struct journal_rec_decoder *decoder;
+	struct db_journal_tx *tx, *next;
+	struct db_journal_rec *rec;
+	static const char diag[] = "db_journal_pipeline_decoder";
+
+	if ((e = journal_rec_decoder_new(&decoder)) != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: %s",
+		    diag, gfarm_error_string(e)); /* exit */
+
+	gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	for (;;) {
+		while (pipeline.to_decode == NULL && !pipeline.read_done &&
+		    !pipeline.quit)
+			gfarm_cond_wait(&pipeline.decodable_cond,
+			    &pipeline.mutex, diag,
+			    PIPELINE_DECODABLE_COND_DIAG);
+		if (pipeline.to_decode == NULL || pipeline.quit)
+			break;
+		/* take consecutive transactions at once to reduce wakeups */
+		tx = pipeline.to_decode;
+		for (n = 0; pipeline.to_decode != NULL &&
+		    n < DB_JOURNAL_PIPELINE_BATCH; n++)
+			pipeline.to_decode =
+			    GFARM_STAILQ_NEXT(pipeline.to_decode, next);
+		gfarm_mutex_unlock(&pipeline.mutex, diag,
+		    PIPELINE_MUTEX_DIAG);
+
+		for (i = 0; i < n; i++, tx = next) {
+			/* tx may be freed by the applier after decoded */
+			next = GFARM_STAILQ_NEXT(tx, next);
+			GFARM_STAILQ_FOREACH(rec, &tx->recs, next) {
+				e = journal_rec_decode(decoder, NULL,
+				    db_journal_read_ops, rec->ope,
+				    rec->data, rec->data_len, &rec->obj);
+				free(rec->data);
+				rec->data = NULL;
+				if (e != GFARM_ERR_NO_ERROR) {
+					GFLOG_ERROR_WITH_SN(GFARM_MSG_UNFIXED,
+					    "decode record", e, rec->seqnum,
+					    rec->ope);
+					tx->error = e;
+					break;
+				}
+			}
+			gfarm_mutex_lock(&pipeline.mutex, diag,
+			    PIPELINE_MUTEX_DIAG);
+			tx->decoded = 1;
+			if (tx == GFARM_STAILQ_FIRST(&pipeline.txs))
+				gfarm_cond_signal(&pipeline.decoded_cond,
+				    diag, PIPELINE_DECODED_COND_DIAG);
+			if (i < n - 1)
+				gfarm_mutex_unlock(&pipeline.mutex, diag,
+				    PIPELINE_MUTEX_DIAG);
+		}
+	}
+	db_journal_pipeline_thread_exit(diag);
+	gfarm_mutex_unlock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+
+	journal_rec_decoder_free(decoder);
+	return (NULL);
+}
+
+/*
+ * store a transaction to the db, and apply it to memory if `apply'.
+ * the journal records are committed after they are stored.
+ */
+static gfarm_error_t
+db_journal_pipeline_apply_tx(struct db_journal_tx *tx, int apply)
+{
+	gfarm_error_t e;
+	struct db_journal_rec *rec;
+	static const char diag[] = "db_journal_pipeline_apply_tx";
+
+	if (apply)
+		giant_lock();
+	else /* lock to avoid race condition between db_thread. */
+		gfarm_mutex_lock(get_db_access_mutex(), diag,
+		    DB_ACCESS_MUTEX_DIAG);
+	e = db_journal_store_rec_list(&tx->recs, diag);
+	if (!apply)
+		gfarm_mutex_unlock(get_db_access_mutex(), diag,
+		    DB_ACCESS_MUTEX_DIAG);
+	if (e != GFARM_ERR_NO_ERROR || journal_file_is_closed(self_jf))
+		goto end;
+
+	journal_file_mutex_lock(self_jf, diag);
+	journal_file_reader_commit_len(pipeline.reader, tx->len);
+	journal_file_mutex_unlock(self_jf, diag);
+
+	if (apply) {
+		GFARM_STAILQ_FOREACH(rec, &tx->recs, next) {
+			if ((e = db_journal_ops_call(journal_apply_ops,
+			    rec->seqnum, rec->ope, rec->obj, diag))
+			    != GFARM_ERR_NO_ERROR)
+				break;
+		}
+	}
+end:
+	if (apply)
+		giant_unlock();
+	return (e);
+}
+
+/*
+ * returns GFARM_ERR_CANT_OPEN, if the reader is drained by
+ * db_journal_wait_for_apply_thread().
+ */
+static gfarm_error_t
+db_journal_pipeline_run(int apply, struct db_journal_apply_stat *stat)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	int i, nthreads = gfarm_get_journal_replay_threads();
+	struct db_journal_tx *tx;
+	struct db_journal_tx_list ready;
+	static const char diag[] = "db_journal_pipeline_run";
+
+	gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	pipeline.reader = journal_file_main_reader(self_jf);
+	pipeline.to_decode = NULL;
+	pipeline.ntxs = 0;
+	pipeline.read_done = pipeline.quit = 0;
+	pipeline.read_error = GFARM_ERR_NO_ERROR;
+	pipeline.running = 1;
+	pipeline.nthreads = 1 + nthreads;
+	gfarm_mutex_unlock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+
+	if ((e = create_detached_thread(db_journal_pipeline_reader, NULL))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "create_detached_thread(db_journal_pipeline_reader): %s",
+		    gfarm_error_string(e)); /* exit */
+	for (i = 0; i < nthreads; i++) {
+		if ((e = create_detached_thread(db_journal_pipeline_decoder,
+		    NULL)) != GFARM_ERR_NO_ERROR)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "create_detached_thread"
+			    "(db_journal_pipeline_decoder): %s",
+			    gfarm_error_string(e)); /* exit */
+	}
+
+	GFARM_STAILQ_INIT(&ready);
+	for (;;) {
+		gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+		while ((tx = GFARM_STAILQ_FIRST(&pipeline.txs)) == NULL ?
+		    !pipeline.read_done : !tx->decoded)
+			gfarm_cond_wait(&pipeline.decoded_cond,
+			    &pipeline.mutex, diag,
+			    PIPELINE_DECODED_COND_DIAG);
+		/* take all decoded transactions at the head */
+		while ((tx = GFARM_STAILQ_FIRST(&pipeline.txs)) != NULL &&
+		    tx->decoded) {
+			GFARM_STAILQ_REMOVE_HEAD(&pipeline.txs, next);
+			GFARM_STAILQ_INSERT_TAIL(&ready, tx, next);
+			if (--pipeline.ntxs == DB_JOURNAL_PIPELINE_MAX_TXS / 2)
+				gfarm_cond_signal(&pipeline.nonfull_cond,
+				    diag, PIPELINE_NONFULL_COND_DIAG);
+		}
+		gfarm_mutex_unlock(&pipeline.mutex, diag,
+		    PIPELINE_MUTEX_DIAG);
+		if (GFARM_STAILQ_EMPTY(&ready))
+			break; /* all transactions have been applied */
+
+		while ((tx = GFARM_STAILQ_FIRST(&ready)) != NULL) {
+			GFARM_STAILQ_REMOVE_HEAD(&ready, next);
+			if ((e = tx->error) == GFARM_ERR_NO_ERROR)
+				e = db_journal_pipeline_apply_tx(tx, apply);
+			if (e == GFARM_ERR_NO_ERROR && stat != NULL)
+				stat->nrecs += tx->nrecs;
+			db_journal_tx_free(tx);
+			if (e != GFARM_ERR_NO_ERROR)
+				goto quit;
+		}
+		if (apply && stat != NULL)
+			db_journal_apply_stat_tick(stat);
+	}
+
+	gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	while (pipeline.nthreads > 0)
+		gfarm_cond_wait(&pipeline.exit_cond, &pipeline.mutex, diag,
+		    PIPELINE_EXIT_COND_DIAG);
+	e = pipeline.read_error;
+	pipeline.running = 0;
+	gfarm_cond_broadcast(&pipeline.exit_cond, diag,
+	    PIPELINE_EXIT_COND_DIAG);
+	gfarm_mutex_unlock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	return (e);
+
+quit: /* the caller shuts gfmd down */
+	while ((tx = GFARM_STAILQ_FIRST(&ready)) != NULL) {
+		GFARM_STAILQ_REMOVE_HEAD(&ready, next);
+		db_journal_tx_free(tx);
+	}
+	gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	pipeline.quit = 1;
+	gfarm_cond_broadcast(&pipeline.nonfull_cond, diag,
+	    PIPELINE_NONFULL_COND_DIAG);
+	gfarm_cond_broadcast(&pipeline.decodable_cond, diag,
+	    PIPELINE_DECODABLE_COND_DIAG);
+	gfarm_mutex_unlock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	return (e);
+}
+
+/* wait until db_journal_pipeline_run() applies all read transactions */
+static void
+db_journal_pipeline_wait(void)
+{
+	static const char diag[] = "db_journal_pipeline_wait";
+
+	gfarm_mutex_lock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+	while (pipeline.running)
+		gfarm_cond_wait(&pipeline.exit_cond, &pipeline.mutex, diag,
+		    PIPELINE_EXIT_COND_DIAG);
+	gfarm_mutex_unlock(&pipeline.mutex, diag, PIPELINE_MUTEX_DIAG);
+}
+
 void *
 db_journal_store_thread(void *arg)
 {
@@ -3661,8 +4357,25 @@ db_journal_store_thread(void *arg)
 		journal_file_main_reader(self_jf);
 	struct db_journal_rec *rec;
 	struct db_journal_rec_list recs;
+	struct db_journal_apply_stat stat;
 	static const char diag[] = "db_journal_store_thread";
 
+	(void)giant_stat_owner_set(GIANT_STAT_OWNER_DB_JOURNAL);
+	db_journal_apply_stat_reset(&stat);
+	if (gfarm_get_journal_replay_threads() > 0) {
+		e = db_journal_pipeline_run(0, &stat);
+		if (boot_apply && e == GFARM_ERR_CANT_OPEN) {
+			db_journal_apply_stat_report(&stat, "journal replayed");
+			return (NULL);
+		}
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_error(GFARM_MSG_UNFIXED,
+			    "failed to replay journal : %s",
+			    gfarm_error_string(e));
+			db_journal_fail_store_op();
+		}
+		return (NULL);
+	}
 	for (;;) {
 		GFARM_STAILQ_INIT(&recs);
 		first = 1;
@@ -3688,38 +4401,17 @@ db_journal_store_thread(void *arg)
 				else
 					first = 0;
 			}
+			stat.nrecs++;
 		} while (rec->ope != GFM_JOURNAL_END);
 
 		/* lock to avoid race condition between db_thread. */
 		gfarm_mutex_lock(get_db_access_mutex(), diag,
 		    DB_ACCESS_MUTEX_DIAG);
-retry:
-		GFARM_STAILQ_FOREACH(rec, &recs, next) {
-#ifdef DEBUG_JOURNAL
-			gflog_info(GFARM_MSG_1003187,
-			    "store seqnum=%" GFARM_PRId64 " ope=%s",
-			    rec->seqnum, journal_operation_name(rec->ope));
-#endif
-			if ((e = db_journal_ops_call(store_ops, rec->seqnum,
-			    rec->ope, rec->obj, diag))
-			    == GFARM_ERR_DB_ACCESS_SHOULD_BE_RETRIED) {
-				if (!db_journal_is_rec_stored(rec))
-					goto retry;
-				gflog_info(GFARM_MSG_1003327,
-				    "db seems to have been committed the "
-				    "last operation, no retry is needed");
-				e = GFARM_ERR_NO_ERROR;
-			} else if (e != GFARM_ERR_NO_ERROR) {
-				gflog_error(GFARM_MSG_1003188,
-				    "failed to store to db : %s",
-				    gfarm_error_string(e));
-				gfarm_mutex_unlock(get_db_access_mutex(), diag,
-				    DB_ACCESS_MUTEX_DIAG);
-				goto error;
-			}
-		}
+		e = db_journal_store_rec_list(&recs, diag);
 		gfarm_mutex_unlock(get_db_access_mutex(), diag,
 		    DB_ACCESS_MUTEX_DIAG);
+		if (e != GFARM_ERR_NO_ERROR)
+			goto error;
 		if (journal_file_is_closed(self_jf))
 			goto end;
 
@@ -3733,6 +4425,8 @@ error:
 	db_journal_fail_store_op();
 end:
 	db_journal_free_rec_list(&recs);
+	if (boot_apply)
+		db_journal_apply_stat_report(&stat, "journal replayed");
 	return (NULL);
 }
 
@@ -3744,7 +4438,18 @@ db_journal_apply_thread(void *arg)
 	struct journal_file_reader *reader = journal_file_main_reader(self_jf);
 	struct db_journal_rec_list closure =
 		GFARM_STAILQ_HEAD_INITIALIZER(closure);
-
+	struct db_journal_apply_stat stat;
+
+	(void)giant_stat_owner_set(GIANT_STAT_OWNER_DB_JOURNAL);
+	db_journal_apply_stat_reset(&stat);
+	if (gfarm_get_journal_replay_threads() > 0) {
+		e = db_journal_pipeline_run(1, &stat);
+		if (e != GFARM_ERR_NO_ERROR && e != GFARM_ERR_CANT_OPEN)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "failed to read journal or apply to memory/db : %s",
+			    gfarm_error_string(e)); /* exit */
+		return (NULL);
+	}
 	for (;;) {
 		if ((e = db_journal_read(reader,
 		    (void *)store_ops /* UNCONST */, db_journal_apply_op,
@@ -3757,10 +4462,144 @@ db_journal_apply_thread(void *arg)
 		}
 		if (journal_file_is_closed(self_jf))
 			break;
+		if (!eof) {
+			stat.nrecs++;
+			db_journal_apply_stat_tick(&stat);
+		}
 	}
 	return (NULL);
 }
 
+/*
+ * replay of the journal records after a metadata snapshot
+ */
+
+static struct db_journal_replay {
+	struct journal_file_reader *reader;
+	gfarm_uint64_t from_seqnum, to_seqnum, next_seqnum;
+} replay;
+
+/*
+ * check that the journal file still holds the records after `from_seqnum'.
+ * this must be called after boot_apply_db_journal().
+ */
+gfarm_error_t
+db_journal_replay_begin(gfarm_uint64_t from_seqnum)
+{
+	gfarm_error_t e;
+	int inited = 0;
+
+	replay.from_seqnum = from_seqnum;
+	replay.to_seqnum = db_journal_get_current_seqnum();
+	replay.next_seqnum = from_seqnum + 1;
+	replay.reader = NULL;
+	if (from_seqnum >= replay.to_seqnum)
+		return (GFARM_ERR_NO_ERROR);
+	if ((e = journal_file_reader_reopen_if_needed(self_jf,
+	    &replay.reader, from_seqnum, &inited)) != GFARM_ERR_NO_ERROR) {
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "journal records after seqnum %llu: %s",
+		    (unsigned long long)from_seqnum, gfarm_error_string(e));
+		if (inited)
+			journal_file_reader_close(replay.reader);
+		replay.reader = NULL;
+	}
+	return (e);
+}
+
+static gfarm_error_t
+db_journal_replay_op(void *op_arg, gfarm_uint64_t seqnum,
+	enum journal_operation ope, void *obj, void *closure, size_t length,
+	int *needs_freep)
+{
+	struct db_journal_replay *r = closure;
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+
+	if (seqnum <= r->from_seqnum)
+		return (GFARM_ERR_NO_ERROR);
+	if (seqnum != r->next_seqnum) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "journal record seqnum %llu is expected, but %llu",
+		    (unsigned long long)r->next_seqnum,
+		    (unsigned long long)seqnum);
+		return (GFARM_ERR_EXPIRED);
+	}
+	r->next_seqnum = seqnum + 1;
+
+	/*
+	 * only the tables in a snapshot are updated.
+	 * the others were loaded from the backend DB, which already
+	 * includes these records.
+	 */
+	switch (ope) {
+	case GFM_JOURNAL_INODE_ADD:
+	case GFM_JOURNAL_INODE_MODIFY:
+	case GFM_JOURNAL_INODE_GEN_MODIFY:
+	case GFM_JOURNAL_INODE_NLINK_MODIFY:
+	case GFM_JOURNAL_INODE_SIZE_MODIFY:
+	case GFM_JOURNAL_INODE_MODE_MODIFY:
+	case GFM_JOURNAL_INODE_USER_MODIFY:
+	case GFM_JOURNAL_INODE_GROUP_MODIFY:
+	case GFM_JOURNAL_INODE_ATIME_MODIFY:
+	case GFM_JOURNAL_INODE_MTIME_MODIFY:
+	case GFM_JOURNAL_INODE_CTIME_MODIFY:
+	case GFM_JOURNAL_INODE_CKSUM_ADD:
+	case GFM_JOURNAL_INODE_CKSUM_MODIFY:
+	case GFM_JOURNAL_INODE_CKSUM_REMOVE:
+	case GFM_JOURNAL_FILECOPY_ADD:
+	case GFM_JOURNAL_FILECOPY_REMOVE:
+	case GFM_JOURNAL_DIRENTRY_ADD:
+	case GFM_JOURNAL_DIRENTRY_REMOVE:
+	case GFM_JOURNAL_SYMLINK_ADD:
+	case GFM_JOURNAL_SYMLINK_REMOVE:
+	case GFM_JOURNAL_XATTR_ADD:
+	case GFM_JOURNAL_XATTR_MODIFY:
+	case GFM_JOURNAL_XATTR_REMOVE:
+	case GFM_JOURNAL_XATTR_REMOVEALL:
+		e = db_journal_ops_call(journal_apply_ops, seqnum, ope, obj,
+		    "db_journal_replay_op");
+		break;
+	default:
+		break;
+	}
+	return (e);
+}
+
+/*
+ * apply the journal records checked by db_journal_replay_begin()
+ * to the memory.
+ */
+gfarm_error_t
+db_journal_replay_namespace(void)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	int eof;
+
+	if (replay.reader == NULL)
+		return (GFARM_ERR_NO_ERROR);
+	giant_lock();
+	/* never reaches the end of the file, thus this doesn't block */
+	while (replay.next_seqnum <= replay.to_seqnum) {
+		if ((e = db_journal_read(replay.reader, NULL,
+		    db_journal_replay_op, &replay, &eof))
+		    != GFARM_ERR_NO_ERROR)
+			break;
+		if (eof) {
+			e = GFARM_ERR_EXPIRED;
+			break;
+		}
+	}
+	giant_unlock();
+	journal_file_reader_close(replay.reader);
+	replay.reader = NULL;
+	if (e == GFARM_ERR_NO_ERROR)
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "replayed journal records from seqnum %llu to %llu",
+		    (unsigned long long)replay.from_seqnum + 1,
+		    (unsigned long long)replay.to_seqnum);
+	return (e);
+}
+
 void
 db_journal_reset_slave_transaction_nesting(void)
 {
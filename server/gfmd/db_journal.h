@@ -17,6 +17,8 @@ gfarm_error_t db_journal_read(struct journal_file_reader *, void *,
 	gfarm_error_t (*)(void *, gfarm_uint64_t, enum journal_operation,
 	void *, void *, size_t, int *), void *, int *);
 void db_journal_wait_for_apply_thread(void);
+gfarm_error_t db_journal_replay_begin(gfarm_uint64_t);
+gfarm_error_t db_journal_replay_namespace(void);
 gfarm_error_t db_journal_reader_reopen_if_needed(struct journal_file_reader **,
 	gfarm_uint64_t, int *);
 gfarm_error_t db_journal_fetch(struct journal_file_reader *, gfarm_uint64_t,
@@ -27,6 +29,9 @@ gfarm_error_t db_journal_recvq_enter(gfarm_uint64_t, gfarm_uint64_t, int,
 void db_journal_cancel_recvq();
 void db_journal_set_sync_op(gfarm_error_t (*func)(gfarm_uint64_t));
 gfarm_error_t db_journal_file_writer_sync(void);
+int db_journal_group_commit_request(gfarm_uint64_t);
+void db_journal_group_commit_wait(void);
+void db_journal_group_commit_info(void);
 void db_journal_set_remove_db_update_info_op(void (*)(gfarm_uint64_t,
 	const char *));
 void db_journal_wait_until_readable(void);
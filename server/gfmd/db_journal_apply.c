@@ -454,28 +454,57 @@ db_journal_apply_inode_ctime_modify(gfarm_uint64_t seqnum,
 /**********************************************************/
 /* inode_cksum */
 
+static gfarm_error_t
+db_journal_apply_inode_cksum_set(struct db_inode_cksum_arg *arg,
+	const char *diag)
+{
+	gfarm_error_t e;
+	struct inode *n;
+
+	if ((e = db_journal_inode_lookup(arg->inum, &n, diag))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "inum=%llu : %s",
+		    (unsigned long long)arg->inum, gfarm_error_string(e));
+	else if ((e = inode_cksum_set_in_cache(n, arg->type, arg->len,
+	    arg->sum)) != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s: inum=%llu : %s", diag,
+		    (unsigned long long)arg->inum, gfarm_error_string(e));
+	return (e);
+}
+
 static gfarm_error_t
 db_journal_apply_inode_cksum_add(gfarm_uint64_t seqnum,
 	struct db_inode_cksum_arg *arg)
 {
-	/* XXX - NOT IMPLEMENTED */
-	return (GFARM_ERR_FUNCTION_NOT_IMPLEMENTED);
+	return (db_journal_apply_inode_cksum_set(arg,
+	    "db_journal_apply_inode_cksum_add"));
 }
 
 static gfarm_error_t
 db_journal_apply_inode_cksum_modify(gfarm_uint64_t seqnum,
 	struct db_inode_cksum_arg *arg)
 {
-	/* XXX - NOT IMPLEMENTED */
-	return (GFARM_ERR_FUNCTION_NOT_IMPLEMENTED);
+	return (db_journal_apply_inode_cksum_set(arg,
+	    "db_journal_apply_inode_cksum_modify"));
 }
 
 static gfarm_error_t
 db_journal_apply_inode_cksum_remove(gfarm_uint64_t seqnum,
 	struct db_inode_inum_arg *arg)
 {
-	/* XXX - NOT IMPLEMENTED */
-	return (GFARM_ERR_FUNCTION_NOT_IMPLEMENTED);
+	gfarm_error_t e;
+	struct inode *n;
+
+	if ((e = db_journal_inode_lookup(arg->inum, &n,
+	    "db_journal_apply_inode_cksum_remove")) != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "inum=%llu : %s",
+		    (unsigned long long)arg->inum, gfarm_error_string(e));
+	else
+		inode_cksum_remove_in_cache(n);
+	return (e);
 }
 
 /**********************************************************/
@@ -582,6 +611,7 @@ db_journal_apply_direntry_remove(gfarm_uint64_t seqnum,
 {
 	gfarm_error_t e;
 	Dir dir;
+	DirEntry entry;
 	struct inode *idir = inode_lookup(arg->dir_inum);
 
 	if (idir == NULL || (dir = inode_get_dir(idir)) == NULL) {
@@ -592,7 +622,8 @@ db_journal_apply_direntry_remove(gfarm_uint64_t seqnum,
 		    (unsigned long long)arg->dir_inum,
 		    (unsigned long long)arg->entry_inum,
 		    gfarm_error_string(e));
-	} else if (dir_lookup(dir, arg->entry_name, arg->entry_len) == NULL) {
+	} else if ((entry = dir_lookup(dir, arg->entry_name, arg->entry_len))
+	    == NULL) {
 		e = GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY;
 		gflog_error(GFARM_MSG_1003234,
 		    "seqnum=%llu dir_inum=%llu entry_inum=%llu : %s",
@@ -601,6 +632,17 @@ db_journal_apply_direntry_remove(gfarm_uint64_t seqnum,
 		    (unsigned long long)arg->entry_inum,
 		    gfarm_error_string(e));
 	} else {
+		/*
+		 * dir_entry_add() increments it, and a journal replay at
+		 * startup needs this for inode_check_and_repair()
+		 */
+		inode_decrement_nlink_ini(dir_entry_get_inode(entry));
+		/*
+		 * same with inode_unlink().  i_nlink is usually updated by
+		 * the following journal record, and the parent hint is
+		 * checked again by inode_set_nlink_in_cache() then.
+		 */
+		inode_file_unset_parent(dir_entry_get_inode(entry));
 		(void)dir_remove_entry(dir, arg->entry_name, arg->entry_len);
 		e = GFARM_ERR_NO_ERROR;
 	}
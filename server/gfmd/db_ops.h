@@ -263,4 +263,12 @@ struct db_ops {
 
 	gfarm_error_t (*fsngroup_modify)(gfarm_uint64_t,
 		struct db_fsngroup_modify_arg *);
+
+	/*
+	 * optional, may be NULL.
+	 * give the calling thread its own connection for *_load(),
+	 * to load tables in parallel at startup.
+	 */
+	gfarm_error_t (*load_thread_begin)(void);
+	void (*load_thread_end)(void);
 };
@@ -134,6 +134,8 @@ free_arg(void *arg)
 }
 
 static PGconn *conn = NULL;
+static char *pgsql_conninfo = NULL; /* to open connections for loading */
+static pthread_key_t pgsql_load_conn_key;
 static int transaction_nesting = 0;
 static int transaction_ok;
 static int connection_recovered = 0;
@@ -205,6 +207,7 @@ gfarm_pgsql_initialize(void)
 	};
 	char *varvalues[GFARM_ARRAY_LENGTH(varnames)];
 	char *e, *conninfo;
+	int err;
 
 	/*
 	 * sanity check:
@@ -241,9 +244,17 @@ gfarm_pgsql_initialize(void)
 	 * initialize PostgreSQL
 	 */
 
+	err = pthread_key_create(&pgsql_load_conn_key, NULL);
+	if (err != 0) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "pthread_key_create: %s", strerror(err));
+		free(conninfo);
+		return (gfarm_errno_to_error(err));
+	}
+	pgsql_conninfo = conninfo;
+
 	/* open a connection */
 	conn = PQconnectdb(conninfo);
-	free(conninfo);
 
 	if (PQstatus(conn) != CONNECTION_OK) {
 		/* PQerrorMessage's return value will be freed in PQfinish() */
@@ -259,10 +270,53 @@ gfarm_pgsql_terminate(void)
 {
 	/* close and free connection resources */
 	PQfinish(conn);
+	free(pgsql_conninfo);
+	pgsql_conninfo = NULL;
 
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * a connection dedicated to the calling thread, to load tables in
+ * parallel with other threads at startup.
+ * only gfarm_pgsql_generic_load() and gfarm_pgsql_generic_get_all_no_retry()
+ * use this connection, and they don't retry on it.
+ */
+static gfarm_error_t
+gfarm_pgsql_load_thread_begin(void)
+{
+	PGconn *c = PQconnectdb(pgsql_conninfo);
+
+	if (PQstatus(c) != CONNECTION_OK) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "connecting PostgreSQL for loading: %s",
+		    PQerrorMessage(c));
+		PQfinish(c);
+		return (GFARM_ERR_CONNECTION_REFUSED);
+	}
+	pthread_setspecific(pgsql_load_conn_key, c);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static void
+gfarm_pgsql_load_thread_end(void)
+{
+	PGconn *c = pthread_getspecific(pgsql_load_conn_key);
+
+	if (c != NULL) {
+		PQfinish(c);
+		pthread_setspecific(pgsql_load_conn_key, NULL);
+	}
+}
+
+static PGconn *
+pgsql_load_conn(void)
+{
+	PGconn *c = pthread_getspecific(pgsql_load_conn_key);
+
+	return (c != NULL ? c : conn);
+}
+
 
 /**********************************************************************/
 
@@ -875,7 +929,7 @@ gfarm_pgsql_generic_get_all_no_retry(
 	int n, i;
 	char *results;
 
-	res = PQexecParams(conn, sql,
+	res = PQexecParams(pgsql_load_conn(), sql,
 		nparams,
 		NULL, /* param types */
 		paramValues,
@@ -1192,14 +1246,15 @@ gfarm_pgsql_generic_load(
 	int ret;
 	uint32_t header_flags, extension_area_len;
 	int16_t trailer;
+	PGconn *c = pgsql_load_conn();
 
 	static const char binary_signature[COPY_BINARY_SIGNATURE_LEN] =
 		"PGCOPY\n\377\r\n\0";
 
 	do {
-		res = PQexec(conn, command);
+		res = PQexec(c, command);
 	} while (PQresultStatus(res) != PGRES_COPY_OUT &&
-	    pgsql_should_retry(res));
+	    c == conn && pgsql_should_retry(res));
 	if (PQresultStatus(res) != PGRES_COPY_OUT) {
 		gflog_error(GFARM_MSG_1000434, "%s: %s: %s", diag, command,
 		    PQresultErrorMessage(res));
@@ -1208,7 +1263,7 @@ gfarm_pgsql_generic_load(
 	}
 	PQclear(res);
 
-	ret = PQgetCopyData(conn, &buf,	0);
+	ret = PQgetCopyData(c, &buf,	0);
 	if (ret < COPY_BINARY_HEADER_LEN + COPY_BINARY_TRAILER_LEN ||
 	    memcmp(buf, binary_signature, COPY_BINARY_SIGNATURE_LEN) != 0) {
 		gflog_fatal(GFARM_MSG_1000435, "%s: "
@@ -1246,7 +1301,7 @@ gfarm_pgsql_generic_load(
 		if (trailer == COPY_BINARY_TRAILER_VALUE) {
 			PQfreemem(buf);
 			/* make sure that the COPY is done */
-			ret = PQgetCopyData(conn, &buf, 0);
+			ret = PQgetCopyData(c, &buf, 0);
 			if (ret >= 0)
 				gflog_fatal(GFARM_MSG_1000439, "%s: "
 				    "Fatal error, COPY file data after trailer"
@@ -1262,7 +1317,7 @@ gfarm_pgsql_generic_load(
 #endif
 		PQfreemem(buf);
 
-		ret = PQgetCopyData(conn, &buf, 0);
+		ret = PQgetCopyData(c, &buf, 0);
 		bp = buf;
 		if (ret < 0) {
 			gflog_warning(GFARM_MSG_1000440,
@@ -1277,10 +1332,10 @@ gfarm_pgsql_generic_load(
 		    diag);
 	if (ret == PQ_GET_COPY_DATA_ERROR) {
 		gflog_error(GFARM_MSG_1000442,
-		    "%s: data error: %s", diag, PQerrorMessage(conn));
+		    "%s: data error: %s", diag, PQerrorMessage(c));
 		return (GFARM_ERR_UNKNOWN);
 	}
-	res = PQgetResult(conn);
+	res = PQgetResult(c);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK) {
 		gflog_error(GFARM_MSG_1000443,
 		    "%s: failed: %s", diag, PQresultErrorMessage(res));
@@ -3846,4 +3901,7 @@ const struct db_ops db_pgsql_ops = {
 	gfarm_pgsql_mdhost_load,
 
 	gfarm_pgsql_fsngroup_modify,
+
+	gfarm_pgsql_load_thread_begin,
+	gfarm_pgsql_load_thread_end,
 };
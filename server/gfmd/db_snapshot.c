@@ -0,0 +1,869 @@
+/*
+ * $Id$
+ */
+
+/*
+ * metadata snapshot
+ *
+ * a snapshot is a binary dump of the in-memory inode, inode cksum,
+ * file copy, directory entry, symlink and xattr tables, and covers
+ * the journal records up to its sequence number.
+ * when a valid snapshot exists at startup, gfmd loads these tables from
+ * the snapshot instead of the backend DB, and then applies the journal
+ * records after the sequence number to the memory.
+ *
+ * << Snapshot File Header Format >>
+ *
+ *           |MAGIC(8)|VERSION(4)|NSECTIONS(4)|SEQNUM(8)|CTIME(8)|
+ *   offset  0        8          12           16        24       32
+ *
+ *           |BODY_LENGTH(8)|BODY_CRC32(4)|SECTION(24) * NSECTIONS|
+ *   offset 32             40            44                      188
+ *
+ *           |HEADER_CRC32(4)|
+ *   offset 188             192
+ *
+ *   SECTION is |OFFSET(8)|LENGTH(8)|NRECORDS(8)|, OFFSET is in the body.
+ *   HEADER_CRC32 covers the header before it.
+ *
+ * << Record Formats >>
+ *
+ *   inode:	|INUM(8)|GEN(8)|NLINK(8)|SIZE(8)|MODE(4)|USER|GROUP|
+ *		|ATIME|MTIME|CTIME|
+ *   cksum:	|INUM(8)|TYPE|SUM|
+ *   filecopy:	|INUM(8)|HOSTNAME|
+ *   direntry:	|DIR_INUM(8)|NAME|ENTRY_INUM(8)|
+ *   symlink:	|INUM(8)|SOURCE_PATH|
+ *   xattr:	|INUM(8)|XMLMODE(4)|ATTRNAME|VALUE|
+ *
+ *   strings and byte arrays are |LENGTH(4)|BYTES(LENGTH)|,
+ *   the LENGTH of an uncached xattr VALUE is 0xffffffff,
+ *   times are |SEC(8)|NSEC(4)|, and all integers are big endian.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/wait.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+
+#include "config.h"
+#include "crc32.h"
+#include "xattr_info.h"
+#include "gfm_proto.h"
+#include "gfp_xdr.h"
+
+#include "subr.h"
+#include "giant_stat.h"
+#include "mdhost.h"
+#include "inode.h"
+#include "db_journal.h"
+#include "db_snapshot.h"
+
+#define DB_SNAPSHOT_FILE		"snapshot.gms"
+#define DB_SNAPSHOT_MAGIC		"GFMDSNAP"
+#define DB_SNAPSHOT_MAGIC_SIZE		8
+#define DB_SNAPSHOT_VERSION		1
+#define DB_SNAPSHOT_SECTIONS_OFFSET	44
+#define DB_SNAPSHOT_SECTION_SIZE	24
+#define DB_SNAPSHOT_HEADER_CRC_OFFSET	(DB_SNAPSHOT_SECTIONS_OFFSET + \
+	DB_SNAPSHOT_SECTION_SIZE * DB_SNAPSHOT_NSECTIONS)
+#define DB_SNAPSHOT_HEADER_SIZE		(DB_SNAPSHOT_HEADER_CRC_OFFSET + 4)
+#define DB_SNAPSHOT_NO_VALUE		0xffffffff
+
+#define DB_SNAPSHOT_WRITE_BUFSIZE	(1024 * 1024)
+
+struct db_snapshot_section_info {
+	gfarm_uint64_t offset, length, nrecords;
+};
+
+struct db_snapshot_writer {
+	FILE *file;
+	int error; /* errno, see db_snapshot_dump() for why */
+	gfarm_uint32_t crc;
+	gfarm_uint64_t length;
+	enum db_snapshot_section section;
+	struct db_snapshot_section_info sections[DB_SNAPSHOT_NSECTIONS];
+};
+
+/* the snapshot loaded at startup */
+static struct db_snapshot {
+	unsigned char *map;
+	size_t map_size;
+	const unsigned char *body;
+	struct db_snapshot_section_info sections[DB_SNAPSHOT_NSECTIONS];
+} snapshot;
+
+static void
+db_snapshot_path(char *path, size_t size, const char *suffix)
+{
+	snprintf(path, size, "%s/%s%s",
+	    gfarm_get_journal_dir(), DB_SNAPSHOT_FILE, suffix);
+}
+
+static void
+db_snapshot_encode_uint32(unsigned char *p, gfarm_uint32_t n)
+{
+	n = htonl(n);
+	memcpy(p, &n, sizeof(n));
+}
+
+static void
+db_snapshot_encode_uint64(unsigned char *p, gfarm_uint64_t n)
+{
+	db_snapshot_encode_uint32(p, (gfarm_uint32_t)(n >> 32));
+	db_snapshot_encode_uint32(p + 4, (gfarm_uint32_t)n);
+}
+
+static gfarm_uint32_t
+db_snapshot_decode_uint32(const unsigned char *p)
+{
+	gfarm_uint32_t n;
+
+	memcpy(&n, p, sizeof(n));
+	return (ntohl(n));
+}
+
+static gfarm_uint64_t
+db_snapshot_decode_uint64(const unsigned char *p)
+{
+	return (((gfarm_uint64_t)db_snapshot_decode_uint32(p) << 32) |
+	    db_snapshot_decode_uint32(p + 4));
+}
+
+/**********************************************************************
+ * writer
+ */
+
+static void
+db_snapshot_put_raw(struct db_snapshot_writer *w, const void *p, size_t len)
+{
+	if (w->error != 0 || len == 0)
+		return;
+	if (fwrite(p, 1, len, w->file) != len) {
+		w->error = errno;
+		return;
+	}
+	w->crc = gfarm_crc32(w->crc, p, len);
+	w->length += len;
+	w->sections[w->section].length += len;
+}
+
+static void
+db_snapshot_put_uint32(struct db_snapshot_writer *w, gfarm_uint32_t n)
+{
+	unsigned char buf[4];
+
+	db_snapshot_encode_uint32(buf, n);
+	db_snapshot_put_raw(w, buf, sizeof(buf));
+}
+
+static void
+db_snapshot_put_uint64(struct db_snapshot_writer *w, gfarm_uint64_t n)
+{
+	unsigned char buf[8];
+
+	db_snapshot_encode_uint64(buf, n);
+	db_snapshot_put_raw(w, buf, sizeof(buf));
+}
+
+static void
+db_snapshot_put_bytes(struct db_snapshot_writer *w, const void *p, size_t len)
+{
+	db_snapshot_put_uint32(w, len);
+	db_snapshot_put_raw(w, p, len);
+}
+
+static void
+db_snapshot_put_string(struct db_snapshot_writer *w, const char *s)
+{
+	db_snapshot_put_bytes(w, s, strlen(s));
+}
+
+static void
+db_snapshot_put_timespec(struct db_snapshot_writer *w,
+	const struct gfarm_timespec *ts)
+{
+	db_snapshot_put_uint64(w, ts->tv_sec);
+	db_snapshot_put_uint32(w, ts->tv_nsec);
+}
+
+void
+db_snapshot_section_begin(struct db_snapshot_writer *w,
+	enum db_snapshot_section section)
+{
+	w->section = section;
+	w->sections[section].offset = w->length;
+}
+
+void
+db_snapshot_put_inode(struct db_snapshot_writer *w, const struct gfs_stat *st)
+{
+	db_snapshot_put_uint64(w, st->st_ino);
+	db_snapshot_put_uint64(w, st->st_gen);
+	db_snapshot_put_uint64(w, st->st_nlink);
+	db_snapshot_put_uint64(w, st->st_size);
+	db_snapshot_put_uint32(w, st->st_mode);
+	db_snapshot_put_string(w, st->st_user);
+	db_snapshot_put_string(w, st->st_group);
+	db_snapshot_put_timespec(w, &st->st_atimespec);
+	db_snapshot_put_timespec(w, &st->st_mtimespec);
+	db_snapshot_put_timespec(w, &st->st_ctimespec);
+	w->sections[w->section].nrecords++;
+}
+
+void
+db_snapshot_put_inode_cksum(struct db_snapshot_writer *w, gfarm_ino_t inum,
+	const char *type, size_t len, const char *sum)
+{
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_string(w, type);
+	db_snapshot_put_bytes(w, sum, len);
+	w->sections[w->section].nrecords++;
+}
+
+void
+db_snapshot_put_filecopy(struct db_snapshot_writer *w, gfarm_ino_t inum,
+	const char *hostname)
+{
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_string(w, hostname);
+	w->sections[w->section].nrecords++;
+}
+
+void
+db_snapshot_put_direntry(struct db_snapshot_writer *w, gfarm_ino_t dir_inum,
+	const char *entry_name, int entry_len, gfarm_ino_t entry_inum)
+{
+	db_snapshot_put_uint64(w, dir_inum);
+	db_snapshot_put_bytes(w, entry_name, entry_len);
+	db_snapshot_put_uint64(w, entry_inum);
+	w->sections[w->section].nrecords++;
+}
+
+void
+db_snapshot_put_symlink(struct db_snapshot_writer *w, gfarm_ino_t inum,
+	const char *source_path)
+{
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_string(w, source_path);
+	w->sections[w->section].nrecords++;
+}
+
+/* value == NULL means that the value isn't cached */
+void
+db_snapshot_put_xattr(struct db_snapshot_writer *w, int xmlMode,
+	gfarm_ino_t inum, const char *attrname, const void *value, int size)
+{
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_uint32(w, xmlMode);
+	db_snapshot_put_string(w, attrname);
+	if (value == NULL)
+		db_snapshot_put_uint32(w, DB_SNAPSHOT_NO_VALUE);
+	else
+		db_snapshot_put_bytes(w, value, size);
+	w->sections[w->section].nrecords++;
+}
+
+static void
+db_snapshot_header_encode(unsigned char *header, gfarm_uint64_t seqnum,
+	struct db_snapshot_writer *w)
+{
+	unsigned char *p;
+	int i;
+
+	memset(header, 0, DB_SNAPSHOT_HEADER_SIZE);
+	memcpy(header, DB_SNAPSHOT_MAGIC, DB_SNAPSHOT_MAGIC_SIZE);
+	db_snapshot_encode_uint32(header + 8, DB_SNAPSHOT_VERSION);
+	db_snapshot_encode_uint32(header + 12, DB_SNAPSHOT_NSECTIONS);
+	db_snapshot_encode_uint64(header + 16, seqnum);
+	db_snapshot_encode_uint64(header + 24, time(NULL));
+	db_snapshot_encode_uint64(header + 32, w->length);
+	db_snapshot_encode_uint32(header + 40, w->crc);
+	for (i = 0; i < DB_SNAPSHOT_NSECTIONS; i++) {
+		p = header + DB_SNAPSHOT_SECTIONS_OFFSET +
+		    i * DB_SNAPSHOT_SECTION_SIZE;
+		db_snapshot_encode_uint64(p, w->sections[i].offset);
+		db_snapshot_encode_uint64(p + 8, w->sections[i].length);
+		db_snapshot_encode_uint64(p + 16, w->sections[i].nrecords);
+	}
+	db_snapshot_encode_uint32(header + DB_SNAPSHOT_HEADER_CRC_OFFSET,
+	    gfarm_crc32(0, header, DB_SNAPSHOT_HEADER_CRC_OFFSET));
+}
+
+/*
+ * this runs in the child process forked by db_snapshot_write().
+ * only the thread which called fork() exists in the child, thus a lock
+ * which another thread held at fork is never released in the child.
+ * therefore this and inode_snapshot() must not take any lock except
+ * giant_lock, which the parent held at fork, and must not allocate
+ * memory, nor log, nor call gfarm_errno_to_error(), which may log.
+ * inode_snapshot() only walks the tables by inode_table_get(),
+ * dir_cursor_*(), dir_entry_get_*(), inode_xattrs(), host_name(),
+ * user_name_even_invalid() and group_name_even_invalid(),
+ * which take no lock, and the stdio buffer of `w->file' is allocated
+ * by the parent.
+ * returns errno, or 0 if succeeded.
+ */
+static int
+db_snapshot_dump(struct db_snapshot_writer *w, gfarm_uint64_t seqnum)
+{
+	unsigned char header[DB_SNAPSHOT_HEADER_SIZE];
+
+	/* reserve space for the header */
+	memset(header, 0, sizeof(header));
+	if (fwrite(header, 1, sizeof(header), w->file) != sizeof(header))
+		return (errno);
+
+	inode_snapshot(w);
+	if (w->error != 0)
+		return (w->error);
+
+	db_snapshot_header_encode(header, seqnum, w);
+	if (fseek(w->file, 0, SEEK_SET) == -1 ||
+	    fwrite(header, 1, sizeof(header), w->file) != sizeof(header) ||
+	    fflush(w->file) == EOF ||
+	    fsync(fileno(w->file)) == -1)
+		return (errno);
+	return (0);
+}
+
+/* the child process reports errno by `fd', and exits with 0 or 1 */
+static void
+db_snapshot_dump_child(struct db_snapshot_writer *w, gfarm_uint64_t seqnum,
+	int fd)
+{
+	int eno = db_snapshot_dump(w, seqnum);
+
+	if (eno != 0 && write(fd, &eno, sizeof(eno)) == -1)
+		; /* the parent reports an unknown error */
+	_exit(eno == 0 ? 0 : 1);
+}
+
+/* returns the result of the child process */
+static gfarm_error_t
+db_snapshot_dump_wait(pid_t pid, int fd)
+{
+	pid_t rv;
+	int status, eno;
+
+	while ((rv = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
+		;
+	if (rv == -1)
+		return (gfarm_errno_to_error(errno));
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		return (GFARM_ERR_NO_ERROR);
+	if (WIFSIGNALED(status)) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "metadata snapshot: process %ld killed by signal %d",
+		    (long)pid, WTERMSIG(status));
+		return (GFARM_ERR_UNKNOWN);
+	}
+	if (read(fd, &eno, sizeof(eno)) != sizeof(eno) || eno == 0)
+		return (GFARM_ERR_UNKNOWN);
+	return (gfarm_errno_to_error(eno));
+}
+
+/*
+ * write a snapshot of the current metadata.
+ *
+ * giant_lock is only held while forking a child process,
+ * which dumps the tables from its copy-on-write image of the memory.
+ * thus requests can still be processed while dumping.
+ */
+gfarm_error_t
+db_snapshot_write(void)
+{
+	gfarm_error_t e;
+	struct db_snapshot_writer *w;
+	char *buf;
+	char path[MAXPATHLEN + 1], tmp_path[MAXPATHLEN + 1];
+	gfarm_uint64_t seqnum;
+	struct timespec start, end;
+	pid_t pid;
+	int fds[2];
+	static const char diag[] = "db_snapshot_write";
+
+	db_snapshot_path(path, sizeof(path), "");
+	db_snapshot_path(tmp_path, sizeof(tmp_path), ".tmp");
+	GFARM_MALLOC(w);
+	GFARM_MALLOC_ARRAY(buf, DB_SNAPSHOT_WRITE_BUFSIZE);
+	if (w == NULL || buf == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: no memory", diag);
+		free(w);
+		free(buf);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	memset(w, 0, sizeof(*w));
+	if (pipe(fds) == -1) {
+		e = gfarm_errno_to_error(errno);
+		gflog_error(GFARM_MSG_UNFIXED, "%s: pipe: %s",
+		    diag, gfarm_error_string(e));
+		free(w);
+		free(buf);
+		return (e);
+	}
+	if ((w->file = fopen(tmp_path, "w")) == NULL) {
+		e = gfarm_errno_to_error(errno);
+		gflog_error(GFARM_MSG_UNFIXED, "%s: %s: %s",
+		    diag, tmp_path, gfarm_error_string(e));
+		close(fds[0]);
+		close(fds[1]);
+		free(w);
+		free(buf);
+		return (e);
+	}
+	/* the child must not allocate it at the first fwrite() */
+	if (setvbuf(w->file, buf, _IOFBF, DB_SNAPSHOT_WRITE_BUFSIZE) != 0) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: setvbuf failed", diag);
+		fclose(w->file);
+		(void)unlink(tmp_path);
+		close(fds[0]);
+		close(fds[1]);
+		free(w);
+		free(buf);
+		return (GFARM_ERR_UNKNOWN);
+	}
+
+	gfarm_gettime(&start);
+	giant_set_shared_mode(1);
+	giant_lock();
+	/* exclude small updates by read-only requests, e.g. atime */
+	giant_shared_update_begin();
+	seqnum = db_journal_get_current_seqnum();
+	if ((pid = fork()) == 0)
+		db_snapshot_dump_child(w, seqnum, fds[1]);
+	e = pid == -1 ? gfarm_errno_to_error(errno) : GFARM_ERR_NO_ERROR;
+	giant_shared_update_end();
+	giant_unlock();
+	giant_set_shared_mode(0);
+	gfarm_gettime(&end);
+
+	close(fds[1]);
+	if (pid != -1)
+		e = db_snapshot_dump_wait(pid, fds[0]);
+	close(fds[0]);
+	/* nothing is buffered in the parent */
+	if (fclose(w->file) == EOF && e == GFARM_ERR_NO_ERROR)
+		e = gfarm_errno_to_error(errno);
+	free(buf);
+	if (e == GFARM_ERR_NO_ERROR && rename(tmp_path, path) == -1)
+		e = gfarm_errno_to_error(errno);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: %s: %s",
+		    diag, tmp_path, gfarm_error_string(e));
+		(void)unlink(tmp_path);
+	} else {
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "metadata snapshot: seqnum=%llu, "
+		    "giant_lock held %.3f sec to fork",
+		    (unsigned long long)seqnum,
+		    (end.tv_sec - start.tv_sec) +
+		    (end.tv_nsec - start.tv_nsec) / 1e9);
+	}
+	free(w);
+	return (e);
+}
+
+void *
+db_snapshot_thread(void *arg)
+{
+	int interval = gfarm_get_metadb_snapshot_interval();
+
+	(void)giant_stat_owner_set(GIANT_STAT_OWNER_DB_SNAPSHOT);
+	for (;;) {
+		gfarm_sleep(interval);
+		/* on a slave, the memory may be behind the journal */
+		if (mdhost_self_is_master())
+			(void)db_snapshot_write();
+	}
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+/**********************************************************************
+ * loader
+ */
+
+/*
+ * map the snapshot, and check its integrity.
+ * the snapshot is only usable if it doesn't exceed `max_seqnum',
+ * which is the sequence number of the backend DB.
+ */
+gfarm_error_t
+db_snapshot_open(gfarm_uint64_t max_seqnum, gfarm_uint64_t *seqnump)
+{
+	int fd, i;
+	struct stat sb;
+	void *map;
+	const unsigned char *h, *p;
+	gfarm_uint64_t seqnum, body_length;
+	struct db_snapshot_section_info *si;
+	char path[MAXPATHLEN + 1];
+	const char *reason = NULL;
+	gfarm_error_t e;
+	static const char diag[] = "db_snapshot_open";
+
+	db_snapshot_path(path, sizeof(path), "");
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		e = gfarm_errno_to_error(errno);
+		if (e != GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY)
+			gflog_error(GFARM_MSG_UNFIXED, "%s: %s: %s",
+			    diag, path, gfarm_error_string(e));
+		return (e);
+	}
+	if (fstat(fd, &sb) == -1) {
+		e = gfarm_errno_to_error(errno);
+		gflog_error(GFARM_MSG_UNFIXED, "%s: fstat %s: %s",
+		    diag, path, gfarm_error_string(e));
+		close(fd);
+		return (e);
+	}
+	if (sb.st_size < DB_SNAPSHOT_HEADER_SIZE) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: %s: too short",
+		    diag, path);
+		close(fd);
+		return (GFARM_ERR_INTERNAL_ERROR);
+	}
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	e = gfarm_errno_to_error(errno);
+	close(fd);
+	if (map == MAP_FAILED) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: mmap %s: %s",
+		    diag, path, gfarm_error_string(e));
+		return (e);
+	}
+#ifdef MADV_SEQUENTIAL
+	(void)madvise(map, sb.st_size, MADV_SEQUENTIAL);
+#endif
+
+	h = map;
+	seqnum = db_snapshot_decode_uint64(h + 16);
+	body_length = db_snapshot_decode_uint64(h + 32);
+	if (memcmp(h, DB_SNAPSHOT_MAGIC, DB_SNAPSHOT_MAGIC_SIZE) != 0)
+		reason = "bad magic";
+	else if (db_snapshot_decode_uint32(h + 8) != DB_SNAPSHOT_VERSION ||
+	    db_snapshot_decode_uint32(h + 12) != DB_SNAPSHOT_NSECTIONS)
+		reason = "unsupported version";
+	else if (db_snapshot_decode_uint32(h + DB_SNAPSHOT_HEADER_CRC_OFFSET)
+	    != gfarm_crc32(0, h, DB_SNAPSHOT_HEADER_CRC_OFFSET))
+		reason = "header checksum mismatch";
+	else if (body_length != sb.st_size - DB_SNAPSHOT_HEADER_SIZE)
+		reason = "truncated";
+	else if (seqnum > max_seqnum)
+		reason = "newer than the journal";
+	for (i = 0; reason == NULL && i < DB_SNAPSHOT_NSECTIONS; i++) {
+		si = &snapshot.sections[i];
+		p = h + DB_SNAPSHOT_SECTIONS_OFFSET +
+		    i * DB_SNAPSHOT_SECTION_SIZE;
+		si->offset = db_snapshot_decode_uint64(p);
+		si->length = db_snapshot_decode_uint64(p + 8);
+		si->nrecords = db_snapshot_decode_uint64(p + 16);
+		if (si->offset > body_length ||
+		    si->length > body_length - si->offset)
+			reason = "bad section";
+	}
+	if (reason == NULL && db_snapshot_decode_uint32(h + 40) !=
+	    gfarm_crc32(0, h + DB_SNAPSHOT_HEADER_SIZE, body_length))
+		reason = "body checksum mismatch";
+	if (reason != NULL) {
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "%s: %s: %s, ignored", diag, path, reason);
+		munmap(map, sb.st_size);
+		return (GFARM_ERR_INTERNAL_ERROR);
+	}
+
+	snapshot.map = map;
+	snapshot.map_size = sb.st_size;
+	snapshot.body = snapshot.map + DB_SNAPSHOT_HEADER_SIZE;
+	*seqnump = seqnum;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+int
+db_snapshot_is_loaded(void)
+{
+	return (snapshot.map != NULL);
+}
+
+/* if `discard' is true, the snapshot is removed not to be used again */
+void
+db_snapshot_close(int discard)
+{
+	char path[MAXPATHLEN + 1];
+
+	if (snapshot.map == NULL)
+		return;
+	munmap(snapshot.map, snapshot.map_size);
+	snapshot.map = NULL;
+	if (discard) {
+		db_snapshot_path(path, sizeof(path), "");
+		if (unlink(path) == -1)
+			gflog_error(GFARM_MSG_UNFIXED,
+			    "db_snapshot_close: unlink %s: %s",
+			    path, strerror(errno));
+	}
+}
+
+struct db_snapshot_cursor {
+	const unsigned char *p, *end;
+	gfarm_error_t error;
+};
+
+static gfarm_uint64_t
+db_snapshot_cursor_init(struct db_snapshot_cursor *c,
+	enum db_snapshot_section section)
+{
+	struct db_snapshot_section_info *si = &snapshot.sections[section];
+
+	c->p = snapshot.body + si->offset;
+	c->end = c->p + si->length;
+	c->error = GFARM_ERR_NO_ERROR;
+	return (si->nrecords);
+}
+
+static const unsigned char *
+db_snapshot_get_raw(struct db_snapshot_cursor *c, size_t len)
+{
+	const unsigned char *p = c->p;
+
+	if (c->error != GFARM_ERR_NO_ERROR)
+		return (NULL);
+	if (len > c->end - c->p) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "metadata snapshot: broken record");
+		c->error = GFARM_ERR_INTERNAL_ERROR;
+		return (NULL);
+	}
+	c->p += len;
+	return (p);
+}
+
+static gfarm_uint32_t
+db_snapshot_get_uint32(struct db_snapshot_cursor *c)
+{
+	const unsigned char *p = db_snapshot_get_raw(c, 4);
+
+	return (p == NULL ? 0 : db_snapshot_decode_uint32(p));
+}
+
+static gfarm_uint64_t
+db_snapshot_get_uint64(struct db_snapshot_cursor *c)
+{
+	const unsigned char *p = db_snapshot_get_raw(c, 8);
+
+	return (p == NULL ? 0 : db_snapshot_decode_uint64(p));
+}
+
+static void
+db_snapshot_get_timespec(struct db_snapshot_cursor *c,
+	struct gfarm_timespec *ts)
+{
+	ts->tv_sec = db_snapshot_get_uint64(c);
+	ts->tv_nsec = db_snapshot_get_uint32(c);
+}
+
+/*
+ * returns a NUL terminated copy, which must be freed by the caller.
+ * NULL means an error, or an uncached xattr value.
+ */
+static char *
+db_snapshot_get_bytes(struct db_snapshot_cursor *c, size_t *lenp)
+{
+	gfarm_uint32_t len = db_snapshot_get_uint32(c);
+	const unsigned char *p;
+	char *s;
+
+	if (c->error != GFARM_ERR_NO_ERROR || len == DB_SNAPSHOT_NO_VALUE)
+		return (NULL);
+	if ((p = db_snapshot_get_raw(c, len)) == NULL)
+		return (NULL);
+	GFARM_MALLOC_ARRAY(s, len + 1);
+	if (s == NULL) {
+		c->error = GFARM_ERR_NO_MEMORY;
+		return (NULL);
+	}
+	memcpy(s, p, len);
+	s[len] = '\0';
+	if (lenp != NULL)
+		*lenp = len;
+	return (s);
+}
+
+static char *
+db_snapshot_get_string(struct db_snapshot_cursor *c)
+{
+	return (db_snapshot_get_bytes(c, NULL));
+}
+
+gfarm_error_t
+db_snapshot_inode_load(void *closure,
+	void (*callback)(void *, struct gfs_stat *))
+{
+	struct db_snapshot_cursor c;
+	gfarm_uint64_t i, n = db_snapshot_cursor_init(&c, DB_SNAPSHOT_INODE);
+	struct gfs_stat st;
+
+	for (i = 0; i < n; i++) {
+		st.st_ino = db_snapshot_get_uint64(&c);
+		st.st_gen = db_snapshot_get_uint64(&c);
+		st.st_nlink = db_snapshot_get_uint64(&c);
+		st.st_size = db_snapshot_get_uint64(&c);
+		st.st_mode = db_snapshot_get_uint32(&c);
+		st.st_user = db_snapshot_get_string(&c);
+		st.st_group = db_snapshot_get_string(&c);
+		db_snapshot_get_timespec(&c, &st.st_atimespec);
+		db_snapshot_get_timespec(&c, &st.st_mtimespec);
+		db_snapshot_get_timespec(&c, &st.st_ctimespec);
+		st.st_ncopy = 0;
+		if (c.error != GFARM_ERR_NO_ERROR) {
+			gfs_stat_free(&st);
+			return (c.error);
+		}
+		/* the memory owner of `st' is changed to the callback */
+		(*callback)(closure, &st);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+db_snapshot_inode_cksum_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *, size_t, char *))
+{
+	struct db_snapshot_cursor c;
+	gfarm_uint64_t i, n =
+	    db_snapshot_cursor_init(&c, DB_SNAPSHOT_INODE_CKSUM);
+	gfarm_ino_t inum;
+	char *type, *sum;
+	size_t len;
+
+	for (i = 0; i < n; i++) {
+		inum = db_snapshot_get_uint64(&c);
+		type = db_snapshot_get_string(&c);
+		sum = db_snapshot_get_bytes(&c, &len);
+		if (c.error != GFARM_ERR_NO_ERROR) {
+			free(type);
+			free(sum);
+			return (c.error);
+		}
+		(*callback)(closure, inum, type, len, sum);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+db_snapshot_filecopy_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *))
+{
+	struct db_snapshot_cursor c;
+	gfarm_uint64_t i, n = db_snapshot_cursor_init(&c, DB_SNAPSHOT_FILECOPY);
+	gfarm_ino_t inum;
+	char *hostname;
+
+	for (i = 0; i < n; i++) {
+		inum = db_snapshot_get_uint64(&c);
+		hostname = db_snapshot_get_string(&c);
+		if (c.error != GFARM_ERR_NO_ERROR)
+			return (c.error);
+		(*callback)(closure, inum, hostname);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+db_snapshot_direntry_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *, int, gfarm_ino_t))
+{
+	struct db_snapshot_cursor c;
+	gfarm_uint64_t i, n = db_snapshot_cursor_init(&c, DB_SNAPSHOT_DIRENTRY);
+	gfarm_ino_t dir_inum, entry_inum;
+	char *entry_name;
+	size_t entry_len;
+
+	for (i = 0; i < n; i++) {
+		dir_inum = db_snapshot_get_uint64(&c);
+		entry_name = db_snapshot_get_bytes(&c, &entry_len);
+		entry_inum = db_snapshot_get_uint64(&c);
+		if (c.error != GFARM_ERR_NO_ERROR) {
+			free(entry_name);
+			return (c.error);
+		}
+		(*callback)(closure, dir_inum, entry_name, entry_len,
+		    entry_inum);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+db_snapshot_symlink_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *))
+{
+	struct db_snapshot_cursor c;
+	gfarm_uint64_t i, n = db_snapshot_cursor_init(&c, DB_SNAPSHOT_SYMLINK);
+	gfarm_ino_t inum;
+	char *source_path;
+
+	for (i = 0; i < n; i++) {
+		inum = db_snapshot_get_uint64(&c);
+		source_path = db_snapshot_get_string(&c);
+		if (c.error != GFARM_ERR_NO_ERROR)
+			return (c.error);
+		(*callback)(closure, inum, source_path);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* `closure' points the xmlMode, as db_xattr_load() */
+gfarm_error_t
+db_snapshot_xattr_load(void *closure,
+	void (*callback)(void *, struct xattr_info *))
+{
+	struct db_snapshot_cursor c;
+	gfarm_uint64_t i, n = db_snapshot_cursor_init(&c, DB_SNAPSHOT_XATTR);
+	int xmlMode = *(int *)closure;
+	struct xattr_info info;
+	size_t size;
+
+	for (i = 0; i < n; i++) {
+		info.inum = db_snapshot_get_uint64(&c);
+		if (db_snapshot_get_uint32(&c) != xmlMode) {
+			/* skip this record */
+			free(db_snapshot_get_string(&c));
+			free(db_snapshot_get_bytes(&c, NULL));
+			if (c.error != GFARM_ERR_NO_ERROR)
+				return (c.error);
+			continue;
+		}
+		info.attrname = db_snapshot_get_string(&c);
+		size = 0;
+		info.attrvalue = db_snapshot_get_bytes(&c, &size);
+		if (c.error != GFARM_ERR_NO_ERROR) {
+			free(info.attrname);
+			free(info.attrvalue);
+			return (c.error);
+		}
+		info.namelen = strlen(info.attrname);
+		info.attrsize = size;
+		/* the memory owner of `info' isn't changed */
+		(*callback)(closure, &info);
+		free(info.attrname);
+		free(info.attrvalue);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
@@ -0,0 +1,56 @@
+/*
+ * $Id$
+ */
+
+/*
+ * sections of a metadata snapshot.
+ * records are loaded in this order, i.e. the order of *_init() in gfmd.
+ */
+enum db_snapshot_section {
+	DB_SNAPSHOT_INODE,
+	DB_SNAPSHOT_INODE_CKSUM,
+	DB_SNAPSHOT_FILECOPY,
+	DB_SNAPSHOT_DIRENTRY,
+	DB_SNAPSHOT_SYMLINK,
+	DB_SNAPSHOT_XATTR,
+	DB_SNAPSHOT_NSECTIONS
+};
+
+struct gfs_stat;
+struct xattr_info;
+struct db_snapshot_writer;
+
+void db_snapshot_section_begin(struct db_snapshot_writer *,
+	enum db_snapshot_section);
+void db_snapshot_put_inode(struct db_snapshot_writer *,
+	const struct gfs_stat *);
+void db_snapshot_put_inode_cksum(struct db_snapshot_writer *, gfarm_ino_t,
+	const char *, size_t, const char *);
+void db_snapshot_put_filecopy(struct db_snapshot_writer *, gfarm_ino_t,
+	const char *);
+void db_snapshot_put_direntry(struct db_snapshot_writer *, gfarm_ino_t,
+	const char *, int, gfarm_ino_t);
+void db_snapshot_put_symlink(struct db_snapshot_writer *, gfarm_ino_t,
+	const char *);
+void db_snapshot_put_xattr(struct db_snapshot_writer *, int, gfarm_ino_t,
+	const char *, const void *, int);
+
+gfarm_error_t db_snapshot_write(void);
+void *db_snapshot_thread(void *);
+
+gfarm_error_t db_snapshot_open(gfarm_uint64_t, gfarm_uint64_t *);
+int db_snapshot_is_loaded(void);
+void db_snapshot_close(int);
+
+gfarm_error_t db_snapshot_inode_load(void *,
+	void (*)(void *, struct gfs_stat *));
+gfarm_error_t db_snapshot_inode_cksum_load(void *,
+	void (*)(void *, gfarm_ino_t, char *, size_t, char *));
+gfarm_error_t db_snapshot_filecopy_load(void *,
+	void (*)(void *, gfarm_ino_t, char *));
+gfarm_error_t db_snapshot_direntry_load(void *,
+	void (*)(void *, gfarm_ino_t, char *, int, gfarm_ino_t));
+gfarm_error_t db_snapshot_symlink_load(void *,
+	void (*)(void *, gfarm_ino_t, char *));
+gfarm_error_t db_snapshot_xattr_load(void *,
+	void (*)(void *, struct xattr_info *));
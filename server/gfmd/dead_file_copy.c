@@ -18,6 +18,7 @@
 #include "gfp_xdr.h" /* gfmd.h needs this */
 
 #include "subr.h"
+#include "giant_stat.h"
 #include "callout.h"
 #include "db_access.h"
 #include "inode.h"
@@ -26,7 +27,10 @@
 #include "netsendq.h"
 #include "netsendq_impl.h"
 #include "dead_file_copy.h"
+#include "auth.h" /* for "peer.h" */
+#include "peer.h"
 #include "back_channel.h"
+#include "slab.h"
 #include "gfmd.h"	/* sync_protocol_get_thrpool() */
 
 struct dead_file_copy {
@@ -44,6 +48,9 @@ struct dead_file_copy_list {
 	GFARM_HCIRCLEQ_HEAD(dead_file_copy) list;
 };
 
+static struct slab dead_file_copy_slab =
+	SLAB_INITIALIZER("dead_file_copy", sizeof(struct dead_file_copy));
+
 struct dfc_keptq {
 	pthread_mutex_t mutex;
 
@@ -87,6 +94,7 @@ static void
 handle_removal_result(struct netsendq_entry *qentryp)
 {
 	struct dead_file_copy *dfc = (struct dead_file_copy *)qentryp;
+	int saved_owner = giant_stat_owner_set(GIANT_STAT_OWNER_DEAD_FILE_COPY);
 	const char diag[] = "handle_removal_result";
 
 	if (dfc->qentry.result == GFARM_ERR_NO_ERROR ||
@@ -110,6 +118,7 @@ handle_removal_result(struct netsendq_entry *qentryp)
 		dead_file_copy_schedule_removal(dfc);
 		giant_unlock();
 	}
+	giant_stat_owner_set(saved_owner);
 }
 
 /*
@@ -452,45 +461,185 @@ gfs_client_fhremove_free(void *p, void *arg)
 	removal_finishedq_enqueue(dfc, GFARM_ERR_CONNECTION_ABORTED);
 }
 
+static int
+dead_file_copy_batch(struct dead_file_copy *head,
+	struct dead_file_copy **dfcs)
+{
+	struct netsendq_entry *qe;
+	int n = 0;
+
+	for (qe = &head->qentry; qe != NULL; qe = netsendq_entry_batch_next(qe))
+		dfcs[n++] = (struct dead_file_copy *)qe;
+	return (n);
+}
+
+/* the reply is received one by one, see gfs_proto.h */
+static gfarm_int32_t
+gfs_client_fhremove_batch_result(void *p, void *arg, size_t size)
+{
+	struct peer *peer = p;
+	struct gfp_xdr *conn = peer_get_conn(peer);
+	struct dead_file_copy *dfcs[GFS_PROTO_FHREMOVE_BATCH_MAX];
+	gfarm_int32_t errs[GFS_PROTO_FHREMOVE_BATCH_MAX];
+	int i, n = dead_file_copy_batch(arg, dfcs), eof = 0;
+	struct host *host = dead_file_copy_get_host(arg);
+	gfarm_int32_t errcode, nresults;
+	gfarm_error_t e;
+	static const char diag[] = "GFS_PROTO_FHREMOVE_BATCH";
+
+	e = gfp_xdr_recv_sized(conn, 0, 1, &size, &eof, "i", &errcode);
+	if (e == GFARM_ERR_NO_ERROR && !eof &&
+	    errcode == GFARM_ERR_NO_ERROR) {
+		e = gfp_xdr_recv_sized(conn, 0, 1, &size, &eof, "i",
+		    &nresults);
+		if (e == GFARM_ERR_NO_ERROR && !eof && nresults != n) {
+			gflog_error(GFARM_MSG_UNFIXED,
+			    "%s(%s): %d results for %d requests", diag,
+			    host_name(host), (int)nresults, n);
+			e = GFARM_ERR_PROTOCOL;
+		}
+		for (i = 0; i < n && e == GFARM_ERR_NO_ERROR && !eof; i++)
+			e = gfp_xdr_recv_sized(conn, 0, 1, &size, &eof, "i",
+			    &errs[i]);
+	}
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s(%s) RPC result: %s",
+		    diag, host_name(host), gfarm_error_string(e));
+	} else if (size != 0) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s(%s) RPC result: protocol residual %d",
+		    diag, host_name(host), (int)size);
+		if ((e = gfp_xdr_purge(conn, 0, size)) != GFARM_ERR_NO_ERROR)
+			gflog_warning(GFARM_MSG_UNFIXED,
+			    "%s(%s) RPC result: skipping: %s",
+			    diag, host_name(host), gfarm_error_string(e));
+		e = GFARM_ERR_PROTOCOL;
+	}
+
+	for (i = 0; i < n; i++)
+		removal_finishedq_enqueue(dfcs[i],
+		    e != GFARM_ERR_NO_ERROR ? e :
+		    errcode != GFARM_ERR_NO_ERROR ? errcode : errs[i]);
+	return (e);
+}
+
+/* both giant_lock and peer_table_lock are held before calling this function */
+static void
+gfs_client_fhremove_batch_free(void *p, void *arg)
+{
+	struct dead_file_copy *dfcs[GFS_PROTO_FHREMOVE_BATCH_MAX];
+	int i, n = dead_file_copy_batch(arg, dfcs);
+
+	for (i = 0; i < n; i++)
+		removal_finishedq_enqueue(dfcs[i],
+		    GFARM_ERR_CONNECTION_ABORTED);
+}
+
+struct fhremove_batch {
+	int n;
+	struct dead_file_copy **dfcs;
+};
+
+static gfarm_error_t
+gfs_client_fhremove_batch_send(struct gfp_xdr *conn, void *arg)
+{
+	struct fhremove_batch *batch = arg;
+	gfarm_error_t e;
+	int i;
+
+	e = gfp_xdr_send(conn, "i", (gfarm_int32_t)batch->n);
+	for (i = 0; i < batch->n && e == GFARM_ERR_NO_ERROR; i++)
+		e = gfp_xdr_send(conn, "ll",
+		    dead_file_copy_get_ino(batch->dfcs[i]),
+		    dead_file_copy_get_gen(batch->dfcs[i]));
+	return (e);
+}
+
+/*
+ * removal requests are coalesced by netsendq for each host which supports
+ * GFS_PROTO_FHREMOVE_BATCH, and sent by one request.
+ * if the host is reconnected by an older gfsd after they are coalesced,
+ * they are sent by GFS_PROTO_FHREMOVE one by one.
+ */
 static void *
 gfs_client_fhremove_request(void *closure)
 {
-	struct dead_file_copy *dfc = closure;
-	gfarm_ino_t ino = dead_file_copy_get_ino(dfc);
-	gfarm_int64_t gen = dead_file_copy_get_gen(dfc);
-	struct host *host = dead_file_copy_get_host(dfc);
+	struct dead_file_copy *dfcs[GFS_PROTO_FHREMOVE_BATCH_MAX];
+	gfarm_error_t errs[GFS_PROTO_FHREMOVE_BATCH_MAX];
+	struct fhremove_batch batch;
+	int i, n = dead_file_copy_batch(closure, dfcs);
+	struct host *host = dead_file_copy_get_host(closure);
 	gfarm_error_t e;
 	static const char diag[] = "GFS_PROTO_FHREMOVE";
 
-	e = gfs_client_send_request(host, NULL, diag,
-	    gfs_client_fhremove_result, gfs_client_fhremove_free, dfc,
-	    GFS_PROTO_FHREMOVE, "ll", ino, gen);
-	netsendq_entry_was_sent(abstract_host_get_sendq(dfc->qentry.abhost),
-	    &dfc->qentry);
+	if (n > 1 && host_supports_fhremove_batch(host)) {
+		batch.n = n;
+		batch.dfcs = dfcs;
+		/* "i", and "ll" for each file */
+		e = gfs_client_send_params_request(host, NULL, diag,
+		    gfs_client_fhremove_batch_result,
+		    gfs_client_fhremove_batch_free, closure,
+		    GFS_PROTO_FHREMOVE_BATCH,
+		    sizeof(gfarm_int32_t) + n * 2 * sizeof(gfarm_uint64_t),
+		    gfs_client_fhremove_batch_send, &batch);
+		for (i = 0; i < n; i++)
+			errs[i] = e;
+	} else {
+		for (i = 0; i < n; i++) {
+			errs[i] = gfs_client_send_request(host, NULL, diag,
+			    gfs_client_fhremove_result,
+			    gfs_client_fhremove_free, dfcs[i],
+			    GFS_PROTO_FHREMOVE, "ll",
+			    dead_file_copy_get_ino(dfcs[i]),
+			    dead_file_copy_get_gen(dfcs[i]));
+		}
+	}
+
+	/*
+	 * netsendq doesn't finalize an entry until it is marked as sent,
+	 * so dfcs[] is still valid here, even if the result has arrived.
+	 * dfcs[] was collected before sending, because the result callback
+	 * may remove the entries, see netsendq_entry_batch_next().
+	 */
+	for (i = 0; i < n; i++) {
+		netsendq_entry_was_sent(
+		    abstract_host_get_sendq(dfcs[i]->qentry.abhost),
+		    &dfcs[i]->qentry);
 
-	if (e != GFARM_ERR_NO_ERROR) {
 		/* accessing dfc is only allowed if e != GFARM_ERR_NO_ERROR */
-		if (e == GFARM_ERR_DEVICE_BUSY) {
+		if (errs[i] == GFARM_ERR_NO_ERROR)
+			continue;
+		if (errs[i] == GFARM_ERR_DEVICE_BUSY) {
 			gflog_info(GFARM_MSG_1002284,
 			    "%s(%lld, %lld, %s): "
 			    "busy, shouldn't happen", diag,
-			    (long long)dead_file_copy_get_ino(dfc),
-			    (long long)dead_file_copy_get_gen(dfc),
-			    host_name(dead_file_copy_get_host(dfc)));
+			    (long long)dead_file_copy_get_ino(dfcs[i]),
+			    (long long)dead_file_copy_get_gen(dfcs[i]),
+			    host_name(host));
 		}
-		removal_finishedq_enqueue(dfc, e);
+		removal_finishedq_enqueue(dfcs[i], errs[i]);
 	}
 
 	/* this return value won't be used, because this thread is detached */
 	return (NULL);
 }
 
+static int
+gfs_client_fhremove_batchable(struct abstract_host *abhost)
+{
+	return (host_supports_fhremove_batch(abstract_host_to_host(abhost)));
+}
+
 struct netsendq_type gfs_proto_fhremove_queue = {
 	gfs_client_fhremove_request,
 	handle_removal_result,
 	0, /* will be initialized by gfs_proto_fhremove_request_window */
 	NETSENDQ_FLAG_QUEUEABLE_IF_DOWN,
-	NETSENDQ_TYPE_GFS_PROTO_FHREMOVE
+	NETSENDQ_TYPE_GFS_PROTO_FHREMOVE,
+	GFS_PROTO_FHREMOVE_BATCH_MAX,
+	gfs_client_fhremove_batchable
 };
 
 /*
@@ -503,7 +652,7 @@ dead_file_copy_alloc(gfarm_ino_t inum, gfarm_uint64_t igen, struct host *host)
 	struct dead_file_copy *dfc;
 	static const char diag[] = "dead_file_copy_alloc";
 
-	GFARM_MALLOC(dfc);
+	dfc = slab_alloc(&dead_file_copy_slab);
 	if (dfc == NULL) {
 		gflog_debug(GFARM_MSG_1002228,
 		    "%s(%lld, %lld, %s): no memory", diag,
@@ -657,7 +806,7 @@ dead_file_copy_free(struct dead_file_copy *dfc)
 	    abstract_host_to_host(dfc->qentry.abhost));
 
 	netsendq_entry_destroy(&dfc->qentry);
-	free(dfc);
+	slab_free(&dead_file_copy_slab, dfc);
 }
 
 /* The memory owner of `hostname' is changed to dead_file_copy.c */
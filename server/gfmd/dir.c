@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -8,6 +9,7 @@
 #include <gfarm/gfs.h> /* gfarm_off_t */
 
 #include "dir.h"
+#include "slab.h"
 
 /*
  * this implementation uses red-black tree
@@ -30,7 +32,17 @@ struct rbdir_entry {
 	struct inode *inode;
 };
 
-RB_HEAD(rbdir, rbdir_entry);
+RB_HEAD(rbdir_tree, rbdir_entry);
+
+struct rbdir {
+	struct rbdir_tree tree;
+
+	/* the entry of this directory in its parent, see inode.c */
+	DirEntry name_entry;
+};
+
+static struct slab rbdir_entry_slab =
+	SLAB_INITIALIZER("rbdir_entry", sizeof(struct rbdir_entry));
 
 static int
 rbdir_compare(DirEntry a, DirEntry b)
@@ -63,8 +75,8 @@ rbdir_augment(DirEntry entry)
 	entry->nentries = rbdir_node_count(entry);
 }
 
-RB_PROTOTYPE(rbdir, rbdir_entry, node, rbdir_compare)
-RB_GENERATE(rbdir, rbdir_entry, node, rbdir_compare)
+RB_PROTOTYPE(rbdir_tree, rbdir_entry, node, rbdir_compare)
+RB_GENERATE(rbdir_tree, rbdir_entry, node, rbdir_compare)
 
 static DirEntry
 rbdir_entry_prev(DirEntry entry)
@@ -97,7 +109,7 @@ static void
 rbdir_entry_free(struct rbdir_entry *entry)
 {
 	free(entry->key);
-	free(entry);
+	slab_free(&rbdir_entry_slab, entry);
 }
 
 static int
@@ -107,7 +119,9 @@ rbdir_entry_delete(Dir dir, DirEntry entry)
 	DirEntry parent = RB_PARENT(entry, node);
 	DirEntry prev = rbdir_entry_prev(entry);
 
-	deleted = RB_REMOVE(rbdir, dir, entry);
+	if (entry->inode != NULL)
+		inode_dir_entry_detached(entry->inode, entry);
+	deleted = RB_REMOVE(rbdir_tree, &dir->tree, entry);
 	if (prev != NULL)
 		rbdir_fixup(prev);
 	if (parent != NULL)
@@ -130,7 +144,8 @@ dir_alloc(void)
 			"allocation of 'Dir' failed");
 		return (NULL);
 	}
-	RB_INIT(dir);
+	RB_INIT(&dir->tree);
+	dir->name_entry = NULL;
 	return (dir);
 }
 
@@ -139,7 +154,7 @@ dir_free(Dir dir)
 {
 	DirEntry entry;
 
-	while ((entry = RB_MIN(rbdir, dir)) != NULL)
+	while ((entry = RB_MIN(rbdir_tree, &dir->tree)) != NULL)
 		rbdir_entry_delete(dir, entry);
 	free(dir);
 }
@@ -148,14 +163,14 @@ dir_free(Dir dir)
 int
 dir_is_empty(Dir dir)
 {
-	return (RB_ROOT(dir) == NULL);
+	return (RB_ROOT(&dir->tree) == NULL);
 }
 #endif
 
 gfarm_off_t
 dir_get_entry_count(Dir dir)
 {
-	DirEntry root = RB_ROOT(dir);
+	DirEntry root = RB_ROOT(&dir->tree);
 
 	if (root == NULL)
 		return (0);
@@ -169,7 +184,7 @@ dir_enter(Dir dir, const char *name, int namelen, int *createdp)
 	DirEntry found;
 	DirEntry prev;
 
-	GFARM_MALLOC(entry);
+	entry = slab_alloc(&rbdir_entry_slab);
 	if (entry == NULL) {
 		gflog_debug(GFARM_MSG_1001709,
 			"allocation of 'DirEntry' failed");
@@ -178,7 +193,7 @@ dir_enter(Dir dir, const char *name, int namelen, int *createdp)
 	entry->keylen = namelen;
 	GFARM_MALLOC_ARRAY(entry->key, namelen);
 	if (entry->key == NULL) {
-		free(entry);
+		slab_free(&rbdir_entry_slab, entry);
 		gflog_debug(GFARM_MSG_1001710,
 			"allocation of 'DirEntry.key' failed");
 		return (NULL); /* no memory */
@@ -186,7 +201,7 @@ dir_enter(Dir dir, const char *name, int namelen, int *createdp)
 	memcpy(entry->key, name, namelen);
 	entry->nentries = 1; /* leaf */
 
-	found = RB_INSERT(rbdir, dir, entry);
+	found = RB_INSERT(rbdir_tree, &dir->tree, entry);
 	if (found != NULL) {
 		rbdir_entry_free(entry);
 		*createdp = 0;
@@ -213,7 +228,7 @@ dir_lookup(Dir dir, const char *name, int namelen)
 
 	entry.keylen = namelen;
 	entry.key = (char *)name;
-	return (RB_FIND(rbdir, dir, &entry));
+	return (RB_FIND(rbdir_tree, &dir->tree, &entry));
 }
 
 int
@@ -235,6 +250,7 @@ dir_entry_set_inode(DirEntry entry, struct inode *inode)
 	assert(entry->inode == NULL);
 
 	entry->inode = inode;
+	inode_dir_entry_attached(inode, entry);
 }
 
 struct inode *
@@ -244,6 +260,19 @@ dir_entry_get_inode(DirEntry entry)
 	return (entry->inode);
 }
 
+/* NULL, if unknown */
+DirEntry
+dir_get_name_entry(Dir dir)
+{
+	return (dir->name_entry);
+}
+
+void
+dir_set_name_entry(Dir dir, DirEntry entry)
+{
+	dir->name_entry = entry;
+}
+
 char *
 dir_entry_get_name(DirEntry entry, int *namelenp)
 {
@@ -263,12 +292,37 @@ dir_cursor_lookup(Dir dir, const char *name, int namelen, DirCursor *cursor)
 	return (0);
 }
 
+/* the first entry whose name is greater than `name', which may not exist */
+int
+dir_cursor_lookup_next(Dir dir, const char *name, int namelen,
+	DirCursor *cursor)
+{
+	struct rbdir_entry key;
+	DirEntry entry = RB_ROOT(&dir->tree), next = NULL;
+
+	key.keylen = namelen;
+	key.key = (char *)name;
+	while (entry != NULL) {
+		if (rbdir_compare(&key, entry) < 0) {
+			next = entry;
+			entry = RB_LEFT(entry, node);
+		} else {
+			entry = RB_RIGHT(entry, node);
+		}
+	}
+	if (next != NULL) {
+		*cursor = next;
+		return (1);
+	}
+	return (0);
+}
+
 int
 dir_cursor_next(Dir dir, DirCursor *cursor)
 {
 	if (*cursor == NULL)
 		return (0); /* end of directory */
-	*cursor = RB_NEXT(rbdir, dir, *cursor);
+	*cursor = RB_NEXT(rbdir_tree, &dir->tree, *cursor);
 	if (*cursor == NULL)
 		return (0); /* end of directory */
 	return (1); /* ok */
@@ -281,7 +335,7 @@ dir_cursor_remove_entry(Dir dir, DirCursor *cursor)
 
 	if (entry == NULL)
 		return (0); /* end of directory */
-	*cursor = RB_NEXT(rbdir, dir, entry);
+	*cursor = RB_NEXT(rbdir_tree, &dir->tree, entry);
 	rbdir_entry_delete(dir, entry);
 	return (*cursor != NULL); /* is there still any entry? */
 }
@@ -289,7 +343,7 @@ dir_cursor_remove_entry(Dir dir, DirCursor *cursor)
 int
 dir_cursor_set_pos(Dir dir, gfarm_off_t nth, DirCursor *cursor)
 {
-	DirEntry entry = RB_ROOT(dir);
+	DirEntry entry = RB_ROOT(&dir->tree);
 	gfarm_off_t index;
 
 	while (entry != NULL) {
@@ -312,7 +366,7 @@ gfarm_off_t
 dir_cursor_get_pos(Dir dir, DirCursor *cursor)
 {
 	DirEntry key = *cursor;
-	DirEntry entry = RB_ROOT(dir);
+	DirEntry entry = RB_ROOT(&dir->tree);
 	int cmp;
 	gfarm_off_t delta, index = 0;
 
@@ -32,7 +32,11 @@ void dir_entry_set_inode(DirEntry, struct inode *);
 struct inode *dir_entry_get_inode(DirEntry);
 char *dir_entry_get_name(DirEntry, int *);
 
+DirEntry dir_get_name_entry(Dir);
+void dir_set_name_entry(Dir, DirEntry);
+
 int dir_cursor_lookup(Dir, const char *, int, DirCursor *);
+int dir_cursor_lookup_next(Dir, const char *, int, DirCursor *);
 int dir_cursor_next(Dir, DirCursor *);
 int dir_cursor_remove_entry(Dir, DirCursor *);
 int dir_cursor_set_pos(Dir, gfarm_off_t, DirCursor *);
@@ -40,6 +44,8 @@ gfarm_off_t dir_cursor_get_pos(Dir, DirCursor *);
 DirEntry dir_cursor_get_entry(Dir, DirCursor *);
 gfarm_error_t dir_cursor_get_name_and_inode(Dir, DirCursor *,
 	char **, struct inode **);
+gfarm_error_t dir_get_entry_after(Dir, const char *,
+	char **, struct inode **);
 
 /*
  * the following should belong to inode.h, really.
@@ -47,3 +53,7 @@ gfarm_error_t dir_cursor_get_name_and_inode(Dir, DirCursor *,
  * in *.c files which need inode.h, but don't really need dir.h.
  */
 Dir inode_get_dir(struct inode *);
+
+/* called by dir.c, when `entry' starts or stops referring to the inode */
+void inode_dir_entry_attached(struct inode *, DirEntry);
+void inode_dir_entry_detached(struct inode *, DirEntry);
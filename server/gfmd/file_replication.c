@@ -3,10 +3,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include <gfarm/gfarm.h>
 
 #include "queue.h"
+#include "gfutil.h"
+#include "nanosec.h"
 #include "thrsubr.h"
 
 #include "context.h"
@@ -59,14 +62,366 @@ struct file_replication {
 	gfarm_int64_t handle; /* pid of destination side worker */
 	gfarm_off_t filesize;
 	struct gfarm_thr_statewait *statewait;
+
+	/* see replication shaper */
+	GFARM_STAILQ_ENTRY(file_replication) shaper_entries;
+	int shaper_state;
+	gfarm_off_t shaper_size;
 };
 
+/* struct file_replication::shaper_state */
+#define SHAPER_NOT_STARTED	0
+#define SHAPER_QUEUED		1	/* on replication_shaper_host::queue */
+#define SHAPER_ACTIVE		2	/* added to netsendq */
+
 struct inode_replication_state {
 	GFARM_HCIRCLEQ_HEAD(file_replication) same_inode_list;
 };
 
 static int outstanding_file_replications = 0;
 
+/*
+ * replication shaper
+ *
+ * file_replication_start() doesn't send GFS_PROTO_REPLICATION_REQUEST
+ * immediately, but queues it to the destination host.
+ * the shaper dispatches the queued replications to netsendq
+ * round-robin over the destination hosts, within the following limits:
+ * - gfs_proto_replication_request_window per destination
+ * - file_replication_source_limit per source
+ * - file_replication_total_limit in total.
+ *   the effective limit (shaper.window) is adapted to the throughput.
+ * - file_replication_bandwidth_limit bytes/sec. in total, by token bucket
+ * - file_replication_host_bandwidth_limit bytes/sec. for each host,
+ *   by two token buckets for the host as the source and the destination.
+ *
+ * all of them are protected by the giant_lock()
+ */
+struct replication_shaper_host {
+	/* linked to shaper.hosts, if n_queued > 0 */
+	GFARM_HCIRCLEQ_ENTRY(replication_shaper_host) shaper_hosts;
+	/* as the destination */
+	GFARM_STAILQ_HEAD(replication_shaper_queue, file_replication) queue;
+	struct host *host;
+	int n_queued, n_active_src, n_active_dst;
+
+	/* bytes, see host_bandwidth_limit */
+	double tokens_src, tokens_dst;
+	struct timeval refilled;
+};
+
+#define SHAPER_TICK		(100 * GFARM_MILLISEC_BY_NANOSEC)
+#define SHAPER_ADJUST_TICKS	100	/* adapt the window every 10 sec. */
+
+static struct replication_shaper {
+	GFARM_HCIRCLEQ_HEAD(replication_shaper_host) hosts;
+	int n_queued, n_active;
+
+	int window;		/* effective file_replication_total_limit */
+	double tokens;		/* bytes, see bandwidth_limit */
+	struct timeval refilled;
+
+	/* statistics to adapt the window */
+	gfarm_off_t bytes_done;
+	int n_done, n_failed, window_was_full;
+	double last_rate;	/* bytes/sec */
+} shaper;
+
+static struct replication_shaper_host *
+replication_shaper_host_get(struct host *host)
+{
+	struct replication_shaper_host *sh = host_get_replication_shaper(host);
+
+	if (sh != NULL)
+		return (sh);
+	GFARM_MALLOC(sh);
+	if (sh == NULL)
+		return (NULL);
+	GFARM_STAILQ_INIT(&sh->queue);
+	sh->host = host;
+	sh->n_queued = sh->n_active_src = sh->n_active_dst = 0;
+	sh->tokens_src = sh->tokens_dst =
+	    gfarm_file_replication_host_bandwidth_limit;
+	gettimeofday(&sh->refilled, NULL);
+	host_set_replication_shaper(host, sh);
+	return (sh);
+}
+
+/* returns the seconds elapsed since `*refilled', and updates it */
+static double
+replication_shaper_elapsed(struct timeval *refilled, struct timeval *now)
+{
+	struct timeval elapsed = *now;
+
+	gfarm_timeval_sub(&elapsed, refilled);
+	*refilled = *now;
+	return (elapsed.tv_sec +
+	    (double)elapsed.tv_usec / GFARM_SECOND_BY_MICROSEC);
+}
+
+static void
+replication_shaper_bucket_refill(double *tokens, double rate, double elapsed)
+{
+	*tokens += rate * elapsed;
+	if (*tokens > rate) /* allow burst of 1 second */
+		*tokens = rate;
+}
+
+static void
+replication_shaper_refill(struct timeval *now)
+{
+	if (gfarm_file_replication_bandwidth_limit <= 0)
+		return;
+	replication_shaper_bucket_refill(&shaper.tokens,
+	    gfarm_file_replication_bandwidth_limit,
+	    replication_shaper_elapsed(&shaper.refilled, now));
+}
+
+static void
+replication_shaper_host_refill(struct replication_shaper_host *sh,
+	struct timeval *now)
+{
+	double rate = gfarm_file_replication_host_bandwidth_limit, elapsed;
+
+	if (rate <= 0)
+		return;
+	elapsed = replication_shaper_elapsed(&sh->refilled, now);
+	replication_shaper_bucket_refill(&sh->tokens_src, rate, elapsed);
+	replication_shaper_bucket_refill(&sh->tokens_dst, rate, elapsed);
+}
+
+static int
+replication_shaper_is_full(void)
+{
+	if (gfarm_file_replication_total_limit > 0 &&
+	    shaper.n_active >= shaper.window)
+		return (1);
+	/* the last one may exceed the budget, it's paid back later */
+	if (gfarm_file_replication_bandwidth_limit > 0 && shaper.tokens <= 0)
+		return (1);
+	return (0);
+}
+
+/* PREREQUISITE: giant_lock */
+static void
+replication_shaper_activate(struct replication_shaper_host *dsh,
+	struct file_replication *fr)
+{
+	struct replication_shaper_host *ssh = host_get_replication_shaper(
+	    fr->src);
+
+	GFARM_STAILQ_REMOVE_HEAD(&dsh->queue, shaper_entries);
+	if (--dsh->n_queued == 0)
+		GFARM_HCIRCLEQ_REMOVE(dsh, shaper_hosts);
+	shaper.n_queued--;
+
+	fr->shaper_state = SHAPER_ACTIVE;
+	dsh->n_active_dst++;
+	ssh->n_active_src++;
+	shaper.n_active++;
+	shaper.tokens -= fr->shaper_size;
+	dsh->tokens_dst -= fr->shaper_size;
+	ssh->tokens_src -= fr->shaper_size;
+
+	/*
+	 * we don't have to check the result, because of
+	 * NETSENDQ_ADD_FLAG_DETACH_ERROR_HANDLING
+	 */
+	(void)netsendq_add_entry(
+	    abstract_host_get_sendq(fr->qentry.abhost), &fr->qentry,
+	    NETSENDQ_ADD_FLAG_DETACH_ERROR_HANDLING);
+}
+
+/* PREREQUISITE: giant_lock */
+static void
+replication_shaper_dispatch(void)
+{
+	struct replication_shaper_host *dsh, *next, *ssh;
+	struct file_replication *fr;
+	struct timeval now;
+	int dispatched;
+	int host_limited = gfarm_file_replication_host_bandwidth_limit > 0;
+
+	gettimeofday(&now, NULL);
+	replication_shaper_refill(&now);
+	do {
+		dispatched = 0;
+		/* one replication for each destination at a time */
+		GFARM_HCIRCLEQ_FOREACH_SAFE(dsh, shaper.hosts, shaper_hosts,
+		    next) {
+			if (replication_shaper_is_full()) {
+				shaper.window_was_full = 1;
+				return;
+			}
+			if (dsh->n_active_dst >=
+			    gfs_proto_replication_request_window)
+				continue;
+			/* the last one may exceed the budget, as in total */
+			if (host_limited) {
+				replication_shaper_host_refill(dsh, &now);
+				if (dsh->tokens_dst <= 0)
+					continue;
+			}
+			fr = GFARM_STAILQ_FIRST(&dsh->queue);
+			ssh = host_get_replication_shaper(fr->src);
+			if (gfarm_file_replication_source_limit > 0 &&
+			    ssh->n_active_src >=
+			    gfarm_file_replication_source_limit)
+				continue;
+			if (host_limited) {
+				replication_shaper_host_refill(ssh, &now);
+				if (ssh->tokens_src <= 0)
+					continue;
+			}
+			replication_shaper_activate(dsh, fr);
+			dispatched = 1;
+		}
+	} while (dispatched);
+}
+
+/* PREREQUISITE: giant_lock */
+static gfarm_error_t
+replication_shaper_enqueue(struct file_replication *fr)
+{
+	struct replication_shaper_host *dsh, *ssh;
+
+	dsh = replication_shaper_host_get(file_replication_get_dst(fr));
+	ssh = replication_shaper_host_get(fr->src);
+	if (dsh == NULL || ssh == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+
+	fr->shaper_state = SHAPER_QUEUED;
+	fr->shaper_size = inode_get_size(fr->inode);
+	GFARM_STAILQ_INSERT_TAIL(&dsh->queue, fr, shaper_entries);
+	if (dsh->n_queued++ == 0)
+		GFARM_HCIRCLEQ_INSERT_TAIL(shaper.hosts, dsh, shaper_hosts);
+	shaper.n_queued++;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* PREREQUISITE: giant_lock */
+static void
+replication_shaper_done(struct file_replication *fr)
+{
+	struct replication_shaper_host *dsh =
+	    host_get_replication_shaper(file_replication_get_dst(fr));
+	struct replication_shaper_host *ssh =
+	    host_get_replication_shaper(fr->src);
+
+	switch (fr->shaper_state) {
+	case SHAPER_NOT_STARTED:
+		return;
+	case SHAPER_QUEUED:
+		GFARM_STAILQ_REMOVE(&dsh->queue, fr, file_replication,
+		    shaper_entries);
+		shaper.n_queued--;
+		if (--dsh->n_queued == 0)
+			GFARM_HCIRCLEQ_REMOVE(dsh, shaper_hosts);
+		return;
+	case SHAPER_ACTIVE:
+		dsh->n_active_dst--;
+		ssh->n_active_src--;
+		shaper.n_active--;
+		if (fr->qentry.result == GFARM_ERR_NO_ERROR &&
+		    fr->src_errcode == GFARM_ERR_NO_ERROR) {
+			shaper.n_done++;
+			shaper.bytes_done += fr->shaper_size;
+		} else
+			shaper.n_failed++;
+		replication_shaper_dispatch();
+		return;
+	}
+}
+
+/*
+ * adapt the window to the throughput, like AIMD of TCP.
+ * if more replications fail than succeed, the network or filesystem
+ * nodes are overloaded.  otherwise, try to widen the window if it was
+ * full, as long as the throughput doesn't drop.
+ *
+ * PREREQUISITE: giant_lock
+ */
+static void
+replication_shaper_adjust(double interval)
+{
+	double rate = shaper.bytes_done / interval;
+	int limit = gfarm_file_replication_total_limit;
+
+	if (limit <= 0) {
+		;
+	} else if (shaper.n_failed > shaper.n_done) {
+		if (shaper.window > 1)
+			shaper.window /= 2;
+	} else if (shaper.window_was_full) {
+		if (rate >= shaper.last_rate) {
+			if (shaper.window < limit)
+				shaper.window++;
+		} else if (shaper.window > 1)
+			shaper.window--;
+	}
+	shaper.last_rate = rate;
+	shaper.bytes_done = 0;
+	shaper.n_done = shaper.n_failed = shaper.window_was_full = 0;
+}
+
+static void *
+replication_shaper_thread(void *arg)
+{
+	int ticks = 0;
+
+	for (;;) {
+		gfarm_nanosleep(SHAPER_TICK);
+		giant_lock();
+		if (shaper.n_queued > 0)
+			replication_shaper_dispatch();
+		if (++ticks >= SHAPER_ADJUST_TICKS) {
+			replication_shaper_adjust((double)ticks * SHAPER_TICK /
+			    GFARM_SECOND_BY_NANOSEC);
+			ticks = 0;
+		}
+		giant_unlock();
+	}
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+/* report queued and active replications, called by SIGUSR2 */
+void
+file_replication_info(void)
+{
+	gfarm_error_t e;
+	int i, nhosts;
+	struct host **hosts;
+	struct replication_shaper_host *sh;
+
+	giant_lock();
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "replication: queued=%d, active=%d, window=%d, "
+	    "throughput=%.0f bytes/sec.",
+	    shaper.n_queued, shaper.n_active,
+	    gfarm_file_replication_total_limit > 0 ? shaper.window : -1,
+	    shaper.last_rate);
+	e = host_array_alloc(&nhosts, &hosts);
+	if (e != GFARM_ERR_NO_ERROR) {
+		giant_unlock();
+		gflog_info(GFARM_MSG_UNFIXED, "replication: %s",
+		    gfarm_error_string(e));
+		return;
+	}
+	for (i = 0; i < nhosts; i++) {
+		sh = host_get_replication_shaper(hosts[i]);
+		if (sh == NULL || (sh->n_queued == 0 &&
+		    sh->n_active_src == 0 && sh->n_active_dst == 0))
+			continue;
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "replication %s: queued=%d, active src=%d, dst=%d",
+		    host_name(hosts[i]), sh->n_queued,
+		    sh->n_active_src, sh->n_active_dst);
+	}
+	giant_unlock();
+	free(hosts);
+}
+
 struct host *
 file_replication_get_dst(struct file_replication *fr)
 {
@@ -140,11 +495,15 @@ file_replication_new(struct inode *inode, gfarm_uint64_t gen,
 	fr->src = src;
 	fr->cleanup = deferred_cleanup;
 	fr->queued = 0;
+	fr->src_errcode = GFARM_ERR_NO_ERROR;
 	fr->handle = -1;
 	fr->filesize = -1;
 	fr->statewait = NULL;
+	fr->shaper_state = SHAPER_NOT_STARTED;
 
 	++outstanding_file_replications;
+	host_replications_add(src, 1);
+	host_replications_add(dst, 1);
 
 	*frp = fr;
 	return (GFARM_ERR_NO_ERROR);
@@ -157,6 +516,9 @@ file_replication_free(struct file_replication *fr,
 	struct inode_replication_state *irs = *rstatep;
 
 	--outstanding_file_replications;
+	host_replications_add(fr->src, -1);
+	host_replications_add(file_replication_get_dst(fr), -1);
+	replication_shaper_done(fr);
 
 	GFARM_HCIRCLEQ_REMOVE(fr, replications);
 	if (GFARM_HCIRCLEQ_EMPTY(irs->same_inode_list, replications)) {
@@ -191,17 +553,19 @@ file_replication_start(struct inode_replication_state *rstate,
 	GFARM_HCIRCLEQ_FOREACH(fr, rstate->same_inode_list, replications) {
 		if (fr->igen <= gen && !fr->queued) {
 			fr->queued = 1;
+			if (replication_shaper_enqueue(fr) ==
+			    GFARM_ERR_NO_ERROR)
+				continue;
 
-			/*
-			 * we don't have to check the result, because of
-			 * NETSENDQ_ADD_FLAG_DETACH_ERROR_HANDLING
-			 */
+			/* no memory for the shaper, send it immediately */
+			fr->shaper_state = SHAPER_NOT_STARTED;
 			(void)netsendq_add_entry(
 			    abstract_host_get_sendq(fr->qentry.abhost),
 			    &fr->qentry,
 			    NETSENDQ_ADD_FLAG_DETACH_ERROR_HANDLING);
 		}
 	}
+	replication_shaper_dispatch();
 }
 
 void
@@ -488,6 +852,24 @@ struct netsendq_type gfs_proto_replication_request_queue = {
 void
 file_replication_init(void)
 {
+	gfarm_error_t e;
+
 	gfs_proto_replication_request_queue.window_size =
 	    gfs_proto_replication_request_window;
+
+	GFARM_HCIRCLEQ_INIT(shaper.hosts, shaper_hosts);
+	shaper.window = gfarm_file_replication_total_limit;
+	gettimeofday(&shaper.refilled, NULL);
+	shaper.tokens = gfarm_file_replication_bandwidth_limit;
+
+	/* the thread is only necessary to adapt the window or to refill */
+	if (gfarm_file_replication_total_limit <= 0 &&
+	    gfarm_file_replication_bandwidth_limit <= 0 &&
+	    gfarm_file_replication_host_bandwidth_limit <= 0)
+		return;
+	if ((e = create_detached_thread(replication_shaper_thread, NULL))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "create_detached_thread(replication_shaper): %s",
+		    gfarm_error_string(e));
 }
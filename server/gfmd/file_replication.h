@@ -28,6 +28,7 @@ void file_replication_free(struct file_replication *,
 	struct inode_replication_state **);
 
 void file_replication_init(void);
+void file_replication_info(void);
 
 struct netsendq_type;
 extern struct netsendq_type gfs_proto_replication_request_queue;
@@ -2232,6 +2232,323 @@ gfm_server_remove(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	return (e2);
 }
 
+/*
+ * GFM_PROTO_REMOVE_RECURSIVE removes a directory tree in batches.
+ * each batch is done in one transaction with giant_lock held,
+ * and giant_lock is released between batches to let other RPCs proceed.
+ * an RPC returns with done == 0, if it removed `limit' entries or it took
+ * REMOVE_RECURSIVE_TIME_LIMIT seconds, then the client calls it again.
+ */
+#define REMOVE_RECURSIVE_BATCH		1000	/* entries per transaction */
+#define REMOVE_RECURSIVE_LIMIT_DEFAULT	100000	/* entries per RPC */
+#define REMOVE_RECURSIVE_TIME_LIMIT	10	/* seconds per RPC */
+
+/* a directory which is being removed */
+struct remove_recursive_frame {
+	struct remove_recursive_frame *parent;
+	gfarm_ino_t inum;
+	gfarm_uint64_t igen;
+	char *name;	/* name in the parent directory */
+	char *resume;	/* last entry which couldn't be removed */
+};
+
+struct remove_recursive_state {
+	struct remove_recursive_frame *top;
+	int done;
+	gfarm_error_t first_error;
+	gfarm_uint64_t nfiles, ndirs;
+};
+
+static void
+remove_recursive_record_error(struct remove_recursive_state *rr,
+	gfarm_error_t e)
+{
+	if (rr->first_error == GFARM_ERR_NO_ERROR)
+		rr->first_error = e;
+}
+
+static gfarm_error_t
+remove_recursive_push(struct remove_recursive_state *rr,
+	struct inode *dir, char *name)
+{
+	struct remove_recursive_frame *f;
+
+	GFARM_MALLOC(f);
+	if (f == NULL) {
+		free(name);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	f->parent = rr->top;
+	f->inum = inode_get_number(dir);
+	f->igen = inode_get_gen(dir);
+	f->name = name;
+	f->resume = NULL;
+	rr->top = f;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static void
+remove_recursive_free(struct remove_recursive_state *rr)
+{
+	struct remove_recursive_frame *f;
+
+	while ((f = rr->top) != NULL) {
+		rr->top = f->parent;
+		free(f->name);
+		free(f->resume);
+		free(f);
+	}
+}
+
+/*
+ * giant_lock may have been released since the frame is pushed,
+ * thus the directory may be removed or replaced by others.
+ *
+ * PREREQUISITE: giant_lock
+ */
+static struct inode *
+remove_recursive_frame_dir(struct remove_recursive_frame *f,
+	struct inode *base)
+{
+	struct inode *dir;
+
+	if (f == NULL)
+		return (base);
+	dir = inode_lookup(f->inum);
+	if (dir == NULL || inode_get_gen(dir) != f->igen ||
+	    !inode_is_dir(dir))
+		return (NULL);
+	return (dir);
+}
+
+/*
+ * `name' is freed, or moved to *resumep if it cannot be removed.
+ *
+ * PREREQUISITE: giant_lock, db_begin()
+ */
+static void
+remove_recursive_unlink(struct remove_recursive_state *rr,
+	struct inode *dir, char *name, int is_dir, struct process *process,
+	char **resumep)
+{
+	gfarm_error_t e;
+	int hlink_removed = 0;
+
+	e = inode_unlink(dir, name, process, NULL, &hlink_removed);
+	if (e == GFARM_ERR_NO_ERROR) {
+		if (is_dir)
+			rr->ndirs++;
+		else
+			rr->nfiles++;
+		free(name);
+		return;
+	}
+	gflog_debug(GFARM_MSG_UNFIXED,
+	    "remove_recursive: %s: %s", name, gfarm_error_string(e));
+	remove_recursive_record_error(rr, e);
+	if (resumep == NULL) {
+		free(name);
+	} else { /* skip this entry from now on */
+		free(*resumep);
+		*resumep = name;
+	}
+}
+
+/*
+ * removes at most REMOVE_RECURSIVE_BATCH entries in depth-first order.
+ *
+ * PREREQUISITE: giant_lock, db_begin()
+ */
+static gfarm_error_t
+remove_recursive_batch(struct remove_recursive_state *rr,
+	struct inode *base, struct process *process)
+{
+	gfarm_error_t e;
+	struct remove_recursive_frame *f;
+	struct inode *dir, *parent, *inode;
+	struct user *user = process_get_user(process);
+	char *name;
+	int n;
+
+	for (n = 0; n < REMOVE_RECURSIVE_BATCH; n++) {
+		if ((f = rr->top) == NULL) {
+			rr->done = 1;
+			break;
+		}
+		if ((dir = remove_recursive_frame_dir(f, base)) == NULL) {
+			/* removed or replaced by others, leave it alone */
+			rr->top = f->parent;
+			free(f->name);
+			free(f->resume);
+			free(f);
+			continue;
+		}
+		if ((e = dir_get_entry_after(inode_get_dir(dir), f->resume,
+		    &name, &inode)) != GFARM_ERR_NO_ERROR)
+			return (e);
+		if (name == NULL) {
+			/* all entries are visited, remove the directory */
+			rr->top = f->parent;
+			parent = remove_recursive_frame_dir(f->parent, base);
+			if (parent != NULL)
+				remove_recursive_unlink(rr, parent, f->name, 1,
+				    process, rr->top == NULL ? NULL :
+				    &rr->top->resume);
+			else
+				free(f->name);
+			free(f->resume);
+			free(f);
+			continue;
+		}
+		if (!inode_is_dir(inode) ||
+		    dir_is_empty(inode_get_dir(inode))) {
+			remove_recursive_unlink(rr, dir, name,
+			    inode_is_dir(inode), process, &f->resume);
+		} else if ((e = inode_access(inode, user,
+		    GFS_R_OK|GFS_X_OK)) != GFARM_ERR_NO_ERROR) {
+			remove_recursive_record_error(rr, e);
+			free(f->resume);
+			f->resume = name;
+		} else if ((e = remove_recursive_push(rr, inode, name)) !=
+		    GFARM_ERR_NO_ERROR) {
+			return (e);
+		}
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* PREREQUISITE: giant_lock, db_begin() */
+static gfarm_error_t
+remove_recursive_start(struct remove_recursive_state *rr,
+	struct inode *base, char *name, struct process *process)
+{
+	gfarm_error_t e;
+	struct inode *inode;
+	char *s;
+
+	if (strcmp(name, dot) == 0 || strcmp(name, dotdot) == 0)
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	if ((e = inode_lookup_by_name(base, name, process, 0, &inode)) !=
+	    GFARM_ERR_NO_ERROR)
+		return (e);
+	if (inode_is_dir(inode) && (e = inode_access(inode,
+	    process_get_user(process), GFS_R_OK|GFS_X_OK)) !=
+	    GFARM_ERR_NO_ERROR)
+		return (e);
+	if ((s = strdup(name)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	if (!inode_is_dir(inode)) {
+		remove_recursive_unlink(rr, base, s, 0, process, NULL);
+		rr->done = 1;
+		return (GFARM_ERR_NO_ERROR);
+	}
+	return (remove_recursive_push(rr, inode, s));
+}
+
+gfarm_error_t
+gfm_server_remove_recursive(struct peer *peer, gfp_xdr_xid_t xid,
+	size_t *sizep, int from_client, int skip)
+{
+	gfarm_error_t e, e_rpc;
+	char *name;
+	gfarm_int32_t limit, done = 0, first_error = GFARM_ERR_NO_ERROR;
+	gfarm_uint64_t nfiles = 0, ndirs = 0;
+	struct process *process;
+	gfarm_int32_t cfd;
+	struct inode *base;
+	struct remove_recursive_state rr;
+	struct timeval start, now;
+	int nbatches = 0;
+	struct relayed_request *relay;
+	static const char diag[] = "GFM_PROTO_REMOVE_RECURSIVE";
+
+	e = gfm_server_relay_get_request(peer, sizep, skip, &relay, diag,
+	    GFM_PROTO_REMOVE_RECURSIVE, "si", &name, &limit);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (skip) {
+		free(name);
+		return (GFARM_ERR_NO_ERROR);
+	}
+
+	if (relay == NULL) {
+		/* do not relay RPC to master gfmd */
+		if (limit <= 0)
+			limit = REMOVE_RECURSIVE_LIMIT_DEFAULT;
+		rr.top = NULL;
+		rr.done = 0;
+		rr.first_error = GFARM_ERR_NO_ERROR;
+		rr.nfiles = rr.ndirs = 0;
+		gettimeofday(&start, NULL);
+		for (;;) {
+			giant_lock();
+
+			/* the process may be changed while giant_unlock */
+			if ((process = peer_get_process(peer)) == NULL) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "operation is not permitted: "
+				    "peer_get_process() failed");
+				e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+			} else if (process_get_user(process) == NULL) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "process_get_user() failed");
+				e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+			} else if ((e = peer_fdpair_get_current(peer, &cfd)) !=
+			    GFARM_ERR_NO_ERROR) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "peer_fdpair_get_current() failed: %s",
+				    gfarm_error_string(e));
+			} else if ((e = process_get_file_inode(process, cfd,
+			    &base)) != GFARM_ERR_NO_ERROR) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "process_get_file_inode() failed: %s",
+				    gfarm_error_string(e));
+			} else if ((e = db_begin(diag)) != GFARM_ERR_NO_ERROR) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "db_begin() failed: %s",
+				    gfarm_error_string(e));
+			} else {
+				/* one transaction per batch */
+				if (nbatches == 0)
+					e = remove_recursive_start(&rr, base,
+					    name, process);
+				if (e == GFARM_ERR_NO_ERROR && !rr.done)
+					e = remove_recursive_batch(&rr, base,
+					    process);
+				db_end(diag);
+			}
+
+			giant_unlock();
+			nbatches++;
+
+			if (e != GFARM_ERR_NO_ERROR || rr.done ||
+			    rr.nfiles + rr.ndirs >= limit)
+				break;
+			gettimeofday(&now, NULL);
+			if (now.tv_sec - start.tv_sec >=
+			    REMOVE_RECURSIVE_TIME_LIMIT)
+				break;
+		}
+		remove_recursive_free(&rr);
+		done = rr.done;
+		first_error = rr.first_error;
+		nfiles = rr.nfiles;
+		ndirs = rr.ndirs;
+		if (nbatches > 1)
+			gflog_info(GFARM_MSG_UNFIXED,
+			    "%s: %s: %llu files and %llu directories removed "
+			    "in %d batches%s", diag, name,
+			    (unsigned long long)nfiles,
+			    (unsigned long long)ndirs, nbatches,
+			    done ? "" : ", to be continued");
+	}
+
+	e_rpc = gfm_server_relay_put_reply(peer, xid, sizep, relay, diag,
+	    &e, "iill", &done, &first_error, &nfiles, &ndirs);
+	free(name);
+	return (e_rpc);
+}
+
 gfarm_error_t
 gfm_server_rename(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	int from_client, int skip)
@@ -2827,23 +3144,28 @@ fs_dir_get(struct peer *peer, int from_client,
 	} else if ((dir = inode_get_dir(inode)) == NULL) {
 		gflog_debug(GFARM_MSG_1001915, "inode_get_dir() failed");
 		return (GFARM_ERR_NOT_A_DIRECTORY);
-	} else if ((e = process_get_dir_key(process, peer, fd,
-		    &key, &keylen)) != GFARM_ERR_NO_ERROR) {
+	} else if (n <= 0) {
+		gflog_debug(GFARM_MSG_1001918,
+			"invalid argument");
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	}
+
+	/*
+	 * this may be running under shared giant_lock,
+	 * and the key may be replaced by fs_dir_remember_cursor()
+	 */
+	giant_shared_update_begin();
+	if ((e = process_get_dir_key(process, peer, fd,
+	    &key, &keylen)) != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1001916,
 			"process_get_dir_key() failed: %s",
 			gfarm_error_string(e));
-		return (e);
 	} else if (key == NULL &&
 		 (e = process_get_dir_offset(process, peer, fd,
 		    &dir_offset)) != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1001917,
 			"process_get_dir_offset() failed: %s",
 			gfarm_error_string(e));
-		return (e);
-	} else if (n <= 0) {
-		gflog_debug(GFARM_MSG_1001918,
-			"invalid argument");
-		return (GFARM_ERR_INVALID_ARGUMENT);
 	} else {
 		if (key != NULL)
 			ok = dir_cursor_lookup(dir, key, strlen(key), cursorp);
@@ -2853,24 +3175,30 @@ fs_dir_get(struct peer *peer, int from_client,
 			ok = dir_cursor_set_pos(dir, dir_offset, cursorp);
 		if (!ok)
 			n = 0; /* end of directory? */
+	}
+	giant_shared_update_end();
+	if (e == GFARM_ERR_NO_ERROR) {
 		*np = n;
 		*processp = process;
 		*fdp = fd;
 		*inodep = inode;
 		*dirp = dir;
 		/* *cursorp = *cursorp; */
-		return (GFARM_ERR_NO_ERROR);
 	}
+	return (e);
 }
 
-/* remember current position */
+/* remember current position, and update atime, if `accessed' */
 static void
 fs_dir_remember_cursor(struct peer *peer, struct process *process,
-	gfarm_int32_t fd, Dir dir, DirCursor *cursor, int eof)
+	gfarm_int32_t fd, struct inode *inode, Dir dir, DirCursor *cursor,
+	int eof, int accessed)
 {
 	DirEntry entry;
 	gfarm_off_t dir_offset;
 
+	/* this may be running under shared giant_lock */
+	giant_shared_update_begin();
 	if (eof || (entry = dir_cursor_get_entry(dir, cursor)) == NULL) {
 		process_clear_dir_key(process, peer, fd);
 		dir_offset = dir_get_entry_count(dir);
@@ -2882,6 +3210,9 @@ fs_dir_remember_cursor(struct peer *peer, struct process *process,
 		dir_offset = dir_cursor_get_pos(dir, cursor);
 	}
 	process_set_dir_offset(process, peer, fd, dir_offset);
+	if (accessed)
+		inode_accessed(inode);
+	giant_shared_update_end();
 }
 
 gfarm_error_t
@@ -2942,12 +3273,10 @@ gfm_server_getdirents(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 			if (!dir_cursor_next(dir, &cursor))
 				break;
 		}
-		if (e_rpc == GFARM_ERR_NO_ERROR) {
-			fs_dir_remember_cursor(peer, process, fd, dir,
-			    &cursor, n == 0);
-			if (i > 0) /* XXX is this check necessary? */
-				inode_accessed(inode);
-		}
+		if (e_rpc == GFARM_ERR_NO_ERROR)
+			/* XXX is the check of (i > 0) necessary? */
+			fs_dir_remember_cursor(peer, process, fd, inode, dir,
+			    &cursor, n == 0, i > 0);
 		n = i;
 	}
 
@@ -3048,12 +3377,10 @@ gfm_server_getdirentsplus(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 			if (!dir_cursor_next(dir, &cursor))
 				break;
 		}
-		if (e_rpc == GFARM_ERR_NO_ERROR) {
-			fs_dir_remember_cursor(peer, process, fd, dir,
-			    &cursor, n == 0);
-			if (i > 0) /* XXX is this check necessary? */
-				inode_accessed(inode);
-		}
+		if (e_rpc == GFARM_ERR_NO_ERROR)
+			/* XXX is the check of (i > 0) necessary? */
+			fs_dir_remember_cursor(peer, process, fd, inode, dir,
+			    &cursor, n == 0, i > 0);
 		n = i;
 	}
 
@@ -3179,12 +3506,10 @@ gfm_server_getdirentsplusxattr(struct peer *peer, gfp_xdr_xid_t xid,
 			if (!dir_cursor_next(dir, &cursor))
 				break;
 		}
-		if (e_rpc == GFARM_ERR_NO_ERROR) {
-			fs_dir_remember_cursor(peer, process, fd, dir,
-			    &cursor, n == 0);
-			if (i > 0) /* XXX is this check necessary? */
-				inode_accessed(inode);
-		}
+		if (e_rpc == GFARM_ERR_NO_ERROR)
+			/* XXX is the check of (i > 0) necessary? */
+			fs_dir_remember_cursor(peer, process, fd, inode, dir,
+			    &cursor, n == 0, i > 0);
 		n = i;
 	}
 
@@ -3301,6 +3626,482 @@ gfm_server_getdirentsplusxattr(struct peer *peer, gfp_xdr_xid_t xid,
 	return (e_ret);
 }
 
+/*
+ * GFM_PROTO_FIND walks the directory tree in the order of names.
+ * like GFM_PROTO_XMLATTR_FIND, gfmd doesn't keep any state between RPCs.
+ * instead, the path of the entry to be visited next is returned as a cookie,
+ * and the next RPC restarts from there.
+ * an RPC visits at most FIND_VISIT_LIMIT entries to bound giant_lock time.
+ */
+#define FIND_VISIT_LIMIT	10000
+
+struct find_cond {
+	gfarm_int32_t flags, types, maxdepth;
+	char *name;
+	gfarm_int64_t size_min, size_max;
+	gfarm_int64_t mtime_min, mtime_max;
+	gfarm_int64_t atime_min, atime_max;
+	gfarm_int64_t ncopy_min, ncopy_max;
+	char *username, *groupname;
+	struct user *user;
+	struct group *group;
+};
+
+struct find_result {
+	char *path;
+	struct gfs_stat st;
+};
+
+struct find_state {
+	struct find_cond *cond;
+	struct user *user;
+
+	/* cookie, e.g. "dir1/dir2/file" is split into 3 names */
+	char *ckpath, **ckpathnames;
+	int ckpathdepth, resuming;
+
+	int nvisited, full;
+	char *next_cookie;
+
+	gfarm_int32_t nresults, nalloc;
+	struct find_result *results;
+};
+
+static int
+find_in_range(gfarm_int64_t v, gfarm_int64_t min, gfarm_int64_t max)
+{
+	return (min <= v && v <= max);
+}
+
+/* PREREQUISITE: giant_lock */
+static int
+find_match(struct find_cond *c, const char *name, struct inode *inode)
+{
+	int flags = c->flags;
+
+	if ((flags & GFS_FIND_NAME) != 0 &&
+	    !gfarm_pattern_match(c->name, name, 0))
+		return (0);
+	if ((flags & GFS_FIND_TYPE) != 0 && (c->types &
+	    GFS_FIND_TYPE_BIT(gfs_mode_to_type(inode_get_mode(inode)))) == 0)
+		return (0);
+	if ((flags & GFS_FIND_SIZE) != 0 &&
+	    !find_in_range(inode_get_size(inode), c->size_min, c->size_max))
+		return (0);
+	if ((flags & GFS_FIND_MTIME) != 0 &&
+	    !find_in_range(inode_get_mtime(inode)->tv_sec,
+	    c->mtime_min, c->mtime_max))
+		return (0);
+	if ((flags & GFS_FIND_ATIME) != 0 &&
+	    !find_in_range(inode_get_atime(inode)->tv_sec,
+	    c->atime_min, c->atime_max))
+		return (0);
+	if ((flags & GFS_FIND_USER) != 0 && inode_get_user(inode) != c->user)
+		return (0);
+	if ((flags & GFS_FIND_GROUP) != 0 &&
+	    inode_get_group(inode) != c->group)
+		return (0);
+	if ((flags & GFS_FIND_NCOPY) != 0 && (!inode_is_file(inode) ||
+	    !find_in_range(inode_get_ncopy(inode), c->ncopy_min, c->ncopy_max)))
+		return (0);
+	return (1);
+}
+
+static char *
+find_subpath(const char *path, const char *name, int namelen)
+{
+	size_t pathlen = strlen(path), sz;
+	int overflow = 0;
+	char *subpath;
+
+	sz = gfarm_size_add(&overflow, pathlen, namelen);
+	sz = gfarm_size_add(&overflow, sz, 2);
+	if (overflow)
+		return (NULL);
+	GFARM_MALLOC_ARRAY(subpath, sz);
+	if (subpath == NULL)
+		return (NULL);
+	if (pathlen > 0) {
+		memcpy(subpath, path, pathlen);
+		subpath[pathlen++] = '/';
+	}
+	memcpy(subpath + pathlen, name, namelen);
+	subpath[pathlen + namelen] = '\0';
+	return (subpath);
+}
+
+static gfarm_error_t
+find_set_cookie(struct find_state *fs, char *cookie)
+{
+	char *p;
+	int i;
+
+	fs->ckpath = NULL;
+	fs->ckpathnames = NULL;
+	fs->ckpathdepth = 0;
+	fs->resuming = 0;
+	if (cookie[0] == '\0')
+		return (GFARM_ERR_NO_ERROR);
+
+	if ((fs->ckpath = strdup(cookie)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	fs->ckpathdepth = 1;
+	for (p = fs->ckpath; *p != '\0'; p++) {
+		if (*p == '/')
+			fs->ckpathdepth++;
+	}
+	GFARM_MALLOC_ARRAY(fs->ckpathnames, fs->ckpathdepth);
+	if (fs->ckpathnames == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	p = fs->ckpath;
+	for (i = 0; i < fs->ckpathdepth; i++) {
+		fs->ckpathnames[i] = p;
+		if ((p = strchr(p, '/')) == NULL)
+			break;
+		*p++ = '\0';
+	}
+	fs->resuming = 1;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* PREREQUISITE: giant_lock */
+static gfarm_error_t
+find_add_result(struct find_state *fs, const char *path, struct inode *inode)
+{
+	gfarm_error_t e;
+	struct find_result *r = &fs->results[fs->nresults];
+
+	if ((r->path = strdup(path)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	if ((e = inode_get_stat(inode, &r->st)) != GFARM_ERR_NO_ERROR) {
+		free(r->path);
+		return (e);
+	}
+	fs->nresults++;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * find_walk() keeps the directories being walked in an explicit stack,
+ * instead of recursion, because the depth of a directory tree is not
+ * limited, but the stack size of a gfmd thread is.
+ * frames[0] is the starting directory, and frames[i] is the directory
+ * at the level `i' below it.
+ */
+struct find_frame {
+	Dir dir;
+	DirCursor cursor;
+	int valid;	/* `cursor' points to an entry */
+	char *path;	/* relative to the starting directory */
+};
+
+struct find_stack {
+	int nframes, nalloc;
+	struct find_frame *frames;
+};
+
+/*
+ * push `dir', if it's to be walked.
+ * `path' is always consumed.
+ *
+ * PREREQUISITE: giant_lock
+ */
+static gfarm_error_t
+find_push(struct find_state *fs, struct find_stack *stack,
+	struct inode *dir, char *path, int *pushedp)
+{
+	Dir d;
+	struct find_frame *f;
+	int nalloc;
+
+	*pushedp = 0;
+	if ((fs->cond->maxdepth >= 0 &&
+	    stack->nframes >= fs->cond->maxdepth) ||
+	    (d = inode_get_dir(dir)) == NULL ||
+	    inode_access(dir, fs->user, GFS_R_OK|GFS_X_OK) !=
+	    GFARM_ERR_NO_ERROR) {
+		free(path);
+		return (GFARM_ERR_NO_ERROR);
+	}
+	if (stack->nframes >= stack->nalloc) {
+		nalloc = stack->nalloc == 0 ? 16 : stack->nalloc * 2;
+		GFARM_REALLOC_ARRAY(f, stack->frames, nalloc);
+		if (f == NULL) {
+			free(path);
+			return (GFARM_ERR_NO_MEMORY);
+		}
+		stack->frames = f;
+		stack->nalloc = nalloc;
+	}
+	f = &stack->frames[stack->nframes++];
+	f->dir = d;
+	f->valid = dir_cursor_set_pos(d, 0, &f->cursor);
+	f->path = path;
+	*pushedp = 1;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* the entry of the parent directory is visited after the pop */
+static void
+find_pop(struct find_stack *stack)
+{
+	struct find_frame *f = &stack->frames[--stack->nframes];
+
+	free(f->path);
+	if (stack->nframes > 0) {
+		f = &stack->frames[stack->nframes - 1];
+		f->valid = dir_cursor_next(f->dir, &f->cursor);
+	}
+}
+
+/*
+ * push the directories in the cookie, and move the cursor of
+ * the last one to the entry which is visited first.
+ *
+ * PREREQUISITE: giant_lock
+ */
+static gfarm_error_t
+find_resume(struct find_state *fs, struct find_stack *stack)
+{
+	gfarm_error_t e;
+	struct find_frame *f;
+	struct inode *inode;
+	char *name, *subpath;
+	int depth, namelen, pushed;
+
+	for (depth = 0; fs->resuming && depth < fs->ckpathdepth; depth++) {
+		f = &stack->frames[depth];
+		name = fs->ckpathnames[depth];
+		namelen = strlen(name);
+		if (depth < fs->ckpathdepth - 1 &&
+		    dir_cursor_lookup(f->dir, name, namelen, &f->cursor) &&
+		    inode_is_dir(inode = dir_entry_get_inode(
+		    dir_cursor_get_entry(f->dir, &f->cursor)))) {
+			/* already visited, restart in the subdirectory */
+			if ((subpath = find_subpath(f->path, name, namelen))
+			    == NULL)
+				return (GFARM_ERR_NO_MEMORY);
+			e = find_push(fs, stack, inode, subpath, &pushed);
+			if (e != GFARM_ERR_NO_ERROR)
+				return (e);
+			if (!pushed) {
+				fs->resuming = 0;
+				f->valid = dir_cursor_next(f->dir, &f->cursor);
+			}
+		} else {
+			/*
+			 * the entry which is visited first,
+			 * or removed since the last RPC
+			 */
+			fs->resuming = 0;
+			f->valid =
+			    (depth == fs->ckpathdepth - 1 &&
+			    dir_cursor_lookup(f->dir, name, namelen,
+			    &f->cursor)) ||
+			    dir_cursor_lookup_next(f->dir, name, namelen,
+			    &f->cursor);
+		}
+	}
+	fs->resuming = 0;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* PREREQUISITE: giant_lock */
+static gfarm_error_t
+find_walk(struct find_state *fs, struct inode *top)
+{
+	gfarm_error_t e;
+	struct find_stack stack;
+	struct find_frame *f;
+	DirEntry entry;
+	struct inode *inode;
+	char *name, *path, *subpath;
+	int namelen, pushed;
+
+	stack.nframes = stack.nalloc = 0;
+	stack.frames = NULL;
+	if ((path = strdup("")) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	e = find_push(fs, &stack, top, path, &pushed);
+	if (e == GFARM_ERR_NO_ERROR && pushed && fs->resuming)
+		e = find_resume(fs, &stack);
+
+	while (e == GFARM_ERR_NO_ERROR && stack.nframes > 0) {
+		f = &stack.frames[stack.nframes - 1];
+		if (!f->valid ||
+		    (entry = dir_cursor_get_entry(f->dir, &f->cursor)) ==
+		    NULL) {
+			find_pop(&stack);
+			continue;
+		}
+		name = dir_entry_get_name(entry, &namelen);
+		if (name[0] == '.' && (namelen == 1 ||
+		    (namelen == 2 && name[1] == '.'))) {
+			f->valid = dir_cursor_next(f->dir, &f->cursor);
+			continue;
+		}
+		if ((subpath = find_subpath(f->path, name, namelen)) == NULL) {
+			e = GFARM_ERR_NO_MEMORY;
+			break;
+		}
+		if (fs->nvisited >= FIND_VISIT_LIMIT ||
+		    fs->nresults >= fs->nalloc) {
+			fs->full = 1;
+			fs->next_cookie = subpath;
+			break;
+		}
+		fs->nvisited++;
+		inode = dir_entry_get_inode(entry);
+		/* subpath is NUL terminated, and its last part is the name */
+		if (find_match(fs->cond, subpath + strlen(subpath) - namelen,
+		    inode))
+			e = find_add_result(fs, subpath, inode);
+		if (e == GFARM_ERR_NO_ERROR && inode_is_dir(inode)) {
+			/* `f' may be moved by find_push() */
+			e = find_push(fs, &stack, inode, subpath, &pushed);
+			if (e == GFARM_ERR_NO_ERROR && pushed)
+				continue;
+			f = &stack.frames[stack.nframes - 1];
+		} else
+			free(subpath);
+		f->valid = dir_cursor_next(f->dir, &f->cursor);
+	}
+
+	while (stack.nframes > 0)
+		free(stack.frames[--stack.nframes].path);
+	free(stack.frames);
+	return (e);
+}
+
+gfarm_error_t
+gfm_server_find(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
+	int from_client, int skip)
+{
+	struct peer *mhpeer;
+	struct gfp_xdr *client = peer_get_conn(peer);
+	gfarm_error_t e_ret, e_rpc;
+	int size_pos;
+	gfarm_int32_t fd, i, eof = 0;
+	struct process *process;
+	struct inode *inode;
+	struct find_cond cond;
+	struct find_state fs;
+	char *cookie;
+	static const char diag[] = "GFM_PROTO_FIND";
+
+	e_ret = gfm_server_get_request(peer, sizep, diag, "isiillllllllssis",
+	    &cond.flags, &cond.name, &cond.types,
+	    &cond.maxdepth, &cond.size_min, &cond.size_max,
+	    &cond.mtime_min, &cond.mtime_max,
+	    &cond.atime_min, &cond.atime_max,
+	    &cond.ncopy_min, &cond.ncopy_max,
+	    &cond.username, &cond.groupname, &fs.nalloc, &cookie);
+	if (e_ret != GFARM_ERR_NO_ERROR)
+		return (e_ret);
+	if (skip) {
+		free(cond.name);
+		free(cond.username);
+		free(cond.groupname);
+		free(cookie);
+		return (GFARM_ERR_NO_ERROR);
+	}
+
+	fs.cond = &cond;
+	fs.nvisited = fs.full = 0;
+	fs.next_cookie = NULL;
+	fs.nresults = 0;
+	fs.results = NULL;
+	if (fs.nalloc > GFM_PROTO_MAX_DIRENT)
+		fs.nalloc = GFM_PROTO_MAX_DIRENT;
+
+	e_rpc = wait_db_update_info(peer,
+	    DBUPDATE_FS_DIRENT | DBUPDATE_USER | DBUPDATE_GROUP, diag);
+	if (e_rpc != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s: failed to wait for the backend DB to be updated: %s",
+		    diag, gfarm_error_string(e_rpc));
+		/* Continue processing. */
+	}
+	giant_lock();
+
+	if (e_rpc != GFARM_ERR_NO_ERROR) {
+		; /* Continue processing. */
+	} else if ((process = peer_get_process(peer)) == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED, "peer_get_process() failed");
+		e_rpc = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	} else if ((fs.user = process_get_user(process)) == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED, "process_get_user() failed");
+		e_rpc = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	} else if ((e_rpc = peer_fdpair_get_current(peer, &fd)) !=
+	    GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "peer_fdpair_get_current() failed: %s",
+		    gfarm_error_string(e_rpc));
+	} else if ((e_rpc = process_get_file_inode(process, fd, &inode)) !=
+	    GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "process_get_file_inode() failed: %s",
+		    gfarm_error_string(e_rpc));
+	} else if (!inode_is_dir(inode)) {
+		e_rpc = GFARM_ERR_NOT_A_DIRECTORY;
+	} else if (fs.nalloc <= 0) {
+		e_rpc = GFARM_ERR_INVALID_ARGUMENT;
+	} else if (GFARM_MALLOC_ARRAY(fs.results, fs.nalloc) == NULL ||
+	    (e_rpc = find_set_cookie(&fs, cookie)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: no memory", diag);
+		e_rpc = GFARM_ERR_NO_MEMORY;
+	} else {
+		/* unknown user or group matches nothing */
+		cond.user = user_lookup(cond.username);
+		cond.group = group_lookup(cond.groupname);
+		e_rpc = find_walk(&fs, inode);
+		eof = !fs.full;
+	}
+
+	giant_unlock();
+	e_ret = gfm_server_put_reply_begin(peer, &mhpeer, xid, &size_pos, diag,
+	    e_rpc, "isi", eof,
+	    fs.next_cookie == NULL ? "" : fs.next_cookie, fs.nresults);
+	/* if network error doesn't happen, e_ret == e_rpc here */
+	if (e_ret == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < fs.nresults; i++) {
+			struct gfs_stat *st = &fs.results[i].st;
+
+			e_ret = gfp_xdr_send(client, "sllilsslllilili",
+			    fs.results[i].path,
+			    st->st_ino, st->st_gen, st->st_mode, st->st_nlink,
+			    st->st_user, st->st_group, st->st_size,
+			    st->st_ncopy,
+			    st->st_atimespec.tv_sec, st->st_atimespec.tv_nsec,
+			    st->st_mtimespec.tv_sec, st->st_mtimespec.tv_nsec,
+			    st->st_ctimespec.tv_sec, st->st_ctimespec.tv_nsec);
+			if (e_ret != GFARM_ERR_NO_ERROR) {
+				gflog_warning(GFARM_MSG_UNFIXED,
+				    "%s@%s: find: %s",
+				    peer_get_username(peer),
+				    peer_get_hostname(peer),
+				    gfarm_error_string(e_ret));
+				break;
+			}
+		}
+		gfm_server_put_reply_end(peer, mhpeer, diag, size_pos);
+	}
+
+	for (i = 0; i < fs.nresults; i++) {
+		free(fs.results[i].path);
+		gfs_stat_free(&fs.results[i].st);
+	}
+	free(fs.results);
+	free(fs.next_cookie);
+	free(fs.ckpath);
+	free(fs.ckpathnames);
+	free(cond.name);
+	free(cond.username);
+	free(cond.groupname);
+	free(cookie);
+	return (e_ret);
+}
+
 gfarm_error_t
 gfm_server_seek(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	int from_client, int skip)
@@ -4577,66 +5378,180 @@ gfm_server_replica_list_by_name(struct peer *peer, gfp_xdr_xid_t xid,
 	return (e_ret);
 }
 
+/*
+ * list inodes which have a valid replica on the host, in ascending order
+ * of inode numbers from start_inum, at most n_req entries at a time.
+ * fewer than n_req entries means that the end of the list is reached.
+ */
 gfarm_error_t
 gfm_server_replica_list_by_host(
 	struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	int from_client, int skip)
 {
-	gfarm_error_t e;
-	char *host;
-	gfarm_int32_t port;
-	struct relayed_request *relay;
+	struct peer *mhpeer;
+	gfarm_error_t e_ret, e_rpc;
+	int size_pos;
+	char *hostname;
+	gfarm_int32_t port, n_req;
+	gfarm_ino_t start_inum, *inums = NULL;
+	int i, n_ret = 0;
+	struct host *host;
+	struct file_copy *copy;
+	struct user *user = peer_get_user(peer);
 	static const char diag[] = "GFM_PROTO_REPLICA_LIST_BY_HOST";
 
-	/* XXX - NOT IMPLEMENTED */
-	gflog_error(GFARM_MSG_1000398, "%s: not implemented", diag);
-
-	e = gfm_server_relay_get_request(peer, sizep, skip, &relay, diag,
-	    GFM_PROTO_REPLICA_LIST_BY_HOST, "si",
-	    &host, &port);
-	if (e != GFARM_ERR_NO_ERROR)
-		return (e);
+	e_ret = gfm_server_get_request(peer, sizep, diag,
+	    "sili", &hostname, &port, &start_inum, &n_req);
+	if (e_ret != GFARM_ERR_NO_ERROR)
+		return (e_ret);
 	if (skip) {
-		free(host);
+		free(hostname);
 		return (GFARM_ERR_NO_ERROR);
 	}
 
-	free(host);
-	e = GFARM_ERR_FUNCTION_NOT_IMPLEMENTED;
-	e = gfm_server_relay_put_reply(peer, xid, sizep, relay, diag,
-	    &e, "");
-	return (e);
+	e_rpc = wait_db_update_info(peer, DBUPDATE_FS | DBUPDATE_HOST, diag);
+	if (e_rpc != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s: failed to wait for the backend DB to be updated: %s",
+		    diag, gfarm_error_string(e_rpc));
+	}
+
+	giant_lock();
+	if (e_rpc != GFARM_ERR_NO_ERROR) {
+		;
+	} else if (!from_client || user == NULL || !user_is_admin(user)) {
+		gflog_debug(GFARM_MSG_UNFIXED, "operation is not permitted");
+		e_rpc = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	} else if ((host = host_lookup(hostname)) == NULL ||
+	    host_port(host) != port) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s:%d: no such host",
+		    hostname, (int)port);
+		e_rpc = GFARM_ERR_NO_SUCH_OBJECT;
+	} else if (n_req <= 0) {
+		gflog_debug(GFARM_MSG_UNFIXED, "n_req is %d", (int)n_req);
+		e_rpc = GFARM_ERR_INVALID_ARGUMENT;
+	} else if (GFARM_MALLOC_ARRAY(inums, n_req) == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED, "no memory");
+		e_rpc = GFARM_ERR_NO_MEMORY;
+	} else {
+		for (copy = host_file_copy_first(host, start_inum);
+		    copy != NULL && n_ret < n_req;
+		    copy = host_file_copy_next(copy)) {
+			if (file_copy_is_valid(copy))
+				inums[n_ret++] =
+				    inode_get_number(file_copy_inode(copy));
+		}
+	}
+	giant_unlock();
+	free(hostname);
+
+	e_ret = gfm_server_put_reply_begin(peer, &mhpeer, xid, &size_pos, diag,
+	    e_rpc, "i", n_ret);
+	/* if network error doesn't happen, e_ret == e_rpc here */
+	if (e_ret == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < n_ret; i++) {
+			e_ret = gfp_xdr_send(peer_get_conn(peer), "l",
+			    inums[i]);
+			if (e_ret != GFARM_ERR_NO_ERROR)
+				break;
+		}
+		gfm_server_put_reply_end(peer, mhpeer, diag, size_pos);
+	}
+
+	free(inums);
+	return (e_ret);
 }
 
+/*
+ * remove replicas on the host, by visiting at most n_req valid replicas
+ * in ascending order of inode numbers from start_inum.
+ * the last available replica and a replica being written are kept.
+ * next_inum is the start_inum of the next call, or 0 at the end.
+ */
 gfarm_error_t
 gfm_server_replica_remove_by_host(
 	struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	int from_client, int skip)
 {
-	gfarm_error_t e;
-	char *host;
-	gfarm_int32_t port;
+	gfarm_error_t e, e2;
+	char *hostname;
+	gfarm_int32_t port, n_req, n_removed = 0;
+	gfarm_ino_t start_inum, next_inum = 0, *inums = NULL;
+	int i, n = 0, transaction = 0;
+	struct host *host;
+	struct inode *inode;
+	struct file_copy *copy;
+	struct user *user = peer_get_user(peer);
 	struct relayed_request *relay;
 	static const char diag[] = "GFM_PROTO_REPLICA_REMOVE_BY_HOST";
 
-	/* XXX - NOT IMPLEMENTED */
-	gflog_error(GFARM_MSG_1000399, "%s: not implemented", diag);
-
 	e = gfm_server_relay_get_request(peer, sizep, skip, &relay, diag,
-	    GFM_PROTO_REPLICA_REMOVE_BY_HOST, "si",
-	    &host, &port);
+	    GFM_PROTO_REPLICA_REMOVE_BY_HOST, "sili",
+	    &hostname, &port, &start_inum, &n_req);
 	if (e != GFARM_ERR_NO_ERROR)
 		return (e);
 	if (skip) {
-		free(host);
+		free(hostname);
 		return (GFARM_ERR_NO_ERROR);
 	}
 
-	free(host);
-	e = GFARM_ERR_FUNCTION_NOT_IMPLEMENTED;
-	e = gfm_server_relay_put_reply(peer, xid, sizep, relay, diag,
-	    &e, "");
-	return (e);
+	if (relay != NULL) {
+		free(hostname);
+	} else {
+		/* do not relay RPC to master gfmd */
+		giant_lock();
+		if (!from_client || user == NULL || !user_is_admin(user)) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "operation is not permitted");
+			e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+		} else if ((host = host_lookup(hostname)) == NULL ||
+		    host_port(host) != port) {
+			gflog_debug(GFARM_MSG_UNFIXED, "%s:%d: no such host",
+			    hostname, (int)port);
+			e = GFARM_ERR_NO_SUCH_OBJECT;
+		} else if (n_req <= 0) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "n_req is %d", (int)n_req);
+			e = GFARM_ERR_INVALID_ARGUMENT;
+		} else if (GFARM_MALLOC_ARRAY(inums, n_req) == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED, "no memory");
+			e = GFARM_ERR_NO_MEMORY;
+		} else {
+			/* removal changes the index, thus collect first */
+			for (copy = host_file_copy_first(host, start_inum);
+			    copy != NULL && n < n_req;
+			    copy = host_file_copy_next(copy)) {
+				if (file_copy_is_valid(copy))
+					inums[n++] = inode_get_number(
+					    file_copy_inode(copy));
+			}
+			if (n == n_req)
+				next_inum = inums[n - 1] + 1;
+
+			if (n > 0 && db_begin(diag) == GFARM_ERR_NO_ERROR)
+				transaction = 1;
+			for (i = 0; i < n; i++) {
+				if ((inode = inode_lookup(inums[i])) == NULL)
+					continue;
+				e2 = inode_remove_replica_on_draining_host(
+				    inode, host);
+				if (e2 == GFARM_ERR_NO_ERROR)
+					n_removed++;
+				else
+					gflog_debug(GFARM_MSG_UNFIXED,
+					    "%s: %s: inode %lld: %s", diag,
+					    hostname, (long long)inums[i],
+					    gfarm_error_string(e2));
+			}
+			if (transaction)
+				db_end(diag);
+			free(inums);
+		}
+		free(hostname);
+		giant_unlock();
+	}
+	return (gfm_server_relay_put_reply(peer, xid, sizep, relay, diag,
+	    &e, "il", &n_removed, &next_inum));
 }
 
 gfarm_error_t
@@ -5461,10 +6376,11 @@ gfm_server_replica_get_my_entries_common(
 	struct gfp_xdr *client = peer_get_conn(peer);
 	gfarm_error_t e_ret, e_rpc;
 	int size_pos;
-	gfarm_ino_t start_inum, inum, table_size;
+	gfarm_ino_t start_inum;
 	int i, n_req, n_ret = 0;
 	struct host *spool_host;
 	struct inode *inode;
+	struct file_copy *copy;
 	struct entry_result {
 		gfarm_ino_t inum;
 		gfarm_uint64_t gen;
@@ -5502,21 +6418,17 @@ gfm_server_replica_get_my_entries_common(
 		gflog_debug(GFARM_MSG_1003493, "no memory");
 		e_rpc = GFARM_ERR_NO_MEMORY;
 	} else {
-		if (start_inum < inode_root_number())
-			start_inum = inode_root_number();
-		table_size = inode_table_current_size();
+		/* include !valid and being removed file_copy */
 		e_rpc = GFARM_ERR_NO_SUCH_OBJECT;
-		for (inum = start_inum; inum < table_size && n_ret < n_req;
-		    inum++) {
-			inode = inode_lookup(inum);
-			if (inode && inode_is_file(inode) &&
-			    inode_has_file_copy(inode, spool_host)) {
-				ents[n_ret].inum = inode_get_number(inode);
-				ents[n_ret].gen = inode_get_gen(inode);
-				ents[n_ret].size = inode_get_size(inode);
-				e_rpc = GFARM_ERR_NO_ERROR;
-				n_ret++;
-			}
+		for (copy = host_file_copy_first(spool_host, start_inum);
+		    copy != NULL && n_ret < n_req;
+		    copy = host_file_copy_next(copy)) {
+			inode = file_copy_inode(copy);
+			ents[n_ret].inum = inode_get_number(inode);
+			ents[n_ret].gen = inode_get_gen(inode);
+			ents[n_ret].size = inode_get_size(inode);
+			e_rpc = GFARM_ERR_NO_ERROR;
+			n_ret++;
 		}
 	}
 	giant_unlock();
@@ -70,6 +70,8 @@ gfarm_error_t gfm_server_schedule_file_with_program(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_remove(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
+gfarm_error_t gfm_server_remove_recursive(
+	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_rmdir(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_rename(
@@ -92,6 +94,8 @@ gfarm_error_t gfm_server_getdirentsplus(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_getdirentsplusxattr(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
+gfarm_error_t gfm_server_find(
+	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 
 /* gfs from gfsd */
 gfarm_error_t gfm_server_reopen(
@@ -0,0 +1,170 @@
+/*
+ * $Id$
+ */
+
+#include <stddef.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfm_proto.h"
+
+#include "gfm_proto_name.h"
+
+#define GFM_PROTO_CASE(name)	case GFM_PROTO_##name: return (#name)
+#define GFJ_PROTO_CASE(name)	case GFJ_PROTO_##name: return ("GFJ_" #name)
+
+/*
+ * returns a printable name of a request number,
+ * or NULL, if the number is not a known request.
+ */
+const char *
+gfm_proto_name(gfarm_int32_t request)
+{
+	switch (request) {
+	GFM_PROTO_CASE(HOST_INFO_GET_ALL);
+	GFM_PROTO_CASE(HOST_INFO_GET_BY_ARCHITECTURE);
+	GFM_PROTO_CASE(HOST_INFO_GET_BY_NAMES);
+	GFM_PROTO_CASE(HOST_INFO_GET_BY_NAMEALIASES);
+	GFM_PROTO_CASE(HOST_INFO_SET);
+	GFM_PROTO_CASE(HOST_INFO_MODIFY);
+	GFM_PROTO_CASE(HOST_INFO_REMOVE);
+	GFM_PROTO_CASE(FSNGROUP_GET_ALL);
+	GFM_PROTO_CASE(FSNGROUP_GET_BY_HOSTNAME);
+	GFM_PROTO_CASE(FSNGROUP_MODIFY);
+	GFM_PROTO_CASE(USER_INFO_GET_ALL);
+	GFM_PROTO_CASE(USER_INFO_GET_BY_NAMES);
+	GFM_PROTO_CASE(USER_INFO_SET);
+	GFM_PROTO_CASE(USER_INFO_MODIFY);
+	GFM_PROTO_CASE(USER_INFO_REMOVE);
+	GFM_PROTO_CASE(USER_INFO_GET_BY_GSI_DN);
+	GFM_PROTO_CASE(GROUP_INFO_GET_ALL);
+	GFM_PROTO_CASE(GROUP_INFO_GET_BY_NAMES);
+	GFM_PROTO_CASE(GROUP_INFO_SET);
+	GFM_PROTO_CASE(GROUP_INFO_MODIFY);
+	GFM_PROTO_CASE(GROUP_INFO_REMOVE);
+	GFM_PROTO_CASE(GROUP_INFO_ADD_USERS);
+	GFM_PROTO_CASE(GROUP_INFO_REMOVE_USERS);
+	GFM_PROTO_CASE(GROUP_NAMES_GET_BY_USERS);
+	GFM_PROTO_CASE(QUOTA_USER_GET);
+	GFM_PROTO_CASE(QUOTA_USER_SET);
+	GFM_PROTO_CASE(QUOTA_GROUP_GET);
+	GFM_PROTO_CASE(QUOTA_GROUP_SET);
+	GFM_PROTO_CASE(QUOTA_CHECK);
+	GFM_PROTO_CASE(COMPOUND_BEGIN);
+	GFM_PROTO_CASE(COMPOUND_END);
+	GFM_PROTO_CASE(COMPOUND_ON_ERROR);
+	GFM_PROTO_CASE(PUT_FD);
+	GFM_PROTO_CASE(GET_FD);
+	GFM_PROTO_CASE(SAVE_FD);
+	GFM_PROTO_CASE(RESTORE_FD);
+	GFM_PROTO_CASE(BEQUEATH_FD);
+	GFM_PROTO_CASE(INHERIT_FD);
+	GFM_PROTO_CASE(OPEN_ROOT);
+	GFM_PROTO_CASE(OPEN_PARENT);
+	GFM_PROTO_CASE(OPEN);
+	GFM_PROTO_CASE(CREATE);
+	GFM_PROTO_CASE(CLOSE);
+	GFM_PROTO_CASE(VERIFY_TYPE);
+	GFM_PROTO_CASE(VERIFY_TYPE_NOT);
+	GFM_PROTO_CASE(REVOKE_GFSD_ACCESS);
+	GFM_PROTO_CASE(OPEN_DIR);
+	GFM_PROTO_CASE(FHOPEN);
+	GFM_PROTO_CASE(FSTAT);
+	GFM_PROTO_CASE(FUTIMES);
+	GFM_PROTO_CASE(FCHMOD);
+	GFM_PROTO_CASE(FCHOWN);
+	GFM_PROTO_CASE(CKSUM_GET);
+	GFM_PROTO_CASE(CKSUM_SET);
+	GFM_PROTO_CASE(SCHEDULE_FILE);
+	GFM_PROTO_CASE(SCHEDULE_FILE_WITH_PROGRAM);
+	GFM_PROTO_CASE(FGETATTRPLUS);
+	GFM_PROTO_CASE(REMOVE);
+	GFM_PROTO_CASE(RENAME);
+	GFM_PROTO_CASE(FLINK);
+	GFM_PROTO_CASE(MKDIR);
+	GFM_PROTO_CASE(SYMLINK);
+	GFM_PROTO_CASE(READLINK);
+	GFM_PROTO_CASE(GETDIRPATH);
+	GFM_PROTO_CASE(GETDIRENTS);
+	GFM_PROTO_CASE(SEEK);
+	GFM_PROTO_CASE(GETDIRENTSPLUS);
+	GFM_PROTO_CASE(GETDIRENTSPLUSXATTR);
+	GFM_PROTO_CASE(REMOVE_RECURSIVE);
+	GFM_PROTO_CASE(FIND);
+	GFM_PROTO_CASE(REOPEN);
+	GFM_PROTO_CASE(CLOSE_READ);
+	GFM_PROTO_CASE(CLOSE_WRITE);
+	GFM_PROTO_CASE(LOCK);
+	GFM_PROTO_CASE(TRYLOCK);
+	GFM_PROTO_CASE(UNLOCK);
+	GFM_PROTO_CASE(LOCK_INFO);
+	GFM_PROTO_CASE(SWITCH_ASYNC_BACK_CHANNEL);
+	GFM_PROTO_CASE(CLOSE_WRITE_V2_4);
+	GFM_PROTO_CASE(GENERATION_UPDATED);
+	GFM_PROTO_CASE(FHCLOSE_READ);
+	GFM_PROTO_CASE(FHCLOSE_WRITE);
+	GFM_PROTO_CASE(GENERATION_UPDATED_BY_COOKIE);
+	GFM_PROTO_CASE(GLOB);
+	GFM_PROTO_CASE(SCHEDULE);
+	GFM_PROTO_CASE(PIO_OPEN);
+	GFM_PROTO_CASE(PIO_SET_PATHS);
+	GFM_PROTO_CASE(PIO_CLOSE);
+	GFM_PROTO_CASE(PIO_VISIT);
+	GFM_PROTO_CASE(HOSTNAME_SET);
+	GFM_PROTO_CASE(SCHEDULE_HOST_DOMAIN);
+	GFM_PROTO_CASE(STATFS);
+	GFM_PROTO_CASE(GIANT_LOCK_STAT_GET);
+	GFM_PROTO_CASE(REPLICA_LIST_BY_NAME);
+	GFM_PROTO_CASE(REPLICA_LIST_BY_HOST);
+	GFM_PROTO_CASE(REPLICA_REMOVE_BY_HOST);
+	GFM_PROTO_CASE(REPLICA_REMOVE_BY_FILE);
+	GFM_PROTO_CASE(REPLICA_INFO_GET);
+	GFM_PROTO_CASE(REPLICATE_FILE_FROM_TO);
+	GFM_PROTO_CASE(REPLICATE_FILE_TO);
+	GFM_PROTO_CASE(REPLICA_ADDING);
+	GFM_PROTO_CASE(REPLICA_ADDED);
+	GFM_PROTO_CASE(REPLICA_LOST);
+	GFM_PROTO_CASE(REPLICA_ADD);
+	GFM_PROTO_CASE(REPLICA_ADDED2);
+	GFM_PROTO_CASE(REPLICATION_RESULT);
+	GFM_PROTO_CASE(REPLICA_GET_MY_ENTRIES);
+	GFM_PROTO_CASE(REPLICA_CREATE_FILE_IN_LOST_FOUND);
+	GFM_PROTO_CASE(REPLICA_GET_MY_ENTRIES2);
+	GFM_PROTO_CASE(PROCESS_ALLOC);
+	GFM_PROTO_CASE(PROCESS_ALLOC_CHILD);
+	GFM_PROTO_CASE(PROCESS_FREE);
+	GFM_PROTO_CASE(PROCESS_SET);
+	GFJ_PROTO_CASE(LOCK_REGISTER);
+	GFJ_PROTO_CASE(UNLOCK_REGISTER);
+	GFJ_PROTO_CASE(REGISTER);
+	GFJ_PROTO_CASE(UNREGISTER);
+	GFJ_PROTO_CASE(REGISTER_NODE);
+	GFJ_PROTO_CASE(LIST);
+	GFJ_PROTO_CASE(INFO);
+	GFJ_PROTO_CASE(HOSTINFO);
+	GFM_PROTO_CASE(XATTR_SET);
+	GFM_PROTO_CASE(XMLATTR_SET);
+	GFM_PROTO_CASE(XATTR_GET);
+	GFM_PROTO_CASE(XMLATTR_GET);
+	GFM_PROTO_CASE(XATTR_REMOVE);
+	GFM_PROTO_CASE(XMLATTR_REMOVE);
+	GFM_PROTO_CASE(XATTR_LIST);
+	GFM_PROTO_CASE(XMLATTR_LIST);
+	GFM_PROTO_CASE(XMLATTR_FIND);
+	GFM_PROTO_CASE(SWITCH_GFMD_CHANNEL);
+	GFM_PROTO_CASE(JOURNAL_READY_TO_RECV);
+	GFM_PROTO_CASE(JOURNAL_SEND);
+	GFM_PROTO_CASE(REMOTE_PEER_ALLOC);
+	GFM_PROTO_CASE(REMOTE_PEER_FREE);
+	GFM_PROTO_CASE(REMOTE_RPC);
+	GFM_PROTO_CASE(REMOTE_GFS_RPC);
+	GFM_PROTO_CASE(REMOTE_PEER_DISCONNECT);
+	GFM_PROTO_CASE(METADB_SERVER_GET);
+	GFM_PROTO_CASE(METADB_SERVER_GET_ALL);
+	GFM_PROTO_CASE(METADB_SERVER_SET);
+	GFM_PROTO_CASE(METADB_SERVER_MODIFY);
+	GFM_PROTO_CASE(METADB_SERVER_REMOVE);
+	default:
+		return (NULL);
+	}
+}
@@ -0,0 +1 @@
+const char *gfm_proto_name(gfarm_int32_t);
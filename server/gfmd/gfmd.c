@@ -50,6 +50,7 @@
 #include "journal_file.h"	/* for enum journal_operation */
 #include "db_access.h"
 #include "db_journal.h"
+#include "db_snapshot.h"
 #include "db_journal_apply.h"
 #include "host.h"
 #include "fsngroup.h"
@@ -61,6 +62,7 @@
 #include "peer.h"
 #include "local_peer.h"
 #include "inode.h"
+#include "loader.h"
 #include "dead_file_copy.h"
 #include "process.h"
 #include "fs.h"
@@ -73,6 +75,9 @@
 #include "gfmd.h"
 #include "iostat.h"
 #include "replica_check.h"
+#include "file_replication.h"
+#include "giant_stat.h"
+#include "rpcstat.h"
 
 #include "protocol_state.h"
 
@@ -98,6 +103,7 @@ struct thread_pool *authentication_thread_pool;
 struct peer_watcher *sync_protocol_watcher;
 
 static char *iostat_dirbuf;
+static char *rpcstat_path;
 
 static const char TRANSFORM_MUTEX_DIAG[] = "transform_mutex";
 static const char TRANSFORM_COND_DIAG[] = "transform_cond";
@@ -146,9 +152,9 @@ protocol_type(gfarm_int32_t request)
 	case GFM_PROTO_FSNGROUP_MODIFY:
 		return (0);
 	case GFM_PROTO_USER_INFO_GET_ALL:
-		return (PROTO_HANDLED_BY_SLAVE);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_USER_INFO_GET_BY_NAMES:
-		return (PROTO_HANDLED_BY_SLAVE);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_USER_INFO_SET:
 		return (0);
 	case GFM_PROTO_USER_INFO_MODIFY:
@@ -156,11 +162,11 @@ protocol_type(gfarm_int32_t request)
 	case GFM_PROTO_USER_INFO_REMOVE:
 		return (0);
 	case GFM_PROTO_USER_INFO_GET_BY_GSI_DN:
-		return (PROTO_HANDLED_BY_SLAVE);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_GROUP_INFO_GET_ALL:
-		return (PROTO_HANDLED_BY_SLAVE);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_GROUP_INFO_GET_BY_NAMES:
-		return (PROTO_HANDLED_BY_SLAVE);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_GROUP_INFO_SET:
 		return (0);
 	case GFM_PROTO_GROUP_INFO_MODIFY:
@@ -172,7 +178,7 @@ protocol_type(gfarm_int32_t request)
 	case GFM_PROTO_GROUP_INFO_REMOVE_USERS:
 		return (0);
 	case GFM_PROTO_GROUP_NAMES_GET_BY_USERS:
-		return (PROTO_HANDLED_BY_SLAVE);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_COMPOUND_BEGIN:
 		return (PROTO_HANDLED_BY_SLAVE);
 	case GFM_PROTO_COMPOUND_END:
@@ -218,7 +224,8 @@ protocol_type(gfarm_int32_t request)
 	case GFM_PROTO_REVOKE_GFSD_ACCESS: /* NOTE: explicitly pass fd */
 		return (0);
 	case GFM_PROTO_FSTAT:
-		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT|
+		    PROTO_READ_ONLY);
 	case GFM_PROTO_FUTIMES:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_FCHMOD:
@@ -226,7 +233,8 @@ protocol_type(gfarm_int32_t request)
 	case GFM_PROTO_FCHOWN:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_CKSUM_GET:
-		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT|
+		    PROTO_READ_ONLY);
 	case GFM_PROTO_CKSUM_SET:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_SCHEDULE_FILE:
@@ -246,17 +254,26 @@ protocol_type(gfarm_int32_t request)
 	case GFM_PROTO_SYMLINK:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_READLINK:
-		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT|
+		    PROTO_READ_ONLY);
 	case GFM_PROTO_GETDIRPATH: /* XXX: can be done in slave */
-		return (PROTO_USE_FD_CURRENT);
+		return (PROTO_USE_FD_CURRENT|PROTO_READ_ONLY);
 	case GFM_PROTO_GETDIRENTS:
-		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT|
+		    PROTO_READ_ONLY);
 	case GFM_PROTO_SEEK:
 		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_GETDIRENTSPLUS:
-		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT|
+		    PROTO_READ_ONLY);
 	case GFM_PROTO_GETDIRENTSPLUSXATTR:
-		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT|
+		    PROTO_READ_ONLY);
+	case GFM_PROTO_REMOVE_RECURSIVE:
+		return (PROTO_USE_FD_CURRENT);
+	case GFM_PROTO_FIND:
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT|
+		    PROTO_READ_ONLY);
 	case GFM_PROTO_REOPEN:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_CLOSE_READ:
@@ -309,12 +326,14 @@ protocol_type(gfarm_int32_t request)
 		return (0);
 	case GFM_PROTO_STATFS:
 		return (0);
+	case GFM_PROTO_GIANT_LOCK_STAT_GET:
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_REPLICA_LIST_BY_NAME:
 		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_REPLICA_LIST_BY_HOST:
-		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+		return (PROTO_HANDLED_BY_SLAVE|PROTO_READ_ONLY);
 	case GFM_PROTO_REPLICA_REMOVE_BY_HOST:
-		return (PROTO_USE_FD_CURRENT);
+		return (0);
 	case GFM_PROTO_REPLICA_REMOVE_BY_FILE:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_REPLICA_INFO_GET:
@@ -368,17 +387,17 @@ protocol_type(gfarm_int32_t request)
 	case GFM_PROTO_XMLATTR_SET:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_XATTR_GET: /* XXX: can be done in slave */
-		return (PROTO_USE_FD_CURRENT);
+		return (PROTO_USE_FD_CURRENT|PROTO_READ_ONLY);
 	case GFM_PROTO_XMLATTR_GET:
-		return (PROTO_USE_FD_CURRENT);
+		return (PROTO_USE_FD_CURRENT|PROTO_READ_ONLY);
 	case GFM_PROTO_XATTR_REMOVE:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_XMLATTR_REMOVE:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_XATTR_LIST: /* XXX: can be done in slave */
-		return (PROTO_USE_FD_CURRENT);
+		return (PROTO_USE_FD_CURRENT|PROTO_READ_ONLY);
 	case GFM_PROTO_XMLATTR_LIST: /* XXX: can be done in slave */
-		return (PROTO_USE_FD_CURRENT);
+		return (PROTO_USE_FD_CURRENT|PROTO_READ_ONLY);
 	case GFM_PROTO_XMLATTR_FIND: /* XXX: can be done in slave */
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_QUOTA_USER_GET: /* XXX: can be done in slave */
@@ -432,7 +451,8 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 {
 	gfarm_error_t e, e2;
 	gfarm_int32_t request;
-	int type;
+	int type, saved_owner;
+	struct rpcstat_request rs;
 
 	e = gfp_xdr_recv_request_command(peer_get_conn(peer), 0, sizep,
 	    &request);
@@ -457,6 +477,11 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	}
 
 	peer_stat_add(peer, GFARM_IOSTAT_TRAN_NUM, 1);
+	rpcstat_request_begin(&rs, peer_get_conn(peer), sizep);
+
+	/* giant_lock() in a PROTO_READ_ONLY handler is taken as shared */
+	giant_set_shared_mode((type & PROTO_READ_ONLY) != 0);
+	saved_owner = giant_stat_owner_set(giant_stat_request_owner(request));
 
 	switch (request) {
 	case GFM_PROTO_HOST_INFO_GET_ALL:
@@ -687,6 +712,13 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		e = gfm_server_getdirentsplusxattr(peer,
 		    xid, sizep, from_client, skip);
 		break;
+	case GFM_PROTO_REMOVE_RECURSIVE:
+		e = gfm_server_remove_recursive(peer, xid, sizep,
+		    from_client, skip);
+		break;
+	case GFM_PROTO_FIND:
+		e = gfm_server_find(peer, xid, sizep, from_client, skip);
+		break;
 	case GFM_PROTO_REOPEN:
 		e = gfm_server_reopen(peer, xid, sizep, from_client, skip,
 		    suspendedp);
@@ -783,6 +815,10 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	case GFM_PROTO_STATFS:
 		e = gfm_server_statfs(peer, xid, sizep, from_client, skip);
 		break;
+	case GFM_PROTO_GIANT_LOCK_STAT_GET:
+		e = gfm_server_giant_lock_stat_get(peer, xid, sizep,
+		    from_client, skip);
+		break;
 	case GFM_PROTO_REPLICA_LIST_BY_NAME:
 		e = gfm_server_replica_list_by_name(peer, xid, sizep,
 		    from_client, skip);
@@ -958,6 +994,9 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		    from_client, skip, level, request, requestp, on_errorp);
 		break;
 	}
+	giant_stat_owner_set(saved_owner);
+	giant_set_shared_mode(0);
+
 	if (skip && request != GFM_PROTO_COMPOUND_ON_ERROR)
 		(void)gfm_server_put_reply(peer, xid, sizep, "skipping",
 		    GFARM_ERR_RPC_REQUEST_IGNORED, "");
@@ -977,6 +1016,7 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		if (e == GFARM_ERR_NO_ERROR)
 			e = e2;
 	}
+	rpcstat_request_end(&rs, peer_get_conn(peer), request, e);
 
 	/* continue unless protocol error happens */
 	return (e);
@@ -1032,6 +1072,7 @@ protocol_service(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep)
 	static const char diag[] = "protocol_service";
 
 	from_client = peer_get_auth_id_type(peer) == GFARM_AUTH_ID_TYPE_USER;
+	(void)giant_stat_owner_set(GIANT_STAT_OWNER_PROTOCOL);
 	if (ps->nesting_level == 0) { /* top level */
 		e = protocol_switch(peer, xid, sizep, from_client, 0, 0,
 		    &request, &dummy, &suspended);
@@ -1571,6 +1612,60 @@ boot_apply_db_journal(void)
 	db_journal_init_seqnum();
 }
 
+/*
+ * use a metadata snapshot instead of the DB, if the journal file
+ * still holds the records after the snapshot.
+ */
+static void
+open_db_snapshot(void)
+{
+	gfarm_error_t e;
+	gfarm_uint64_t seqnum;
+
+	if ((e = db_snapshot_open(db_journal_get_current_seqnum(), &seqnum))
+	    != GFARM_ERR_NO_ERROR) {
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "metadata snapshot isn't used: %s", gfarm_error_string(e));
+	} else if ((e = db_journal_replay_begin(seqnum))
+	    != GFARM_ERR_NO_ERROR) {
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "metadata snapshot at seqnum %llu isn't used: %s",
+		    (unsigned long long)seqnum, gfarm_error_string(e));
+		db_snapshot_close(0);
+	} else {
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "loading metadata snapshot at seqnum %llu",
+		    (unsigned long long)seqnum);
+	}
+}
+
+static void
+close_db_snapshot(void)
+{
+	gfarm_error_t e;
+
+	if ((e = db_journal_replay_namespace()) != GFARM_ERR_NO_ERROR) {
+		/* the next boot will load the DB */
+		db_snapshot_close(1);
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "replaying journal after metadata snapshot: %s",
+		    gfarm_error_string(e));
+	}
+	db_snapshot_close(0);
+}
+
+static void
+start_db_snapshot_thread(void)
+{
+	gfarm_error_t e;
+
+	if ((e = create_detached_thread(db_snapshot_thread, NULL))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "create_detached_thread(db_snapshot_thread): %s",
+		    gfarm_error_string(e));
+}
+
 static void
 start_gfmdc_threads(void)
 {
@@ -1825,7 +1920,10 @@ sigs_handler(void *p)
 #endif
 		case SIGUSR2:
 			thrpool_info();
+			inode_memory_info();
 			replica_check_info();
+			file_replication_info();
+			db_journal_group_commit_info();
 			continue;
 
 		/* some of these will be never delivered due to `*sigs' */
@@ -1893,6 +1991,11 @@ gfmd_terminate(const char *diag)
 		free(iostat_dirbuf);
 		iostat_dirbuf = NULL;
 	}
+	if (rpcstat_path) {
+		unlink(rpcstat_path);
+		free(rpcstat_path);
+		rpcstat_path = NULL;
+	}
 
 	gflog_info(GFARM_MSG_1000202, "bye");
 	exit(0);
@@ -1946,6 +2049,8 @@ gfmd_modules_init_default(int table_size)
 		gflog_info(GFARM_MSG_UNFIXED, "start reading db journal");
 		db_journal_init();
 		boot_apply_db_journal();
+		if (gfarm_get_metadb_snapshot_interval() > 0)
+			open_db_snapshot();
 	}
 	gflog_info(GFARM_MSG_UNFIXED, "start initializing modules and "
 	    "loading database");
@@ -1961,11 +2066,17 @@ gfmd_modules_init_default(int table_size)
 	group_init();
 
 	/* filesystem */
-	inode_init();
-	dir_entry_init();
-	file_copy_init();
-	symlink_init();
-	xattr_init();
+	if (gfarm_get_metadb_server_load_threads() > 1)
+		loader_load_filesystem(gfarm_get_metadb_server_load_threads());
+	else {
+		inode_init();
+		dir_entry_init();
+		file_copy_init();
+		symlink_init();
+		xattr_init();
+	}
+	if (db_snapshot_is_loaded())
+		close_db_snapshot();
 	quota_init();
 
 	/* must be after hosts and filesystem */
@@ -2191,6 +2302,19 @@ main(int argc, char **argv)
 			gflog_fatal(GFARM_MSG_1003611,
 				"gfarm_iostat_mmap(%s): %s",
 				iostat_dirbuf, gfarm_error_string(e));
+
+		/* per-request statistics, in the same directory */
+		len = strlen(iostat_dirbuf) + 4 + 1;
+		GFARM_MALLOC_ARRAY(rpcstat_path, len);
+		if (rpcstat_path == NULL)
+			gflog_fatal(GFARM_MSG_UNFIXED, "rpcstat_path:%s",
+			gfarm_error_string(GFARM_ERR_NO_MEMORY));
+		snprintf(rpcstat_path, len, "%s-rpc", iostat_dirbuf);
+		e = rpcstat_init(rpcstat_path);
+		if (e != GFARM_ERR_NO_ERROR)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+				"rpcstat_init(%s): %s",
+				rpcstat_path, gfarm_error_string(e));
 	}
 	/*
 	 * gfmd shouldn't/cannot read/write DB
@@ -2210,8 +2334,11 @@ main(int argc, char **argv)
 		    "create_detached_thread(resumer): %s",
 		    gfarm_error_string(e));
 
-	if (gfarm_get_metadb_replication_enabled())
+	if (gfarm_get_metadb_replication_enabled()) {
 		start_db_journal_threads();
+		if (gfarm_get_metadb_snapshot_interval() > 0)
+			start_db_snapshot_thread();
+	}
 	if (mdhost_self_is_master()) {
 		gflog_info(GFARM_MSG_UNFIXED, "start filesystem check");
 		/* these functions write db, thus, must be after db_thread  */
@@ -2221,6 +2348,11 @@ main(int argc, char **argv)
 		quota_check();
 	}
 	inode_free_orphan();
+	/* the journal apply thread of a slave may be running */
+	giant_lock();
+	inode_nlink_ini_table_free();
+	giant_unlock();
+	inode_memory_info();
 	gflog_info(GFARM_MSG_UNFIXED, "end bootstrap");
 	if (gfarm_get_metadb_replication_enabled()) {
 		is_master = mdhost_self_is_master();
@@ -27,6 +27,7 @@ struct thread_pool *sync_protocol_get_thrpool(void);
 #define PROTO_USE_FD_SAVED	0x04
 #define PROTO_SET_FD_CURRENT	0x08
 #define PROTO_SET_FD_SAVED	0x10
+#define PROTO_READ_ONLY		0x20 /* may run under shared giant_lock */
 int gfm_server_protocol_type_extension_default(gfarm_int32_t);
 extern int (*gfm_server_protocol_type_extension)(gfarm_int32_t);
 
@@ -2136,6 +2136,66 @@ gfmdc_master_client_remote_gfs_rpc(struct abstract_host *ah,
 	    remote_peer_get_remote_peer_id(rp)));
 }
 
+/*
+ * Internal function of gfmdc_master_client_remote_gfs_params_rpc().
+ * It converts '...' to va_list, in order to call
+ * async_client_vsend_wrapped_params_request().
+ */
+static gfarm_error_t
+gfmdc_master_client_remote_gfs_params_rpc0(struct abstract_host *ah,
+	struct peer *peer, const char *diag,
+	gfarm_int32_t (*result_callback)(void *, void *, size_t),
+	void (*disconnect_callback)(void *, void *), void *closure,
+	gfarm_int32_t command, size_t size,
+	gfarm_error_t (*send_params)(struct gfp_xdr *, void *), void *params,
+	const char *wformat, ...)
+{
+	gfarm_error_t e;
+	struct master_client_remote_gfs_rpc_closure *wclosure;
+	va_list wap;
+	static const char wdiag[] =
+	    "GFM_PROTO_REMOTE_GFS_RPC master (request to slave)";
+
+	gflog_debug(GFARM_MSG_UNFIXED, "%s: sending request", wdiag);
+
+	/* see gfmdc_master_client_remote_gfs_rpc0() about 'wclosure' */
+	wclosure = master_client_remote_gfs_rpc_closure_alloc(result_callback,
+	    disconnect_callback, closure);
+	if (wclosure == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: no memory", wdiag);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+
+	va_start(wap, wformat);
+	e = async_client_vsend_wrapped_params_request(ah, peer, diag,
+	    gfmdc_master_client_remote_gfs_rpc_result,
+	    gfmdc_master_client_remote_gfs_rpc_disconnect, wclosure,
+	    wformat, &wap, command, size, send_params, params);
+	va_end(wap);
+
+	return (e);
+}
+
+/*
+ * Same as gfmdc_master_client_remote_gfs_rpc(), but the parameters of
+ * the GFS protocol request are sent by `send_params'.
+ */
+gfarm_error_t
+gfmdc_master_client_remote_gfs_params_rpc(struct abstract_host *ah,
+	struct peer *peer, const char *diag,
+	gfarm_int32_t (*result_callback)(void *, void *, size_t),
+	void (*disconnect_callback)(void *, void *), void *closure,
+	gfarm_int32_t command, size_t size,
+	gfarm_error_t (*send_params)(struct gfp_xdr *, void *), void *params)
+{
+	struct remote_peer *rp = peer_to_remote_peer(peer);
+
+	return (gfmdc_master_client_remote_gfs_params_rpc0(ah, peer, diag,
+	    result_callback, disconnect_callback, closure, command,
+	    size, send_params, params, "il", GFM_PROTO_REMOTE_GFS_RPC,
+	    remote_peer_get_remote_peer_id(rp)));
+}
+
 /*
  * Internal function of gfmdc_server_vput_remote_gfs_rpc_reply().
  * It converts '...' to va_list, in order to call
@@ -2799,7 +2859,12 @@ gfmdc_journal_sync_multiple(gfarm_uint64_t seqnum)
 	mdhost_foreach(gfmdc_journal_sync_count_host, &nhosts);
 	if (nhosts == 0) {
 		if (gfarm_get_journal_sync_file()) {
-			int e = db_journal_file_writer_sync();
+			int e;
+
+			/* the caller waits for this in giant_unlock() */
+			if (db_journal_group_commit_request(seqnum))
+				return (GFARM_ERR_NO_ERROR);
+			e = db_journal_file_writer_sync();
 			if (e != GFARM_ERR_NO_ERROR) {
 				gflog_fatal(GFARM_MSG_UNFIXED,
 				    "failed to sync the journal file: %s",
@@ -28,6 +28,11 @@ gfarm_error_t gfmdc_master_client_remote_gfs_rpc(struct abstract_host *,
 	struct peer *, const char *, gfarm_int32_t (*)(void *, void *, size_t),
 	void (*)(void *, void *), void *, gfarm_int32_t, const char *,
 	va_list *);
+gfarm_error_t gfmdc_master_client_remote_gfs_params_rpc(
+	struct abstract_host *, struct peer *, const char *,
+	gfarm_int32_t (*)(void *, void *, size_t), void (*)(void *, void *),
+	void *, gfarm_int32_t, size_t,
+	gfarm_error_t (*)(struct gfp_xdr *, void *), void *);
 gfarm_error_t gfmdc_server_vput_remote_gfs_rpc_reply(struct abstract_host *,
 	struct peer *, gfp_xdr_xid_t, const char *, gfarm_error_t,
 	char *, va_list *);
@@ -0,0 +1,314 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdarg.h> /* gfp_xdr.h needs this */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+
+#include "gfp_xdr.h"
+#include "gfm_proto.h"
+#include "config.h"
+
+#include "gfm_proto_name.h"
+#include "giant_stat.h"
+
+/*
+ * giant_lock contention profiler.
+ *
+ * for each owner (a request, or a background activity),
+ * the time waiting for giant_lock and the time holding it are recorded
+ * into histograms whose bucket i (i > 0) counts durations in
+ * [2^(i-1), 2^i) microseconds, and bucket 0 counts shorter ones.
+ * the last bucket also counts all longer durations.
+ *
+ * the overhead is two clock readings and an uncontended mutex per
+ * giant_lock()/giant_unlock() pair, and none when
+ * "metadb_server_giant_lock_profile disable" is specified,
+ * unless the wait time is required by giant_stat_measure_wait().
+ */
+
+#define NBUCKETS	GFM_PROTO_GIANT_LOCK_STAT_NBUCKETS
+
+struct giant_stat_entry {
+	pthread_mutex_t mutex; /* giant_lock may be held in shared mode */
+	struct giant_stat stat;
+};
+
+/* per thread state */
+struct giant_stat_thread {
+	int owner;
+	int timing; /* giant_lock is held, and its hold time is measured */
+	int shared;
+	gfarm_uint64_t wait; /* microseconds */
+	gfarm_uint64_t wait_sum; /* microseconds, see giant_stat_wait_sum() */
+	struct timespec locked_at;
+};
+
+static struct giant_stat_entry giant_stat_table[GIANT_STAT_NOWNERS];
+static pthread_key_t giant_stat_key;
+static int giant_stat_wait_required;
+
+static const char GIANT_STAT_MUTEX_DIAG[] = "giant_stat_mutex";
+
+const char *
+giant_stat_owner_name(int owner)
+{
+	const char *name;
+
+	switch (owner) {
+	case GIANT_STAT_OWNER_OTHER:
+		return ("(other)");
+	case GIANT_STAT_OWNER_PRIVATE_PROTO:
+		return ("(private protocol)");
+	case GIANT_STAT_OWNER_PROTOCOL:
+		return ("(protocol housekeeping)");
+	case GIANT_STAT_OWNER_DEAD_FILE_COPY:
+		return ("(dead_file_copy)");
+	case GIANT_STAT_OWNER_REPLICA_CHECK:
+		return ("(replica_check)");
+	case GIANT_STAT_OWNER_DB_JOURNAL:
+		return ("(db_journal)");
+	case GIANT_STAT_OWNER_DB_SNAPSHOT:
+		return ("(db_snapshot)");
+	}
+	name = gfm_proto_name(owner);
+	return (name != NULL ? name : "(unknown request)");
+}
+
+static void
+giant_stat_thread_free(void *p)
+{
+	free(p);
+}
+
+void
+giant_stat_init(void)
+{
+	int i, err;
+	static const char diag[] = "giant_stat_init";
+
+	err = pthread_key_create(&giant_stat_key, giant_stat_thread_free);
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: key create: %s",
+		    diag, strerror(err));
+	for (i = 0; i < GIANT_STAT_NOWNERS; i++)
+		gfarm_mutex_init(&giant_stat_table[i].mutex, diag,
+		    GIANT_STAT_MUTEX_DIAG);
+}
+
+/* returns NULL, if no memory */
+static struct giant_stat_thread *
+giant_stat_thread_get(void)
+{
+	struct giant_stat_thread *st = pthread_getspecific(giant_stat_key);
+	int err;
+
+	if (st != NULL)
+		return (st);
+	GFARM_MALLOC(st);
+	if (st == NULL)
+		return (NULL);
+	st->owner = GIANT_STAT_OWNER_OTHER;
+	st->timing = 0;
+	st->shared = 0;
+	st->wait = 0;
+	st->wait_sum = 0;
+	err = pthread_setspecific(giant_stat_key, st);
+	if (err != 0) {
+		gflog_warning(GFARM_MSG_UNFIXED, "giant_stat: setspecific: %s",
+		    strerror(err));
+		free(st);
+		return (NULL);
+	}
+	return (st);
+}
+
+/* convert a request number to an owner */
+int
+giant_stat_request_owner(gfarm_int32_t request)
+{
+	if (request < 0 || request >= GIANT_STAT_NPROTO)
+		return (GIANT_STAT_OWNER_PRIVATE_PROTO);
+	return (request);
+}
+
+/*
+ * set the owner of giant_lock for this thread.
+ * returns the previous owner.
+ */
+int
+giant_stat_owner_set(int owner)
+{
+	struct giant_stat_thread *st = giant_stat_thread_get();
+	int old_owner;
+
+	if (st == NULL)
+		return (GIANT_STAT_OWNER_OTHER);
+	old_owner = st->owner;
+	st->owner = owner;
+	return (old_owner);
+}
+
+static gfarm_uint64_t
+giant_stat_elapsed(const struct timespec *from, const struct timespec *to)
+{
+	gfarm_int64_t usec;
+
+	usec = (gfarm_int64_t)(to->tv_sec - from->tv_sec) *
+	    GFARM_SECOND_BY_MICROSEC +
+	    (to->tv_nsec - from->tv_nsec) / GFARM_MICROSEC_BY_NANOSEC;
+	return (usec < 0 ? 0 : usec); /* clock may be adjusted */
+}
+
+static int
+giant_stat_bucket(gfarm_uint64_t usec)
+{
+	int i;
+
+	for (i = 0; usec != 0 && i < NBUCKETS - 1; i++)
+		usec >>= 1;
+	return (i);
+}
+
+/*
+ * measure the wait time for giant_lock, even if the profiler is disabled.
+ * this should be called before any thread is created.
+ */
+void
+giant_stat_measure_wait(void)
+{
+	giant_stat_wait_required = 1;
+}
+
+/*
+ * returns the total time which this thread waited for giant_lock
+ * in microseconds, if the wait time is measured.
+ */
+gfarm_uint64_t
+giant_stat_wait_sum(void)
+{
+	struct giant_stat_thread *st = pthread_getspecific(giant_stat_key);
+
+	return (st == NULL ? 0 : st->wait_sum);
+}
+
+/* called before waiting for giant_lock */
+void
+giant_stat_wait_begin(struct timespec *startp)
+{
+	if (gfarm_metadb_giant_lock_profile || giant_stat_wait_required)
+		gfarm_gettime(startp);
+	else
+		startp->tv_nsec = -1; /* not measured */
+}
+
+/*
+ * called after giant_lock is acquired.
+ * startp == NULL means that giant_lock was acquired without waiting.
+ */
+void
+giant_stat_locked(struct timespec *startp, int shared)
+{
+	struct giant_stat_thread *st;
+
+	if (startp != NULL ? startp->tv_nsec == -1 :
+	    !gfarm_metadb_giant_lock_profile)
+		return;
+	if ((st = giant_stat_thread_get()) == NULL)
+		return;
+	gfarm_gettime(&st->locked_at);
+	st->wait = startp == NULL ? 0 :
+	    giant_stat_elapsed(startp, &st->locked_at);
+	st->wait_sum += st->wait;
+	st->shared = shared;
+	st->timing = gfarm_metadb_giant_lock_profile;
+}
+
+/* called before giant_lock is released */
+void
+giant_stat_unlocking(void)
+{
+	struct giant_stat_thread *st = pthread_getspecific(giant_stat_key);
+	struct giant_stat_entry *entry;
+	struct giant_stat *gs;
+	struct timespec now;
+	gfarm_uint64_t hold;
+	static const char diag[] = "giant_stat_unlocking";
+
+	if (st == NULL || !st->timing)
+		return;
+	st->timing = 0;
+	gfarm_gettime(&now);
+	hold = giant_stat_elapsed(&st->locked_at, &now);
+
+	entry = &giant_stat_table[st->owner];
+	gs = &entry->stat;
+	gfarm_mutex_lock(&entry->mutex, diag, GIANT_STAT_MUTEX_DIAG);
+	gs->count++;
+	if (st->shared)
+		gs->shared_count++;
+	gs->wait_total += st->wait;
+	if (gs->wait_max < st->wait)
+		gs->wait_max = st->wait;
+	gs->wait_hist[giant_stat_bucket(st->wait)]++;
+	gs->hold_total += hold;
+	if (gs->hold_max < hold)
+		gs->hold_max = hold;
+	gs->hold_hist[giant_stat_bucket(hold)]++;
+	gfarm_mutex_unlock(&entry->mutex, diag, GIANT_STAT_MUTEX_DIAG);
+}
+
+/*
+ * copy statistics of owners which have ever held giant_lock
+ * to stats[] and owners[], each of which must have
+ * GIANT_STAT_NOWNERS elements.
+ * returns the number of the copied entries.
+ */
+int
+giant_stat_snapshot(struct giant_stat *stats, int *owners, int reset)
+{
+	int owner, n = 0;
+	struct giant_stat_entry *entry;
+	static const char diag[] = "giant_stat_snapshot";
+
+	/* giant_lock isn't necessary */
+	for (owner = 0; owner < GIANT_STAT_NOWNERS; owner++) {
+		entry = &giant_stat_table[owner];
+		gfarm_mutex_lock(&entry->mutex, diag, GIANT_STAT_MUTEX_DIAG);
+		if (entry->stat.count > 0) {
+			stats[n] = entry->stat;
+			owners[n] = owner;
+			n++;
+		}
+		if (reset)
+			memset(&entry->stat, 0, sizeof(entry->stat));
+		gfarm_mutex_unlock(&entry->mutex, diag, GIANT_STAT_MUTEX_DIAG);
+	}
+	return (n);
+}
+
+/* send a reply entry of GFM_PROTO_GIANT_LOCK_STAT_GET */
+gfarm_error_t
+giant_stat_send(struct gfp_xdr *client, int owner, struct giant_stat *gs)
+{
+	gfarm_error_t e;
+	int i;
+
+	e = gfp_xdr_send(client, "sllllll", giant_stat_owner_name(owner),
+	    gs->count, gs->shared_count,
+	    gs->wait_total, gs->wait_max, gs->hold_total, gs->hold_max);
+	for (i = 0; i < NBUCKETS && e == GFARM_ERR_NO_ERROR; i++)
+		e = gfp_xdr_send(client, "l", gs->wait_hist[i]);
+	for (i = 0; i < NBUCKETS && e == GFARM_ERR_NO_ERROR; i++)
+		e = gfp_xdr_send(client, "l", gs->hold_hist[i]);
+	return (e);
+}
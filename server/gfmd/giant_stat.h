@@ -0,0 +1,40 @@
+/*
+ * giant_lock contention profiler
+ *
+ * an owner is either a GFM_PROTO_* request number,
+ * or one of the following background activities.
+ */
+#define GIANT_STAT_NPROTO	(GFM_PROTO_METADB_SERVER_RESERVE15 + 1)
+
+#define GIANT_STAT_OWNER_OTHER		(GIANT_STAT_NPROTO + 0)
+#define GIANT_STAT_OWNER_PRIVATE_PROTO	(GIANT_STAT_NPROTO + 1)
+#define GIANT_STAT_OWNER_PROTOCOL	(GIANT_STAT_NPROTO + 2)
+#define GIANT_STAT_OWNER_DEAD_FILE_COPY	(GIANT_STAT_NPROTO + 3)
+#define GIANT_STAT_OWNER_REPLICA_CHECK	(GIANT_STAT_NPROTO + 4)
+#define GIANT_STAT_OWNER_DB_JOURNAL	(GIANT_STAT_NPROTO + 5)
+#define GIANT_STAT_OWNER_DB_SNAPSHOT	(GIANT_STAT_NPROTO + 6)
+#define GIANT_STAT_NOWNERS		(GIANT_STAT_NPROTO + 7)
+
+struct giant_stat {
+	gfarm_uint64_t count, shared_count;
+	gfarm_uint64_t wait_total, wait_max; /* microseconds */
+	gfarm_uint64_t hold_total, hold_max; /* microseconds */
+	gfarm_uint64_t wait_hist[GFM_PROTO_GIANT_LOCK_STAT_NBUCKETS];
+	gfarm_uint64_t hold_hist[GFM_PROTO_GIANT_LOCK_STAT_NBUCKETS];
+};
+
+struct timespec;
+
+void giant_stat_init(void);
+int giant_stat_request_owner(gfarm_int32_t);
+int giant_stat_owner_set(int);
+void giant_stat_measure_wait(void);
+gfarm_uint64_t giant_stat_wait_sum(void);
+void giant_stat_wait_begin(struct timespec *);
+void giant_stat_locked(struct timespec *, int);
+void giant_stat_unlocking(void);
+
+const char *giant_stat_owner_name(int);
+int giant_stat_snapshot(struct giant_stat *, int *, int);
+struct gfp_xdr;
+gfarm_error_t giant_stat_send(struct gfp_xdr *, int, struct giant_stat *);
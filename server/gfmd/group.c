@@ -268,6 +268,13 @@ group_name(struct group *g)
 	    g->groupname : REMOVED_GROUP_NAME);
 }
 
+/* unlike group_name(), this returns the name of an invalid group as is */
+char *
+group_name_even_invalid(struct group *g)
+{
+	return (g->groupname);
+}
+
 struct quota *
 group_quota(struct group *g)
 {
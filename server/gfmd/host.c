@@ -47,9 +47,11 @@
 #include "netsendq.h"
 #include "dead_file_copy.h"
 #include "file_replication.h"
+#include "host_placement.h"
 #include "back_channel.h"
 #include "relay.h"
 #include "replica_check.h"
+#include "giant_stat.h"
 
 #define HOST_HASHTAB_SIZE	3079	/* prime number */
 
@@ -91,6 +93,15 @@ struct host {
 	gfarm_time_t last_report;
 	gfarm_time_t disconnect_time;
 	int status_callout_retry;
+
+	/* maintained by inode.c, protected by the giant_lock() */
+	struct host_replica_index *replica_index;
+
+	/* ongoing replications from/to this host, protected by giant_lock */
+	int n_replications;
+
+	/* maintained by file_replication.c, protected by the giant_lock() */
+	struct replication_shaper_host *replication_shaper;
 };
 
 static struct gfarm_hash_table *host_hashtab = NULL;
@@ -464,6 +475,13 @@ host_supports_async_protocols(struct host *h)
 		>= GFS_PROTOCOL_VERSION_V2_4);
 }
 
+int
+host_supports_fhremove_batch(struct host *h)
+{
+	return (abstract_host_get_protocol_version(&h->ah)
+		>= GFS_PROTOCOL_VERSION_V2_5_8);
+}
+
 static void
 back_channel_mutex_lock(struct host *h, const char *diag)
 {
@@ -615,6 +633,35 @@ host_status_callout(struct host *h)
 	return (h->status_callout);
 }
 
+/* PREREQUISITE: giant_lock */
+struct replication_shaper_host *
+host_get_replication_shaper(struct host *h)
+{
+	return (h->replication_shaper);
+}
+
+/* PREREQUISITE: giant_lock */
+void
+host_set_replication_shaper(struct host *h,
+	struct replication_shaper_host *shaper)
+{
+	h->replication_shaper = shaper;
+}
+
+/* PREREQUISITE: giant_lock */
+struct host_replica_index *
+host_get_replica_index(struct host *h)
+{
+	return (h->replica_index);
+}
+
+/* PREREQUISITE: giant_lock */
+void
+host_set_replica_index(struct host *h, struct host_replica_index *index)
+{
+	h->replica_index = index;
+}
+
 /*
  * if host_get_peer() is called,
  * same number of host_put_peer() calls should be made.
@@ -706,7 +753,7 @@ host_set_peer_unlocked(struct abstract_host *ah, struct peer *p)
 
 	dead_file_copy_host_becomes_up(host);
 	netsendq_host_becomes_up(abstract_host_get_sendq(ah));
-	replica_check_signal_host_up();
+	replica_check_signal_host_up(host);
 }
 
 /*
@@ -742,7 +789,7 @@ host_disable(struct abstract_host *ah)
 	back_channel_mutex_unlock(h, diag);
 
 	host_total_disk_update(saved_used, saved_avail, 0, 0);
-	replica_check_signal_host_down();
+	replica_check_signal_host_down(h);
 }
 
 static void
@@ -813,6 +860,9 @@ host_new(struct gfarm_host_info *hi, struct callout *callout)
 	h->status.disk_avail = 0;
 	h->status_callout = callout;
 	h->status_callout_retry = 0;
+	h->replica_index = NULL;
+	h->n_replications = 0;
+	h->replication_shaper = NULL;
 	h->last_report = 0;
 	h->disconnect_time = time(NULL);
 	return (h);
@@ -1066,20 +1116,65 @@ host_number()
 }
 
 /*
- * just select randomly		XXX FIXME: needs to improve
+ * select by the cost, see host_placement.c
+ *
+ * PREREQUISITE: giant_lock
+ * LOCKS: host::back_channel_mutex
+ * SLEEPS: no
  */
-static void
+static gfarm_error_t
 select_hosts(int nhosts, struct host **hosts,
+	int n_existing, struct host **existing,
 	int nresults, struct host **results)
 {
-	int i, j;
+	int i, n;
+	struct host *h;
+	struct host_placement_candidate *cands;
+	const char **groups;
+	static const char diag[] = "select_hosts";
 
 	assert(nhosts > nresults);
-	for (i = 0; i < nresults; i++) {
-		j = gfarm_random() % nhosts;
-		results[i] = hosts[j];
-		hosts[j] = hosts[--nhosts];
+	GFARM_MALLOC_ARRAY(cands, nhosts);
+	GFARM_MALLOC_ARRAY(groups, n_existing + nresults);
+	if (cands == NULL || groups == NULL) {
+		free(cands);
+		free(groups);
+		return (GFARM_ERR_NO_MEMORY);
 	}
+	for (i = 0; i < n_existing; i++)
+		groups[i] = host_fsngroup(existing[i]);
+	for (i = 0; i < nhosts; i++) {
+		h = hosts[i];
+		cands[i].host = h;
+		cands[i].fsngroup = host_fsngroup(h);
+		cands[i].ncpu = h->hi.ncpu;
+		cands[i].n_replications = h->n_replications;
+
+		back_channel_mutex_lock(h, diag);
+		cands[i].loadavg = h->status.loadavg_1min;
+		cands[i].disk_used = h->status.disk_used;
+		cands[i].disk_avail = h->status.disk_avail;
+		back_channel_mutex_unlock(h, diag);
+	}
+	n = host_placement_select(nhosts, cands, n_existing, groups,
+	    nresults, gfarm_random);
+	assert(n == nresults);
+	for (i = 0; i < n; i++)
+		results[i] = cands[i].host;
+	free(cands);
+	free(groups);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * PREREQUISITE: giant_lock
+ * LOCKS: -
+ * SLEEPS: no
+ */
+void
+host_replications_add(struct host *h, int n)
+{
+	h->n_replications += n;
 }
 
 /*
@@ -1164,33 +1259,45 @@ host_schedule_n_except(
 		return (e);
 	}
 	*n_validp = n_before - *nhostsp; /* existing valid replicas */
-	free(up);
 	free(down);
 
 	/* search available hosts */
 	e = host_except(nhostsp, hosts, &n_zero, NULL, filter, closure);
-	if (e != GFARM_ERR_NO_ERROR)
+	if (e != GFARM_ERR_NO_ERROR) {
+		free(up);
 		return (e);
+	}
 
 	nhosts = *nhostsp;
 	n_shortage = n_desired - *n_validp;
 	if (n_shortage <= 0) { /* sufficient */
+		free(up);
 		*n_targetsp = 0;
 		*targetsp = NULL;
 		return (GFARM_ERR_NO_ERROR);
 	}
 	GFARM_MALLOC_ARRAY(targets, n_shortage);
-	if (targets == NULL)
+	if (targets == NULL) {
+		free(up);
 		return (GFARM_ERR_NO_MEMORY);
+	}
 
 	if (nhosts <= n_shortage) { /* just enough or shortage */
 		for (i = 0; i < nhosts; i++)
 			targets[i] = hosts[i];
 		*n_targetsp = nhosts;
 	} else { /* too enough targets */
-		select_hosts(nhosts, hosts, n_shortage, targets);
+		/* up[] is used to spread replicas over fsngroups */
+		e = select_hosts(nhosts, hosts, n_up, up,
+		    n_shortage, targets);
+		if (e != GFARM_ERR_NO_ERROR) {
+			free(up);
+			free(targets);
+			return (e);
+		}
 		*n_targetsp = n_shortage;
 	}
+	free(up);
 	*targetsp = targets;
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -2291,6 +2398,69 @@ gfm_server_statfs(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	    &e, "lll", &used, &avail, &files));
 }
 
+/* this is not relayed, every gfmd replies its own statistics */
+gfarm_error_t
+gfm_server_giant_lock_stat_get(struct peer *peer, gfp_xdr_xid_t xid,
+	size_t *sizep, int from_client, int skip)
+{
+	gfarm_error_t e, e2;
+	struct peer *mhpeer;
+	int size_pos;
+	struct user *user = peer_get_user(peer);
+	gfarm_int32_t flags, n = 0, i;
+	struct giant_stat *stats = NULL;
+	int *owners = NULL;
+	static const char diag[] = "GFM_PROTO_GIANT_LOCK_STAT_GET";
+
+	e = gfm_server_get_request(peer, sizep, diag, "i", &flags);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (skip)
+		return (GFARM_ERR_NO_ERROR);
+
+	giant_lock();
+	if (!from_client || user == NULL || !user_is_admin(user)) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "%s: operation is not permitted", diag);
+		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	}
+	giant_unlock();
+
+	if (e == GFARM_ERR_NO_ERROR) {
+		GFARM_MALLOC_ARRAY(stats, GIANT_STAT_NOWNERS);
+		GFARM_MALLOC_ARRAY(owners, GIANT_STAT_NOWNERS);
+		if (stats == NULL || owners == NULL) {
+			e = GFARM_ERR_NO_MEMORY;
+			gflog_debug(GFARM_MSG_UNFIXED, "%s: %s",
+			    diag, gfarm_error_string(e));
+		} else {
+			n = giant_stat_snapshot(stats, owners,
+			    (flags & GFM_PROTO_GIANT_LOCK_STAT_RESET) != 0);
+		}
+	}
+
+	e2 = gfm_server_put_reply_begin(peer, &mhpeer, xid, &size_pos, diag,
+	    e, "ii", n, (gfarm_int32_t)GFM_PROTO_GIANT_LOCK_STAT_NBUCKETS);
+	if (e2 == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < n; i++) {
+			e2 = giant_stat_send(peer_get_conn(peer),
+			    owners[i], &stats[i]);
+			if (e2 != GFARM_ERR_NO_ERROR) {
+				gflog_warning(GFARM_MSG_UNFIXED,
+				    "%s@%s: %s: giant_stat_send() failed: %s",
+				    peer_get_username(peer),
+				    peer_get_hostname(peer),
+				    diag, gfarm_error_string(e2));
+				break;
+			}
+		}
+		gfm_server_put_reply_end(peer, mhpeer, diag, size_pos);
+	}
+	free(stats);
+	free(owners);
+	return (e2);
+}
+
 #endif /* TEST */
 
 /*
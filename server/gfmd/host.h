@@ -27,6 +27,19 @@ struct host *host_addr_lookup(const char *, struct sockaddr *);
 int host_status_callout_retry(struct host *);
 void host_disconnect_request(struct host *, struct peer *);
 struct callout *host_status_callout(struct host *);
+
+/* per-host index of file_copy, maintained by inode.c */
+struct host_replica_index;
+struct host_replica_index *host_get_replica_index(struct host *);
+void host_set_replica_index(struct host *, struct host_replica_index *);
+
+/* number of ongoing replications, maintained by file_replication.c */
+void host_replications_add(struct host *, int);
+struct replication_shaper_host;
+struct replication_shaper_host *host_get_replication_shaper(struct host *);
+void host_set_replication_shaper(struct host *,
+	struct replication_shaper_host *);
+
 struct peer *host_get_peer(struct host *);
 struct peer *host_get_peer_by_generation(struct host *, gfarm_uint32_t);
 void host_put_peer(struct host *, struct peer *);
@@ -40,6 +53,7 @@ int host_flags(struct host *);
 char *host_fsngroup(struct host *);
 struct netsendq *host_sendq(struct host *);
 int host_supports_async_protocols(struct host *);
+int host_supports_fhremove_batch(struct host *);
 int host_is_disk_available(struct host *, gfarm_off_t);
 
 #ifdef COMPAT_GFARM_2_3
@@ -115,6 +129,8 @@ gfarm_error_t gfm_server_schedule_host_domain(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_statfs(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
+gfarm_error_t gfm_server_giant_lock_stat_get(
+	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 
 
 /* exported for a use from a private extension */
@@ -0,0 +1,91 @@
+/*
+ * $Id$
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gfarm/gfarm.h>
+
+#include "host_placement.h"
+
+/*
+ * weights of the cost.  each term is normalized to be about 1.0,
+ * when the host is as busy as a host should usually be.
+ */
+#define COST_REPLICATION	1.0	/* per ongoing replication */
+#define COST_LOADAVG		1.0	/* per loadavg / ncpu */
+#define COST_DISK_USAGE		2.0	/* disk_used / disk total */
+#define COST_FSNGROUP		1.0	/* per replica in the same fsngroup */
+#define COST_JITTER		0.1	/* to spread targets of same cost */
+
+/*
+ * `n_same_fsngroup' is the number of replicas (including the ones
+ * which are just selected) in the fsngroup of the candidate.
+ */
+double
+host_placement_cost(const struct host_placement_candidate *c,
+	int n_same_fsngroup)
+{
+	double cost, total;
+
+	cost = COST_REPLICATION * c->n_replications;
+	cost += COST_LOADAVG * c->loadavg / (c->ncpu > 0 ? c->ncpu : 1);
+	total = (double)c->disk_used + (double)c->disk_avail;
+	if (total > 0)
+		cost += COST_DISK_USAGE * c->disk_used / total;
+	cost += COST_FSNGROUP * n_same_fsngroup;
+	return (cost);
+}
+
+static int
+count_fsngroup(const char *fsngroup, int ngroups, const char **groups)
+{
+	int i, n = 0;
+
+	if (fsngroup[0] == '\0') /* not specified */
+		return (0);
+	for (i = 0; i < ngroups; i++) {
+		if (strcmp(fsngroup, groups[i]) == 0)
+			n++;
+	}
+	return (n);
+}
+
+/*
+ * select `nresults' hosts from `ncands' candidates greedily in the order
+ * of the cost.  groups[] are fsngroups of existing replicas, and
+ * it must have room for `nresults' more entries.
+ * selected hosts are moved to the head of cands[], and
+ * the number of them is returned.
+ */
+int
+host_placement_select(int ncands, struct host_placement_candidate *cands,
+	int ngroups, const char **groups, int nresults,
+	long (*random_func)(void))
+{
+	int i, best, n;
+	double cost, best_cost = 0;
+	struct host_placement_candidate tmp;
+
+	for (n = 0; n < nresults && n < ncands; n++) {
+		best = -1;
+		for (i = n; i < ncands; i++) {
+			cost = host_placement_cost(&cands[i],
+			    count_fsngroup(cands[i].fsngroup,
+			    ngroups, groups)) +
+			    COST_JITTER * (random_func() % 1024) / 1024.0;
+			if (best == -1 || cost < best_cost) {
+				best = i;
+				best_cost = cost;
+			}
+		}
+		cands[best].cost = best_cost;
+		groups[ngroups++] = cands[best].fsngroup;
+
+		tmp = cands[n];
+		cands[n] = cands[best];
+		cands[best] = tmp;
+	}
+	return (n);
+}
@@ -0,0 +1,25 @@
+/*
+ * $Id$
+ */
+
+/*
+ * cost-based selection of replication targets.
+ *
+ * this doesn't depend on other parts of gfmd, so that the simulator
+ * in regress/server/gfmd/host_placement can replay a placement trace
+ * offline with the same algorithm.
+ */
+struct host_placement_candidate {
+	void *host;		/* opaque to host_placement.c */
+	const char *fsngroup;	/* "" if not specified */
+	int ncpu;
+	double loadavg;		/* loadavg_1min */
+	gfarm_off_t disk_used, disk_avail; /* KiB */
+	int n_replications;	/* ongoing replications from/to the host */
+
+	double cost;		/* set by host_placement_select() */
+};
+
+double host_placement_cost(const struct host_placement_candidate *, int);
+int host_placement_select(int, struct host_placement_candidate *,
+	int, const char **, int, long (*)(void));
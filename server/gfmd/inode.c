@@ -22,6 +22,7 @@
 #include "gfutil.h"
 #include "nanosec.h"
 #include "thrsubr.h"
+#include "tree.h"
 
 #include "context.h"
 #include "config.h"
@@ -48,6 +49,8 @@
 #include "repattr.h"
 #include "fsngroup.h"
 #include "replica_check.h"
+#include "db_snapshot.h"
+#include "slab.h"
 
 #include "auth.h" /* for "peer.h" */
 #include "peer.h" /* peer_reset_pending_new_generation() */
@@ -56,8 +59,12 @@
 #define MAX_DIR_DEPTH			1024	/* == GFARM_PATH_MAX */
 
 #define ROOT_INUMBER			2
-#define INODE_TABLE_SIZE_INITIAL	1000
-#define INODE_TABLE_SIZE_MULTIPLY	2
+#define INODE_TABLE_CHUNK_SHIFT		16
+#define INODE_TABLE_CHUNK_SIZE	((gfarm_ino_t)1 << INODE_TABLE_CHUNK_SHIFT)
+#define INODE_TABLE_CHUNK_MASK		(INODE_TABLE_CHUNK_SIZE - 1)
+#define INODE_TABLE_BITMAP_WORDS	(INODE_TABLE_CHUNK_SIZE / 64)
+#define INODE_TABLE_NCHUNKS_INITIAL	16
+#define INODE_TABLE_NCHUNKS_MULTIPLY	2
 
 #define INODE_MODE_FREE			0	/* struct inode:i_mode */
 
@@ -69,6 +76,10 @@ struct file_copy {
 	int flags; /* 0, if there is ongoing replication about lastest gen */
 #define FILE_COPY_VALID		1
 #define FILE_COPY_BEING_REMOVED	2
+
+	/* see host_replica_index */
+	struct inode *inode;
+	RB_ENTRY(file_copy) host_node;
 };
 
 #define FILE_COPY_IS_VALID(fc) \
@@ -88,6 +99,7 @@ struct file_copy {
  *	}
  */
 
+/* head->prev points to the tail, to save a pointer in each inode */
 struct xattr_entry {
 	struct xattr_entry *prev, *next;
 	char *name;
@@ -96,14 +108,18 @@ struct xattr_entry {
 };
 
 struct xattrs {
-	struct xattr_entry *head, *tail;
+	struct xattr_entry *head;
 };
 
+/*
+ * struct inode is kept as small as possible, since gfmd holds all of them.
+ * rarely used members are in struct inode_cold, which is allocated
+ * on demand, and nlink_ini is in inode_nlink_ini_table.
+ */
 struct inode {
 	gfarm_ino_t i_number;
 	gfarm_uint64_t i_gen;
 	gfarm_uint64_t i_nlink;
-	gfarm_uint64_t i_nlink_ini; /* only used at gfmd startup */
 	gfarm_off_t i_size;
 	struct user *i_user;
 	struct group *i_group;
@@ -111,9 +127,8 @@ struct inode {
 	gfarm_mode_t i_mode;
 	struct gfarm_timespec i_mtimespec;
 	struct gfarm_timespec i_ctimespec;
-	struct xattrs i_xattrs, i_xmlattrs;
-
-	struct dead_file_copy_list *dead_copies; /* even free inode may have */
+	struct xattrs i_xattrs;
+	struct inode_cold *i_cold; /* NULL, if all members are empty */
 
 	union {
 		struct inode_free_link {
@@ -124,6 +139,10 @@ struct inode {
 				struct inode_file {
 					struct file_copy *copies;
 					struct checksum *cksum;
+
+					/* see inode_file_get_parent() */
+					struct inode *parent;
+					gfarm_uint64_t parent_gen;
 				} f;
 				struct inode_dir {
 					Dir entries;
@@ -140,6 +159,11 @@ struct inode {
 	} u;
 };
 
+struct inode_cold {
+	struct xattrs i_xmlattrs;
+	struct dead_file_copy_list *dead_copies; /* even free inode may have */
+};
+
 struct checksum {
 	char *type;
 	size_t len;
@@ -170,10 +194,44 @@ struct inode_activity {
 	} u;
 };
 
-struct inode **inode_table = NULL;
+/*
+ * inode_table is a two-level table indexed by i_number.
+ * it grows chunk by chunk, thus pointers to existing inodes are never
+ * copied, and only the small array of chunk pointers is reallocated.
+ */
+struct inode_table_chunk {
+	struct inode *inodes[INODE_TABLE_CHUNK_SIZE];
+
+	/*
+	 * a bit is set, if the slot in inodes[] is used.
+	 * not maintained by inode_add_at_loading(), but inode_load_end().
+	 */
+	gfarm_uint64_t used[INODE_TABLE_BITMAP_WORDS];
+	gfarm_ino_t nused;
+
+	/*
+	 * the number of links counted from directory entries,
+	 * only used until inode_nlink_ini_table_free() at the end of bootstrap
+	 */
+	gfarm_uint64_t *nlink_ini;
+};
+
+static struct inode_table_chunk **inode_table = NULL;
+static gfarm_ino_t inode_table_nchunks = 0, inode_table_nchunks_max = 0;
 gfarm_ino_t inode_table_size = 0;
+/* the smallest unused slot in inode_table */
 gfarm_ino_t inode_free_index = ROOT_INUMBER;
 
+static int inode_nlink_ini_table_freed = 0;
+static void inode_set_nlink_ini(struct inode *, gfarm_uint64_t);
+
+static struct slab inode_slab =
+	SLAB_INITIALIZER("inode", sizeof(struct inode));
+static struct slab inode_cold_slab =
+	SLAB_INITIALIZER("inode_cold", sizeof(struct inode_cold));
+static struct slab file_copy_slab =
+	SLAB_INITIALIZER("file_copy", sizeof(struct file_copy));
+
 struct inode inode_free_list; /* dummy header of doubly linked circular list */
 int inode_free_list_initialized = 0;
 
@@ -243,6 +301,174 @@ file_copy_is_being_removed(struct file_copy *file_copy)
 	return (FILE_COPY_IS_BEING_REMOVED(file_copy));
 }
 
+struct inode *
+file_copy_inode(struct file_copy *file_copy)
+{
+	return (file_copy->inode);
+}
+
+/*
+ * file_copy entries of each host, ordered by inode number.
+ *
+ * this makes per-host operations such as REPLICA_LIST_BY_HOST,
+ * REPLICA_REMOVE_BY_HOST and REPLICA_GET_MY_ENTRIES proportional to
+ * the number of replicas on the host, rather than the size of inode_table.
+ * every file_copy linked to inode->u.c.s.f.copies is in this index,
+ * including !FILE_COPY_VALID and FILE_COPY_BEING_REMOVED ones.
+ *
+ * PREREQUISITE of the functions below: giant_lock, or loading
+ * (only file_copy_init() adds file_copy while loading)
+ */
+RB_HEAD(file_copy_tree, file_copy);
+
+struct host_replica_index {
+	struct file_copy_tree tree;
+	gfarm_uint64_t nreplicas;
+};
+
+static int
+file_copy_compare(struct file_copy *a, struct file_copy *b)
+{
+	gfarm_ino_t ia = a->inode->i_number, ib = b->inode->i_number;
+
+	return (ia < ib ? -1 : ia > ib ? 1 : 0);
+}
+
+RB_PROTOTYPE(file_copy_tree, file_copy, host_node, file_copy_compare)
+RB_GENERATE(file_copy_tree, file_copy, host_node, file_copy_compare)
+
+static struct host_replica_index *
+host_replica_index_get(struct host *host)
+{
+	struct host_replica_index *index = host_get_replica_index(host);
+
+	if (index == NULL) {
+		GFARM_MALLOC(index);
+		if (index == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "host %s: no memory for replica index",
+			    host_name(host));
+			return (NULL);
+		}
+		RB_INIT(&index->tree);
+		index->nreplicas = 0;
+		host_set_replica_index(host, index);
+	}
+	return (index);
+}
+
+static void
+host_replica_index_add(struct host_replica_index *index,
+	struct file_copy *copy)
+{
+	if (RB_INSERT(file_copy_tree, &index->tree, copy) != NULL)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "replica index of %s: inode %lld: duplicate entry",
+		    host_name(copy->host),
+		    (long long)copy->inode->i_number);
+	index->nreplicas++;
+}
+
+/* must be called when the copy is unlinked from inode->u.c.s.f.copies */
+static void
+host_replica_index_remove(struct file_copy *copy)
+{
+	struct host_replica_index *index = host_get_replica_index(copy->host);
+
+	assert(index != NULL && index->nreplicas > 0);
+	RB_REMOVE(file_copy_tree, &index->tree, copy);
+	index->nreplicas--;
+}
+
+static void
+file_copy_free(struct file_copy *copy)
+{
+	host_replica_index_remove(copy);
+	slab_free(&file_copy_slab, copy);
+}
+
+/* the first file_copy on the host whose inode number is >= inum */
+struct file_copy *
+host_file_copy_first(struct host *host, gfarm_ino_t inum)
+{
+	struct host_replica_index *index = host_get_replica_index(host);
+	struct file_copy *copy, *found = NULL;
+
+	if (index == NULL)
+		return (NULL);
+	copy = RB_ROOT(&index->tree);
+	while (copy != NULL) {
+		if (copy->inode->i_number >= inum) {
+			found = copy;
+			copy = RB_LEFT(copy, host_node);
+		} else
+			copy = RB_RIGHT(copy, host_node);
+	}
+	return (found);
+}
+
+struct file_copy *
+host_file_copy_next(struct file_copy *copy)
+{
+	return (RB_NEXT(file_copy_tree, NULL, copy));
+}
+
+gfarm_uint64_t
+host_file_copy_count(struct host *host)
+{
+	struct host_replica_index *index = host_get_replica_index(host);
+
+	return (index == NULL ? 0 : index->nreplicas);
+}
+
+/*
+ * a directory which has a link to the file, or NULL if not known.
+ * this is a hint to find gfarm.ncopy and gfarm.replicainfo of the file
+ * without a pathname, e.g. for replica_check of the replicas on a host.
+ * if the file has multiple links, it's one of them.
+ * after one of the links is removed, it may be the directory which had
+ * the removed link, because other links cannot be found without a
+ * namespace walk.  the background audit of replica_check covers that.
+ * the generation of the directory is kept with the hint, because
+ * the inode number of a removed directory may be reused.
+ */
+struct inode *
+inode_file_get_parent(struct inode *inode)
+{
+	struct inode *parent;
+
+	if (!inode_is_file(inode))
+		return (NULL);
+	parent = inode->u.c.s.f.parent;
+	if (parent != NULL && (!inode_is_dir(parent) || /* removed */
+	    parent->i_gen != inode->u.c.s.f.parent_gen)) /* reused */
+		return (NULL);
+	return (parent);
+}
+
+static void
+inode_file_set_parent(struct inode *inode, struct inode *dir)
+{
+	if (inode_is_file(inode)) {
+		inode->u.c.s.f.parent = dir;
+		inode->u.c.s.f.parent_gen = dir->i_gen;
+	}
+}
+
+/*
+ * a link of the file is removed, and i_nlink is already decremented.
+ * the parent hint is kept while other links remain,
+ * see inode_file_get_parent().
+ *
+ * NOTE: this function is called in slave_mode as well
+ */
+void
+inode_file_unset_parent(struct inode *inode)
+{
+	if (inode_is_file(inode) && inode->i_nlink == 0)
+		inode->u.c.s.f.parent = NULL;
+}
+
 gfarm_uint64_t
 inode_total_num(void)
 {
@@ -257,6 +483,30 @@ inode_total_num(void)
 	return (num_inodes);
 }
 
+/* memory consumed by inodes, replicas and directory entries */
+void
+inode_memory_info(void)
+{
+	gfarm_uint64_t ninodes = inode_total_num(), ncold, bytes, total;
+	gfarm_ino_t nchunks = inode_table_nchunks;
+
+	slab_get_stat(&inode_cold_slab, &ncold, &bytes);
+	total = slab_total_bytes() +
+	    inode_table_nchunks_max * sizeof(*inode_table) +
+	    nchunks * sizeof(**inode_table);
+	if (!inode_nlink_ini_table_freed)
+		total += nchunks * INODE_TABLE_CHUNK_SIZE *
+		    sizeof((*inode_table)->nlink_ini[0]);
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "inode memory: %llu inodes of %d bytes (%llu with %d bytes "
+	    "inode_cold), %llu bytes in total, %.1f MiB per million inodes",
+	    (unsigned long long)ninodes, (int)sizeof(struct inode),
+	    (unsigned long long)ncold, (int)sizeof(struct inode_cold),
+	    (unsigned long long)total, ninodes == 0 ? 0.0 :
+	    (double)total / ninodes * 1000000.0 / (1024 * 1024));
+	slab_info();
+}
+
 void
 inode_cksum_clear(struct inode *inode)
 {
@@ -344,6 +594,23 @@ inode_cksum_set_internal(struct inode *inode,
 	return(GFARM_ERR_NO_ERROR);
 }
 
+gfarm_error_t
+inode_cksum_set_in_cache(struct inode *inode,
+	const char *cksum_type, size_t cksum_len, const char *cksum)
+{
+	if (!inode_is_file(inode))
+		return (GFARM_ERR_OPERATION_NOT_PERMITTED);
+	inode_cksum_clear(inode);
+	return (inode_cksum_set_internal(inode, cksum_type, cksum_len, cksum));
+}
+
+void
+inode_cksum_remove_in_cache(struct inode *inode)
+{
+	if (inode_is_file(inode))
+		inode_cksum_clear(inode);
+}
+
 gfarm_error_t
 inode_cksum_set(struct file_opening *fo,
 	const char *cksum_type, size_t cksum_len, const char *cksum,
@@ -468,7 +735,7 @@ inode_cksum_get(struct file_opening *fo,
 static void
 xattrs_init(struct xattrs *xattrs)
 {
-	xattrs->head = xattrs->tail =NULL;
+	xattrs->head = NULL;
 }
 
 static void
@@ -484,29 +751,91 @@ xattrs_free_entries(struct xattrs *xattrs)
 		entry = next;
 	}
 	xattrs->head = NULL;
-	xattrs->tail = NULL;
+}
+
+/* returns NULL, if no memory */
+static struct inode_cold *
+inode_cold_get(struct inode *inode)
+{
+	struct inode_cold *cold = inode->i_cold;
+
+	if (cold == NULL) {
+		cold = slab_alloc(&inode_cold_slab);
+		if (cold == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "allocation of 'inode_cold' failed");
+			return (NULL);
+		}
+		xattrs_init(&cold->i_xmlattrs);
+		cold->dead_copies = NULL;
+		inode->i_cold = cold;
+	}
+	return (cold);
+}
+
+static void
+inode_cold_free_if_empty(struct inode *inode)
+{
+	struct inode_cold *cold = inode->i_cold;
+
+	if (cold != NULL &&
+	    cold->i_xmlattrs.head == NULL && cold->dead_copies == NULL) {
+		slab_free(&inode_cold_slab, cold);
+		inode->i_cold = NULL;
+	}
+}
+
+static struct dead_file_copy_list *
+inode_dead_copies(struct inode *inode)
+{
+	return (inode->i_cold == NULL ? NULL : inode->i_cold->dead_copies);
+}
+
+/* the result must not be modified, use inode_xattrs_for_update() for that */
+static struct xattrs *
+inode_xattrs(struct inode *inode, int xmlMode)
+{
+	static struct xattrs no_xattrs = { NULL };
+
+	if (!xmlMode)
+		return (&inode->i_xattrs);
+	return (inode->i_cold == NULL ?
+	    &no_xattrs : &inode->i_cold->i_xmlattrs);
+}
+
+/* returns NULL, if no memory */
+static struct xattrs *
+inode_xattrs_for_update(struct inode *inode, int xmlMode)
+{
+	struct inode_cold *cold;
+
+	if (!xmlMode)
+		return (&inode->i_xattrs);
+	cold = inode_cold_get(inode);
+	return (cold == NULL ? NULL : &cold->i_xmlattrs);
 }
 
 static void
 inode_xattrs_init(struct inode *inode)
 {
 	xattrs_init(&inode->i_xattrs);
-	xattrs_init(&inode->i_xmlattrs);
 }
 
 void
 inode_xattrs_clear(struct inode *inode)
 {
 	xattrs_free_entries(&inode->i_xattrs);
-	xattrs_free_entries(&inode->i_xmlattrs);
+	if (inode->i_cold != NULL) {
+		xattrs_free_entries(&inode->i_cold->i_xmlattrs);
+		inode_cold_free_if_empty(inode);
+	}
 }
 
 static void
 remove_all_xattrs(struct inode *inode, int xmlMode)
 {
 	gfarm_error_t e;
-	struct xattrs *xattrs = xmlMode ?
-		&inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs(inode, xmlMode);
 	struct xattr_entry *entry = NULL;
 
 	if (xattrs->head == NULL)
@@ -602,40 +931,138 @@ inode_free_list_init(void)
 	inode_free_list_initialized = 1;
 }
 
-struct inode *
-inode_alloc_num(gfarm_ino_t inum)
+/* PREREQUISITE: inum < inode_table_size */
+static struct inode **
+inode_table_slot(gfarm_ino_t inum)
 {
-	gfarm_ino_t i;
-	struct inode *inode;
-	static const char diag[] = "inode_alloc_num";
+	return (&inode_table[inum >> INODE_TABLE_CHUNK_SHIFT]->
+	    inodes[inum & INODE_TABLE_CHUNK_MASK]);
+}
 
-	if (inum < ROOT_INUMBER)
-		return (NULL); /* we don't use 0 and 1 as i_number */
-	if (inode_table_size <= inum) {
-		gfarm_ino_t new_table_size;
-		struct inode **p;
-
-		if (inum < INODE_TABLE_SIZE_INITIAL)
-			new_table_size = INODE_TABLE_SIZE_INITIAL;
-		else if (inum < inode_table_size * INODE_TABLE_SIZE_MULTIPLY)
-			new_table_size =
-			    inode_table_size * INODE_TABLE_SIZE_MULTIPLY;
-		else
-			new_table_size = inum * INODE_TABLE_SIZE_MULTIPLY;
-		GFARM_REALLOC_ARRAY(p, inode_table, new_table_size);
+/* PREREQUISITE: inum < inode_table_size */
+static struct inode *
+inode_table_get(gfarm_ino_t inum)
+{
+	return (*inode_table_slot(inum));
+}
+
+static void
+inode_table_mark_used(gfarm_ino_t inum)
+{
+	struct inode_table_chunk *chunk =
+	    inode_table[inum >> INODE_TABLE_CHUNK_SHIFT];
+	gfarm_ino_t i = inum & INODE_TABLE_CHUNK_MASK;
+
+	chunk->used[i / 64] |= (gfarm_uint64_t)1 << (i % 64);
+	chunk->nused++;
+}
+
+/* PREREQUISITE: the slot is unused */
+static void
+inode_table_set(gfarm_ino_t inum, struct inode *inode)
+{
+	*inode_table_slot(inum) = inode;
+	inode_table_mark_used(inum);
+}
+
+/*
+ * returns the smallest unused slot at or after `start',
+ * or inode_table_size if there isn't.
+ * full chunks are skipped by nused, and used slots by the bitmap.
+ */
+static gfarm_ino_t
+inode_table_find_unused(gfarm_ino_t start)
+{
+	gfarm_ino_t c, w;
+	struct inode_table_chunk *chunk;
+	gfarm_uint64_t unused;
+	int b;
+
+	for (c = start >> INODE_TABLE_CHUNK_SHIFT; c < inode_table_nchunks;
+	    c++, start = 0) {
+		chunk = inode_table[c];
+		if (chunk->nused == INODE_TABLE_CHUNK_SIZE)
+			continue;
+		w = (start & INODE_TABLE_CHUNK_MASK) / 64;
+		unused = ~chunk->used[w] &
+		    (~(gfarm_uint64_t)0 << (start % 64));
+		while (unused == 0 && ++w < INODE_TABLE_BITMAP_WORDS)
+			unused = ~chunk->used[w];
+		if (unused == 0)
+			continue;
+		for (b = 0; (unused & 1) == 0; b++)
+			unused >>= 1;
+		return ((c << INODE_TABLE_CHUNK_SHIFT) + w * 64 + b);
+	}
+	return (inode_table_size);
+}
+
+/* make inode_table[inum] available */
+static gfarm_error_t
+inode_table_grow(gfarm_ino_t inum)
+{
+	gfarm_ino_t i, nchunks;
+	struct inode_table_chunk **p, *chunk;
+
+	if (inum < inode_table_size)
+		return (GFARM_ERR_NO_ERROR);
+
+	nchunks = (inum >> INODE_TABLE_CHUNK_SHIFT) + 1;
+	if (nchunks > inode_table_nchunks_max) {
+		i = inode_table_nchunks_max == 0 ? INODE_TABLE_NCHUNKS_INITIAL :
+		    inode_table_nchunks_max * INODE_TABLE_NCHUNKS_MULTIPLY;
+		if (i < nchunks)
+			i = nchunks;
+		GFARM_REALLOC_ARRAY(p, inode_table, i);
 		if (p == NULL) {
 			gflog_debug(GFARM_MSG_1001720,
 				"re-allocation of inode array failed");
-			return (NULL); /* no memory */
+			return (GFARM_ERR_NO_MEMORY);
 		}
 		inode_table = p;
+		inode_table_nchunks_max = i;
+	}
 
-		for (i = inode_table_size; i < new_table_size; i++)
-			inode_table[i] = NULL;
-		inode_table_size = new_table_size;
+	while (inode_table_nchunks < nchunks) {
+		GFARM_CALLOC_ARRAY(chunk, 1);
+		if (chunk == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "allocation of inode table chunk failed");
+			return (GFARM_ERR_NO_MEMORY);
+		}
+		if (!inode_nlink_ini_table_freed) {
+			GFARM_CALLOC_ARRAY(chunk->nlink_ini,
+			    INODE_TABLE_CHUNK_SIZE);
+			if (chunk->nlink_ini == NULL) {
+				free(chunk);
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "allocation of nlink_ini array failed");
+				return (GFARM_ERR_NO_MEMORY);
+			}
+		}
+		inode_table[inode_table_nchunks++] = chunk;
+		inode_table_size += INODE_TABLE_CHUNK_SIZE;
+		if (inode_table_nchunks == 1) {
+			/* we don't use 0 and 1 as i_number */
+			for (i = 0; i < ROOT_INUMBER; i++)
+				inode_table_mark_used(i);
+		}
 	}
-	if ((inode = inode_table[inum]) == NULL) {
-		GFARM_MALLOC(inode);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+struct inode *
+inode_alloc_num(gfarm_ino_t inum)
+{
+	struct inode *inode;
+	static const char diag[] = "inode_alloc_num";
+
+	if (inum < ROOT_INUMBER)
+		return (NULL); /* we don't use 0 and 1 as i_number */
+	if (inode_table_grow(inum) != GFARM_ERR_NO_ERROR)
+		return (NULL); /* no memory */
+	if ((inode = inode_table_get(inum)) == NULL) {
+		inode = slab_alloc(&inode_slab);
 		if (inode == NULL) {
 			gflog_debug(GFARM_MSG_1001721,
 				"allocation of 'inode' failed");
@@ -645,17 +1072,12 @@ inode_alloc_num(gfarm_ino_t inum)
 
 		inode->i_number = inum;
 		inode->i_gen = 0;
-		inode->dead_copies = NULL;
-		inode_table[inum] = inode;
+		inode->i_cold = NULL;
+		inode_table_set(inum, inode);
 
 		/* update inode_free_index */
-		if (inum == inode_free_index) { /* always true for now */
-			while (++inode_free_index < inode_table_size) {
-				/* the following is always true for now */
-				if (inode_table[inode_free_index] == NULL)
-					break;
-			}
-		}
+		if (inum == inode_free_index)
+			inode_free_index = inode_table_find_unused(inum + 1);
 	} else if (inode->i_mode != INODE_MODE_FREE) {
 		assert(0);
 		return (NULL); /* the inode is not free */
@@ -665,7 +1087,7 @@ inode_alloc_num(gfarm_ino_t inum)
 		inode->u.l.prev->u.l.next = inode->u.l.next;
 		inode->i_gen++;
 	}
-	inode->i_nlink_ini = 0;
+	inode_set_nlink_ini(inode, 0);
 	inode->u.c.activity = NULL;
 	gfarm_mutex_lock(&total_num_inodes_mutex, diag, total_num_inodes_diag);
 	++total_num_inodes;
@@ -692,14 +1114,14 @@ inode_clear(struct inode *inode)
 	static const char diag[] = "inode_clear";
 
 	inode->i_mode = INODE_MODE_FREE;
-	inode->i_nlink = inode->i_nlink_ini = 0;
+	inode->i_nlink = 0;
+	inode_set_nlink_ini(inode, 0);
 	/* add to the inode_free_list */
 	inode->u.l.prev = &inode_free_list;
 	inode->u.l.next = inode_free_list.u.l.next;
 	inode->u.l.next->u.l.prev = inode;
 	inode_free_list.u.l.next = inode;
-	inode_xattrs_clear(inode);
-	/* preserve inode->dead_copies */
+	inode_xattrs_clear(inode); /* preserves dead_copies in inode->i_cold */
 	gfarm_mutex_lock(&total_num_inodes_mutex, diag, total_num_inodes_diag);
 	--total_num_inodes;
 	gfarm_mutex_unlock(&total_num_inodes_mutex,
@@ -1192,6 +1614,8 @@ update_replicas(struct inode *inode, struct host *spool_host,
 			continue;
 		}
 		*copyp = copy->host_next;
+		/* before inode_replication_new() adds copy->host again */
+		host_replica_index_remove(copy);
 
 		if (start_replication && spool_host != NULL) {
 			/*
@@ -1211,7 +1635,7 @@ update_replicas(struct inode *inode, struct host *spool_host,
 			} else { /* dead_file_copy must be already created */
 				assert(!FILE_COPY_IS_VALID(copy));
 			}
-			free(copy);
+			slab_free(&file_copy_slab, copy);
 		}
 	}
 
@@ -1292,7 +1716,7 @@ update_replicas(struct inode *inode, struct host *spool_host,
 		}
 
 		next = copy->host_next;
-		free(copy);
+		slab_free(&file_copy_slab, copy);
 	}
 
 	/*
@@ -1304,7 +1728,8 @@ update_replicas(struct inode *inode, struct host *spool_host,
 	 */
 	/* avoid calling replica_check if GFARM_ERR_NO_MEMORY occurs */
 	if (save_e != GFARM_ERR_NO_ERROR && save_e != GFARM_ERR_NO_MEMORY)
-		replica_check_signal_rep_request_failed();
+		replica_check_signal_rep_request_failed(
+		    inode_get_number(inode));
 }
 
 void
@@ -1328,7 +1753,7 @@ inode_remove(struct inode *inode)
 				/* abandon error */
 			}
 			cn = copy->host_next;
-			free(copy);
+			file_copy_free(copy);
 		}
 		inode->u.c.s.f.copies = NULL; /* ncopy == 0 */
 		inode_cksum_remove(inode);
@@ -1346,8 +1771,8 @@ inode_remove(struct inode *inode)
 	quota_update_file_remove(inode);
 	inode_free(inode);
 
-	if (dfc_needs_free && inode->dead_copies != NULL)
-		dead_file_copy_inode_status_changed(inode->dead_copies);
+	if (dfc_needs_free && inode_dead_copies(inode) != NULL)
+		dead_file_copy_inode_status_changed(inode_dead_copies(inode));
 }
 
 static int
@@ -1424,6 +1849,8 @@ inode_init_file(struct inode *inode)
 	inode->i_mode = GFARM_S_IFREG;
 	inode->u.c.s.f.copies = NULL;
 	inode->u.c.s.f.cksum = NULL;
+	inode->u.c.s.f.parent = NULL;
+	inode->u.c.s.f.parent_gen = 0;
 	return (GFARM_ERR_NO_ERROR);
 }
 
@@ -1482,7 +1909,7 @@ inode_lookup(gfarm_ino_t inum)
 
 	if (inum >= inode_table_size)
 		return (NULL);
-	inode = inode_table[inum];
+	inode = inode_table_get(inum);
 	if (inode == NULL)
 		return (NULL);
 	if (inode->i_mode == INODE_MODE_FREE)
@@ -1495,18 +1922,19 @@ inode_lookup_including_free(gfarm_ino_t inum)
 {
 	if (inum >= inode_table_size)
 		return (NULL);
-	return (inode_table[inum]);
+	return (inode_table_get(inum));
 }
 
 void
 inode_lookup_all(void *closure, void (*callback)(void *, struct inode *))
 {
-	int i;
+	gfarm_ino_t i;
+	struct inode *inode;
 
 	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
-		if (inode_table[i] != NULL &&
-		    inode_table[i]->i_mode != INODE_MODE_FREE)
-			callback(closure, inode_table[i]);
+		inode = inode_table_get(i);
+		if (inode != NULL && inode->i_mode != INODE_MODE_FREE)
+			callback(closure, inode);
 	}
 }
 
@@ -1562,22 +1990,67 @@ inode_get_nlink(struct inode *inode)
 	return (inode->i_nlink);
 }
 
+/* returns NULL after inode_nlink_ini_table_free() */
+static gfarm_uint64_t *
+inode_nlink_ini(struct inode *inode)
+{
+	gfarm_uint64_t *nlink_ini =
+	    inode_table[inode->i_number >> INODE_TABLE_CHUNK_SHIFT]->nlink_ini;
+
+	if (nlink_ini == NULL)
+		return (NULL);
+	return (&nlink_ini[inode->i_number & INODE_TABLE_CHUNK_MASK]);
+}
+
 static gfarm_int64_t
 inode_get_nlink_ini(struct inode *inode)
 {
-	return (inode->i_nlink_ini);
+	gfarm_uint64_t *nlink_ini = inode_nlink_ini(inode);
+
+	return (nlink_ini == NULL ? 0 : *nlink_ini);
 }
 
 static void
-inode_increment_nlink_ini(struct inode *inode)
+inode_set_nlink_ini(struct inode *inode, gfarm_uint64_t nlink)
 {
-	++inode->i_nlink_ini;
+	gfarm_uint64_t *nlink_ini = inode_nlink_ini(inode);
+
+	if (nlink_ini != NULL)
+		*nlink_ini = nlink;
 }
 
 static void
+inode_increment_nlink_ini(struct inode *inode)
+{
+	gfarm_uint64_t *nlink_ini = inode_nlink_ini(inode);
+
+	if (nlink_ini != NULL)
+		++*nlink_ini;
+}
+
+void
 inode_decrement_nlink_ini(struct inode *inode)
 {
-	--inode->i_nlink_ini;
+	gfarm_uint64_t *nlink_ini = inode_nlink_ini(inode);
+
+	if (nlink_ini != NULL)
+		--*nlink_ini;
+}
+
+/*
+ * nlink_ini is only necessary for inode_check_and_repair() at startup.
+ * PREREQUISITE: giant_lock
+ */
+void
+inode_nlink_ini_table_free(void)
+{
+	gfarm_ino_t c;
+
+	for (c = 0; c < inode_table_nchunks; c++) {
+		free(inode_table[c]->nlink_ini);
+		inode_table[c]->nlink_ini = NULL;
+	}
+	inode_nlink_ini_table_freed = 1;
 }
 
 struct user *
@@ -1886,6 +2359,7 @@ void
 inode_set_nlink_in_cache(struct inode *inode, gfarm_uint64_t nlink)
 {
 	inode->i_nlink = nlink;
+	inode_file_unset_parent(inode);
 }
 
 void
@@ -2185,7 +2659,7 @@ struct dead_file_copy_list *
 inode_get_dead_copies(struct inode *inode)
 {
 	if (inode != NULL)
-		return (inode->dead_copies);
+		return (inode_dead_copies(inode));
 	return (NULL);
 }
 
@@ -2293,8 +2767,8 @@ inode_replication_start(struct inode *inode)
 	assert(ia != NULL);
 	if (ia->u.f.rstate != NULL)
 		file_replication_start(ia->u.f.rstate, inode->i_gen);
-	else if (inode->dead_copies != NULL)
-		dead_file_copy_inode_status_changed(inode->dead_copies);
+	else if (inode_dead_copies(inode) != NULL)
+		dead_file_copy_inode_status_changed(inode_dead_copies(inode));
 }
 
 gfarm_error_t
@@ -2621,6 +3095,7 @@ inode_lookup_basename(struct inode *parent, const char *name, int len,
 		*inp = dir_entry_get_inode(entry);
 		(*inp)->i_nlink--;
 		dir_remove_entry(parent->u.c.s.d.entries, name, len);
+		inode_file_unset_parent(*inp);
 		inode_modified(parent);
 
 		e = db_direntry_remove(parent->i_number, name, len);
@@ -2660,6 +3135,7 @@ inode_lookup_basename(struct inode *parent, const char *name, int len,
 		n = *inp;
 		n->i_nlink++;
 		dir_entry_set_inode(entry, n);
+		inode_file_set_parent(n, parent);
 		inode_status_changed(n);
 		inode_modified(parent);
 
@@ -2714,6 +3190,7 @@ inode_lookup_basename(struct inode *parent, const char *name, int len,
 	n->i_size = 0;
 	inode_created(n);
 	dir_entry_set_inode(entry, n);
+	inode_file_set_parent(n, parent);
 	inode_modified(parent);
 
 	e = xattr_inherit(parent, n,
@@ -2969,8 +3446,8 @@ inode_lookup_lost_found(void)
 		return (NULL);
 	}
 	if (created) {
-		root->i_nlink_ini++;
-		inode->i_nlink_ini = inode->i_nlink;
+		inode_increment_nlink_ini(root);
+		inode_set_nlink_ini(inode, inode->i_nlink);
 		inode->u.c.s.d.parent_dir = root;
 		gflog_info(GFARM_MSG_1002483, "create /%s directory",
 		    lost_found);
@@ -3225,7 +3702,7 @@ inode_link_to_lost_found(struct inode *inode)
 	    (unsigned long long)inode_get_gen(inode));
 	e = inode_create_link_internal(base, name, admin, inode);
 	if (e == GFARM_ERR_NO_ERROR) {
-		inode->i_nlink_ini++;
+		inode_increment_nlink_ini(inode);
 		if (inode_is_dir(inode)) {
 			inode_dir_check_and_repair_dotdot(inode, base);
 			inode->u.c.s.d.parent_dir = base;
@@ -3461,7 +3938,8 @@ inode_rename(
 		if (sdir != ddir && (inode_is_dir(src) || inode_is_file(src))
 		    && (!inode_has_desired_number(src, &num) &&
 			!inode_has_repattr(src, NULL)))
-			replica_check_signal_rename();
+			replica_check_signal_rename(
+			    inode_get_number(src));
 	}
 	/* db_inode_nlink_modify() is not necessary, because it's unchanged */
 	return (e);
@@ -3741,7 +4219,8 @@ inode_check_pending_replication(struct file_opening *fo)
 		 */
 		/* avoid calling replica_check if GFARM_ERR_NO_MEMORY occurs */
 		if (e != GFARM_ERR_NO_ERROR && e != GFARM_ERR_NO_MEMORY)
-			replica_check_signal_rep_request_failed();
+			replica_check_signal_rep_request_failed(
+			    inode_get_number(inode));
 	}
 }
 
@@ -3942,6 +4421,28 @@ inode_has_replica(struct inode *inode, struct host *spool_host)
 	return (FILE_COPY_IS_VALID(copy));
 }
 
+/*
+ * the entry of the directory `inode' in the directory `parent_dir',
+ * looked up by the reverse index.  see inode_dir_entry_attached().
+ * returns NULL, if it's not known, or if the entry is stale.
+ */
+static DirEntry
+inode_dir_get_name_entry(struct inode *inode, Dir parent_dir)
+{
+	DirEntry entry;
+	char *name;
+	int namelen;
+
+	if (!inode_is_dir(inode) ||
+	    (entry = dir_get_name_entry(inode->u.c.s.d.entries)) == NULL)
+		return (NULL);
+	name = dir_entry_get_name(entry, &namelen);
+	if (dir_lookup(parent_dir, name, namelen) != entry ||
+	    dir_entry_get_inode(entry) != inode)
+		return (NULL);
+	return (entry);
+}
+
 gfarm_error_t
 inode_getdirpath(struct inode *inode, struct process *process, char **namep)
 {
@@ -3974,24 +4475,26 @@ inode_getdirpath(struct inode *inode, struct process *process, char **namep)
 				gfarm_error_string(e));
 			return (e);
 		}
-		/* search the inode in the parent directory. */
-		/* XXX this is slow. should we create a reverse index? */
 		dir = inode_get_dir(parent);
-		ok = dir_cursor_set_pos(dir, 0, &cursor);
-		assert(ok);
-		for (;;) {
-			entry = dir_cursor_get_entry(dir, &cursor);
-			assert(entry != NULL);
-			dei = dir_entry_get_inode(entry);
-			assert(dei != NULL);
-			if (dei == inode)
-				break;
-			ok = dir_cursor_next(dir, &cursor);
-			/*
-			 * For now, we won't remove a directory
-			 * while it's opened
-			 */
+		entry = inode_dir_get_name_entry(inode, dir);
+		if (entry == NULL) {
+			/* search the inode in the parent directory. */
+			ok = dir_cursor_set_pos(dir, 0, &cursor);
 			assert(ok);
+			for (;;) {
+				entry = dir_cursor_get_entry(dir, &cursor);
+				assert(entry != NULL);
+				dei = dir_entry_get_inode(entry);
+				assert(dei != NULL);
+				if (dei == inode)
+					break;
+				ok = dir_cursor_next(dir, &cursor);
+				/*
+				 * For now, we won't remove a directory
+				 * while it's opened
+				 */
+				assert(ok);
+			}
 		}
 		name = dir_entry_get_name(entry, &namelen);
 		GFARM_MALLOC_ARRAY(s, namelen + 1);
@@ -4331,7 +4834,7 @@ inode_remove_replica_in_cache(struct inode *inode, struct host *spool_host)
 	}
 	copy = *foundp;
 	*foundp = copy->host_next;
-	free(copy);
+	file_copy_free(copy);
 	return (GFARM_ERR_NO_ERROR);
 }
 
@@ -4489,8 +4992,9 @@ inode_replicated(struct file_replication *fr,
 		}
 	} else if (e == GFARM_ERR_NO_ERROR) {
 		/* try to sweep kept queue */
-		if (inode->dead_copies != NULL)
-			dead_file_copy_inode_status_changed(inode->dead_copies);
+		if (inode_dead_copies(inode) != NULL)
+			dead_file_copy_inode_status_changed(
+			    inode_dead_copies(inode));
 	}
 
 	inode_replication_free(fr);
@@ -4503,7 +5007,8 @@ inode_replicated(struct file_replication *fr,
 		 * #647 - workaround for #646 - retry replication when
 		 * a result of replication is failure
 		 */
-		replica_check_signal_rep_result_failed();
+		replica_check_signal_rep_result_failed(
+		    inode_get_number(inode));
 	}
 
 	return (e);
@@ -4514,6 +5019,7 @@ inode_add_replica_internal(struct inode *inode, struct host *spool_host,
 	int flags, int update_quota)
 {
 	struct file_copy *copy;
+	struct host_replica_index *index;
 
 	for (copy = inode->u.c.s.f.copies; copy != NULL;
 	    copy = copy->host_next) {
@@ -4558,7 +5064,9 @@ inode_add_replica_internal(struct inode *inode, struct host *spool_host,
 		}
 	}
 
-	GFARM_MALLOC(copy);
+	if ((index = host_replica_index_get(spool_host)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	copy = slab_alloc(&file_copy_slab);
 	if (copy == NULL) {
 		gflog_debug(GFARM_MSG_1001768,
 			"allocation of 'copy' failed");
@@ -4570,8 +5078,10 @@ inode_add_replica_internal(struct inode *inode, struct host *spool_host,
 
 	copy->host = spool_host;
 	copy->flags = flags;
+	copy->inode = inode;
 	copy->host_next = inode->u.c.s.f.copies;
 	inode->u.c.s.f.copies = copy;
+	host_replica_index_add(index, copy);
 	return (GFARM_ERR_NO_ERROR);
 }
 
@@ -4580,6 +5090,7 @@ inode_dead_file_copy_added(gfarm_ino_t inum, gfarm_int64_t igen,
 	struct host *host, struct dead_file_copy *dfc)
 {
 	struct inode *inode = inode_lookup(inum);
+	struct inode_cold *cold;
 
 	/* maintain inode::dead_copies */
 	if (inode == NULL) {
@@ -4591,7 +5102,13 @@ inode_dead_file_copy_added(gfarm_ino_t inum, gfarm_int64_t igen,
 		}
 		inode_clear(inode);
 	}
-	dead_file_copy_list_add(&inode->dead_copies, dfc);
+	if ((cold = inode_cold_get(inode)) == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "cannot allocate dead_copies of inode %lld",
+		    (long long)inum);
+		return;
+	}
+	dead_file_copy_list_add(&cold->dead_copies, dfc);
 
 	if (!inode_is_file(inode))
 		return;
@@ -4657,9 +5174,10 @@ remove_replica_entity(struct inode *inode, gfarm_int64_t gen,
 	struct dead_file_copy **deferred_cleanupp)
 {
 	struct dead_file_copy *dfc;
+	struct inode_cold *cold = inode_cold_get(inode);
 
-	dfc = dead_file_copy_new(inode->i_number, gen, spool_host,
-	    &inode->dead_copies);
+	dfc = cold == NULL ? NULL : dead_file_copy_new(inode->i_number, gen,
+	    spool_host, &cold->dead_copies);
 	if (dfc == NULL) {
 		gflog_error(GFARM_MSG_1002260,
 		    "removing old replica %lld:%lld host %s: no memory",
@@ -4689,11 +5207,13 @@ inode_remove_replica_completed(gfarm_ino_t inum, gfarm_int64_t igen,
 		inode2 = inode;
 	} else {
 		assert(inum < inode_table_size);
-		inode2 = inode_table[inum];
+		inode2 = inode_table_get(inum);
 		assert(inode2 != NULL);
 	}
-	if (dead_file_copy_list_free_check(inode2->dead_copies))
-		inode2->dead_copies = NULL;
+	if (dead_file_copy_list_free_check(inode_dead_copies(inode2))) {
+		inode2->i_cold->dead_copies = NULL;
+		inode_cold_free_if_empty(inode2);
+	}
 
 	if (inode == NULL)
 		return;
@@ -4868,7 +5388,7 @@ inode_remove_replica_internal(struct inode *inode, struct host *spool_host,
 					copy->flags |= FILE_COPY_BEING_REMOVED;
 				} else {
 					*foundp = copy->host_next;
-					free(copy);
+					file_copy_free(copy);
 				}
 			}
 		} else {
@@ -4886,7 +5406,7 @@ inode_remove_replica_internal(struct inode *inode, struct host *spool_host,
 					e = GFARM_ERR_NO_ERROR;
 				}
 				*foundp = copy->host_next;
-				free(copy);
+				file_copy_free(copy);
 			} else {
 				gflog_debug(GFARM_MSG_1002487,
 				    "remove_replica_metadata(%lld, %lld, %s): "
@@ -4929,10 +5449,35 @@ inode_remove_replica_protected(struct inode *inode, struct host *spool_host,
 	    inode_get_gen(inode), fo, 0, 0, NULL));
 }
 
-/* remove an incomplete replica, when a replication fails */
-void
-inode_remove_replica_incomplete(struct inode *inode, struct host *spool_host,
-	gfarm_int64_t gen)
+/*
+ * remove a replica to drain spool_host.
+ * a replica which is being written, or which is the last available one
+ * is kept.
+ */
+gfarm_error_t
+inode_remove_replica_on_draining_host(struct inode *inode,
+	struct host *spool_host)
+{
+	struct file_copy *copy = inode_get_file_copy(inode, spool_host);
+	gfarm_int64_t ncopy;
+
+	if (copy == NULL || !FILE_COPY_IS_VALID(copy))
+		return (GFARM_ERR_NO_SUCH_OBJECT);
+	if (inode_writing_spool_host(inode) == spool_host)
+		return (GFARM_ERR_TEXT_FILE_BUSY);
+	ncopy = inode_get_ncopy(inode);
+	if (host_is_up(spool_host))
+		ncopy--;
+	if (ncopy <= 0)
+		return (GFARM_ERR_CANNOT_REMOVE_LAST_REPLICA);
+	return (inode_remove_replica_internal(inode, spool_host,
+	    inode_get_gen(inode), NULL, 0, 0, NULL));
+}
+
+/* remove an incomplete replica, when a replication fails */
+void
+inode_remove_replica_incomplete(struct inode *inode, struct host *spool_host,
+	gfarm_int64_t gen)
 {
 	gfarm_error_t e;
 
@@ -5118,7 +5663,7 @@ inode_replica_info_get(struct inode *inode, gfarm_int32_t iflags,
 	nlatest = inode_get_ncopy_common(inode, !show_incomplete, 0);
 
 	if (show_obsolete)
-		ndead = dead_file_copy_count_by_inode(inode->dead_copies,
+		ndead = dead_file_copy_count_by_inode(inode_dead_copies(inode),
 		    latest_gen, 0); /* include !host_is_up() */
 	else
 		ndead = 0;
@@ -5172,7 +5717,7 @@ inode_replica_info_get(struct inode *inode, gfarm_int32_t iflags,
 	}
 	if (e == GFARM_ERR_NO_ERROR && show_obsolete)
 		e = dead_file_copy_info_by_inode(
-		     inode->dead_copies, latest_gen,
+		     inode_dead_copies(inode), latest_gen,
 		     !show_down, &ndead, &hosts[i], &gens[i], &oflags[i]);
 
 	if (e != GFARM_ERR_NO_ERROR) {
@@ -5431,6 +5976,10 @@ static struct dir_entry_removal_todo {
 	int entry_len;
 } *dir_entry_removal_list = NULL;
 
+/* dir_entry_add_at_loading() may be called by multiple threads */
+static pthread_mutex_t dir_entry_removal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char dir_entry_removal_diag[] = "dir_entry_removal_mutex";
+
 static void
 dir_entry_free_orphan(void)
 {
@@ -5450,6 +5999,7 @@ dir_entry_defer_db_removal(gfarm_ino_t dir_inum,
 {
 	struct dir_entry_removal_todo *entry;
 	char *ename;
+	static const char diag[] = "dir_entry_defer_db_removal";
 
 	GFARM_MALLOC(entry);
 	GFARM_MALLOC_ARRAY(ename, entry_len);
@@ -5474,8 +6024,12 @@ dir_entry_defer_db_removal(gfarm_ino_t dir_inum,
 	entry->entry_name = ename;
 	entry->entry_len = entry_len;
 
+	gfarm_mutex_lock(&dir_entry_removal_mutex,
+	    diag, dir_entry_removal_diag);
 	entry->next = dir_entry_removal_list;
 	dir_entry_removal_list = entry;
+	gfarm_mutex_unlock(&dir_entry_removal_mutex,
+	    diag, dir_entry_removal_diag);
 }
 
 static void
@@ -5677,6 +6231,7 @@ gfarm_error_t
 inode_add_or_modify_in_cache(struct gfs_stat *st, struct inode **inodep)
 {
 	struct inode *n = inode_lookup(st->st_ino);
+	struct file_copy *copy, *next;
 
 	if (n != NULL) {
 		if ((GFARM_S_IFMT & st->st_mode) ==
@@ -5691,7 +6246,11 @@ inode_add_or_modify_in_cache(struct gfs_stat *st, struct inode **inodep)
 			dir_free(n->u.c.s.d.entries);
 			break;
 		case GFARM_S_IFREG:
-			/* XXX need to free file_copy ? */
+			for (copy = n->u.c.s.f.copies; copy != NULL;
+			    copy = next) {
+				next = copy->host_next;
+				file_copy_free(copy);
+			}
 			break;
 		case GFARM_S_IFLNK:
 			inode_clear_symlink(n);
@@ -5828,6 +6387,35 @@ name_is_dot_or_dotdot(const char *name, int len)
 	    (len == DOTDOT_LEN && memcmp(name, dotdot, DOTDOT_LEN) == 0));
 }
 
+/*
+ * maintain the reverse index from a directory to its entry in the parent,
+ * which makes inode_getdirpath() O(depth).
+ * a directory has only one such entry except during rename,
+ * and the newest one wins, because the old one is going to be removed.
+ */
+void
+inode_dir_entry_attached(struct inode *inode, DirEntry entry)
+{
+	char *name;
+	int len;
+
+	if (!inode_is_dir(inode) || inode->u.c.s.d.entries == NULL)
+		return;
+	name = dir_entry_get_name(entry, &len);
+	if (name_is_dot_or_dotdot(name, len))
+		return;
+	dir_set_name_entry(inode->u.c.s.d.entries, entry);
+}
+
+void
+inode_dir_entry_detached(struct inode *inode, DirEntry entry)
+{
+	if (!inode_is_dir(inode) || inode->u.c.s.d.entries == NULL)
+		return;
+	if (dir_get_name_entry(inode->u.c.s.d.entries) == entry)
+		dir_set_name_entry(inode->u.c.s.d.entries, NULL);
+}
+
 
 /* The memory owner of `entry_name' is changed to inode.c */
 static void
@@ -5841,9 +6429,13 @@ dir_entry_add_one(void *closure,
 	free(entry_name);
 }
 
-gfarm_error_t
-dir_entry_add(gfarm_ino_t dir_inum, char *entry_name, int entry_len,
-	gfarm_ino_t entry_inum)
+/*
+ * if `at_loading' is set, nlink_ini and parent_dir are not updated here,
+ * but by dir_entry_load_end() instead.
+ */
+static gfarm_error_t
+dir_entry_add_internal(gfarm_ino_t dir_inum, char *entry_name, int entry_len,
+	gfarm_ino_t entry_inum, int at_loading)
 {
 	gfarm_error_t e;
 	struct inode *dir_inode = inode_lookup(dir_inum);
@@ -5884,8 +6476,13 @@ dir_entry_add(gfarm_ino_t dir_inum, char *entry_name, int entry_len,
 		    "%s: directory inode %lld entry name \'%*s\': %s", diag,
 		    (long long)dir_inum, entry_len, entry_name,
 		    gfarm_error_string(e));
+	} else if (at_loading) {
+		dir_entry_set_inode(entry, entry_inode);
+		inode_file_set_parent(entry_inode, dir_inode);
+		e = GFARM_ERR_NO_ERROR;
 	} else {
 		dir_entry_set_inode(entry, entry_inode);
+		inode_file_set_parent(entry_inode, dir_inode);
 		inode_increment_nlink_ini(entry_inode);
 		if (inode_is_dir(entry_inode) &&
 		    !name_is_dot_or_dotdot(entry_name, entry_len) &&
@@ -5899,24 +6496,52 @@ dir_entry_add(gfarm_ino_t dir_inum, char *entry_name, int entry_len,
 	return (e);
 }
 
+gfarm_error_t
+dir_entry_add(gfarm_ino_t dir_inum, char *entry_name, int entry_len,
+	gfarm_ino_t entry_inum)
+{
+	return (dir_entry_add_internal(dir_inum, entry_name, entry_len,
+	    entry_inum, 0));
+}
+
 void
 inode_init(void)
 {
 	gfarm_error_t e;
-	struct inode *root;
-	struct gfs_stat st;
 
 	if (!inode_free_list_initialized)
 		inode_free_list_init();
 
-	e = db_inode_load(NULL, inode_add_one);
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_inode_load(NULL, inode_add_one) :
+	    db_inode_load(NULL, inode_add_one);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000355,
 		    "loading inode: %s", gfarm_error_string(e));
-	e = db_inode_cksum_load(NULL, inode_cksum_add_one);
+	inode_cksum_init();
+	inode_root_init();
+}
+
+void
+inode_cksum_init(void)
+{
+	gfarm_error_t e;
+
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_inode_cksum_load(NULL, inode_cksum_add_one) :
+	    db_inode_cksum_load(NULL, inode_cksum_add_one);
 	if (e != GFARM_ERR_NO_ERROR && e != GFARM_ERR_NO_SUCH_OBJECT /* XXX */)
 		gflog_error(GFARM_MSG_1000356,
 		    "loading inode cksum: %s", gfarm_error_string(e));
+}
+
+/* create the root directory, if it doesn't exist */
+void
+inode_root_init(void)
+{
+	gfarm_error_t e;
+	struct inode *root;
+	struct gfs_stat st;
 
 	root = inode_lookup(ROOT_INUMBER);
 	if (root != NULL)
@@ -5967,7 +6592,9 @@ file_copy_init(void)
 {
 	gfarm_error_t e;
 
-	e = db_filecopy_load(NULL, file_copy_add_one);
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_filecopy_load(NULL, file_copy_add_one) :
+	    db_filecopy_load(NULL, file_copy_add_one);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000361,
 		    "loading filecopy: %s", gfarm_error_string(e));
@@ -6207,7 +6834,9 @@ dir_entry_init(void)
 	gfarm_error_t e;
 	struct inode *root;
 
-	e = db_direntry_load(NULL, dir_entry_add_one);
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_direntry_load(NULL, dir_entry_add_one) :
+	    db_direntry_load(NULL, dir_entry_add_one);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000363,
 		    "loading direntry: %s", gfarm_error_string(e));
@@ -6222,12 +6851,238 @@ dir_entry_init(void)
 	root->u.c.s.d.parent_dir = root;
 }
 
+/*
+ * parallel loading at startup, used by loader.c.
+ *
+ * inode_add_at_loading() and dir_entry_add_at_loading() may be called
+ * by multiple threads concurrently, as long as each inode or directory
+ * is handled by only one thread.
+ * the inode_free_list, inode_free_index and total_num_inodes are set up
+ * by inode_load_end(), and nlink_ini and parent_dir are set up by
+ * dir_entry_load_end().
+ */
+
+/* protects the user and group table during inode_add_at_loading() */
+static pthread_mutex_t inode_loading_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char inode_loading_diag[] = "inode_loading_mutex";
+
+void
+inode_load_begin(void)
+{
+	if (!inode_free_list_initialized)
+		inode_free_list_init();
+}
+
+/*
+ * must not be called while inode_add_at_loading() is running,
+ * if inode_load_reserve_reallocs() returns true.
+ * otherwise, only new chunks are added, and inode_table_size only grows,
+ * thus the running inode_add_at_loading() for reserved inodes isn't
+ * affected.
+ */
+gfarm_error_t
+inode_load_reserve(gfarm_ino_t inum)
+{
+	return (inode_table_grow(inum));
+}
+
+/* returns true, if inode_load_reserve() reallocates inode_table[] */
+int
+inode_load_reserve_reallocs(gfarm_ino_t inum)
+{
+	return ((inum >> INODE_TABLE_CHUNK_SHIFT) + 1 >
+	    inode_table_nchunks_max);
+}
+
+int
+inode_load_is_reserved(gfarm_ino_t inum)
+{
+	return (inum < inode_table_size);
+}
+
+/* The memory owner of `*st' is changed to inode.c */
+void
+inode_add_at_loading(struct gfs_stat *st)
+{
+	gfarm_error_t e;
+	gfarm_ino_t inum = st->st_ino;
+	struct inode *inode;
+	static const char diag[] = "inode_add_at_loading";
+
+	if (inum < ROOT_INUMBER || inum >= inode_table_size ||
+	    inode_table_get(inum) != NULL) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s: invalid or duplicate inode %lld",
+		    diag, (unsigned long long)inum);
+		gfs_stat_free(st);
+		return;
+	}
+	inode = slab_alloc(&inode_slab);
+	if (inode == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "cannot allocate inode %lld", (unsigned long long)inum);
+		gfs_stat_free(st);
+		return;
+	}
+	inode_xattrs_init(inode);
+	inode->i_number = inum;
+	inode->i_cold = NULL;
+	inode->u.c.activity = NULL;
+
+	if (GFARM_S_ISDIR(st->st_mode)) {
+		e = inode_init_dir_internal(inode);
+	} else if (GFARM_S_ISREG(st->st_mode)) {
+		e = inode_init_file(inode);
+	} else if (GFARM_S_ISLNK(st->st_mode)) {
+		e = inode_init_symlink(inode, NULL);
+	} else if (st->st_mode == INODE_MODE_FREE) {
+		/* linked to the inode_free_list by inode_load_end() */
+		e = GFARM_ERR_NO_ERROR;
+	} else {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "unknown inode type %lld, mode 0%o",
+		    (unsigned long long)inum, st->st_mode);
+		e = GFARM_ERR_UNKNOWN;
+	}
+	if (e != GFARM_ERR_NO_ERROR) {
+		if (e != GFARM_ERR_UNKNOWN)
+			gflog_error(GFARM_MSG_UNFIXED, "inode %lld: %s",
+			    (unsigned long long)inum, gfarm_error_string(e));
+		slab_free(&inode_slab, inode);
+		gfs_stat_free(st);
+		return;
+	}
+
+	inode->i_gen = st->st_gen;
+	inode->i_nlink = st->st_nlink;
+	inode->i_size = st->st_size;
+	inode->i_mode = st->st_mode;
+	inode->i_atimespec = st->st_atimespec;
+	inode->i_mtimespec = st->st_mtimespec;
+	inode->i_ctimespec = st->st_ctimespec;
+	gfarm_mutex_lock(&inode_loading_mutex, diag, inode_loading_diag);
+	inode_set_user_by_name_in_cache(inode, st->st_user);
+	inode_set_group_by_name_in_cache(inode, st->st_group);
+	gfarm_mutex_unlock(&inode_loading_mutex, diag, inode_loading_diag);
+	gfs_stat_free(st);
+
+	/* inode_table_mark_used() is called by inode_load_end() */
+	*inode_table_slot(inum) = inode;
+}
+
+void
+inode_load_end(void)
+{
+	gfarm_ino_t i;
+	gfarm_uint64_t n = 0;
+	struct inode *inode;
+	static const char diag[] = "inode_load_end";
+
+	inode_free_index = inode_table_size;
+	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
+		inode = inode_table_get(i);
+		if (inode == NULL) {
+			if (inode_free_index == inode_table_size)
+				inode_free_index = i;
+			continue;
+		}
+		inode_table_mark_used(i);
+		if (inode->i_mode == INODE_MODE_FREE) {
+			inode->i_nlink = 0;
+			inode->u.l.prev = &inode_free_list;
+			inode->u.l.next = inode_free_list.u.l.next;
+			inode->u.l.next->u.l.prev = inode;
+			inode_free_list.u.l.next = inode;
+		} else {
+			n++;
+		}
+	}
+	gfarm_mutex_lock(&total_num_inodes_mutex, diag, total_num_inodes_diag);
+	total_num_inodes = n;
+	gfarm_mutex_unlock(&total_num_inodes_mutex,
+	    diag, total_num_inodes_diag);
+}
+
+/* The memory owner of `entry_name' is changed to inode.c */
+void
+dir_entry_add_at_loading(gfarm_ino_t dir_inum, char *entry_name,
+	int entry_len, gfarm_ino_t entry_inum)
+{
+	(void)dir_entry_add_internal(dir_inum, entry_name, entry_len,
+	    entry_inum, 1);
+
+	/* abandon error */
+	free(entry_name);
+}
+
+static void
+inode_reset_nlink_ini(void *closure, struct inode *inode)
+{
+	inode_set_nlink_ini(inode, 0);
+}
+
+static void
+dir_entry_count_links(void *closure, struct inode *dir_inode)
+{
+	Dir dir;
+	DirEntry entry;
+	DirCursor cursor;
+	struct inode *entry_inode;
+	char *entry_name;
+	int entry_len;
+
+	if (!inode_is_dir(dir_inode))
+		return;
+	dir = dir_inode->u.c.s.d.entries;
+	if (!dir_cursor_set_pos(dir, 0, &cursor))
+		return;
+	while ((entry = dir_cursor_get_entry(dir, &cursor)) != NULL) {
+		entry_inode = dir_entry_get_inode(entry);
+		inode_increment_nlink_ini(entry_inode);
+		entry_name = dir_entry_get_name(entry, &entry_len);
+		if (inode_is_dir(entry_inode) &&
+		    !name_is_dot_or_dotdot(entry_name, entry_len) &&
+		    dir_inode != entry_inode /* avoid self reference */) {
+			/* XXX should avoid loop too */
+			/* remember parent */
+			entry_inode->u.c.s.d.parent_dir = dir_inode;
+		}
+		if (!dir_cursor_next(dir, &cursor))
+			break;
+	}
+}
+
+/*
+ * set up what dir_entry_add() does besides adding the entry.
+ * must be called after all dir_entry_add_at_loading() calls are finished.
+ */
+void
+dir_entry_load_end(void)
+{
+	struct inode *root;
+
+	/* the root directory may be counted by inode_root_init() already */
+	inode_lookup_all(NULL, inode_reset_nlink_ini);
+	inode_lookup_all(NULL, dir_entry_count_links);
+
+	/* setup root->u.c.s.d.parent_dir */
+	root = inode_lookup(ROOT_INUMBER);
+	if (root == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "dir_entry_load_end: no root directory");
+		return;
+	}
+	root->u.c.s.d.parent_dir = root;
+}
+
 void
 symlink_init(void)
 {
 	gfarm_error_t e;
 
-	e = db_symlink_load(NULL, symlink_add_one);
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_symlink_load(NULL, symlink_add_one) :
+	    db_symlink_load(NULL, symlink_add_one);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000364,
 		    "loading symlink: %s", gfarm_error_string(e));
@@ -6258,6 +7113,44 @@ dir_is_empty(Dir dir)
 	}
 }
 
+/*
+ * returns the first entry except "." and ".." next to `prev',
+ * or from the beginning of the directory if `prev' is NULL.
+ * *namep is set to NULL at the end of the directory.
+ * implemented here to refer dot and dotdot.
+ */
+gfarm_error_t
+dir_get_entry_after(Dir dir, const char *prev,
+	char **namep, struct inode **inodep)
+{
+	DirEntry entry;
+	DirCursor cursor;
+	char *name;
+	int namelen;
+
+	if (prev != NULL) {
+		if (!dir_cursor_lookup_next(dir, prev, strlen(prev), &cursor))
+			goto end_of_dir;
+	} else if (!dir_cursor_set_pos(dir, 0, &cursor)) {
+		goto end_of_dir;
+	}
+	for (;;) {
+		entry = dir_cursor_get_entry(dir, &cursor);
+		if (entry == NULL)
+			break;
+		name = dir_entry_get_name(entry, &namelen);
+		if (!name_is_dot_or_dotdot(name, namelen))
+			return (dir_cursor_get_name_and_inode(dir, &cursor,
+			    namep, inodep));
+		if (!dir_cursor_next(dir, &cursor))
+			break;
+	}
+ end_of_dir:
+	*namep = NULL;
+	*inodep = NULL;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static struct xattr_entry *
 xattr_entry_alloc(const char *attrname)
 {
@@ -6316,14 +7209,13 @@ xattr_add(struct xattrs *xattrs, int xmlMode, const char *attrname,
 	}
 
 	if (xattrs->head == NULL) {
-		xattrs->head = xattrs->tail = entry;
-		entry->prev = NULL;
+		xattrs->head = entry;
 	} else {
-		tail = xattrs->tail;
+		tail = xattrs->head->prev;
 		entry->prev = tail;
 		tail->next = entry;
-		xattrs->tail = entry;
 	}
+	xattrs->head->prev = entry;
 	return entry;
 }
 
@@ -6347,8 +7239,9 @@ xattr_add_one(void *closure, struct xattr_info *info)
 		else
 			xattr_defer_db_removal(info);
 	} else {
-		xattrs = (xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs);
-		if (xattr_add(xattrs, xmlMode, info->attrname,
+		xattrs = inode_xattrs_for_update(inode, xmlMode);
+		if (xattrs == NULL ||
+		    xattr_add(xattrs, xmlMode, info->attrname,
 		    info->attrvalue, info->attrsize) == NULL)
 			gflog_error(GFARM_MSG_1000367, "xattr_add_one: "
 				"cannot add attrname %s to %lld",
@@ -6378,19 +7271,132 @@ xattr_init(void)
 		gfarm_xattr_caching_pattern_add(GFARM_REPATTR_NAME);
 
 	xmlMode = 0;
-	e = db_xattr_load(&xmlMode, xattr_add_one);
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_xattr_load(&xmlMode, xattr_add_one) :
+	    db_xattr_load(&xmlMode, xattr_add_one);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000368,
 		    "loading xattr: %s", gfarm_error_string(e));
 #ifdef ENABLE_XMLATTR
 	xmlMode = 1;
-	e = db_xattr_load(&xmlMode, xattr_add_one);
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_xattr_load(&xmlMode, xattr_add_one) :
+	    db_xattr_load(&xmlMode, xattr_add_one);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000369,
 		    "loading xmlattr: %s", gfarm_error_string(e));
 #endif
 }
 
+static void
+inode_snapshot_xattrs(struct db_snapshot_writer *w, gfarm_ino_t inum,
+	int xmlMode, struct xattrs *xattrs)
+{
+	struct xattr_entry *entry;
+
+	for (entry = xattrs->head; entry != NULL; entry = entry->next)
+		db_snapshot_put_xattr(w, xmlMode, inum, entry->name,
+		    entry->cached_attrvalue, entry->cached_attrsize);
+}
+
+/*
+ * dump the tables loaded by inode_init(), file_copy_init(),
+ * dir_entry_init(), symlink_init() and xattr_init().
+ * this is called in the child process forked by db_snapshot_write().
+ *
+ * PREREQUISITE: giant_lock at fork
+ */
+void
+inode_snapshot(struct db_snapshot_writer *w)
+{
+	gfarm_ino_t i;
+	struct inode *inode;
+	struct gfs_stat st;
+	struct checksum *cs;
+	struct file_copy *copy;
+	Dir dir;
+	DirCursor cursor;
+	DirEntry entry;
+	char *name;
+	int namelen;
+
+	db_snapshot_section_begin(w, DB_SNAPSHOT_INODE);
+	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
+		if ((inode = inode_table_get(i)) == NULL)
+			continue;
+		/* free inodes are dumped too, to keep their generation */
+		st.st_ino = inode->i_number;
+		st.st_gen = inode->i_gen;
+		st.st_nlink = inode->i_nlink;
+		st.st_size = inode->i_size;
+		st.st_mode = inode->i_mode;
+		st.st_user = user_name_even_invalid(inode->i_user);
+		st.st_group = group_name_even_invalid(inode->i_group);
+		st.st_atimespec = inode->i_atimespec;
+		st.st_mtimespec = inode->i_mtimespec;
+		st.st_ctimespec = inode->i_ctimespec;
+		db_snapshot_put_inode(w, &st);
+	}
+
+	db_snapshot_section_begin(w, DB_SNAPSHOT_INODE_CKSUM);
+	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
+		if ((inode = inode_table_get(i)) == NULL ||
+		    !inode_is_file(inode) ||
+		    (cs = inode->u.c.s.f.cksum) == NULL)
+			continue;
+		db_snapshot_put_inode_cksum(w, i, cs->type, cs->len, cs->sum);
+	}
+
+	db_snapshot_section_begin(w, DB_SNAPSHOT_FILECOPY);
+	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
+		if ((inode = inode_table_get(i)) == NULL ||
+		    !inode_is_file(inode))
+			continue;
+		/* incomplete replicas aren't stored in the DB either */
+		for (copy = inode->u.c.s.f.copies; copy != NULL;
+		    copy = copy->host_next) {
+			if (FILE_COPY_IS_VALID(copy))
+				db_snapshot_put_filecopy(w, i,
+				    host_name(copy->host));
+		}
+	}
+
+	db_snapshot_section_begin(w, DB_SNAPSHOT_DIRENTRY);
+	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
+		if ((inode = inode_table_get(i)) == NULL ||
+		    !inode_is_dir(inode))
+			continue;
+		dir = inode->u.c.s.d.entries;
+		if (!dir_cursor_set_pos(dir, 0, &cursor))
+			continue;
+		while ((entry = dir_cursor_get_entry(dir, &cursor)) != NULL) {
+			name = dir_entry_get_name(entry, &namelen);
+			db_snapshot_put_direntry(w, i, name, namelen,
+			    dir_entry_get_inode(entry)->i_number);
+			if (!dir_cursor_next(dir, &cursor))
+				break;
+		}
+	}
+
+	db_snapshot_section_begin(w, DB_SNAPSHOT_SYMLINK);
+	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
+		if ((inode = inode_table_get(i)) == NULL ||
+		    !inode_is_symlink(inode))
+			continue;
+		db_snapshot_put_symlink(w, i, inode->u.c.s.l.source_path);
+	}
+
+	db_snapshot_section_begin(w, DB_SNAPSHOT_XATTR);
+	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
+		if ((inode = inode_table_get(i)) == NULL)
+			continue;
+		inode_snapshot_xattrs(w, i, 0, &inode->i_xattrs);
+#ifdef ENABLE_XMLATTR
+		inode_snapshot_xattrs(w, i, 1, inode_xattrs(inode, 1));
+#endif
+	}
+}
+
 static struct xattr_entry *
 xattr_find(struct xattrs *xattrs, const char *attrname)
 {
@@ -6409,7 +7415,7 @@ xattr_find(struct xattrs *xattrs, const char *attrname)
 int
 inode_xattr_has_attr(struct inode *inode, int xmlMode, const char *attrname)
 {
-	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs(inode, xmlMode);
 
 	return (xattr_find(xattrs, attrname) != NULL);
 }
@@ -6419,18 +7425,20 @@ inode_xattr_add(struct inode *inode, int xmlMode, const char *attrname,
 	void *value, size_t size)
 {
 	gfarm_error_t e;
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs;
 
-	if (xattr_find(xattrs, attrname) != NULL) {
+	if (xattr_find(inode_xattrs(inode, xmlMode), attrname) != NULL) {
 		gflog_debug(GFARM_MSG_1001779,
 			"xattr of inode already exists: %s", attrname);
 		e = GFARM_ERR_ALREADY_EXISTS;
-	} else if (xattr_add(xattrs, xmlMode, attrname, value, size) != NULL) {
+	} else if ((xattrs = inode_xattrs_for_update(inode, xmlMode))
+	    != NULL &&
+	    xattr_add(xattrs, xmlMode, attrname, value, size) != NULL) {
 		e = GFARM_ERR_NO_ERROR;
 	} else {
 		gflog_debug(GFARM_MSG_1001780,
 			"xattr_add() failed : %s", attrname);
+		inode_cold_free_if_empty(inode);
 		e = GFARM_ERR_NO_MEMORY;
 	}
 	return (e);
@@ -6440,8 +7448,7 @@ gfarm_error_t
 inode_xattr_modify(struct inode *inode, int xmlMode, const char *attrname,
 	void *value, size_t size)
 {
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs(inode, xmlMode);
 	struct xattr_entry *entry = xattr_find(xattrs, attrname);
 
 	if (entry == NULL)
@@ -6471,8 +7478,7 @@ gfarm_error_t
 inode_xattr_get_cache(struct inode *inode, int xmlMode,
 	const char *attrname, void **cached_valuep, size_t *cached_sizep)
 {
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs(inode, xmlMode);
 	struct xattr_entry *entry;
 	void *r;
 
@@ -6498,8 +7504,7 @@ int
 inode_xattr_cache_is_same(struct inode *inode, int xmlMode,
 	const char *attrname, const void *value, size_t size)
 {
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs(inode, xmlMode);
 	struct xattr_entry *entry = xattr_find(xattrs, attrname);
 
 	if (entry == NULL || entry->cached_attrvalue == NULL) {
@@ -6607,7 +7612,7 @@ int
 inode_xattr_has_xmlattrs(struct inode *inode)
 {
 #ifdef ENABLE_XMLATTR
-	return (inode->i_xmlattrs.head != NULL);
+	return (inode_xattrs(inode, 1)->head != NULL);
 #else
 	return 0;
 #endif
@@ -6616,22 +7621,25 @@ inode_xattr_has_xmlattrs(struct inode *inode)
 gfarm_error_t
 inode_xattr_remove(struct inode *inode, int xmlMode, const char *attrname)
 {
-	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs(inode, xmlMode);
 	struct xattr_entry *entry, *prev, *next;
 
 	entry = xattr_find(xattrs, attrname);
 	if (entry != NULL) {
-		prev = entry->prev; // NULL if entry is head
+		prev = entry->prev; // tail if entry is head
 		next = entry->next; // NULL if entry is tail
 		if (entry == xattrs->head)
 			xattrs->head = next;
 		else
 			prev->next = next;
-		if (entry == xattrs->tail)
-			xattrs->tail = prev;
-		else
+		if (next == NULL) {
+			if (xattrs->head != NULL)
+				xattrs->head->prev = prev;
+		} else
 			next->prev = prev;
 		xattr_entry_free(entry);
+		if (xmlMode)
+			inode_cold_free_if_empty(inode);
 		return GFARM_ERR_NO_ERROR;
 	} else {
 		gflog_debug(GFARM_MSG_1001781,
@@ -6643,7 +7651,7 @@ inode_xattr_remove(struct inode *inode, int xmlMode, const char *attrname)
 gfarm_error_t
 inode_xattr_list(struct inode *inode, int xmlMode, char **namesp, size_t *sizep)
 {
-	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs(inode, xmlMode);
 	struct xattr_entry *entry = NULL;
 	char *names, *p;
 	int size = 0, len;
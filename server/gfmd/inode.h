@@ -1,10 +1,26 @@
 void inode_init(void);
+void inode_cksum_init(void);
+void inode_root_init(void);
 void dir_entry_init(void);
 void file_copy_init(void);
 void symlink_init(void);
 void xattr_init(void);
+struct db_snapshot_writer;
+void inode_snapshot(struct db_snapshot_writer *);
+
+/* parallel loading at startup */
+struct gfs_stat;
+void inode_load_begin(void);
+gfarm_error_t inode_load_reserve(gfarm_ino_t);
+int inode_load_reserve_reallocs(gfarm_ino_t);
+int inode_load_is_reserved(gfarm_ino_t);
+void inode_add_at_loading(struct gfs_stat *);
+void inode_load_end(void);
+void dir_entry_add_at_loading(gfarm_ino_t, char *, int, gfarm_ino_t);
+void dir_entry_load_end(void);
 
 gfarm_uint64_t inode_total_num(void);
+void inode_memory_info(void);
 
 struct inode;
 
@@ -29,6 +45,12 @@ void inode_for_each_file_opening(
 struct host *file_copy_host(struct file_copy *);
 int file_copy_is_valid(struct file_copy *);
 int file_copy_is_being_removed(struct file_copy *);
+struct inode *file_copy_inode(struct file_copy *);
+
+struct file_copy *host_file_copy_first(struct host *, gfarm_ino_t);
+struct file_copy *host_file_copy_next(struct file_copy *);
+gfarm_uint64_t host_file_copy_count(struct host *);
+struct inode *inode_file_get_parent(struct inode *);
 
 int inode_is_dir(struct inode *);
 int inode_is_file(struct inode *);
@@ -38,6 +60,7 @@ gfarm_int64_t inode_get_gen(struct inode *);
 void inode_set_gen_in_cache(struct inode *, gfarm_uint64_t);
 gfarm_int64_t inode_get_nlink(struct inode *);
 void inode_set_nlink_in_cache(struct inode *, gfarm_uint64_t);
+void inode_file_unset_parent(struct inode *);
 struct user *inode_get_user(struct inode *);
 void inode_set_user_by_name_in_cache(struct inode *, const char *);
 struct group *inode_get_group(struct inode *);
@@ -74,6 +97,8 @@ char *inode_get_symlink(struct inode *);
 struct dead_file_copy_list *inode_get_dead_copies(struct inode *);
 int inode_desired_dead_file_copy(gfarm_ino_t);
 gfarm_error_t inode_add_or_modify_in_cache(struct gfs_stat *, struct inode **);
+void inode_decrement_nlink_ini(struct inode *);
+void inode_nlink_ini_table_free(void);
 void inode_modify(struct inode *, struct gfs_stat *);
 gfarm_error_t symlink_add(gfarm_ino_t, char *);
 void inode_clear_symlink(struct inode *);
@@ -133,6 +158,8 @@ gfarm_error_t inode_remove_replica_metadata(struct inode *, struct host *,
 	gfarm_int64_t);
 gfarm_error_t inode_remove_replica_protected(struct inode *, struct host *,
 	struct file_opening *);
+gfarm_error_t inode_remove_replica_on_draining_host(struct inode *,
+	struct host *);
 void inode_remove_replica_incomplete(struct inode *, struct host *,
 	gfarm_int64_t);
 gfarm_error_t inode_remove_replica_in_cache(struct inode *, struct host *);
@@ -175,6 +202,9 @@ gfarm_error_t inode_cksum_set(struct file_opening *,
 	gfarm_int32_t, struct gfarm_timespec *);
 gfarm_error_t inode_cksum_get(struct file_opening *,
 	char **, size_t *, char **, gfarm_int32_t *);
+gfarm_error_t inode_cksum_set_in_cache(struct inode *,
+	const char *, size_t, const char *);
+void inode_cksum_remove_in_cache(struct inode *);
 
 int inode_is_opened_for_writing(struct inode *);
 int inode_is_opened_on(struct inode *, struct host *);
@@ -322,12 +322,24 @@ journal_file_reader_is_empty(struct journal_file_reader *reader)
 /* PREREQUISITE: journal_file_mutex. */
 void
 journal_file_reader_commit_pos(struct journal_file_reader *reader)
+{
+	journal_file_reader_commit_len(reader, reader->uncommitted_len);
+}
+
+/*
+ * commit only the first `len' bytes of the records read so far.
+ * `len' must be at a record boundary.
+ * PREREQUISITE: journal_file_mutex.
+ */
+void
+journal_file_reader_commit_len(struct journal_file_reader *reader, size_t len)
 {
 	struct journal_file *jf = reader->file;
-	static const char diag[] = "journal_file_reader_commit_pos";
+	static const char diag[] = "journal_file_reader_commit_len";
 	off_t pos;
 
-	pos = reader->committed_pos + reader->uncommitted_len;
+	assert(len <= reader->uncommitted_len);
+	pos = reader->committed_pos + len;
 	if (pos < jf->tail)
 		reader->committed_pos = pos;
 	else if (pos == jf->tail && reader->committed_lap == jf->writer.lap)
@@ -337,7 +349,7 @@ journal_file_reader_commit_pos(struct journal_file_reader *reader)
 		    pos - jf->tail + JOURNAL_FILE_HEADER_SIZE;
 		reader->committed_lap++;
 	}
-	reader->uncommitted_len = 0;
+	reader->uncommitted_len -= len;
 	gfarm_cond_signal(&jf->nonfull_cond, diag, JOURNAL_FILE_STR);
 }
 
@@ -1264,7 +1276,9 @@ static struct gfp_iobuffer_ops journal_iobuffer_ops = {
 	journal_env_for_credential_fd_op,
 	journal_blocking_read_op,
 	journal_blocking_read_op,
-	journal_blocking_write_op
+	journal_blocking_write_op,
+	NULL,
+	NULL
 };
 
 static gfarm_error_t
@@ -1867,75 +1881,105 @@ journal_read_purge(struct gfp_xdr *xdr, int len)
 	return (e);
 }
 
-gfarm_error_t
-journal_file_read(struct journal_file_reader *reader, void *op_arg,
-	journal_read_op_t read_op,
-	journal_post_read_op_t post_read_op,
-	journal_free_op_t free_op, void *closure, int *eofp)
+/*
+ * wait until a record is available.
+ * *eofp is set, if there is no more record and no writer.
+ * GFARM_ERR_CANT_OPEN is returned and *drainedp is set, if the reader is
+ * drained by journal_file_wait_for_read_completion().
+ * PREREQUISITE: journal_file_mutex.
+ */
+static gfarm_error_t
+journal_file_read_wait(struct journal_file_reader *reader, int read_ahead,
+	int *drainedp, int *eofp)
 {
 	gfarm_error_t e;
-	gfarm_uint64_t seqnum;
-	enum journal_operation ope = 0;
-	int needs_free = 1, drained = 0;
-	size_t len;
-	void *obj = NULL;
 	struct journal_file *jf = reader->file;
 	struct gfp_xdr *xdr = reader->xdr;
-	static const char diag[] = "journal_file_read";
+	static const char diag[] = "journal_file_read_wait";
 	size_t avail;
 	size_t min_rec_size = journal_rec_header_size()
 		+ sizeof(gfarm_uint32_t);
 
-	if (eofp)
-		*eofp = 0;
-	journal_file_mutex_lock(jf, diag);
-	if (journal_file_is_closed(jf)) {
-		e = GFARM_ERR_NO_ERROR;
-		goto unlock;
-	}
-	if (xdr == NULL) {
-		e = GFARM_ERR_INPUT_OUTPUT; /* shutting down */
-		goto unlock;
-	}
-
-	if ((e = gfp_xdr_recv_ahead(xdr, JOURNAL_READ_AHEAD_SIZE,
-	    &avail)) != GFARM_ERR_NO_ERROR) {
+	/*
+	 * refill the buffer only when half of the read-ahead is consumed,
+	 * to avoid moving a large buffer for each record.
+	 */
+	if ((e = gfp_xdr_recv_ahead(xdr, 1, &avail)) == GFARM_ERR_NO_ERROR &&
+	    avail < read_ahead / 2)
+		e = gfp_xdr_recv_ahead(xdr, read_ahead, &avail);
+	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_error(GFARM_MSG_1002914,
 		    "gfp_xdr_recv_ahead : %s", gfarm_error_string(e));
-		goto unlock;
+		return (e);
 	}
 	if (avail < min_rec_size) { /* no more record */
 		if (journal_file_has_writer(jf) == 0) {
 			*eofp = 1;
-			goto unlock;
+			return (GFARM_ERR_NO_ERROR);
 		}
 		while (avail < min_rec_size) {
 			jf->wait_until_nonempty = 1;
 			if (JOURNAL_FILE_READER_DRAINED(reader)) {
 				journal_file_reader_set_flag(reader,
 				    JOURNAL_FILE_READER_F_DRAIN, 0);
-				drained = 1;
-				e = GFARM_ERR_CANT_OPEN;
-				goto unlock;
+				*drainedp = 1;
+				return (GFARM_ERR_CANT_OPEN);
 			}
 			gfarm_cond_wait(&jf->nonempty_cond, &jf->mutex,
 			    diag, JOURNAL_FILE_STR);
 			jf->wait_until_nonempty = 0;
 			if ((e = gfp_xdr_recv_ahead(xdr,
-			    JOURNAL_READ_AHEAD_SIZE, &avail))
+			    read_ahead, &avail))
 			    != GFARM_ERR_NO_ERROR) {
 				gflog_debug(GFARM_MSG_1002915,
 				    "gfp_xdr_recv_ahead : %s",
 				    gfarm_error_string(e));
-				goto unlock;
+				return (e);
 			}
 		}
 	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+journal_file_read(struct journal_file_reader *reader, void *op_arg,
+	journal_read_op_t read_op,
+	journal_post_read_op_t post_read_op,
+	journal_free_op_t free_op, void *closure, int *eofp)
+{
+	gfarm_error_t e;
+	gfarm_uint64_t seqnum;
+	enum journal_operation ope = 0;
+	int needs_free = 1, drained = 0, eof = 0;
+	size_t len;
+	void *obj = NULL;
+	struct journal_file *jf = reader->file;
+	struct gfp_xdr *xdr = reader->xdr;
+	static const char diag[] = "journal_file_read";
+
+	if (eofp)
+		*eofp = 0;
+	journal_file_mutex_lock(jf, diag);
+	if (journal_file_is_closed(jf)) {
+		e = GFARM_ERR_NO_ERROR;
+		goto unlock;
+	}
+	if (xdr == NULL) {
+		e = GFARM_ERR_INPUT_OUTPUT; /* shutting down */
+		goto unlock;
+	}
+
+	if ((e = journal_file_read_wait(reader, JOURNAL_READ_AHEAD_SIZE,
+	    &drained, &eof)) != GFARM_ERR_NO_ERROR)
+		goto unlock;
+	if (eof) {
+		if (eofp)
+			*eofp = 1;
+		goto unlock;
+	}
 	if ((e = journal_read_rec_header(xdr, &ope, &seqnum, &len))
 	    != GFARM_ERR_NO_ERROR)
 		goto unlock;
-	if (eofp && *eofp)
-		goto unlock;
 	if ((e = read_op(op_arg, xdr, ope, &obj))
 	    != GFARM_ERR_NO_ERROR) {
 		GFLOG_ERROR_WITH_SN(GFARM_MSG_1002916,
@@ -1961,6 +2005,188 @@ unlock:
 	return (e);
 }
 
+/*
+ * read a record without decoding it.
+ * the body of the record is returned in *datap, which must be freed
+ * by caller, and it can be decoded later by journal_rec_decode().
+ * `read_ahead' is the size of the read-ahead on the journal file.
+ * this waits for a record, and is drained, like journal_file_read().
+ */
+gfarm_error_t
+journal_file_read_raw(struct journal_file_reader *reader, int read_ahead,
+	gfarm_uint64_t *seqnump, enum journal_operation *opep,
+	char **datap, size_t *data_lenp, size_t *rec_lenp, int *eofp)
+{
+	gfarm_error_t e;
+	gfarm_uint64_t seqnum;
+	enum journal_operation ope;
+	int drained = 0, rlen;
+	size_t len, data_len;
+	char *data = NULL;
+	struct journal_file *jf = reader->file;
+	struct gfp_xdr *xdr = reader->xdr;
+	static const char diag[] = "journal_file_read_raw";
+
+	*eofp = 0;
+	*datap = NULL;
+	journal_file_mutex_lock(jf, diag);
+	if (journal_file_is_closed(jf)) {
+		e = GFARM_ERR_NO_ERROR;
+		goto unlock;
+	}
+	if (xdr == NULL) {
+		e = GFARM_ERR_INPUT_OUTPUT; /* shutting down */
+		goto unlock;
+	}
+
+	if ((e = journal_file_read_wait(reader, read_ahead, &drained, eofp))
+	    != GFARM_ERR_NO_ERROR || *eofp)
+		goto unlock;
+	if ((e = journal_read_rec_header(xdr, &ope, &seqnum, &len))
+	    != GFARM_ERR_NO_ERROR)
+		goto unlock;
+	data_len = len - journal_rec_header_size() - sizeof(gfarm_uint32_t);
+	GFARM_MALLOC_ARRAY(data, data_len > 0 ? data_len : 1);
+	if (data == NULL) {
+		e = GFARM_ERR_NO_MEMORY;
+		GFLOG_ERROR_WITH_SN(GFARM_MSG_UNFIXED,
+		    "read record", e, seqnum, ope);
+		goto unlock;
+	}
+	if (data_len > 0) {
+		if ((e = gfp_xdr_recv_partial(xdr, 0, data, data_len, &rlen))
+		    != GFARM_ERR_NO_ERROR) {
+			GFLOG_ERROR_WITH_SN(GFARM_MSG_UNFIXED,
+			    "gfp_xdr_recv_partial", e, seqnum, ope);
+			goto unlock;
+		}
+		if ((size_t)rlen != data_len) {
+			e = GFARM_ERR_INTERNAL_ERROR;
+			GFLOG_ERROR_WITH_SN(GFARM_MSG_UNFIXED,
+			    "record is too short", e, seqnum, ope);
+			goto unlock;
+		}
+	}
+	if ((e = journal_read_purge(xdr, sizeof(gfarm_uint32_t)))
+	    != GFARM_ERR_NO_ERROR) /* skip crc */
+		goto unlock;
+	reader->uncommitted_len += len;
+	*seqnump = seqnum;
+	*opep = ope;
+	*datap = data;
+	*data_lenp = data_len;
+	*rec_lenp = len;
+	data = NULL;
+unlock:
+	journal_file_mutex_unlock(jf, diag);
+	free(data);
+	if (drained)
+		gfarm_cond_signal(&jf->drain_cond, diag, JOURNAL_FILE_STR);
+	return (e);
+}
+
+/*
+ * decoder of the records returned by journal_file_read_raw().
+ * each decoding thread should have its own decoder.
+ */
+struct journal_rec_decoder {
+	struct gfp_xdr *xdr;
+	const char *data;
+	size_t len, pos;
+};
+
+static gfarm_error_t
+journal_rec_decoder_close_op(void *cookie, int fd)
+{
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static int
+journal_rec_decoder_read_op(struct gfarm_iobuffer *b,
+	void *cookie, int fd, void *data, int length)
+{
+	struct journal_rec_decoder *decoder = cookie;
+	size_t rlen = decoder->len - decoder->pos;
+
+	if (rlen > (size_t)length)
+		rlen = length;
+	memcpy(data, decoder->data + decoder->pos, rlen);
+	decoder->pos += rlen;
+	return (rlen);
+}
+
+static struct gfp_iobuffer_ops journal_rec_decoder_iobuffer_ops = {
+	journal_rec_decoder_close_op,
+	journal_export_credential_fd_op,
+	journal_delete_credential_fd_op,
+	journal_env_for_credential_fd_op,
+	journal_rec_decoder_read_op,
+	journal_rec_decoder_read_op,
+	NULL,
+	NULL,
+	NULL
+};
+
+gfarm_error_t
+journal_rec_decoder_new(struct journal_rec_decoder **decoderp)
+{
+	gfarm_error_t e;
+	struct journal_rec_decoder *decoder;
+
+	GFARM_MALLOC(decoder);
+	if (decoder == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "allocation of journal_rec_decoder failed");
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	decoder->data = NULL;
+	decoder->len = decoder->pos = 0;
+	if ((e = gfp_xdr_new(&journal_rec_decoder_iobuffer_ops, decoder, -1,
+	    GFP_XDR_NEW_RECV|GFP_XDR_NEW_AUTO_RECV_EXPANSION,
+	    &decoder->xdr)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfp_xdr_new: %s", gfarm_error_string(e));
+		free(decoder);
+		return (e);
+	}
+	*decoderp = decoder;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+void
+journal_rec_decoder_free(struct journal_rec_decoder *decoder)
+{
+	gfp_xdr_free(decoder->xdr);
+	free(decoder);
+}
+
+gfarm_error_t
+journal_rec_decode(struct journal_rec_decoder *decoder, void *op_arg,
+	journal_read_op_t read_op, enum journal_operation ope,
+	const char *data, size_t len, void **objp)
+{
+	gfarm_error_t e;
+	size_t avail;
+
+	decoder->data = data;
+	decoder->len = len;
+	decoder->pos = 0;
+	gfp_xdr_recvbuffer_clear_read_eof(decoder->xdr);
+	e = read_op(op_arg, decoder->xdr, ope, objp);
+	if (e == GFARM_ERR_NO_ERROR &&
+	    (decoder->pos != len ||
+	    gfp_xdr_recv_ahead(decoder->xdr, 1, &avail) != GFARM_ERR_NO_ERROR
+	    || avail != 0)) {
+		/* the record body has not been consumed exactly */
+		e = GFARM_ERR_INTERNAL_ERROR;
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "ope=%s: journal record has an unexpected length",
+		    journal_operation_name(ope));
+	}
+	decoder->data = NULL;
+	return (e);
+}
+
 /* recp must be freed by caller */
 gfarm_error_t
 journal_file_read_serialized(struct journal_file_reader *reader,
@@ -78,6 +78,7 @@ struct gfp_xdr;
 struct journal_file;
 struct journal_file_reader;
 struct journal_file_writer;
+struct journal_rec_decoder;
 
 typedef gfarm_error_t (*journal_size_add_op_t)(enum journal_operation,
 	size_t *, void *);
@@ -107,6 +108,14 @@ gfarm_error_t journal_file_read(struct journal_file_reader *, void *,
 	void *, int *);
 gfarm_error_t journal_file_read_serialized(struct journal_file_reader *,
 	char **, gfarm_uint32_t *, gfarm_uint64_t *, int *);
+gfarm_error_t journal_file_read_raw(struct journal_file_reader *, int,
+	gfarm_uint64_t *, enum journal_operation *, char **, size_t *, size_t *,
+	int *);
+gfarm_error_t journal_rec_decoder_new(struct journal_rec_decoder **);
+void journal_rec_decoder_free(struct journal_rec_decoder *);
+gfarm_error_t journal_rec_decode(struct journal_rec_decoder *, void *,
+	journal_read_op_t, enum journal_operation, const char *, size_t,
+	void **);
 void journal_file_wait_for_read_completion(struct journal_file_reader *);
 void journal_file_wait_until_readable(struct journal_file *);
 void journal_file_wait_until_empty(struct journal_file *);
@@ -124,6 +133,7 @@ void journal_file_reader_committed_pos(struct journal_file_reader *, off_t *,
 void journal_file_reader_committed_pos_unlocked(struct journal_file_reader *,
 	off_t *, gfarm_uint64_t *);
 void journal_file_reader_commit_pos(struct journal_file_reader *);
+void journal_file_reader_commit_len(struct journal_file_reader *, size_t);
 int journal_file_reader_is_expired(struct journal_file_reader *);
 void journal_file_reader_disable_block_writer(struct journal_file_reader *);
 void journal_file_reader_invalidate(struct journal_file_reader *);
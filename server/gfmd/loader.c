@@ -0,0 +1,389 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdarg.h> /* gfp_xdr.h needs this */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+
+#include "db_access.h"
+#include "db_snapshot.h"
+#include "inode.h"
+#include "loader.h"
+
+/*
+ * parallel loading of the filesystem metadata at startup.
+ *
+ * the calling thread reads the inode and the direntry table, and
+ * distributes the records to worker threads in batches.
+ * a record is assigned to a worker by the range of its inode number
+ * (the directory inode number for a direntry), thus each inode and
+ * each directory is only modified by one worker.
+ * the other tables, which only modify their own fields of inodes,
+ * are loaded by their own threads while direntries are being loaded.
+ *
+ * each thread which reads the database uses its own connection,
+ * if the database backend supports it (see db_load_thread_begin()).
+ * the counters, the free inode list, nlink_ini and parent_dir
+ * are set up after the workers finish.
+ */
+
+#define LOADER_RANGE		1024	/* inode numbers per range */
+#define LOADER_BATCH_SIZE	256	/* records per batch */
+#define LOADER_QUEUE_MAX	64	/* max batches queued per worker */
+
+enum loader_batch_type {
+	LOADER_BATCH_INODE,
+	LOADER_BATCH_DIRENTRY
+};
+
+struct loader_direntry {
+	gfarm_ino_t dir_inum, entry_inum;
+	char *entry_name;
+	int entry_len;
+};
+
+struct loader_batch {
+	struct loader_batch *next;
+
+	enum loader_batch_type type;
+	int n;
+	union {
+		struct gfs_stat inodes[LOADER_BATCH_SIZE];
+		struct loader_direntry direntries[LOADER_BATCH_SIZE];
+	} u;
+};
+
+struct loader_worker {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t nonempty, nonfull;
+	struct loader_batch *head, **tailp;
+	int nbatches, quit;
+
+	struct loader_batch *filling; /* only accessed by the producer */
+};
+
+static struct loader {
+	int nworkers;
+	struct loader_worker *workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t idle;
+	int outstanding; /* batches which are submitted but not finished */
+} loader;
+
+static const char LOADER_MUTEX_DIAG[] = "loader.mutex";
+static const char LOADER_IDLE_DIAG[] = "loader.idle";
+static const char WORKER_MUTEX_DIAG[] = "loader_worker.mutex";
+static const char WORKER_NONEMPTY_DIAG[] = "loader_worker.nonempty";
+static const char WORKER_NONFULL_DIAG[] = "loader_worker.nonfull";
+
+static void
+loader_batch_run(struct loader_batch *b)
+{
+	int i;
+	struct loader_direntry *de;
+
+	switch (b->type) {
+	case LOADER_BATCH_INODE:
+		for (i = 0; i < b->n; i++)
+			inode_add_at_loading(&b->u.inodes[i]);
+		break;
+	case LOADER_BATCH_DIRENTRY:
+		for (i = 0; i < b->n; i++) {
+			de = &b->u.direntries[i];
+			dir_entry_add_at_loading(de->dir_inum,
+			    de->entry_name, de->entry_len, de->entry_inum);
+		}
+		break;
+	}
+}
+
+static void *
+loader_worker_main(void *arg)
+{
+	struct loader_worker *w = arg;
+	struct loader_batch *b;
+	static const char diag[] = "loader_worker_main";
+
+	for (;;) {
+		gfarm_mutex_lock(&w->mutex, diag, WORKER_MUTEX_DIAG);
+		while (w->head == NULL && !w->quit)
+			gfarm_cond_wait(&w->nonempty, &w->mutex,
+			    diag, WORKER_NONEMPTY_DIAG);
+		if ((b = w->head) != NULL) {
+			if ((w->head = b->next) == NULL)
+				w->tailp = &w->head;
+			w->nbatches--;
+			gfarm_cond_signal(&w->nonfull,
+			    diag, WORKER_NONFULL_DIAG);
+		}
+		gfarm_mutex_unlock(&w->mutex, diag, WORKER_MUTEX_DIAG);
+		if (b == NULL) /* quit */
+			break;
+
+		loader_batch_run(b);
+		free(b);
+
+		gfarm_mutex_lock(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+		if (--loader.outstanding == 0)
+			gfarm_cond_broadcast(&loader.idle,
+			    diag, LOADER_IDLE_DIAG);
+		gfarm_mutex_unlock(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+	}
+	return (NULL);
+}
+
+static void
+loader_submit(struct loader_worker *w)
+{
+	struct loader_batch *b = w->filling;
+	static const char diag[] = "loader_submit";
+
+	if (b == NULL || b->n == 0)
+		return;
+	w->filling = NULL;
+
+	gfarm_mutex_lock(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+	loader.outstanding++;
+	gfarm_mutex_unlock(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+
+	gfarm_mutex_lock(&w->mutex, diag, WORKER_MUTEX_DIAG);
+	while (w->nbatches >= LOADER_QUEUE_MAX)
+		gfarm_cond_wait(&w->nonfull, &w->mutex,
+		    diag, WORKER_NONFULL_DIAG);
+	b->next = NULL;
+	*w->tailp = b;
+	w->tailp = &b->next;
+	w->nbatches++;
+	gfarm_cond_signal(&w->nonempty, diag, WORKER_NONEMPTY_DIAG);
+	gfarm_mutex_unlock(&w->mutex, diag, WORKER_MUTEX_DIAG);
+}
+
+/* submit all partially filled batches, and wait until they are finished */
+static void
+loader_wait_idle(void)
+{
+	int i;
+	static const char diag[] = "loader_wait_idle";
+
+	for (i = 0; i < loader.nworkers; i++)
+		loader_submit(&loader.workers[i]);
+
+	gfarm_mutex_lock(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+	while (loader.outstanding > 0)
+		gfarm_cond_wait(&loader.idle, &loader.mutex,
+		    diag, LOADER_IDLE_DIAG);
+	gfarm_mutex_unlock(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+}
+
+/* returns the batch of the worker which is responsible for `inum' */
+static struct loader_batch *
+loader_batch_get(gfarm_ino_t inum, enum loader_batch_type type)
+{
+	struct loader_worker *w =
+	    &loader.workers[(inum / LOADER_RANGE) % loader.nworkers];
+	struct loader_batch *b;
+
+	if (w->filling != NULL && w->filling->n >= LOADER_BATCH_SIZE)
+		loader_submit(w);
+	if ((b = w->filling) == NULL) {
+		GFARM_MALLOC(b);
+		if (b == NULL)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "loading metadata: no memory");
+		b->type = type;
+		b->n = 0;
+		w->filling = b;
+	}
+	return (b);
+}
+
+/* The memory owner of `*st' is changed to loader.c */
+static void
+loader_inode_add(void *closure, struct gfs_stat *st)
+{
+	struct loader_batch *b;
+
+	if (!inode_load_is_reserved(st->st_ino)) {
+		/* the chunk array of inode_table is to be reallocated */
+		if (inode_load_reserve_reallocs(st->st_ino))
+			loader_wait_idle();
+		(void)inode_load_reserve(st->st_ino);
+		/* an error is reported by inode_add_at_loading() */
+	}
+	b = loader_batch_get(st->st_ino, LOADER_BATCH_INODE);
+	b->u.inodes[b->n++] = *st;
+}
+
+/* The memory owner of `entry_name' is changed to loader.c */
+static void
+loader_direntry_add(void *closure,
+	gfarm_ino_t dir_inum, char *entry_name, int entry_len,
+	gfarm_ino_t entry_inum)
+{
+	struct loader_batch *b =
+	    loader_batch_get(dir_inum, LOADER_BATCH_DIRENTRY);
+	struct loader_direntry *de = &b->u.direntries[b->n++];
+
+	de->dir_inum = dir_inum;
+	de->entry_name = entry_name;
+	de->entry_len = entry_len;
+	de->entry_inum = entry_inum;
+}
+
+static void
+loader_db_thread_begin(const char *table)
+{
+	gfarm_error_t e = db_load_thread_begin();
+
+	if (e != GFARM_ERR_NO_ERROR &&
+	    e != GFARM_ERR_OPERATION_NOT_SUPPORTED)
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "loading %s: cannot open a database connection, "
+		    "shared connection is used: %s",
+		    table, gfarm_error_string(e));
+}
+
+static void *
+loader_table_main(void *arg)
+{
+	void (*init)(void) = arg;
+
+	loader_db_thread_begin("table");
+	(*init)();
+	db_load_thread_end();
+	return (NULL);
+}
+
+static void (*loader_tables[])(void) = {
+	inode_cksum_init,
+	file_copy_init,
+	symlink_init,
+	xattr_init,
+};
+#define LOADER_NTABLES	GFARM_ARRAY_LENGTH(loader_tables)
+
+static void
+loader_workers_start(int nworkers)
+{
+	int i, err;
+	struct loader_worker *w;
+	static const char diag[] = "loader_workers_start";
+
+	GFARM_MALLOC_ARRAY(loader.workers, nworkers);
+	if (loader.workers == NULL)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: no memory", diag);
+	loader.nworkers = nworkers;
+	loader.outstanding = 0;
+	gfarm_mutex_init(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+	gfarm_cond_init(&loader.idle, diag, LOADER_IDLE_DIAG);
+
+	for (i = 0; i < nworkers; i++) {
+		w = &loader.workers[i];
+		gfarm_mutex_init(&w->mutex, diag, WORKER_MUTEX_DIAG);
+		gfarm_cond_init(&w->nonempty, diag, WORKER_NONEMPTY_DIAG);
+		gfarm_cond_init(&w->nonfull, diag, WORKER_NONFULL_DIAG);
+		w->head = NULL;
+		w->tailp = &w->head;
+		w->nbatches = w->quit = 0;
+		w->filling = NULL;
+		err = pthread_create(&w->thread, NULL, loader_worker_main, w);
+		if (err != 0)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "%s: pthread_create: %s", diag, strerror(err));
+	}
+}
+
+static void
+loader_workers_stop(void)
+{
+	int i;
+	struct loader_worker *w;
+	static const char diag[] = "loader_workers_stop";
+
+	for (i = 0; i < loader.nworkers; i++) {
+		w = &loader.workers[i];
+		gfarm_mutex_lock(&w->mutex, diag, WORKER_MUTEX_DIAG);
+		w->quit = 1;
+		gfarm_cond_signal(&w->nonempty, diag, WORKER_NONEMPTY_DIAG);
+		gfarm_mutex_unlock(&w->mutex, diag, WORKER_MUTEX_DIAG);
+	}
+	for (i = 0; i < loader.nworkers; i++) {
+		w = &loader.workers[i];
+		pthread_join(w->thread, NULL);
+		gfarm_cond_destroy(&w->nonfull, diag, WORKER_NONFULL_DIAG);
+		gfarm_cond_destroy(&w->nonempty, diag, WORKER_NONEMPTY_DIAG);
+		gfarm_mutex_destroy(&w->mutex, diag, WORKER_MUTEX_DIAG);
+	}
+	gfarm_cond_destroy(&loader.idle, diag, LOADER_IDLE_DIAG);
+	gfarm_mutex_destroy(&loader.mutex, diag, LOADER_MUTEX_DIAG);
+	free(loader.workers);
+	loader.workers = NULL;
+	loader.nworkers = 0;
+}
+
+/*
+ * does the same as inode_init(), dir_entry_init(), file_copy_init(),
+ * symlink_init() and xattr_init(), by `nthreads' worker threads.
+ */
+void
+loader_load_filesystem(int nthreads)
+{
+	gfarm_error_t e;
+	int i, err;
+	pthread_t tables[LOADER_NTABLES];
+	struct timespec start, end;
+	static const char diag[] = "loader_load_filesystem";
+
+	gfarm_gettime(&start);
+	inode_load_begin();
+	loader_workers_start(nthreads);
+	loader_db_thread_begin("inode");
+
+	/* inode */
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_inode_load(NULL, loader_inode_add) :
+	    db_inode_load(NULL, loader_inode_add);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "loading inode: %s", gfarm_error_string(e));
+	loader_wait_idle();
+	inode_load_end();
+	inode_root_init();
+
+	/* the other tables, and direntry */
+	for (i = 0; i < LOADER_NTABLES; i++) {
+		err = pthread_create(&tables[i], NULL, loader_table_main,
+		    loader_tables[i]);
+		if (err != 0)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "%s: pthread_create: %s", diag, strerror(err));
+	}
+	e = db_snapshot_is_loaded() ?
+	    db_snapshot_direntry_load(NULL, loader_direntry_add) :
+	    db_direntry_load(NULL, loader_direntry_add);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "loading direntry: %s", gfarm_error_string(e));
+	loader_wait_idle();
+	for (i = 0; i < LOADER_NTABLES; i++)
+		pthread_join(tables[i], NULL);
+	dir_entry_load_end();
+
+	db_load_thread_end();
+	loader_workers_stop();
+	gfarm_gettime(&end);
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "filesystem metadata loaded by %d threads in %.3f sec", nthreads,
+	    (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
@@ -0,0 +1,5 @@
+/*
+ * $Id$
+ */
+
+void loader_load_filesystem(int);
@@ -27,7 +27,12 @@ struct netsendq_workq {
 					    
 	struct netsendq_entry *next; /* next data to move to readyq */
 
-	int inflight_number;
+	int inflight_number; /* number of batches, if batch_size > 1 */
+};
+
+/* entries which are passed to (*sendq_type->send)() at once */
+struct netsendq_batch {
+	int nentries; /* number of entries which are not removed yet */
 };
 
 struct netsendq_manager;
@@ -83,6 +88,8 @@ netsendq_entry_init(struct netsendq_entry *entry, struct netsendq_type *type)
 	gfarm_mutex_init(&entry->entry_mutex, "netsendq_entry_init", "init");
 	entry->sending = 0;
 	entry->finalize_pending = 0;
+	entry->batch = NULL;
+	entry->batch_next = NULL;
 
 	/* entry->result is not initialized */
 }
@@ -95,6 +102,79 @@ netsendq_entry_destroy(struct netsendq_entry *entry)
 	    "netsendq_entry_destroy", "destroy");
 }
 
+/*
+ * the next entry of the batch which is passed to (*sendq_type->send)().
+ * an entry may be finalized and freed after netsendq_remove_entry()
+ * is called against it, thus the caller must get all entries of the batch
+ * by this function, before calling netsendq_remove_entry() against any
+ * of them.
+ * netsendq_entry_was_sent() doesn't finalize an entry which isn't
+ * removed yet, thus the batch may be walked after that, e.g. by a result
+ * callback.
+ */
+struct netsendq_entry *
+netsendq_entry_batch_next(struct netsendq_entry *entry)
+{
+	return (entry->batch_next);
+}
+
+/*
+ * PREREQUISITE: netsendq_workq::mutex
+ *
+ * link at most batch_size entries from workq->next as a batch,
+ * and advance workq->next.
+ */
+static void
+netsendq_workq_make_batch(struct netsendq_workq *workq,
+	struct netsendq_entry *head)
+{
+	struct netsendq_entry *entry = head, *next;
+	struct netsendq_batch *batch = NULL;
+	int n = 1;
+
+	if (head->sendq_type->batch_size > 1 &&
+	    (head->sendq_type->batchable == NULL ||
+	     (*head->sendq_type->batchable)(head->abhost)))
+		GFARM_MALLOC(batch); /* if NULL, send `head' alone */
+	for (;;) {
+		entry->batch = batch;
+		next = GFARM_HCIRCLEQ_NEXT(entry, workq_entries);
+		if (GFARM_HCIRCLEQ_IS_END(workq->q, next))
+			next = NULL;
+		if (batch == NULL || next == NULL ||
+		    n >= head->sendq_type->batch_size)
+			break;
+		entry->batch_next = next;
+		entry = next;
+		n++;
+	}
+	entry->batch_next = NULL;
+	if (batch != NULL)
+		batch->nentries = n;
+	workq->next = next;
+}
+
+/*
+ * PREREQUISITE: netsendq_workq::mutex
+ *
+ * `entry' is no longer in flight,
+ * the window slot is released when all entries of its batch are done.
+ */
+static void
+netsendq_workq_entry_done(struct netsendq_workq *workq,
+	struct netsendq_entry *entry)
+{
+	struct netsendq_batch *batch = entry->batch;
+
+	if (batch != NULL) {
+		entry->batch = NULL;
+		if (--batch->nentries > 0)
+			return;
+		free(batch);
+	}
+	--workq->inflight_number;
+}
+
 static void
 netsendq_entry_start_send(struct netsendq_entry *entry)
 {
@@ -169,9 +249,7 @@ netsendq_workq_to_readyq(struct netsendq *qhost,
 
 	while ((entry = workq->next) != NULL &&
 	    workq->inflight_number < entry->sendq_type->window_size) {
-		workq->next = GFARM_HCIRCLEQ_NEXT(entry, workq_entries);
-		if (GFARM_HCIRCLEQ_IS_END(workq->q, workq->next))
-			workq->next = NULL;
+		netsendq_workq_make_batch(workq, entry);
 		netsendq_readyq_add(qhost, entry, diag);
 		workq->inflight_number++;
 	}
@@ -256,7 +334,7 @@ netsendq_remove_entry(struct netsendq *qhost,
 	workq = &qhost->workqs[entry->sendq_type->type_index];
 	gfarm_mutex_lock(&workq->mutex, diag, "workq");
 	GFARM_HCIRCLEQ_REMOVE(entry, workq_entries);
-	--workq->inflight_number;
+	netsendq_workq_entry_done(workq, entry);
 
 	/* if (*entry->sendq_type->send)() isn't called, abort */
 	assert(entry != workq->next);
@@ -280,7 +358,7 @@ netsendq_host_is_down_at_entry(struct netsendq *qhost,
 	workq = &qhost->workqs[entry->sendq_type->type_index];
 	gfarm_mutex_lock(&workq->mutex, diag, "workq");
 	GFARM_HCIRCLEQ_REMOVE(entry, workq_entries);
-	--workq->inflight_number;
+	netsendq_workq_entry_done(workq, entry);
 	assert(entry != workq->next);
 	gfarm_mutex_unlock(&workq->mutex, diag, "workq");
 
@@ -432,7 +510,7 @@ netsendq_send_manager(void *arg)
 {
 	struct netsendq_manager *manager = arg;
 	struct netsendq *current, *send_to, *to_remove, *c;
-	struct netsendq_entry *entry;
+	struct netsendq_entry *entry, *e, *next;
 	int all_busy = 1;
 	static const char diag[] = "netsendq_send_manager";
 
@@ -497,11 +575,17 @@ netsendq_send_manager(void *arg)
 			/* unset send_to->sending */
 			netsendq_was_sent_to_host(send_to);
 		} else if (abstract_host_is_up(send_to->abhost)) {
-			netsendq_entry_start_send(entry);
+			for (e = entry; e != NULL; e = next) {
+				next = netsendq_entry_batch_next(e);
+				netsendq_entry_start_send(e);
+			}
 			thrpool_add_job(manager->send_thrpool,
 			    entry->sendq_type->send, entry);
 		} else {
-			netsendq_host_is_down_at_entry(send_to, entry);
+			for (e = entry; e != NULL; e = next) {
+				next = netsendq_entry_batch_next(e);
+				netsendq_host_is_down_at_entry(send_to, e);
+			}
 			/* unset send_to->sending */
 			netsendq_was_sent_to_host(send_to);
 		}
@@ -538,7 +622,7 @@ netsendq_host_remove_internal(struct netsendq *qhost, int hold_queue)
 {
 	struct netsendq_manager *manager = qhost->manager;
 	struct netsendq_workq *workq;
-	struct netsendq_entry *entry, *n;
+	struct netsendq_entry *entry, *n, *e, *next;
 	int i;
 	static const char diag[] = "netsendq_host_becomes_down";
 
@@ -563,13 +647,19 @@ netsendq_host_remove_internal(struct netsendq *qhost, int hold_queue)
 
 	gfarm_mutex_lock(&qhost->readyq_mutex, diag, "readyq_mutex");
 	GFARM_STAILQ_FOREACH_SAFE(entry, &qhost->readyq, readyq_entries, n) {
-		/* NOTE: finalize even if NETSENDQ_FLAG_QUEUEABLE_IF_DOWN */
-		GFARM_HCIRCLEQ_REMOVE(entry, workq_entries);
 		workq = &qhost->workqs[entry->sendq_type->type_index];
-		--workq->inflight_number;
+		for (e = entry; e != NULL; e = next) {
+			next = netsendq_entry_batch_next(e);
+			/*
+			 * NOTE: finalize even if
+			 * NETSENDQ_FLAG_QUEUEABLE_IF_DOWN
+			 */
+			GFARM_HCIRCLEQ_REMOVE(e, workq_entries);
+			netsendq_workq_entry_done(workq, e);
 
-		netsendq_finalizeq_add(manager, entry,
-		    GFARM_ERR_CONNECTION_ABORTED, diag);
+			netsendq_finalizeq_add(manager, e,
+			    GFARM_ERR_CONNECTION_ABORTED, diag);
+		}
 	}
 	GFARM_STAILQ_INIT(&qhost->readyq);
 	gfarm_mutex_unlock(&qhost->readyq_mutex, diag, "readyq_mutex");
@@ -13,6 +13,20 @@ struct netsendq_type {
 	int window_size;
 	int flags;	/* NETSENDQ_FLAG_* */
 	int type_index; /* NETSENDQ_TYPE_GF?_* */
+
+	/*
+	 * if this is greater than 1, send() is called with a list of
+	 * at most batch_size entries, see netsendq_entry_batch_next().
+	 * window_size is the number of send() calls in flight, in that case.
+	 */
+	int batch_size;
+
+	/*
+	 * if this is not NULL and returns false, entries for the host
+	 * are sent one by one, e.g. because the host doesn't support
+	 * the batch protocol.
+	 */
+	int (*batchable)(struct abstract_host *);
 };
 
 #if 0
@@ -50,7 +64,12 @@ struct netsendq_entry {
 
 	pthread_mutex_t entry_mutex;
 	int sending, finalize_pending; /* protected by entry_mutex */
+
+	/* protected by netsendq_workq::mutex, while in flight */
+	struct netsendq_batch *batch;
+	struct netsendq_entry *batch_next;
 };
 
 void netsendq_entry_init(struct netsendq_entry *, struct netsendq_type *);
 void netsendq_entry_destroy(struct netsendq_entry *);
+struct netsendq_entry *netsendq_entry_batch_next(struct netsendq_entry *);
@@ -20,11 +20,13 @@
 #include <gfarm/gfs.h>
 
 #include "gfutil.h"
+#include "hash.h"
 #include "nanosec.h"
 #include "thrsubr.h"
 
 #include "gfp_xdr.h"
 #include "config.h"
+#include "gfm_proto.h"
 #include "repattr.h"
 
 #include "fsngroup.h"
@@ -34,9 +36,12 @@
 #include "file_replication.h"
 #include "host.h"
 #include "subr.h"
+#include "giant_stat.h"
 #include "user.h"
 #include "back_channel.h"
 #include "gflog_reduced.h"
+#include "slab.h"
+#include "replica_check.h"
 
 /* for debug */
 /* #define DEBUG_REPLICA_CHECK or CPPFLAGS='-DDEBUG_REPLICA_CHECK' */
@@ -167,8 +172,10 @@ replica_check_desired_set(
 	char *repattr;
 	int desired_number;
 
+	/* dir_ino may be NULL, see inode_file_get_parent() */
 	if (inode_get_replica_spec(file_ino, &repattr, &desired_number) ||
-	    inode_search_replica_spec(dir_ino, &repattr, &desired_number)) {
+	    (dir_ino != NULL &&
+	     inode_search_replica_spec(dir_ino, &repattr, &desired_number))) {
 		infop->desired_number = desired_number;
 		infop->repattr = repattr;
 	} else {
@@ -179,83 +186,494 @@ replica_check_desired_set(
 
 #define REPLICA_CHECK_DIRENTS_BUFCOUNT 512
 
-static size_t replica_check_stack_size, replica_check_stack_index;
-static struct replication_info *replica_check_stack;
+static void
+replica_check_giant_lock_default()
+{
+	while (!giant_trylock())
+		gfarm_nanosleep(gfarm_replica_check_sleep_time);
+}
+
+static void (*replica_check_giant_lock)(void);
+static void (*replica_check_giant_unlock)(void) = giant_unlock;
+
+/*
+ * dirty set
+ *
+ * replica_check_signal_*() enqueue only inodes and hosts which are
+ * affected by the event, instead of sweeping the whole namespace.
+ * a directory in the dirty set means all files under the directory.
+ * a host in the dirty set means all replicas on the host,
+ * and `inum' is a cursor to walk them.
+ *
+ * all members are protected by replica_check_mutex.
+ */
+struct replica_check_dirty {
+	struct replica_check_dirty *next;
+	time_t due;
+	gfarm_ino_t inum;
+	struct host *host;	/* NULL, if this is an inode */
+};
+
+enum replica_check_queue_type {
+	RC_QUEUE_INODE,
+	RC_QUEUE_HOST,
+	RC_QUEUE_INODE_RETRY,	/* due after gfarm_metadb_heartbeat_interval */
+	RC_QUEUE_HOST_DOWN,	/* due after replica_check_host_down_thresh */
+	RC_NQUEUES
+};
+
+/* each queue has a constant delay, thus it's sorted by `due' */
+struct replica_check_queue {
+	const char *name;
+	struct replica_check_dirty *head, **tailp;
+	gfarm_uint64_t n;
+	struct gfarm_hash_table *inodes; /* to avoid duplicates, if inode */
+};
+
+#define REPLICA_CHECK_DIRTY_MAX		(1024 * 1024)
+#define REPLICA_CHECK_DIRTY_HASHTAB_SIZE	65521	/* prime */
+
+#define REPLICA_CHECK_DIAG "replica_check"
+
+static pthread_mutex_t replica_check_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t replica_check_cond = PTHREAD_COND_INITIALIZER;
+static int replica_check_initialized = 0; /* ignore signals in startup */
+
+static struct replica_check_queue replica_check_queues[RC_NQUEUES] = {
+	{ "inode" }, { "host" }, { "inode_retry" }, { "host_down" },
+};
+static gfarm_uint64_t replica_check_dirty_inodes;
+static int replica_check_dirty_overflowed;
+static time_t replica_check_audit_next; /* 0: not scheduled */
+
+static struct slab replica_check_dirty_slab = SLAB_INITIALIZER(
+	"replica_check_dirty", sizeof(struct replica_check_dirty));
+
+static int
+replica_check_queues_init()
+{
+	int i;
+	struct replica_check_queue *q;
+
+	for (i = 0; i < RC_NQUEUES; i++) {
+		q = &replica_check_queues[i];
+		q->head = NULL;
+		q->tailp = &q->head;
+		q->n = 0;
+		if (i == RC_QUEUE_HOST || i == RC_QUEUE_HOST_DOWN) {
+			q->inodes = NULL;
+			continue;
+		}
+		q->inodes = gfarm_hash_table_alloc(
+		    REPLICA_CHECK_DIRTY_HASHTAB_SIZE,
+		    gfarm_hash_default, gfarm_hash_key_equal_default);
+		if (q->inodes == NULL) {
+			gflog_error(GFARM_MSG_UNFIXED,
+			    "replica_check: no memory");
+			return (0);
+		}
+	}
+	return (1);
+}
 
+static time_t
+replica_check_queue_delay(enum replica_check_queue_type type)
+{
+	switch (type) {
+	case RC_QUEUE_INODE_RETRY:
+		return (gfarm_metadb_heartbeat_interval);
+	case RC_QUEUE_HOST_DOWN:
+		return (gfarm_replica_check_host_down_thresh);
+	default:
+		return (0);
+	}
+}
+
+/* PREREQUISITE: replica_check_mutex */
+static void
+replica_check_audit_request(time_t t)
+{
+	if (replica_check_audit_next == 0 || replica_check_audit_next > t)
+		replica_check_audit_next = t;
+}
+
+/* PREREQUISITE: replica_check_mutex */
+static void
+replica_check_dirty_add(enum replica_check_queue_type type,
+	struct host *host, gfarm_ino_t inum)
+{
+	struct replica_check_queue *q = &replica_check_queues[type];
+	struct replica_check_dirty *d;
+	int created;
+
+	if (host != NULL) {
+		/* a queue of hosts is short */
+		for (d = q->head; d != NULL; d = d->next) {
+			if (d->host == host) {
+				if (d->inum > inum)
+					d->inum = inum;
+				return;
+			}
+		}
+	} else {
+		if (replica_check_dirty_inodes >= REPLICA_CHECK_DIRTY_MAX) {
+			if (!replica_check_dirty_overflowed) {
+				gflog_notice(GFARM_MSG_UNFIXED,
+				    "replica_check: too many dirty inodes, "
+				    "a full audit is scheduled instead");
+				replica_check_dirty_overflowed = 1;
+			}
+			replica_check_audit_request(time(NULL));
+			return;
+		}
+		if (gfarm_hash_enter(q->inodes, &inum, sizeof(inum), 0,
+		    &created) == NULL) {
+			gflog_error(GFARM_MSG_UNFIXED,
+			    "replica_check: inode %lld: no memory",
+			    (long long)inum);
+			replica_check_audit_request(time(NULL));
+			return;
+		}
+		if (!created)
+			return;
+	}
+	if ((d = slab_alloc(&replica_check_dirty_slab)) == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED, "replica_check: no memory");
+		if (host == NULL)
+			gfarm_hash_purge(q->inodes, &inum, sizeof(inum));
+		replica_check_audit_request(time(NULL));
+		return;
+	}
+	d->next = NULL;
+	d->due = time(NULL) + replica_check_queue_delay(type);
+	d->inum = inum;
+	d->host = host;
+	*q->tailp = d;
+	q->tailp = &d->next;
+	q->n++;
+	if (host == NULL)
+		replica_check_dirty_inodes++;
+}
+
+/* PREREQUISITE: replica_check_mutex */
 static int
-replica_check_stack_init()
+replica_check_dirty_get(struct replica_check_dirty *dp, time_t now)
+{
+	int i;
+	struct replica_check_queue *q;
+	struct replica_check_dirty *d;
+
+	for (i = 0; i < RC_NQUEUES; i++) {
+		q = &replica_check_queues[i];
+		if ((d = q->head) == NULL || d->due > now)
+			continue;
+		if ((q->head = d->next) == NULL)
+			q->tailp = &q->head;
+		q->n--;
+		if (d->host == NULL) {
+			gfarm_hash_purge(q->inodes, &d->inum, sizeof(d->inum));
+			replica_check_dirty_inodes--;
+		}
+		*dp = *d;
+		slab_free(&replica_check_dirty_slab, d);
+		return (1);
+	}
+	return (0);
+}
+
+/* PREREQUISITE: replica_check_mutex */
+static time_t
+replica_check_dirty_next_due(void)
 {
-	replica_check_stack_index = 0;
-	replica_check_stack_size = REPLICA_CHECK_DIRENTS_BUFCOUNT;
-	GFARM_MALLOC_ARRAY(replica_check_stack, replica_check_stack_size);
-	if (replica_check_stack == NULL) {
+	int i;
+	time_t due = 0;
+	struct replica_check_dirty *d;
+
+	for (i = 0; i < RC_NQUEUES; i++) {
+		d = replica_check_queues[i].head;
+		if (d != NULL && (due == 0 || d->due < due))
+			due = d->due;
+	}
+	return (due);
+}
+
+static void
+replica_check_enqueue(const char *diag, enum replica_check_queue_type type,
+	struct host *host, gfarm_ino_t inum)
+{
+	gfarm_mutex_lock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	replica_check_dirty_add(type, host, inum);
+	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+}
+
+/*
+ * repair queue
+ *
+ * files which need to be fixed are queued by the risk of data loss,
+ * and fixed in the order of:
+ * 1. the risk class, i.e. files which have no valid replica on
+ *    available hosts come first, then files which have the last one.
+ * 2. the deficit of replicas, relative to gfarm.ncopy/gfarm.replicainfo.
+ * 3. the file size, since smaller files are repaired sooner.
+ *    this restores redundancy of more files per byte of replication.
+ *
+ * the queue itself is only accessed by replica_check_thread,
+ * but replica_check_repair_depth[] is protected by replica_check_mutex.
+ */
+enum replica_check_risk {
+	RC_RISK_NO_REPLICA,	/* no valid replica on available hosts */
+	RC_RISK_LAST_REPLICA,	/* only one valid replica */
+	RC_RISK_DEFICIT,	/* less than the desired number */
+	RC_RISK_BALANCE,	/* replicainfo may require rebalancing */
+	RC_NRISKS
+};
+
+static const char *replica_check_risk_names[RC_NRISKS] = {
+	"no_replica", "last_replica", "deficit", "balance"
+};
+
+struct replica_check_repair {
+	struct replication_info info;
+	gfarm_off_t size;
+	int risk, deficit;
+};
+
+#define REPLICA_CHECK_REPAIR_MAX	(1024 * 1024)
+#define REPLICA_CHECK_REPAIR_BATCH	(64 * 1024) /* for the full audit */
+
+static struct replica_check_repair *replica_check_repair_queue;
+static size_t replica_check_repair_size, replica_check_repair_n;
+static gfarm_uint64_t replica_check_repair_depth[RC_NRISKS];
+static gfarm_uint64_t replica_check_repair_done[RC_NRISKS];
+
+static int
+replica_check_repair_init()
+{
+	replica_check_repair_n = 0;
+	replica_check_repair_size = REPLICA_CHECK_DIRENTS_BUFCOUNT;
+	GFARM_MALLOC_ARRAY(replica_check_repair_queue,
+	    replica_check_repair_size);
+	if (replica_check_repair_queue == NULL) {
 		gflog_error(GFARM_MSG_1003630, "replica_check: no memory");
 		return (0);
 	}
 	return (1);
 }
 
-static void
-replica_check_stack_push(struct inode *dir_ino, struct inode *file_ino)
+static int
+replica_check_repair_is_full(void)
 {
-	assert(replica_check_stack_index < replica_check_stack_size);
+	return (replica_check_repair_n >= REPLICA_CHECK_REPAIR_MAX);
+}
 
-	replica_check_stack[replica_check_stack_index].inum
-		= inode_get_number(file_ino);
-	replica_check_stack[replica_check_stack_index].gen
-		= inode_get_gen(file_ino);
-	replica_check_desired_set(dir_ino, file_ino,
-	    &(replica_check_stack[replica_check_stack_index]));
-	replica_check_stack_index++;
+/* returns true, if `a' should be fixed before `b' */
+static int
+replica_check_repair_before(
+	const struct replica_check_repair *a,
+	const struct replica_check_repair *b)
+{
+	if (a->risk != b->risk)
+		return (a->risk < b->risk);
+	if (a->deficit != b->deficit)
+		return (a->deficit > b->deficit);
+	if (a->size != b->size)
+		return (a->size < b->size);
+	return (a->info.inum < b->info.inum);
 }
 
+/* the total number of replicas specified by gfarm.replicainfo */
 static int
-replica_check_stack_pop(struct replication_info *infop)
+replica_check_repattr_amount(const char *repattr)
 {
-	if (replica_check_stack_index == 0)
+	gfarm_error_t e;
+	gfarm_repattr_t *reps;
+	size_t nreps, i;
+	int amount = 0;
+
+	e = gfarm_repattr_parse(repattr, &reps, &nreps);
+	if (e != GFARM_ERR_NO_ERROR)
 		return (0);
-	replica_check_stack_index--;
-	*infop = replica_check_stack[replica_check_stack_index];
+	for (i = 0; i < nreps; i++)
+		amount += gfarm_repattr_amount(reps[i]);
+	gfarm_repattr_free_all(nreps, reps);
+	return (amount);
+}
+
+/*
+ * classify the file by its risk, and returns 0 if it's not necessary
+ * to fix it.
+ */
+static int
+replica_check_repair_classify(struct inode *file_ino,
+	struct replica_check_repair *r)
+{
+	int ncopy, desired;
+
+	if (r->info.repattr == NULL && r->info.desired_number <= 0)
+		return (0); /* disabled */
+	ncopy = inode_get_ncopy(file_ino);
+	if (ncopy == 0 && r->size == 0 &&
+	    inode_get_ncopy_with_dead_host(file_ino) == 0)
+		return (0); /* an empty file may have no replica */
+
+	desired = r->info.repattr == NULL ? r->info.desired_number :
+	    replica_check_repattr_amount(r->info.repattr);
+	r->deficit = desired - ncopy;
+	if (ncopy == 0)
+		r->risk = RC_RISK_NO_REPLICA;
+	else if (ncopy == 1 && r->deficit > 0)
+		r->risk = RC_RISK_LAST_REPLICA;
+	else if (r->deficit > 0)
+		r->risk = RC_RISK_DEFICIT;
+	else if (r->info.repattr != NULL)
+		r->risk = RC_RISK_BALANCE; /* fsngroups may be unbalanced */
+	else
+		return (0); /* enough replicas */
 	return (1);
 }
 
 static void
-replica_check_giant_lock_default()
+replica_check_repair_depth_update(int risk, int n)
 {
-	while (!giant_trylock())
-		gfarm_nanosleep(gfarm_replica_check_sleep_time);
+	static const char diag[] = "replica_check_repair_depth_update";
+
+	gfarm_mutex_lock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	replica_check_repair_depth[risk] += n;
+	if (n < 0)
+		replica_check_repair_done[risk]++;
+	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
 }
 
-static void (*replica_check_giant_lock)(void);
-static void (*replica_check_giant_unlock)(void) = giant_unlock;
+/* PREREQUISITE: giant_lock */
+static void
+replica_check_repair_push(struct inode *dir_ino, struct inode *file_ino,
+	gfarm_ino_t *countp)
+{
+	struct replica_check_repair r, *q;
+	size_t i, parent;
+
+	(*countp)++;
+	r.info.inum = inode_get_number(file_ino);
+	r.info.gen = inode_get_gen(file_ino);
+	r.size = inode_get_size(file_ino);
+	replica_check_desired_set(dir_ino, file_ino, &r.info);
+	if (!replica_check_repair_classify(file_ino, &r)) {
+		free(r.info.repattr);
+		return;
+	}
+	if (replica_check_repair_n >= replica_check_repair_size) {
+		GFARM_REALLOC_ARRAY(q, replica_check_repair_queue,
+		    replica_check_repair_size * 2);
+		if (q == NULL) {
+			/* the audit will find this later */
+			gflog_error(GFARM_MSG_UNFIXED,
+			    "replica_check: %lld:%lld: no memory to queue",
+			    (long long)r.info.inum, (long long)r.info.gen);
+			free(r.info.repattr);
+			return;
+		}
+		replica_check_repair_queue = q;
+		replica_check_repair_size *= 2;
+	}
+
+	/* binary heap */
+	q = replica_check_repair_queue;
+	for (i = replica_check_repair_n++; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (!replica_check_repair_before(&r, &q[parent]))
+			break;
+		q[i] = q[parent];
+	}
+	q[i] = r;
+	replica_check_repair_depth_update(r.risk, 1);
+}
 
 static int
-replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp)
+replica_check_repair_pop(struct replica_check_repair *rp)
+{
+	struct replica_check_repair *q = replica_check_repair_queue, last;
+	size_t i, child, n;
+
+	if (replica_check_repair_n == 0)
+		return (0);
+	*rp = q[0];
+	n = --replica_check_repair_n;
+	last = q[n];
+	for (i = 0; (child = 2 * i + 1) < n; i = child) {
+		if (child + 1 < n &&
+		    replica_check_repair_before(&q[child + 1], &q[child]))
+			child++;
+		if (!replica_check_repair_before(&q[child], &last))
+			break;
+		q[i] = q[child];
+	}
+	q[i] = last;
+	replica_check_repair_depth_update(rp->risk, -1);
+	return (1);
+}
+
+/* fix the files in the repair queue */
+static void
+replica_check_repair_fix(void)
 {
 	gfarm_error_t e;
+	struct replica_check_repair r;
+	static const char diag[] = "replica_check_repair_fix";
+
+	while (replica_check_repair_pop(&r)) {
+		/* 1 milisec. */
+		unsigned long long sl = GFARM_MILLISEC_BY_NANOSEC;
+
+		for (;;) {
+			replica_check_giant_lock();
+			e = replica_check_fix(&r.info);
+			replica_check_giant_unlock();
+			if (e != GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE)
+				break; /* success or error */
+			/* retry */
+			gfarm_nanosleep(sl);
+			if (sl < GFARM_SECOND_BY_NANOSEC)
+				sl *= 2; /* 2,4,8,...,512,1024,1024 */
+		}
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_1003631,
+			    "replica_check_fix(): %s",
+			    gfarm_error_string(e));
+			replica_check_enqueue(diag, RC_QUEUE_INODE_RETRY,
+			    NULL, r.info.inum);
+		}
+		free(r.info.repattr);
+	}
+}
+
+/* if `recursive', subdirectories are added to the dirty set */
+static void
+replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp, int recursive)
+{
 	struct inode *dir_ino, *file_ino;
 	Dir dir;
 	DirCursor cursor;
 	gfarm_off_t dir_offset = 0;
 	DirEntry entry;
-	struct replication_info rep_info;
-	int need_to_retry = 0, eod = 0, i;
+	char *name;
+	int namelen, eod = 0, i;
+	static const char diag[] = "replica_check_main_dir";
 
 	while (!eod) {
 		replica_check_giant_lock();
 		dir_ino = inode_lookup(inum);
 		if (dir_ino == NULL) {
 			replica_check_giant_unlock();
-			return (need_to_retry);
+			return;
 		}
 		dir = inode_get_dir(dir_ino); /* include inode_is_dir() */
 		if (dir == NULL) {
 			replica_check_giant_unlock();
-			return (need_to_retry);
+			return;
 		}
 		if (!dir_cursor_set_pos(dir, dir_offset, &cursor)) {
 			replica_check_giant_unlock();
-			return (need_to_retry);
+			return;
 		}
 		/* avoid long giant lock */
 		for (i = 0; i < REPLICA_CHECK_DIRENTS_BUFCOUNT; i++) {
@@ -266,7 +684,16 @@ replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp)
 			}
 			file_ino = dir_entry_get_inode(entry);
 			if (inode_is_file(file_ino))
-				replica_check_stack_push(dir_ino, file_ino);
+				replica_check_repair_push(dir_ino, file_ino,
+				    countp);
+			else if (recursive && inode_is_dir(file_ino)) {
+				name = dir_entry_get_name(entry, &namelen);
+				if (!(name[0] == '.' && (namelen == 1 ||
+				    (namelen == 2 && name[1] == '.'))))
+					replica_check_enqueue(diag,
+					    RC_QUEUE_INODE, NULL,
+					    inode_get_number(file_ino));
+			}
 			if (!dir_cursor_next(dir, &cursor)) {
 				eod = 1; /* end of directory */
 				break;
@@ -275,49 +702,144 @@ replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp)
 		dir_offset = dir_cursor_get_pos(dir, &cursor);
 		replica_check_giant_unlock();
 
-		while (replica_check_stack_pop(&rep_info)) {
-			/* 1 milisec. */
-			unsigned long long sl = GFARM_MILLISEC_BY_NANOSEC;
-
-			for (;;) {
-				replica_check_giant_lock();
-				e = replica_check_fix(&rep_info);
-				replica_check_giant_unlock();
-				if (e !=
-				    GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE)
-					break; /* success or error */
-				/* retry */
-				gfarm_nanosleep(sl);
-				if (sl < GFARM_SECOND_BY_NANOSEC)
-					sl *= 2; /* 2,4,8,...,512,1024,1024 */
-			}
-			if (e != GFARM_ERR_NO_ERROR) {
-				need_to_retry = 1;
-				gflog_debug(GFARM_MSG_1003631,
-				    "replica_check_fix(): %s",
-				    gfarm_error_string(e));
-			}
-			(*countp)++;
-			free(rep_info.repattr);
+		if (replica_check_repair_is_full())
+			replica_check_repair_fix();
+	}
+}
+
+static void
+replica_check_inode(gfarm_ino_t inum, gfarm_ino_t *countp)
+{
+	struct inode *inode;
+	int is_dir = 0;
+
+	replica_check_giant_lock();
+	inode = inode_lookup(inum);
+	if (inode == NULL)
+		;
+	else if (inode_is_file(inode))
+		replica_check_repair_push(inode_file_get_parent(inode), inode,
+		    countp);
+	else if (inode_is_dir(inode))
+		is_dir = 1;
+	replica_check_giant_unlock();
+
+	if (is_dir)
+		replica_check_main_dir(inum, countp, 1);
+}
+
+/*
+ * queue the replicas on the host, from the cursor `inum'.
+ * all of them are queued before they are fixed, to fix them by priority.
+ */
+static void
+replica_check_host(struct host *host, gfarm_ino_t inum, gfarm_ino_t *countp)
+{
+	struct file_copy *copy;
+	struct inode *inode;
+	int i, eod = 0;
+	static const char diag[] = "replica_check_host";
+
+	while (!eod) {
+		if (replica_check_repair_is_full()) {
+			/* the rest is checked after the queue is fixed */
+			replica_check_enqueue(diag, RC_QUEUE_HOST, host, inum);
+			break;
+		}
+		/* avoid long giant lock */
+		replica_check_giant_lock();
+		for (copy = host_file_copy_first(host, inum), i = 0;
+		    copy != NULL && i < REPLICA_CHECK_DIRENTS_BUFCOUNT;
+		    copy = host_file_copy_next(copy), i++) {
+			inode = file_copy_inode(copy);
+			replica_check_repair_push(
+			    inode_file_get_parent(inode), inode, countp);
 		}
+		if (copy == NULL)
+			eod = 1;
+		else
+			inum = inode_get_number(file_copy_inode(copy));
+		replica_check_giant_unlock();
 	}
-	return (need_to_retry);
+}
+
+static gfarm_uint64_t info_dirty_count;
+
+/* process the dirty set until nothing is due */
+static void
+replica_check_dirty_process()
+{
+	struct replica_check_dirty d;
+	gfarm_ino_t count = 0;
+	int found, processed = 0;
+	static const char diag[] = "replica_check_dirty_process";
+
+	for (;;) {
+		gfarm_mutex_lock(&replica_check_mutex, diag,
+		    REPLICA_CHECK_DIAG);
+		found = replica_check_dirty_get(&d, time(NULL));
+		gfarm_mutex_unlock(&replica_check_mutex, diag,
+		    REPLICA_CHECK_DIAG);
+		if (!found)
+			break;
+		if (d.host != NULL)
+			replica_check_host(d.host, d.inum, &count);
+		else
+			replica_check_inode(d.inum, &count);
+		processed = 1;
+		if (replica_check_repair_is_full())
+			replica_check_repair_fix();
+	}
+	/* the dirty set is urgent, fix the queue including the audit's */
+	if (processed)
+		replica_check_repair_fix();
+	if (count > 0)
+		RC_LOG_DEBUG(GFARM_MSG_UNFIXED,
+		    "replica_check: dirty set, files=%llu",
+		    (unsigned long long)count);
+
+	replica_check_giant_lock();
+	info_dirty_count += count;
+	replica_check_giant_unlock();
+}
+
+/* limit the rate of the full audit to gfarm_replica_check_audit_rate */
+static void
+replica_check_audit_throttle(gfarm_ino_t count, const struct timeval *start)
+{
+	struct timeval now;
+	double expected, elapsed;
+
+	if (gfarm_replica_check_audit_rate <= 0)
+		return;
+	gettimeofday(&now, NULL);
+	gfarm_timeval_sub(&now, start);
+	elapsed = now.tv_sec + (double)now.tv_usec / GFARM_SECOND_BY_MICROSEC;
+	expected = (double)count / gfarm_replica_check_audit_rate;
+	if (expected > elapsed)
+		gfarm_nanosleep((unsigned long long)
+		    ((expected - elapsed) * GFARM_SECOND_BY_NANOSEC));
 }
 
 static gfarm_ino_t info_inum, info_table_size;
 static time_t info_time_start;
 
-static int
+/*
+ * full audit of all directories.
+ * the dirty set is processed in the meantime, since it has priority.
+ */
+static void
 replica_check_main()
 {
 	gfarm_ino_t inum, table_size, count = 0;
 	gfarm_ino_t root_inum = inode_root_number();
-	int need_to_retry = 0;
+	struct timeval start;
 
 	replica_check_giant_lock();
 	info_table_size = table_size = inode_table_current_size();
 	info_time_start = time(NULL);
 	replica_check_giant_unlock();
+	gettimeofday(&start, NULL);
 
 	RC_LOG_INFO(GFARM_MSG_1003632, "replica_check: start");
 	for (inum = root_inum;;) {
@@ -325,8 +847,11 @@ replica_check_main()
 		info_inum = inum;
 		replica_check_giant_unlock();
 
-		if (replica_check_main_dir(inum, &count))
-			need_to_retry = 1;
+		replica_check_main_dir(inum, &count, 0);
+		if (replica_check_repair_n >= REPLICA_CHECK_REPAIR_BATCH)
+			replica_check_repair_fix();
+		replica_check_audit_throttle(count, &start);
+		replica_check_dirty_process();
 		inum++; /* a next directory */
 		if (inum >= table_size) {
 			replica_check_giant_lock();
@@ -337,14 +862,13 @@ replica_check_main()
 				break;
 		}
 	}
+	replica_check_repair_fix();
 	RC_LOG_INFO(GFARM_MSG_1003633,
 	    "replica_check: finished, files=%llu", (unsigned long long)count);
 
 	replica_check_giant_lock();
 	info_time_start = 0;
 	replica_check_giant_unlock();
-
-	return (need_to_retry);
 }
 
 void
@@ -354,17 +878,45 @@ replica_check_info()
 	time_t time_start, elapse;
 	float progress;
 	long long estimate;
+	gfarm_uint64_t dirty_count, n[RC_NQUEUES];
+	gfarm_uint64_t depth[RC_NRISKS], done[RC_NRISKS];
+	int i;
+	static const char diag[] = "replica_check_info";
 
 	replica_check_giant_lock();
 	table_size = info_table_size;
 	inum = info_inum;
 	time_start = info_time_start;
+	dirty_count = info_dirty_count;
 	replica_check_giant_unlock();
 
 	if (!gfarm_replica_check) {
 		RC_LOG_INFO(GFARM_MSG_UNFIXED, "replica_check is disabled");
 		return;
 	}
+
+	gfarm_mutex_lock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	for (i = 0; i < RC_NQUEUES; i++)
+		n[i] = replica_check_queues[i].n;
+	for (i = 0; i < RC_NRISKS; i++) {
+		depth[i] = replica_check_repair_depth[i];
+		done[i] = replica_check_repair_done[i];
+	}
+	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	RC_LOG_INFO(GFARM_MSG_UNFIXED,
+	    "replica_check: dirty inodes=%llu, hosts=%llu, "
+	    "retry inodes=%llu, down hosts=%llu, checked files=%llu",
+	    (unsigned long long)n[RC_QUEUE_INODE],
+	    (unsigned long long)n[RC_QUEUE_HOST],
+	    (unsigned long long)n[RC_QUEUE_INODE_RETRY],
+	    (unsigned long long)n[RC_QUEUE_HOST_DOWN],
+	    (unsigned long long)dirty_count);
+	for (i = 0; i < RC_NRISKS; i++)
+		RC_LOG_INFO(GFARM_MSG_UNFIXED,
+		    "replica_check: repair queue %s: queued=%llu, done=%llu",
+		    replica_check_risk_names[i],
+		    (unsigned long long)depth[i], (unsigned long long)done[i]);
+
 	if (time_start == 0 || table_size == 0) {
 		RC_LOG_INFO(GFARM_MSG_UNFIXED, "replica_check: standby");
 		return;
@@ -382,195 +934,51 @@ replica_check_info()
 	    (long long)elapse, estimate);
 }
 
-#define REPLICA_CHECK_DIAG "replica_check"
-
-static pthread_mutex_t replica_check_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t replica_check_cond = PTHREAD_COND_INITIALIZER;
-static int replica_check_initialized = 0; /* ignore cond_signal in startup */
-static struct timeval *targets;
-static size_t targets_num, targets_size;
-
-#define MAX_TARGETS_SIZE 1024
-
-static int
-replica_check_timeval_cmp(const void *p1, const void *p2)
-{
-	const struct timeval *t1 = p1;
-	const struct timeval *t2 = p2;
-
-	return (-gfarm_timeval_cmp(t1, t2));
-}
-
+/* returns 1, if the full audit is due */
 static int
-replica_check_targets_init()
-{
-	targets_num = 0;
-	targets_size = MAX_TARGETS_SIZE;
-	GFARM_MALLOC_ARRAY(targets, targets_size);
-	if (targets == NULL) {
-		gflog_error(GFARM_MSG_1003634, "replica_check: no memory");
-		return (0);
-	}
-	return (1);
-}
-
-static void
-replica_check_targets_add(time_t sec)
-{
-	size_t i;
-
-	if (targets_num >= targets_size) {
-		qsort(targets, targets_size, sizeof(struct timeval),
-		    replica_check_timeval_cmp);
-		i = targets_size / 2; /* replace center */
-	} else
-		i = targets_num++;
-
-	gettimeofday(&targets[i], NULL);
-	targets[i].tv_sec += sec;
-#ifdef DEBUG_REPLICA_CHECK
-	RC_LOG_DEBUG(GFARM_MSG_1003635,
-	    "replica_check: add targets[%ld]=%ld.%06ld", (long)i,
-	    (long)targets[i].tv_sec,
-	    (long)targets[i].tv_usec);
-#endif
-}
-
-/* not delete */
-static int
-replica_check_targets_next(struct timeval *next, const struct timeval *now)
-{
-	size_t i;
-	struct timeval now2;
-
-	if (targets_num <= 0)
-		return (0);
-	if (targets_num == 1) {
-		*next = targets[0];
-#ifdef DEBUG_REPLICA_CHECK
-		RC_LOG_DEBUG(GFARM_MSG_1003636,
-		    "replica_check: targets[0]=%ld.%06ld",
-		    (long)next->tv_sec, (long)next->tv_usec);
-#endif
-		return (1);
-	}
-	/* late to early */
-	qsort(targets, targets_num, sizeof(struct timeval),
-	    replica_check_timeval_cmp);
-
-#ifdef DEBUG_REPLICA_CHECK
-	for (i = 0; i < targets_num; i++)
-		RC_LOG_DEBUG(GFARM_MSG_1003637,
-		    "replica_check: targets[%ld]=%ld.%06ld", (long)i,
-		    (long)targets[i].tv_sec, (long)targets[i].tv_usec);
-#endif
-	now2 = *now;
-
-	/* integrate near target times */
-	now2.tv_sec += gfarm_replica_check_minimum_interval;
-
-	/* assert(targets_num >= 2); */
-	for (i = targets_num - 1;; i--) {
-		if (gfarm_timeval_cmp(&targets[i], &now2) > 0) {
-			if (i == targets_num - 1) { /* future times only */
-				*next = targets[i]; /* nearest future time */
-				targets_num = i + 1;
-				return (1);
-			} else { /* latest past time */
-				*next = targets[i + 1]; /* previous */
-				targets_num = i + 2;
-				return (1);
-			}
-		} /* else: skip past times (older than now2) */
-
-		if (i == 0)
-			break;
-	}
-	*next = targets[0];
-	targets_num = 1;
-	return (1);
-}
-
-static void
-replica_check_targets_del()
-{
-	if (targets_num == 0)
-		return;
-	targets_num--;
-}
-
-static int
-replica_check_timedwait(
-	const struct timeval *tv, const struct timeval *now, const char *diag)
-{
-	struct timespec ts;
-
-	if (gfarm_timeval_cmp(tv, now) <= 0)
-		return (0); /* past time */
-
-	ts.tv_sec = tv->tv_sec;
-	ts.tv_nsec = (long)tv->tv_usec * GFARM_MICROSEC_BY_NANOSEC;
-	return (gfarm_cond_timedwait(
-	    &replica_check_cond, &replica_check_mutex,
-	    &ts, diag, REPLICA_CHECK_DIAG));
-}
-
-static void
 replica_check_wait()
 {
 	static const char diag[] = "replica_check_wait";
-	struct timeval next, now;
+	time_t now, next;
+	struct timespec ts;
+	int audit = 0;
 
 	gfarm_mutex_lock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
 	for (;;) {
-		gettimeofday(&now, NULL);
-		if (replica_check_targets_next(&next, &now)) {
-#ifdef DEBUG_REPLICA_CHECK
-			{
-				struct timeval after;
-
-				after = next;
-				gfarm_timeval_sub(&after, &now);
-				RC_LOG_DEBUG(GFARM_MSG_1003638,
-				    "replica_check: next=%ld.%06ld"
-				    "(after %ld.%06ld)",
-				    (long)next.tv_sec, (long)next.tv_usec,
-				    (long)after.tv_sec, (long)after.tv_usec);
-			}
-#endif
-			if (!replica_check_timedwait(&next, &now, diag)) {
-				/* reach the next target time */
-				replica_check_targets_del();
-				break; /* execute */
-			}
-		} else /* no target time */
-			gfarm_cond_wait(
-			    &replica_check_cond, &replica_check_mutex,
+		now = time(NULL);
+		next = replica_check_dirty_next_due();
+		if (next != 0 && next <= now)
+			break;
+		if (replica_check_audit_next != 0 &&
+		    replica_check_audit_next <= now) {
+			audit = 1;
+			replica_check_audit_next = 0;
+			replica_check_dirty_overflowed = 0;
+			break;
+		}
+		if (replica_check_audit_next != 0 &&
+		    (next == 0 || replica_check_audit_next < next))
+			next = replica_check_audit_next;
+		if (next == 0) {
+			gfarm_cond_wait(&replica_check_cond,
+			    &replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+		} else {
+			ts.tv_sec = next;
+			ts.tv_nsec = 0;
+			(void)gfarm_cond_timedwait(&replica_check_cond,
+			    &replica_check_mutex, &ts,
 			    diag, REPLICA_CHECK_DIAG);
-		/* caught cond_signal */
-
-		/*
-		 * integrate many replica_check_signal_*()
-		 *
-		 * waiting gfarm_replica_check_minimum_interval
-		 * seconds here, and replica_check_targets_next() will
-		 * gets the latest target time. (others are skipped)
-		 */
-		gfarm_mutex_unlock(
-		    &replica_check_mutex, diag, REPLICA_CHECK_DIAG);
-		gfarm_nanosleep(
-		    (unsigned long long)gfarm_replica_check_minimum_interval *
-		    GFARM_SECOND_BY_NANOSEC);
-		gfarm_mutex_lock(
-		    &replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+		}
 	}
 	if (!replica_check_initialized)
 		replica_check_initialized = 1;
 	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	return (audit);
 }
 
 static void
-replica_check_signal_general(const char *diag, long sec)
+replica_check_signal_general(const char *diag,
+	enum replica_check_queue_type type, struct host *host, gfarm_ino_t inum)
 {
 	if (!gfarm_replica_check)
 		return;
@@ -580,7 +988,7 @@ replica_check_signal_general(const char *diag, long sec)
 #ifdef DEBUG_REPLICA_CHECK
 		RC_LOG_DEBUG(GFARM_MSG_1003639, "%s is called", diag);
 #endif
-		replica_check_targets_add(sec);
+		replica_check_dirty_add(type, host, inum);
 		gfarm_cond_signal(
 		    &replica_check_cond, diag, REPLICA_CHECK_DIAG);
 	}
@@ -592,64 +1000,64 @@ replica_check_signal_general(const char *diag, long sec)
 }
 
 void
-replica_check_signal_host_up()
+replica_check_signal_host_up(struct host *host)
 {
 	static const char diag[] = "replica_check_signal_host_up";
 
-	replica_check_signal_general(diag, 0);
+	replica_check_signal_general(diag, RC_QUEUE_HOST, host, 0);
 }
 
 void
-replica_check_signal_host_down()
+replica_check_signal_host_down(struct host *host)
 {
 	static const char diag[] = "replica_check_signal_host_down";
 
-	replica_check_signal_general(
-	    diag, gfarm_replica_check_host_down_thresh);
-	/* NOTE: execute replica_check_main() twice after restarting gfsd */
+	replica_check_signal_general(diag, RC_QUEUE_HOST_DOWN, host, 0);
+	/* NOTE: the host is checked again, when gfsd is restarted */
 }
 
 void
-replica_check_signal_update_xattr()
+replica_check_signal_update_xattr(gfarm_ino_t inum)
 {
 	static const char diag[] = "replica_check_signal_update_xattr";
 
-	replica_check_signal_general(diag, 0);
+	replica_check_signal_general(diag, RC_QUEUE_INODE, NULL, inum);
 }
 
 void
-replica_check_signal_rename()
+replica_check_signal_rename(gfarm_ino_t inum)
 {
 	static const char diag[] = "replica_check_signal_rename";
 
-	replica_check_signal_general(diag, 0);
+	replica_check_signal_general(diag, RC_QUEUE_INODE, NULL, inum);
 }
 
 void
-replica_check_signal_rep_request_failed()
+replica_check_signal_rep_request_failed(gfarm_ino_t inum)
 {
 	static const char diag[] = "replica_check_signal_rep_request_failed";
 
-	replica_check_signal_general(diag, 0);
+	replica_check_signal_general(diag, RC_QUEUE_INODE, NULL, inum);
 }
 
 void
-replica_check_signal_rep_result_failed()
+replica_check_signal_rep_result_failed(gfarm_ino_t inum)
 {
 	static const char diag[] = "replica_check_signal_rep_result_failed";
 
-	replica_check_signal_general(diag, 0);
+	replica_check_signal_general(diag, RC_QUEUE_INODE, NULL, inum);
 }
 
 static void *
 replica_check_thread(void *arg)
 {
-	int wait_time;
+	static const char diag[] = "replica_check_thread";
 
-	if (!replica_check_stack_init())
+	if (!replica_check_repair_init())
 		return (NULL);
-	if (!replica_check_targets_init())
+	if (!replica_check_queues_init())
 		return (NULL);
+	(void)giant_stat_owner_set(GIANT_STAT_OWNER_REPLICA_CHECK);
 
 	if (gfarm_replica_check_sleep_time > 0)
 		replica_check_giant_lock = replica_check_giant_lock_default;
@@ -658,18 +1066,30 @@ replica_check_thread(void *arg)
 	if (gfarm_replica_check_sleep_time > GFARM_SECOND_BY_NANOSEC)
 		gfarm_replica_check_sleep_time = GFARM_SECOND_BY_NANOSEC;
 
-	/* wait startup of gfsd hosts */
-	wait_time = gfarm_metadb_heartbeat_interval;
-	replica_check_targets_add(wait_time);
+	/* wait startup of gfsd hosts, and audit all files once */
+	gfarm_mutex_lock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	replica_check_audit_request(
+	    time(NULL) + gfarm_metadb_heartbeat_interval);
+	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
 
 	for (;;) {
 		time_t t = time(NULL) + gfarm_replica_check_minimum_interval;
+		int audit = replica_check_wait();
+
+		replica_check_dirty_process();
+		if (audit) {
+			replica_check_main();
+			if (gfarm_replica_check_audit_interval > 0) {
+				gfarm_mutex_lock(&replica_check_mutex, diag,
+				    REPLICA_CHECK_DIAG);
+				replica_check_audit_request(time(NULL) +
+				    gfarm_replica_check_audit_interval);
+				gfarm_mutex_unlock(&replica_check_mutex, diag,
+				    REPLICA_CHECK_DIAG);
+			}
+		}
 
-		replica_check_wait();
-
-		if (replica_check_main()) /* error occured, retry */
-			replica_check_targets_add(wait_time);
-
+		/* integrate many replica_check_signal_*() */
 		t = t - time(NULL);
 		if (t > 0)
 			gfarm_sleep(t);
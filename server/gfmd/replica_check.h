@@ -2,11 +2,13 @@
  * $Id$
  */
 
+struct host;
+
 void replica_check_start(void);
-void replica_check_signal_host_up(void);
-void replica_check_signal_host_down(void);
-void replica_check_signal_update_xattr(void);
-void replica_check_signal_rename(void);
-void replica_check_signal_rep_request_failed(void);
-void replica_check_signal_rep_result_failed(void);
+void replica_check_signal_host_up(struct host *);
+void replica_check_signal_host_down(struct host *);
+void replica_check_signal_update_xattr(gfarm_ino_t);
+void replica_check_signal_rename(gfarm_ino_t);
+void replica_check_signal_rep_request_failed(gfarm_ino_t);
+void replica_check_signal_rep_result_failed(gfarm_ino_t);
 void replica_check_info(void);
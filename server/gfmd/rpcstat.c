@@ -0,0 +1,386 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdarg.h> /* gfp_xdr.h needs this */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <gfarm/gfarm.h>
+#include <gfarm/gfarm_iostat.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+
+#include "gfp_xdr.h"
+#include "gfm_proto.h"
+#include "iostat.h"
+
+#include "subr.h"
+#include "giant_stat.h"
+#include "rpcstat.h"
+
+/*
+ * per-request statistics.
+ *
+ * row i of the iostat file is for request number (i),
+ * and its id (s_valid) is (i + 1), once the request is called.
+ * the last row is for all requests of private extensions.
+ *
+ * the elapsed time of a request is split into:
+ *	queue:	time waiting for a worker thread in the job queue,
+ *		only counted for the first request handled by the job.
+ *	lock:	time waiting for giant_lock.
+ *	exec:	the rest, i.e. receiving, processing and replying.
+ * the percentiles are of the requests which completed in the last
+ * RPCSTAT_INTERVAL seconds, and remain unchanged while no request completes.
+ * each histogram bucket is at most 1/4 of its value wide,
+ * and the upper bound of the bucket is reported as the percentile.
+ */
+
+#define RPCSTAT_NROWS		(GIANT_STAT_NPROTO + 1)
+#define RPCSTAT_ROW_PRIVATE	GIANT_STAT_NPROTO
+#define RPCSTAT_INTERVAL	10 /* seconds */
+
+#define RPCSTAT_SUB_BITS	2
+#define RPCSTAT_SUB_BUCKETS	(1 << RPCSTAT_SUB_BITS)
+#define RPCSTAT_NBUCKETS	(RPCSTAT_SUB_BUCKETS * 36) /* up to 2^36 usec */
+
+enum rpcstat_phase {
+	RPCSTAT_QUEUE,
+	RPCSTAT_LOCK,
+	RPCSTAT_EXEC,
+	RPCSTAT_NPHASES
+};
+
+/* iostat items */
+#define RPCSTAT_ITEM_CALLS	0
+#define RPCSTAT_ITEM_ERRORS	1
+#define RPCSTAT_ITEM_BYTES_IN	2
+#define RPCSTAT_ITEM_BYTES_OUT	3
+#define RPCSTAT_ITEM_TIME	4 /* + phase */
+#define RPCSTAT_ITEM_PERCENTILE	(RPCSTAT_ITEM_TIME + RPCSTAT_NPHASES)
+#define RPCSTAT_NPERCENTILES	3
+#define RPCSTAT_NITEM \
+	(RPCSTAT_ITEM_PERCENTILE + RPCSTAT_NPHASES * RPCSTAT_NPERCENTILES)
+
+static struct gfarm_iostat_spec rpcstat_spec[RPCSTAT_NITEM] = {
+	{ "calls", GFARM_IOSTAT_TYPE_TOTAL },
+	{ "errors", GFARM_IOSTAT_TYPE_TOTAL },
+	{ "bytes_in", GFARM_IOSTAT_TYPE_TOTAL },
+	{ "bytes_out", GFARM_IOSTAT_TYPE_TOTAL },
+	{ "queue_usec", GFARM_IOSTAT_TYPE_TOTAL },
+	{ "lock_usec", GFARM_IOSTAT_TYPE_TOTAL },
+	{ "exec_usec", GFARM_IOSTAT_TYPE_TOTAL },
+	{ "queue_p50", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "queue_p99", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "queue_p999", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "lock_p50", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "lock_p99", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "lock_p999", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "exec_p50", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "exec_p99", GFARM_IOSTAT_TYPE_CURRENT },
+	{ "exec_p999", GFARM_IOSTAT_TYPE_CURRENT },
+};
+
+/* per mille */
+static const int rpcstat_percentiles[RPCSTAT_NPERCENTILES] = {
+	500, 990, 999
+};
+
+struct rpcstat_entry {
+	pthread_mutex_t mutex;
+	gfarm_uint64_t calls, errors, bytes_in, bytes_out;
+	gfarm_uint64_t time[RPCSTAT_NPHASES];
+
+	/* requests completed in the current interval */
+	gfarm_uint32_t interval_calls;
+	gfarm_uint32_t hist[RPCSTAT_NPHASES][RPCSTAT_NBUCKETS];
+};
+
+/* per thread state */
+struct rpcstat_thread {
+	gfarm_uint64_t queue_time; /* microseconds */
+};
+
+/* NULL, if the statistics are disabled */
+static struct rpcstat_entry *rpcstat_table = NULL;
+
+static pthread_key_t rpcstat_key;
+static struct gfarm_iostat_head *rpcstat_head;
+static struct gfarm_iostat_items *rpcstat_items;
+
+static const char RPCSTAT_MUTEX_DIAG[] = "rpcstat_mutex";
+
+static gfarm_uint64_t
+rpcstat_elapsed(const struct timespec *from, const struct timespec *to)
+{
+	gfarm_int64_t usec;
+
+	usec = (gfarm_int64_t)(to->tv_sec - from->tv_sec) *
+	    GFARM_SECOND_BY_MICROSEC +
+	    (to->tv_nsec - from->tv_nsec) / GFARM_MICROSEC_BY_NANOSEC;
+	return (usec < 0 ? 0 : usec); /* clock may be adjusted */
+}
+
+/*
+ * values less than RPCSTAT_SUB_BUCKETS * 2 have their own buckets,
+ * and each power of 2 range above is divided into RPCSTAT_SUB_BUCKETS.
+ */
+static int
+rpcstat_bucket(gfarm_uint64_t usec)
+{
+	int msb = 0, b;
+	gfarm_uint64_t v;
+
+	if (usec < RPCSTAT_SUB_BUCKETS * 2)
+		return (usec);
+	for (v = usec; v >= RPCSTAT_SUB_BUCKETS * 2; v >>= 1)
+		msb++;
+	/* v is in [RPCSTAT_SUB_BUCKETS, RPCSTAT_SUB_BUCKETS * 2) */
+	b = RPCSTAT_SUB_BUCKETS * (msb + 1) + (v - RPCSTAT_SUB_BUCKETS);
+	return (b < RPCSTAT_NBUCKETS ? b : RPCSTAT_NBUCKETS - 1);
+}
+
+/* the largest value which belongs to the bucket */
+static gfarm_uint64_t
+rpcstat_bucket_max(int b)
+{
+	int shift;
+
+	if (b < RPCSTAT_SUB_BUCKETS * 2)
+		return (b);
+	shift = b / RPCSTAT_SUB_BUCKETS - 1;
+	return (((gfarm_uint64_t)(b % RPCSTAT_SUB_BUCKETS +
+	    RPCSTAT_SUB_BUCKETS + 1) << shift) - 1);
+}
+
+static gfarm_uint64_t
+rpcstat_percentile(const gfarm_uint32_t *hist, gfarm_uint32_t n,
+	int per_mille)
+{
+	gfarm_uint64_t rank, sum = 0;
+	int b;
+
+	rank = ((gfarm_uint64_t)n * per_mille + 999) / 1000;
+	for (b = 0; b < RPCSTAT_NBUCKETS - 1; b++) {
+		sum += hist[b];
+		if (sum >= rank)
+			break;
+	}
+	return (rpcstat_bucket_max(b));
+}
+
+static int
+rpcstat_row(gfarm_int32_t request)
+{
+	if (request < 0 || request >= GIANT_STAT_NPROTO)
+		return (RPCSTAT_ROW_PRIVATE);
+	return (request);
+}
+
+/* publish the statistics to the iostat file */
+static void
+rpcstat_update(void)
+{
+	struct rpcstat_entry *entry, copy;
+	struct gfarm_iostat_items *ip;
+	gfarm_int64_t *vals;
+	int row, phase, i, rowcur = 0;
+	static const char diag[] = "rpcstat_update";
+
+	for (row = 0; row < RPCSTAT_NROWS; row++) {
+		entry = &rpcstat_table[row];
+		gfarm_mutex_lock(&entry->mutex, diag, RPCSTAT_MUTEX_DIAG);
+		if (entry->calls == 0) {
+			gfarm_mutex_unlock(&entry->mutex, diag,
+			    RPCSTAT_MUTEX_DIAG);
+			continue;
+		}
+		copy = *entry;
+		entry->interval_calls = 0;
+		memset(entry->hist, 0, sizeof(entry->hist));
+		gfarm_mutex_unlock(&entry->mutex, diag, RPCSTAT_MUTEX_DIAG);
+
+		ip = (struct gfarm_iostat_items *)((char *)rpcstat_items +
+		    row * rpcstat_head->s_item_size);
+		vals = ip->s_vals;
+		vals[RPCSTAT_ITEM_CALLS] = copy.calls;
+		vals[RPCSTAT_ITEM_ERRORS] = copy.errors;
+		vals[RPCSTAT_ITEM_BYTES_IN] = copy.bytes_in;
+		vals[RPCSTAT_ITEM_BYTES_OUT] = copy.bytes_out;
+		for (phase = 0; phase < RPCSTAT_NPHASES; phase++) {
+			vals[RPCSTAT_ITEM_TIME + phase] = copy.time[phase];
+			if (copy.interval_calls == 0)
+				continue;
+			for (i = 0; i < RPCSTAT_NPERCENTILES; i++)
+				vals[RPCSTAT_ITEM_PERCENTILE +
+				    phase * RPCSTAT_NPERCENTILES + i] =
+				    rpcstat_percentile(copy.hist[phase],
+				    copy.interval_calls,
+				    rpcstat_percentiles[i]);
+		}
+		ip->s_valid = row + 1;
+		rowcur = row + 1;
+	}
+	rpcstat_head->s_rowcur = rowcur;
+	rpcstat_head->s_rowmax = rowcur;
+	rpcstat_head->s_update_sec = time(0);
+}
+
+static void *
+rpcstat_updater(void *arg)
+{
+	for (;;) {
+		gfarm_sleep(RPCSTAT_INTERVAL);
+		rpcstat_update();
+	}
+
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+static void
+rpcstat_thread_free(void *p)
+{
+	free(p);
+}
+
+gfarm_error_t
+rpcstat_init(char *path)
+{
+	gfarm_error_t e;
+	struct rpcstat_entry *table;
+	gfarm_off_t size;
+	int i, err;
+	static const char diag[] = "rpcstat_init";
+
+	GFARM_CALLOC_ARRAY(table, RPCSTAT_NROWS);
+	if (table == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	e = gfarm_iostat_mmap_file(path, rpcstat_spec, RPCSTAT_NITEM,
+	    RPCSTAT_NROWS, &rpcstat_head, &rpcstat_items, &size);
+	if (e != GFARM_ERR_NO_ERROR) {
+		free(table);
+		return (e);
+	}
+	err = pthread_key_create(&rpcstat_key, rpcstat_thread_free);
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: key create: %s",
+		    diag, strerror(err));
+	for (i = 0; i < RPCSTAT_NROWS; i++)
+		gfarm_mutex_init(&table[i].mutex, diag, RPCSTAT_MUTEX_DIAG);
+	rpcstat_table = table;
+
+	giant_stat_measure_wait();
+
+	e = create_detached_thread(rpcstat_updater, NULL);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "%s: create_detached_thread: %s",
+		    diag, gfarm_error_string(e));
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* called by thrpool, when a job is queued */
+void
+rpcstat_job_enqueued(struct timespec *queued_atp)
+{
+	if (rpcstat_table != NULL)
+		gfarm_gettime(queued_atp);
+	else
+		queued_atp->tv_nsec = -1; /* not measured */
+}
+
+/* called by thrpool, when a worker thread starts the job */
+void
+rpcstat_job_started(struct timespec *queued_atp)
+{
+	struct rpcstat_thread *st;
+	struct timespec now;
+	int err;
+
+	if (queued_atp->tv_nsec == -1)
+		return;
+	if ((st = pthread_getspecific(rpcstat_key)) == NULL) {
+		GFARM_MALLOC(st);
+		if (st == NULL)
+			return;
+		err = pthread_setspecific(rpcstat_key, st);
+		if (err != 0) {
+			gflog_warning(GFARM_MSG_UNFIXED,
+			    "rpcstat: setspecific: %s", strerror(err));
+			free(st);
+			return;
+		}
+	}
+	gfarm_gettime(&now);
+	st->queue_time = rpcstat_elapsed(queued_atp, &now);
+}
+
+/*
+ * called after the request number is received.
+ * sizep is the remaining size of the request, or NULL if unknown.
+ */
+void
+rpcstat_request_begin(struct rpcstat_request *rs, struct gfp_xdr *conn,
+	size_t *sizep)
+{
+	struct rpcstat_thread *st;
+
+	if (rpcstat_table == NULL)
+		return;
+	gfarm_gettime(&rs->start);
+	if ((st = pthread_getspecific(rpcstat_key)) != NULL) {
+		/* only the first request of the job has waited in the queue */
+		rs->queue_time = st->queue_time;
+		st->queue_time = 0;
+	} else
+		rs->queue_time = 0;
+	rs->wait_sum = giant_stat_wait_sum();
+	rs->sent_bytes = gfp_xdr_async_sent_bytes(conn);
+	rs->received_bytes = sizep == NULL ? 0 :
+	    ASYNC_REQUEST_HEADER_SIZE_TYPE_XID +
+	    ASYNC_REQUEST_HEADER_SIZE_SIZE + sizeof(gfarm_int32_t) + *sizep;
+}
+
+void
+rpcstat_request_end(struct rpcstat_request *rs, struct gfp_xdr *conn,
+	gfarm_int32_t request, gfarm_error_t e)
+{
+	struct rpcstat_entry *entry;
+	struct timespec now;
+	gfarm_uint64_t t[RPCSTAT_NPHASES], total;
+	gfarm_uint64_t sent_bytes;
+	int phase;
+	static const char diag[] = "rpcstat_request_end";
+
+	if (rpcstat_table == NULL)
+		return;
+	gfarm_gettime(&now);
+	total = rpcstat_elapsed(&rs->start, &now);
+	t[RPCSTAT_QUEUE] = rs->queue_time;
+	t[RPCSTAT_LOCK] = giant_stat_wait_sum() - rs->wait_sum;
+	if (t[RPCSTAT_LOCK] > total) /* clock may be adjusted */
+		t[RPCSTAT_LOCK] = total;
+	t[RPCSTAT_EXEC] = total - t[RPCSTAT_LOCK];
+	sent_bytes = gfp_xdr_async_sent_bytes(conn) - rs->sent_bytes;
+
+	entry = &rpcstat_table[rpcstat_row(request)];
+	gfarm_mutex_lock(&entry->mutex, diag, RPCSTAT_MUTEX_DIAG);
+	entry->calls++;
+	if (e != GFARM_ERR_NO_ERROR)
+		entry->errors++;
+	entry->bytes_in += rs->received_bytes;
+	entry->bytes_out += sent_bytes;
+	entry->interval_calls++;
+	for (phase = 0; phase < RPCSTAT_NPHASES; phase++) {
+		entry->time[phase] += t[phase];
+		entry->hist[phase][rpcstat_bucket(t[phase])]++;
+	}
+	gfarm_mutex_unlock(&entry->mutex, diag, RPCSTAT_MUTEX_DIAG);
+}
@@ -0,0 +1,20 @@
+/*
+ * per-request statistics of gfmd, exported via an iostat file
+ */
+struct rpcstat_request {
+	struct timespec start;
+	gfarm_uint64_t queue_time;	/* microseconds */
+	gfarm_uint64_t wait_sum;	/* giant_stat_wait_sum() at start */
+	gfarm_uint64_t sent_bytes;	/* gfp_xdr_async_sent_bytes() at start */
+	gfarm_uint64_t received_bytes;
+};
+
+gfarm_error_t rpcstat_init(char *);
+void rpcstat_job_enqueued(struct timespec *);
+void rpcstat_job_started(struct timespec *);
+
+struct gfp_xdr;
+void rpcstat_request_begin(struct rpcstat_request *, struct gfp_xdr *,
+	size_t *);
+void rpcstat_request_end(struct rpcstat_request *, struct gfp_xdr *,
+	gfarm_int32_t, gfarm_error_t);
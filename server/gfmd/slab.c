@@ -0,0 +1,147 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <gfarm/gfarm.h>
+
+#include "thrsubr.h"
+
+#include "slab.h"
+
+#define SLAB_CHUNK_SIZE		(64 * 1024)
+
+struct slab_object {
+	struct slab_object *next;
+};
+
+static const char slab_diag[] = "slab_mutex";
+
+/* slabs are never removed from this list, see slab_info() */
+static struct slab *all_slabs = NULL;
+static pthread_mutex_t all_slabs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char all_slabs_diag[] = "all_slabs_mutex";
+
+/* PREREQUISITE: slab->mutex */
+static int
+slab_grow(struct slab *slab)
+{
+	char *chunk;
+	static const char diag[] = "slab_grow";
+
+	GFARM_MALLOC_ARRAY(chunk, SLAB_CHUNK_SIZE);
+	if (chunk == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "%s: %s: no memory", diag, slab->name);
+		return (0);
+	}
+	if (slab->nchunks == 0) {
+		gfarm_mutex_lock(&all_slabs_mutex, diag, all_slabs_diag);
+		slab->next = all_slabs;
+		all_slabs = slab;
+		gfarm_mutex_unlock(&all_slabs_mutex, diag, all_slabs_diag);
+	}
+	/* the rest of the last chunk is wasted, it's small enough */
+	slab->unused = chunk;
+	slab->unused_size = SLAB_CHUNK_SIZE;
+	slab->nchunks++;
+	return (1);
+}
+
+void *
+slab_alloc(struct slab *slab)
+{
+	struct slab_object *obj;
+	static const char diag[] = "slab_alloc";
+
+	gfarm_mutex_lock(&slab->mutex, diag, slab_diag);
+	if ((obj = slab->free_objects) != NULL) {
+		slab->free_objects = obj->next;
+	} else if (slab->unused_size >= slab->object_size ||
+	    slab_grow(slab)) {
+		obj = (struct slab_object *)slab->unused;
+		slab->unused += slab->object_size;
+		slab->unused_size -= slab->object_size;
+	}
+	if (obj != NULL)
+		slab->nobjects++;
+	gfarm_mutex_unlock(&slab->mutex, diag, slab_diag);
+	return (obj);
+}
+
+void
+slab_free(struct slab *slab, void *p)
+{
+	struct slab_object *obj = p;
+	static const char diag[] = "slab_free";
+
+	if (obj == NULL)
+		return;
+	gfarm_mutex_lock(&slab->mutex, diag, slab_diag);
+	obj->next = slab->free_objects;
+	slab->free_objects = obj;
+	slab->nobjects--;
+	gfarm_mutex_unlock(&slab->mutex, diag, slab_diag);
+}
+
+/* number of objects in use, and bytes allocated from the system */
+void
+slab_get_stat(struct slab *slab,
+	gfarm_uint64_t *nobjectsp, gfarm_uint64_t *bytesp)
+{
+	static const char diag[] = "slab_get_stat";
+
+	gfarm_mutex_lock(&slab->mutex, diag, slab_diag);
+	*nobjectsp = slab->nobjects;
+	*bytesp = slab->nchunks * SLAB_CHUNK_SIZE;
+	gfarm_mutex_unlock(&slab->mutex, diag, slab_diag);
+}
+
+static struct slab *
+slab_list_head(void)
+{
+	struct slab *slab;
+	static const char diag[] = "slab_list_head";
+
+	/*
+	 * slabs are only added to the head of the list,
+	 * so the list can be traversed without all_slabs_mutex,
+	 * and slab->mutex is not acquired while all_slabs_mutex is held.
+	 */
+	gfarm_mutex_lock(&all_slabs_mutex, diag, all_slabs_diag);
+	slab = all_slabs;
+	gfarm_mutex_unlock(&all_slabs_mutex, diag, all_slabs_diag);
+	return (slab);
+}
+
+gfarm_uint64_t
+slab_total_bytes(void)
+{
+	struct slab *slab;
+	gfarm_uint64_t nobjects, bytes, total = 0;
+
+	for (slab = slab_list_head(); slab != NULL; slab = slab->next) {
+		slab_get_stat(slab, &nobjects, &bytes);
+		total += bytes;
+	}
+	return (total);
+}
+
+void
+slab_info(void)
+{
+	struct slab *slab;
+	gfarm_uint64_t nobjects, bytes;
+
+	for (slab = slab_list_head(); slab != NULL; slab = slab->next) {
+		slab_get_stat(slab, &nobjects, &bytes);
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "slab %s: %llu objects of %d bytes in use, "
+		    "%llu bytes allocated (%.1f%% used)", slab->name,
+		    (unsigned long long)nobjects, (int)slab->object_size,
+		    (unsigned long long)bytes, bytes == 0 ? 0.0 :
+		    100.0 * nobjects * slab->object_size / bytes);
+	}
+}
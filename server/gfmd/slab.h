@@ -0,0 +1,48 @@
+/*
+ * $Id$
+ */
+
+/*
+ * slab allocator for small fixed-size objects,
+ * which gfmd holds for each inode, replica or directory entry.
+ *
+ * objects are carved out of large chunks, thus they don't have
+ * the per-object overhead of malloc(3).
+ * chunks are never returned to the system, but freed objects are
+ * reused by later slab_alloc() calls on the same slab.
+ *
+ * a slab is defined statically by SLAB_INITIALIZER(),
+ * and may be used by multiple threads concurrently.
+ */
+
+#define SLAB_ALIGN		8
+#define SLAB_OBJECT_SIZE(size)	\
+	(((size) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+
+struct slab_object;
+
+/* all members are private to slab.c */
+struct slab {
+	pthread_mutex_t mutex;
+	const char *name;
+	size_t object_size;
+
+	struct slab_object *free_objects;
+	char *unused;		/* not yet carved part of the last chunk */
+	size_t unused_size;
+
+	gfarm_uint64_t nchunks, nobjects;
+	struct slab *next;	/* list of all slabs, see slab_info() */
+};
+
+#define SLAB_INITIALIZER(name, size) { \
+	PTHREAD_MUTEX_INITIALIZER, (name), SLAB_OBJECT_SIZE(size), \
+	NULL, NULL, 0, 0, 0, NULL \
+}
+
+void *slab_alloc(struct slab *);
+void slab_free(struct slab *, void *);
+
+void slab_get_stat(struct slab *, gfarm_uint64_t *, gfarm_uint64_t *);
+gfarm_uint64_t slab_total_bytes(void);
+void slab_info(void);
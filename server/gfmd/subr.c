@@ -1,8 +1,10 @@
 #include <pthread.h>
 
 #include <assert.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #define GFARM_INTERNAL_USE
@@ -14,36 +16,185 @@
 #include "gfutil.h"
 #include "thrsubr.h"
 
+#include "gfm_proto.h"
 #include "config.h"
 #include "subr.h"
+#include "giant_stat.h"
+#include "db_journal.h"
 
 int debug_mode = 0;
 
-static pthread_mutex_t giant_mutex;
+/*
+ * The giant lock is a reader/writer lock.
+ *
+ * Normally giant_lock() acquires it exclusively.
+ * While a request which protocol_switch() classifies as PROTO_READ_ONLY
+ * is being handled, giant_set_shared_mode(1) is in effect for the thread,
+ * and giant_lock() acquires the lock in shared mode instead, so that
+ * read-only requests can run in parallel.
+ *
+ * A read-only request which still has a small side effect
+ * (e.g. remembering a directory cursor, or updating atime)
+ * must surround it by giant_shared_update_begin()/_end().
+ * That serializes such updates among shared holders,
+ * because an exclusive holder already excludes all of them.
+ */
+static pthread_rwlock_t giant_rwlock;
+static pthread_mutex_t giant_shared_update_mutex;
+static pthread_key_t giant_state_key;
+
+#define GIANT_STATE_SHARED_MODE	((long)0x01)
+#define GIANT_STATE_SHARED_HELD	((long)0x02)
+
+static const char giant_diag[] = "giant";
+
+static long
+giant_state_get(void)
+{
+	return ((long)pthread_getspecific(giant_state_key));
+}
+
+static void
+giant_state_set(long state)
+{
+	int err = pthread_setspecific(giant_state_key, (void *)state);
+
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "giant_state_set: %s", strerror(err));
+}
 
 void
 giant_init(void)
 {
-	gfarm_mutex_init(&giant_mutex, "giant_init", "giant");
+	int err;
+	pthread_rwlockattr_t attr;
+	static const char diag[] = "giant_init";
+
+	err = pthread_rwlockattr_init(&attr);
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: %s rwlockattr init: %s",
+		    diag, giant_diag, strerror(err));
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+	/* do not let a storm of read-only requests starve writers */
+	err = pthread_rwlockattr_setkind_np(&attr,
+	    PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	if (err != 0)
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "%s: %s rwlockattr setkind: %s",
+		    diag, giant_diag, strerror(err));
+#endif
+	err = pthread_rwlock_init(&giant_rwlock, &attr);
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: %s rwlock init: %s",
+		    diag, giant_diag, strerror(err));
+	(void)pthread_rwlockattr_destroy(&attr);
+
+	err = pthread_key_create(&giant_state_key, NULL);
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "%s: %s key create: %s",
+		    diag, giant_diag, strerror(err));
+
+	gfarm_mutex_init(&giant_shared_update_mutex, diag,
+	    "giant_shared_update");
+
+	giant_stat_init();
 }
 
 void
 giant_lock(void)
 {
-	gfarm_mutex_lock(&giant_mutex, "giant_lock", "giant");
+	int err, shared;
+	long state = giant_state_get();
+	struct timespec wait_start;
+
+	giant_stat_wait_begin(&wait_start);
+	shared = (state & GIANT_STATE_SHARED_MODE) != 0;
+	if (shared) {
+		err = pthread_rwlock_rdlock(&giant_rwlock);
+		if (err == 0)
+			giant_state_set(state | GIANT_STATE_SHARED_HELD);
+	} else {
+		err = pthread_rwlock_wrlock(&giant_rwlock);
+	}
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "giant_lock: %s lock: %s",
+		    giant_diag, strerror(err));
+	giant_stat_locked(&wait_start, shared);
 }
 
 /* false: busy */
 int
 giant_trylock(void)
 {
-	return (gfarm_mutex_trylock(&giant_mutex, "giant_trylock", "giant"));
+	int err = pthread_rwlock_trywrlock(&giant_rwlock);
+
+	if (err != 0 && err != EBUSY)
+		gflog_fatal(GFARM_MSG_UNFIXED, "giant_trylock: %s trylock: %s",
+		    giant_diag, strerror(err));
+	if (err == 0)
+		giant_stat_locked(NULL, 0);
+	return (err == 0);
 }
 
 void
 giant_unlock(void)
 {
-	gfarm_mutex_unlock(&giant_mutex, "giant_unlock", "giant");
+	int err;
+	long state = giant_state_get();
+
+	giant_stat_unlocking();
+	if ((state & GIANT_STATE_SHARED_HELD) != 0)
+		giant_state_set(state & ~GIANT_STATE_SHARED_HELD);
+	err = pthread_rwlock_unlock(&giant_rwlock);
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "giant_unlock: %s unlock: %s",
+		    giant_diag, strerror(err));
+
+	/* wait for the journal of this transaction to be synced */
+	db_journal_group_commit_wait();
+}
+
+/*
+ * this is called by protocol_switch() around a request handler.
+ * must be called without holding giant_lock.
+ */
+void
+giant_set_shared_mode(int shared)
+{
+	long state = giant_state_get();
+
+	assert((state & GIANT_STATE_SHARED_HELD) == 0);
+	if (shared && gfarm_metadb_shared_giant_lock)
+		state |= GIANT_STATE_SHARED_MODE;
+	else
+		state &= ~GIANT_STATE_SHARED_MODE;
+	giant_state_set(state);
+}
+
+/* true: giant_lock is held in shared mode by this thread */
+int
+giant_is_shared(void)
+{
+	return ((giant_state_get() & GIANT_STATE_SHARED_HELD) != 0);
+}
+
+/* PREREQUISITE: giant_lock (either shared or exclusive) */
+void
+giant_shared_update_begin(void)
+{
+	if (giant_is_shared())
+		gfarm_mutex_lock(&giant_shared_update_mutex,
+		    "giant_shared_update_begin", "giant_shared_update");
+}
+
+/* PREREQUISITE: giant_lock (either shared or exclusive) */
+void
+giant_shared_update_end(void)
+{
+	if (giant_is_shared())
+		gfarm_mutex_unlock(&giant_shared_update_mutex,
+		    "giant_shared_update_end", "giant_shared_update");
 }
 
 static void
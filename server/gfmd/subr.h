@@ -4,6 +4,10 @@ void giant_init(void);
 void giant_lock(void);
 int giant_trylock(void);
 void giant_unlock(void);
+void giant_set_shared_mode(int);
+int giant_is_shared(void);
+void giant_shared_update_begin(void);
+void giant_shared_update_end(void);
 
 gfarm_error_t create_detached_thread(void *(*)(void *), void *);
 
@@ -3,27 +3,60 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 
 #include <gfarm/gfarm.h>
 
 #include "gfutil.h"
 #include "thrsubr.h"
 
+#include "gfm_proto.h"
+
 #include "subr.h"
 #include "thrpool.h"
+#include "giant_stat.h"
+#include "rpcstat.h"
+
+/*
+ * work-stealing thread pool.
+ *
+ * each worker has its own job queue.
+ * jobs with affinity are queued to the queue of the worker which is
+ * chosen by the affinity, thus they are likely to be processed by the
+ * same thread.  jobs without affinity are queued to the workers in
+ * round-robin order.  thus, while all workers are busy, dispatching a
+ * job doesn't need any lock which is shared by all workers.
+ * a worker takes jobs from its own queue, then from the shared queue,
+ * and when both are empty, steals jobs from the queues of other workers.
+ *
+ * the length of the queue of each worker is queue_length / pool_size.
+ * the shared queue is only used when the queues of all workers are full,
+ * its length is queue_length as before, and thrpool_add_job() blocks
+ * while it's full.
+ */
 
 struct thread_job {
 	void *(*thread_main)(void *);
 	void *arg;
+	struct timespec queued_at; /* for rpcstat */
 };
 
 struct thread_jobq {
 	pthread_mutex_t mutex;
 	pthread_cond_t nonfull, nonempty;
 	int size, n, in, out;
+	int idle; /* the owner is waiting for a job */
+	int kicked; /* the owner is requested to look for a job */
 	struct thread_job *entries;
 };
 
+struct thread_worker {
+	struct thread_jobq jobq;
+	struct thread_pool *pool;
+	int index;
+	int idle_index; /* index in pool->idle_workers[], or -1 */
+};
+
 void
 thrjobq_init(struct thread_jobq *q, int size)
 {
@@ -34,50 +67,124 @@ thrjobq_init(struct thread_jobq *q, int size)
 	gfarm_cond_init(&q->nonfull, diag, "nonfull");
 	q->size = size;
 	q->n = q->in = q->out = 0;
+	q->idle = q->kicked = 0;
 	GFARM_MALLOC_ARRAY(q->entries, size);
 	if (q->entries == NULL)
 		gflog_fatal(GFARM_MSG_1000220,
 		    "%s: jobq size: %s", diag, strerror(ENOMEM));
 }
 
-
-void
-thrjobq_add_job(struct thread_jobq *q, void *(*thread_main)(void *), void *arg)
+/* PREREQUISITE: q->mutex and q->n < q->size */
+static void
+thrjobq_put(struct thread_jobq *q, void *(*thread_main)(void *), void *arg)
 {
-	static const char diag[] = "thrjobq_add_job";
-
-	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
-
-	while (q->n >= q->size) {
-		gfarm_cond_wait(&q->nonfull, &q->mutex, diag, "nonfull");
-	}
 	q->entries[q->in].thread_main = thread_main;
 	q->entries[q->in].arg = arg;
+	rpcstat_job_enqueued(&q->entries[q->in].queued_at);
 	q->in++;
 	if (q->in >= q->size)
 		q->in = 0;
 	q->n++;
-	gfarm_cond_signal(&q->nonempty, diag, "nonempty");
+}
 
+/*
+ * returns -1 if the queue is full,
+ * 1 if the owner of the queue is woken up, 0 otherwise.
+ */
+static int
+thrjobq_try_add_job(struct thread_jobq *q,
+	void *(*thread_main)(void *), void *arg)
+{
+	int woken = 0;
+	static const char diag[] = "thrjobq_try_add_job";
+
+	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+	if (q->n >= q->size) {
+		gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+		return (-1);
+	}
+	thrjobq_put(q, thread_main, arg);
+	if (q->idle) {
+		gfarm_cond_signal(&q->nonempty, diag, "nonempty");
+		woken = 1;
+	}
 	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+	return (woken);
 }
 
-void
-thrjobq_get_job(struct thread_jobq *q, struct thread_job *job)
+/* returns 1 if the owner of the queue is woken up, 0 otherwise. */
+int
+thrjobq_add_job(struct thread_jobq *q, void *(*thread_main)(void *), void *arg)
 {
-	static const char diag[] = "thrjobq_get_job";
+	int woken = 0;
+	static const char diag[] = "thrjobq_add_job";
 
 	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
 
-	while (q->n <= 0) {
-		gfarm_cond_wait(&q->nonempty, &q->mutex, diag, "nonempty");
+	while (q->n >= q->size) {
+		gfarm_cond_wait(&q->nonfull, &q->mutex, diag, "nonfull");
 	}
+	thrjobq_put(q, thread_main, arg);
+	if (q->idle) {
+		gfarm_cond_signal(&q->nonempty, diag, "nonempty");
+		woken = 1;
+	}
+
+	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+	return (woken);
+}
+
+/* PREREQUISITE: q->mutex and q->n > 0 */
+static void
+thrjobq_take(struct thread_jobq *q, struct thread_job *job)
+{
+	static const char diag[] = "thrjobq_take";
+
 	*job = q->entries[q->out++];
 	if (q->out >= q->size)
 		q->out = 0;
 	q->n--;
 	gfarm_cond_signal(&q->nonfull, diag, "nonfull");
+}
+
+/* returns 0 if the queue is empty */
+static int
+thrjobq_get_job(struct thread_jobq *q, struct thread_job *job)
+{
+	int found = 0;
+	static const char diag[] = "thrjobq_get_job";
 
+	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+	if (q->n > 0) {
+		thrjobq_take(q, job);
+		found = 1;
+	}
+	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+	return (found);
+}
+
+/*
+ * same with thrjobq_get_job(), but doesn't lock an empty queue.
+ * this may miss a job which is being added, see thrpool_wait_job()
+ * for why a worker doesn't sleep with such a job left.
+ */
+static int
+thrjobq_try_get_job(struct thread_jobq *q, struct thread_job *job)
+{
+	if (q->n <= 0)
+		return (0);
+	return (thrjobq_get_job(q, job));
+}
+
+/* wake up the owner of the queue */
+static void
+thrjobq_kick(struct thread_jobq *q)
+{
+	static const char diag[] = "thrjobq_kick";
+
+	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+	q->kicked = 1;
+	gfarm_cond_signal(&q->nonempty, diag, "nonempty");
 	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
 }
 
@@ -85,8 +192,15 @@ struct thread_pool {
 	pthread_mutex_t mutex;
 	int pool_size;
 	int threads;
-	int idles;
+	struct thread_worker *workers; /* [pool_size] */
+
+	/* only a hint to choose a worker, thus not protected by any lock */
+	unsigned int next_worker;
+
+	/* if all workers are full.  jobq.mutex protects idle_workers too */
 	struct thread_jobq jobq;
+	struct thread_worker **idle_workers; /* [pool_size] */
+	int idles;
 
 	const char *name;
 	struct thread_pool *next;
@@ -99,17 +213,38 @@ struct thread_pool *
 thrpool_new(int pool_size, int queue_length, const char *pool_name)
 {
 	struct thread_pool *p;
+	int i, worker_queue_length;
 	static const char diag[] = "thrpool_new";
 
+	if (pool_size < 1)
+		pool_size = 1;
 	GFARM_MALLOC(p);
 	if (p == NULL)
 		return (NULL);
+	GFARM_MALLOC_ARRAY(p->workers, pool_size);
+	GFARM_MALLOC_ARRAY(p->idle_workers, pool_size);
+	if (p->workers == NULL || p->idle_workers == NULL) {
+		free(p->workers);
+		free(p->idle_workers);
+		free(p);
+		return (NULL);
+	}
 
+	worker_queue_length = queue_length / pool_size;
+	if (worker_queue_length < 1)
+		worker_queue_length = 1;
+	for (i = 0; i < pool_size; i++) {
+		thrjobq_init(&p->workers[i].jobq, worker_queue_length);
+		p->workers[i].pool = p;
+		p->workers[i].index = i;
+		p->workers[i].idle_index = -1;
+	}
 	thrjobq_init(&p->jobq, queue_length);
 
 	gfarm_mutex_init(&p->mutex, diag, "thrpool");
 	p->pool_size = pool_size;
 	p->threads = 0;
+	p->next_worker = 0;
 	p->idles = 0;
 	p->name = pool_name;
 
@@ -121,24 +256,153 @@ thrpool_new(int pool_size, int queue_length, const char *pool_name)
 	return (p);
 }
 
+/*
+ * returns 1 if a job is stolen from another worker.
+ * an idle worker locks each queue, see thrpool_wait_job() for why.
+ */
+static int
+thrpool_steal_job(struct thread_worker *self, struct thread_job *job,
+	int idle)
+{
+	struct thread_pool *p = self->pool;
+	struct thread_jobq *q;
+	int i, threads = p->threads;
+
+	for (i = 1; i < threads; i++) {
+		q = &p->workers[(self->index + i) % threads].jobq;
+		if (idle ? thrjobq_get_job(q, job) :
+		    thrjobq_try_get_job(q, job))
+			return (1);
+	}
+	return (0);
+}
+
+/*
+ * get a job from the shared queue.
+ * if it's empty, register the worker as idle, and returns 0.
+ */
+static int
+thrpool_get_shared_job(struct thread_worker *self, struct thread_job *job,
+	int idle)
+{
+	struct thread_pool *p = self->pool;
+	struct thread_jobq *q = &p->jobq;
+	int found = 0;
+	static const char diag[] = "thrpool_get_shared_job";
+
+	if (!idle && q->n <= 0) /* avoid the lock while busy */
+		return (0);
+	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+	if (q->n > 0) {
+		thrjobq_take(q, job);
+		found = 1;
+	} else if (idle && self->idle_index == -1) {
+		self->idle_index = p->idles;
+		p->idle_workers[p->idles++] = self;
+	}
+	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+	return (found);
+}
+
+/* PREREQUISITE: p->jobq.mutex */
+static void
+thrpool_idle_remove(struct thread_pool *p, struct thread_worker *w)
+{
+	struct thread_worker *last = p->idle_workers[--p->idles];
+
+	p->idle_workers[w->idle_index] = last;
+	last->idle_index = w->idle_index;
+	w->idle_index = -1;
+}
+
+/* PREREQUISITE: p->jobq.mutex.  returns an idle worker, or NULL */
+static struct thread_worker *
+thrpool_idle_pop(struct thread_pool *p)
+{
+	struct thread_worker *w;
+
+	if (p->idles <= 0)
+		return (NULL);
+	/* LIFO, the worker which became idle most recently is hot */
+	w = p->idle_workers[p->idles - 1];
+	thrpool_idle_remove(p, w);
+	return (w);
+}
+
+/*
+ * wait until a job is available.
+ *
+ * q->idle is set under q->mutex before the worker finds its own queue
+ * empty, and the worker registers itself to p->idle_workers[] under
+ * p->jobq.mutex when it finds the shared queue empty.  thus, a job
+ * which is added after these checks always wakes the worker up, and
+ * the wakeup is delivered under q->mutex, which is held while checking
+ * q->n and q->kicked before sleeping.
+ * a job which is added to the queue of a busy worker kicks a worker in
+ * p->idle_workers[], if p->idles, which is read without the lock,
+ * isn't 0.  the worker registers itself before stealing, and steals
+ * with the lock of each queue, thus either the worker finds the job,
+ * or the job is added after the worker has released the lock of the
+ * queue, and then p->idles which is read after that isn't 0.
+ */
+static void
+thrpool_wait_job(struct thread_worker *self, struct thread_job *job)
+{
+	struct thread_pool *p = self->pool;
+	struct thread_jobq *q = &self->jobq;
+	struct thread_worker *w = NULL;
+	int own = 0;
+	static const char diag[] = "thrpool_wait_job";
+
+	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+	q->idle = 1;
+	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+	for (;;) {
+		if (thrjobq_get_job(q, job)) {
+			own = 1;
+			break;
+		}
+		if (thrpool_get_shared_job(self, job, 1) ||
+		    thrpool_steal_job(self, job, 1))
+			break;
+		gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+		if (q->n <= 0 && !q->kicked)
+			gfarm_cond_wait(&q->nonempty, &q->mutex,
+			    diag, "nonempty");
+		q->kicked = 0;
+		gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+	}
+	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+	q->idle = 0;
+	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+
+	/* only this worker registers itself, thus -1 is stable here */
+	if (self->idle_index != -1 || own) {
+		gfarm_mutex_lock(&p->jobq.mutex, diag, "idle_workers");
+		if (self->idle_index != -1)
+			thrpool_idle_remove(p, self);
+		else /* kicked for another job, pass the kick to others */
+			w = thrpool_idle_pop(p);
+		gfarm_mutex_unlock(&p->jobq.mutex, diag, "idle_workers");
+		if (w != NULL)
+			thrjobq_kick(&w->jobq);
+	}
+}
+
 void *
 thrpool_worker(void *arg)
 {
-	static const char diag[] = "thrpool_worker";
-	struct thread_pool *p = arg;
+	struct thread_worker *self = arg;
 	struct thread_job job;
 
 	for (;;) {
-		gfarm_mutex_lock(&p->mutex, diag, "to get job");
-		p->idles++;
-		gfarm_mutex_unlock(&p->mutex, diag, "to get job");
-
-		thrjobq_get_job(&p->jobq, &job);
-
-		gfarm_mutex_lock(&p->mutex, diag, "after job was gotten");
-		p->idles--;
-		gfarm_mutex_unlock(&p->mutex, diag, "after job was gotten");
+		if (!thrjobq_try_get_job(&self->jobq, &job) &&
+		    !thrpool_get_shared_job(self, &job, 0) &&
+		    !thrpool_steal_job(self, &job, 0))
+			thrpool_wait_job(self, &job);
 
+		(void)giant_stat_owner_set(GIANT_STAT_OWNER_OTHER);
+		rpcstat_job_started(&job.queued_at);
 		(*job.thread_main)(job.arg);
 	}
 	/*NOTREACHED*/
@@ -147,16 +411,41 @@ thrpool_worker(void *arg)
 	return (NULL);
 }
 
+/* wake up an idle worker to steal a job */
+static void
+thrpool_kick_idle(struct thread_pool *p)
+{
+	struct thread_worker *w;
+	static const char diag[] = "thrpool_kick_idle";
+
+	if (p->idles <= 0) /* avoid the lock while all workers are busy */
+		return;
+	gfarm_mutex_lock(&p->jobq.mutex, diag, "idle_workers");
+	w = thrpool_idle_pop(p);
+	gfarm_mutex_unlock(&p->jobq.mutex, diag, "idle_workers");
+	if (w != NULL)
+		thrjobq_kick(&w->jobq);
+}
 
-void
-thrpool_add_job(struct thread_pool *p, void *(*thread_main)(void *), void *arg)
+/* create a new worker if there is no idle worker */
+static void
+thrpool_add_worker(struct thread_pool *p)
 {
-	static const char diag[] = "thrpool_add_job";
 	gfarm_error_t e;
+	int idles;
+	static const char diag[] = "thrpool_add_worker";
+
+	/* unlocked check first, to avoid the lock when the pool is full */
+	if (p->threads >= p->pool_size || p->idles > 0)
+		return;
 
 	gfarm_mutex_lock(&p->mutex, diag, "thrpool");
-	if (p->threads < p->pool_size && p->idles <= 0) {
-		e = create_detached_thread(thrpool_worker, p);
+	gfarm_mutex_lock(&p->jobq.mutex, diag, "idles");
+	idles = p->idles;
+	gfarm_mutex_unlock(&p->jobq.mutex, diag, "idles");
+	if (p->threads < p->pool_size && idles <= 0) {
+		e = create_detached_thread(thrpool_worker,
+		    &p->workers[p->threads]);
 		if (e == GFARM_ERR_NO_ERROR) {
 			p->threads++;
 		} else {
@@ -167,8 +456,73 @@ thrpool_add_job(struct thread_pool *p, void *(*thread_main)(void *), void *arg)
 		}
 	}
 	gfarm_mutex_unlock(&p->mutex, diag, "thrpool");
+}
+
+static void
+thrpool_add_shared_job(struct thread_pool *p,
+	void *(*thread_main)(void *), void *arg)
+{
+	struct thread_jobq *q = &p->jobq;
+	struct thread_worker *w;
+	static const char diag[] = "thrpool_add_shared_job";
 
-	thrjobq_add_job(&p->jobq, thread_main, arg);
+	gfarm_mutex_lock(&q->mutex, diag, "thrjobq");
+	while (q->n >= q->size) {
+		gfarm_cond_wait(&q->nonfull, &q->mutex, diag, "nonfull");
+	}
+	thrjobq_put(q, thread_main, arg);
+	w = thrpool_idle_pop(p);
+	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
+	if (w != NULL)
+		thrjobq_kick(&w->jobq);
+}
+
+/*
+ * jobs which are added with same affinity are queued to same worker,
+ * unless the queue of the worker is full,
+ * thus they are likely to be processed by same thread.
+ * a negative affinity means no affinity.
+ */
+void
+thrpool_add_job_with_affinity(struct thread_pool *p,
+	void *(*thread_main)(void *), void *arg, int affinity)
+{
+	int i, worker, threads, woken;
+
+	thrpool_add_worker(p);
+	threads = p->threads;
+	if (threads <= 0) {
+		/* failed to create any thread, try later */
+		thrpool_add_shared_job(p, thread_main, arg);
+		return;
+	}
+
+	worker = affinity >= 0 ? affinity % threads :
+	    (int)(p->next_worker++ % threads);
+	for (i = 0; i < threads; i++) {
+		woken = thrjobq_try_add_job(
+		    &p->workers[(worker + i) % threads].jobq, thread_main, arg);
+		if (woken != -1)
+			break;
+	}
+	if (i >= threads) { /* all queues are full */
+		if (affinity < 0) {
+			thrpool_add_shared_job(p, thread_main, arg);
+			return;
+		}
+		woken = thrjobq_add_job(&p->workers[worker].jobq,
+		    thread_main, arg);
+	}
+
+	/* the owner is busy, let an idle worker steal the job */
+	if (!woken)
+		thrpool_kick_idle(p);
+}
+
+void
+thrpool_add_job(struct thread_pool *p, void *(*thread_main)(void *), void *arg)
+{
+	thrpool_add_job_with_affinity(p, thread_main, arg, -1);
 }
 
 void
@@ -187,9 +541,11 @@ thrpool_info(void)
 	for (; p != NULL; p = p->next) {
 		gfarm_mutex_lock(&p->mutex, diag, "thrpool");
 		n = p->threads;
-		i = p->idles;
 		name = p->name;
 		gfarm_mutex_unlock(&p->mutex, diag, "thrpool");
+		gfarm_mutex_lock(&p->jobq.mutex, diag, "idles");
+		i = p->idles;
+		gfarm_mutex_unlock(&p->jobq.mutex, diag, "idles");
 
 		gflog_info(GFARM_MSG_1000222,
 		    "pool %s: number of worker threads: %d, idle threads: %d",
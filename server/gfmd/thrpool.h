@@ -1,5 +1,7 @@
 struct thread_pool;
 struct thread_pool *thrpool_new(int, int, const char *);
 void thrpool_add_job(struct thread_pool *, void *(*)(void *), void *);
+void thrpool_add_job_with_affinity(struct thread_pool *,
+	void *(*)(void *), void *, int);
 
 void thrpool_info(void);
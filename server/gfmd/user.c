@@ -318,6 +318,13 @@ user_name(struct user *u)
 	    u->ui.username : REMOVED_USER_NAME);
 }
 
+/* unlike user_name(), this returns the name of an invalid user as is */
+char *
+user_name_even_invalid(struct user *u)
+{
+	return (u->ui.username);
+}
+
 char *
 user_realname(struct user *u)
 {
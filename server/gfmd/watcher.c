@@ -69,7 +69,8 @@ watcher_event_callback(int events, int fd, void *closure,
 	h = wev->handler; wev->handler = NULL;
 	c = wev->closure; wev->closure = NULL;
 	gfarm_mutex_unlock(&wev->mutex, module_name, "event callback");
-	thrpool_add_job(p, h, c);
+	/* events of a connection are likely handled by same worker */
+	thrpool_add_job_with_affinity(p, h, c, fd);
 }
 
 static gfarm_error_t
@@ -441,7 +441,7 @@ xattr_set(int xmlMode, struct inode *inode,
 		}
 	}
 	if (change_replica_spec)
-		replica_check_signal_update_xattr();
+		replica_check_signal_update_xattr(inode_get_number(inode));
 
 	if (*addattr) {
 		e = db_xattr_add(xmlMode, inode_get_number(inode),
@@ -809,13 +809,12 @@ gfm_server_removexattr(
 			gflog_debug(GFARM_MSG_1003038,
 			    "xattr_access() failed: %s",
 			    gfarm_error_string(e));
-		} else
-			e = removexattr(xmlMode, inode, attrname);
-		giant_unlock();
-
-		if (e == GFARM_ERR_NO_ERROR && !xmlMode &&
+		} else if ((e = removexattr(xmlMode, inode, attrname))
+		    == GFARM_ERR_NO_ERROR && !xmlMode &&
 		    strcmp("gfarm.ncopy", attrname) == 0)
-			replica_check_signal_update_xattr();
+			replica_check_signal_update_xattr(
+			    inode_get_number(inode));
+		giant_unlock();
 	}
 
 	free(attrname);
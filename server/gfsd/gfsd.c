@@ -205,6 +205,7 @@ cleanup_iostat(int sighandler)
 
 static void close_all_fd(void);
 static int close_all_fd_for_process_reset(void);
+static void workers_retire(void);
 
 /* this routine should be called before calling exit(). */
 static void
@@ -227,6 +228,7 @@ cleanup(int sighandler)
 		if (kill(back_channel_gfsd_pid, SIGTERM) == -1 && !sighandler)
 			gflog_warning_errno(GFARM_MSG_1002377,
 			    "kill(%ld)", (long)back_channel_gfsd_pid);
+		workers_retire();
 		cleanup_iostat(sighandler);
 	}
 
@@ -1942,13 +1944,97 @@ gfs_server_close(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 	gfs_server_put_reply(client, xid, diag, e, "");
 }
 
+/*
+ * number of bytes which can be sent by sendfile_data() at the offset.
+ * returns -1, if the ordinary read(2) path should be used.
+ */
+static ssize_t
+sendfile_length(int local_fd, size_t iosize, gfarm_int64_t offset)
+{
+	struct stat st;
+
+	/* leave error reporting to read(2) */
+	if (offset < 0 || fstat(local_fd, &st) == -1 ||
+	    !S_ISREG(st.st_mode) ||
+	    (fcntl(local_fd, F_GETFL) & O_ACCMODE) == O_WRONLY)
+		return (-1);
+	if (offset >= st.st_size)
+		return (0);
+	else if (st.st_size - offset < iosize)
+		return (st.st_size - offset);
+	else
+		return (iosize);
+}
+
+static gfarm_error_t
+sendfile_data(struct gfp_xdr *client, int local_fd, gfarm_int64_t offset,
+	size_t len)
+{
+	gfarm_error_t e;
+	size_t sent;
+
+	e = gfp_xdr_sendfile(client, local_fd, offset, len, &sent);
+	/*
+	 * the file was truncated after fstat(2).
+	 * the length is already sent, and the client must not see
+	 * the rest of the data as the file content, thus the caller
+	 * has to abort the connection.
+	 */
+	if (e == GFARM_ERR_NO_ERROR && sent < len) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "sendfile: file truncated while sending, "
+		    "%lld bytes at offset %lld, %lld bytes sent",
+		    (long long)len, (long long)offset, (long long)sent);
+		e = GFARM_ERR_INPUT_OUTPUT;
+	}
+	return (e);
+}
+
+/*
+ * zero-copy version of the pread reply.
+ * the payload is sent by sendfile(2) directly from the spool file,
+ * instead of being copied to a buffer and then to the sendbuffer.
+ * returns -1 without sending anything, if the ordinary path should be used.
+ */
+static ssize_t
+gfs_server_pread_sendfile(struct gfp_xdr *client, gfp_xdr_xid_t xid,
+	int local_fd, size_t iosize, gfarm_int64_t offset)
+{
+	gfarm_error_t e;
+	ssize_t len;
+	static const char diag[] = "pread";
+
+	if ((len = sendfile_length(local_fd, iosize, offset)) == -1)
+		return (-1);
+
+	if (debug_mode)
+		gflog_info(GFARM_MSG_UNFIXED, "<%s> sending reply: %d (%s)",
+		    diag, GFARM_ERR_NO_ERROR,
+		    gfarm_error_string(GFARM_ERR_NO_ERROR));
+
+	/* same as the reply of format "b" */
+	e = gfp_xdr_send_async_result_header(client, xid,
+	    sizeof(gfarm_int32_t) * 2 + len);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send(client, "ii",
+		    (gfarm_int32_t)GFARM_ERR_NO_ERROR, (gfarm_int32_t)len);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = sendfile_data(client, local_fd, offset, len);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_flush(client);
+	if (e != GFARM_ERR_NO_ERROR)
+		conn_fatal(GFARM_MSG_UNFIXED, "%s put reply: %s",
+		    diag, gfarm_error_string(e));
+	return (len);
+}
+
 void
 gfs_server_pread(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 {
 	gfarm_int32_t fd, iosize;
 	gfarm_int64_t offset;
 	ssize_t rv;
-	int local_fd, save_errno = 0;
+	int local_fd, save_errno = 0, replied = 0;
 	char buffer[GFS_PROTO_MAX_IOSIZE];
 	struct file_entry *fe;
 	gfarm_timerval_t t1, t2;
@@ -1969,17 +2055,28 @@ gfs_server_pread(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 		local_fd = file_table_get(fd);
 	}
 
+	rv = -1;
+	if (local_fd >= 0 && iosize > 0 &&
+	    gfp_xdr_sendfile_is_available(client))
+		rv = gfs_server_pread_sendfile(client, xid, local_fd, iosize,
+		    offset);
+	if (rv >= 0) {
+		replied = 1;
+		if (fd != REPLICATION_REMOTE_FD)
+			file_table_set_read(fd);
+	} else {
 #if 0 /* XXX FIXME: pread(2) on NetBSD-3.0_BETA is broken */
-	if ((rv = pread(local_fd, buffer, iosize, offset)) == -1)
+		if ((rv = pread(local_fd, buffer, iosize, offset)) == -1)
 #else
-	rv = 0;
-	if (lseek(local_fd, offset, SEEK_SET) == -1)
-		save_errno = errno;
-	else if ((rv = read(local_fd, buffer, iosize)) == -1)
+		rv = 0;
+		if (lseek(local_fd, offset, SEEK_SET) == -1)
+			save_errno = errno;
+		else if ((rv = read(local_fd, buffer, iosize)) == -1)
 #endif
-		save_errno = errno;
-	else if (fd != REPLICATION_REMOTE_FD)
-		file_table_set_read(fd);
+			save_errno = errno;
+		else if (fd != REPLICATION_REMOTE_FD)
+			file_table_set_read(fd);
+	}
 
 	if (rv > 0) {
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
@@ -1996,8 +2093,126 @@ gfs_server_pread(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 			}
 		});
 
-	gfs_server_put_reply_with_errno(client, xid, "pread", save_errno,
-	    "b", rv, buffer);
+	if (!replied)
+		gfs_server_put_reply_with_errno(client, xid, "pread",
+		    save_errno, "b", rv, buffer);
+}
+
+static int
+client_is_readable(struct gfp_xdr *client)
+{
+	struct pollfd pfd;
+
+	if (gfp_xdr_recv_is_ready(client))
+		return (1);
+	pfd.fd = gfp_xdr_fd(client);
+	pfd.events = POLLIN;
+	return (poll(&pfd, 1, 0) > 0);
+}
+
+static void
+bulkread_recv_grant(struct gfp_xdr *client, gfarm_int64_t *allowancep,
+	int *stoppedp, const char *diag)
+{
+	gfarm_error_t e;
+	gfarm_int32_t grant;
+	int eof;
+
+	/* the application may consume the data slowly, thus no timeout */
+	e = gfp_xdr_recv_notimeout(client, 0, &eof, "i", &grant);
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	if (e != GFARM_ERR_NO_ERROR)
+		conn_fatal(GFARM_MSG_UNFIXED, "%s receive grant: %s",
+		    diag, gfarm_error_string(e));
+	if (grant <= 0)
+		*stoppedp = 1;
+	else
+		*allowancep += grant;
+}
+
+/* see the comment of GFS_PROTO_BULKREAD in gfs_proto.h */
+void
+gfs_server_bulkread(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	gfarm_int32_t fd, window;
+	gfarm_int64_t offset, length, allowance, iosize;
+	ssize_t rv;
+	int local_fd, save_errno = 0, stopped = 0;
+	char buffer[GFS_PROTO_MAX_IOSIZE];
+	static const char diag[] = "GFS_PROTO_BULKREAD";
+
+	gfs_server_get_request(client, size, diag, "iill",
+	    &fd, &window, &offset, &length);
+
+	if ((local_fd = file_table_get(fd)) < 0)
+		save_errno = EBADF;
+	else if (window <= 0 || offset < 0)
+		save_errno = EINVAL;
+	allowance = window;
+
+	while (save_errno == 0 && length != 0) {
+		/* receive grants, and wait for them if nothing is granted */
+		while (!stopped &&
+		    (allowance <= 0 || client_is_readable(client)))
+			bulkread_recv_grant(client, &allowance, &stopped,
+			    diag);
+		if (stopped)
+			break;
+
+		iosize = GFS_PROTO_MAX_IOSIZE;
+		if (iosize > allowance)
+			iosize = allowance;
+		if (length > 0 && iosize > length)
+			iosize = length;
+
+		rv = -1;
+		if (gfp_xdr_sendfile_is_available(client))
+			rv = sendfile_length(local_fd, iosize, offset);
+		if (rv > 0) {
+			e = gfp_xdr_send(client, "i", (gfarm_int32_t)rv);
+			if (e == GFARM_ERR_NO_ERROR)
+				e = sendfile_data(client, local_fd, offset,
+				    rv);
+		} else if (rv == -1) {
+			if (lseek(local_fd, offset, SEEK_SET) == -1 ||
+			    (rv = read(local_fd, buffer, iosize)) == -1) {
+				save_errno = errno;
+				break;
+			}
+			if (rv > 0)
+				e = gfp_xdr_send(client, "b", rv, buffer);
+		}
+		if (rv == 0) /* EOF */
+			break;
+		if (e == GFARM_ERR_NO_ERROR)
+			e = gfp_xdr_flush(client);
+		if (e != GFARM_ERR_NO_ERROR)
+			conn_fatal(GFARM_MSG_UNFIXED, "%s send: %s",
+			    diag, gfarm_error_string(e));
+
+		file_table_set_read(fd);
+		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
+		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, rv);
+		offset += rv;
+		allowance -= rv;
+		if (length > 0)
+			length -= rv;
+	}
+
+	/* end mark, i.e. a zero-length chunk */
+	e = gfp_xdr_send(client, "i", (gfarm_int32_t)0);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_flush(client);
+	if (e != GFARM_ERR_NO_ERROR)
+		conn_fatal(GFARM_MSG_UNFIXED, "%s send end mark: %s",
+		    diag, gfarm_error_string(e));
+	/* grants which were sent before the stop are just ignored */
+	while (!stopped)
+		bulkread_recv_grant(client, &allowance, &stopped, diag);
+
+	gfs_server_put_reply_with_errno(client, xid, diag, save_errno, "");
 }
 
 void
@@ -2675,6 +2890,82 @@ gfs_async_server_fhremove(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
 	    diag, save_errno, ""));
 }
 
+gfarm_error_t
+gfs_async_server_fhremove_batch(struct gfp_xdr *conn, gfp_xdr_xid_t xid,
+	size_t size)
+{
+	gfarm_error_t e;
+	gfarm_int32_t i, n, errs[GFS_PROTO_FHREMOVE_BATCH_MAX];
+	gfarm_ino_t ino;
+	gfarm_uint64_t gen;
+	int eof;
+	char *path;
+	static const char diag[] = "GFS_PROTO_FHREMOVE_BATCH";
+
+	if (debug_mode)
+		gflog_info(GFARM_MSG_UNFIXED, "<%s> async start receiving",
+		    diag);
+
+	/* the request is received one by one, see gfs_proto.h */
+	e = gfp_xdr_recv_sized(conn, 0, 1, &size, &eof, "i", &n);
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s get request: %s",
+		    diag, gfarm_error_string(e));
+		return (e);
+	}
+	if (n < 0 || n > GFS_PROTO_FHREMOVE_BATCH_MAX ||
+	    size != n * 2 * sizeof(gfarm_uint64_t)) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s: invalid request, %d files in %d bytes",
+		    diag, (int)n, (int)size);
+		if ((e = gfp_xdr_purge(conn, 0, size)) != GFARM_ERR_NO_ERROR)
+			return (e);
+		return (gfs_async_server_put_reply(conn, xid, diag,
+		    GFARM_ERR_PROTOCOL, ""));
+	}
+
+	for (i = 0; i < n; i++) {
+		e = gfp_xdr_recv_sized(conn, 0, 1, &size, &eof, "ll",
+		    &ino, &gen);
+		if (e == GFARM_ERR_NO_ERROR && eof)
+			e = GFARM_ERR_UNEXPECTED_EOF;
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_error(GFARM_MSG_UNFIXED, "%s get request: %s",
+			    diag, gfarm_error_string(e));
+			return (e);
+		}
+		gfsd_local_path(ino, gen, diag, &path);
+		if (unlink(path) == -1)
+			errs[i] = gfarm_errno_to_error(errno);
+		else
+			errs[i] = GFARM_ERR_NO_ERROR;
+		free(path);
+	}
+
+	if (debug_mode)
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "<%s> async sending reply: %d (%s)",
+		    diag, GFARM_ERR_NO_ERROR,
+		    gfarm_error_string(GFARM_ERR_NO_ERROR));
+
+	/* the error code, the number of the results, and the results */
+	e = gfp_xdr_send_async_result_header(conn, xid,
+	    sizeof(gfarm_int32_t) * (2 + n));
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send(conn, "ii",
+		    (gfarm_int32_t)GFARM_ERR_NO_ERROR, n);
+	for (i = 0; i < n && e == GFARM_ERR_NO_ERROR; i++)
+		e = gfp_xdr_send(conn, "i", errs[i]);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_flush(conn);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_UNFIXED, "%s put reply: %s",
+		    diag, gfarm_error_string(e));
+	return (e);
+}
+
 gfarm_error_t
 gfs_async_server_status(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
 {
@@ -3621,6 +3912,128 @@ gfs_server_chdir(struct gfp_xdr *client)
 
 #endif /* not yet in gfarm v2 */
 
+/*
+ * worker processes, enabled by spool_server_worker_processes.
+ *
+ * a worker accepts clients by itself, and serves them one after another.
+ * it keeps its gfmd connection across the clients, thus neither fork(2)
+ * nor a new gfmd connection is necessary for each client.
+ * the master forks a child for each client as before, only while
+ * no worker is idle.
+ */
+
+#define WORKER_PARENT_CHECK_INTERVAL	10 /* sec */
+#define WORKER_RESPAWN_INTERVAL		1 /* sec */
+
+struct worker {
+	pid_t pid;	/* 0: not running */
+	int busy;
+	time_t started;
+};
+
+static struct worker *workers = NULL; /* used only by the master */
+static int workers_idle = 0;
+static int worker_pipe[2] = { -1, -1 }; /* reports from workers */
+
+/* index in workers[] in a worker process, -1 in other processes */
+static int worker_slot = -1;
+static volatile sig_atomic_t worker_in_session = 0;
+static volatile sig_atomic_t worker_retiring = 0;
+
+struct worker_report {
+	pid_t pid;
+	int slot, busy;
+};
+
+static void
+worker_report(int busy)
+{
+	struct worker_report r;
+
+	r.pid = getpid();
+	r.slot = worker_slot;
+	r.busy = busy;
+	/* this is smaller than PIPE_BUF, thus written atomically */
+	if (write(worker_pipe[1], &r, sizeof(r)) != sizeof(r))
+		fatal_errno(GFARM_MSG_UNFIXED, "worker report");
+}
+
+/* gfmd may have closed the connection while this worker was idle */
+static void
+worker_check_gfm_server(void)
+{
+	struct pollfd pfd;
+
+	pfd.fd = gfm_client_connection_fd(gfm_server);
+	pfd.events = POLLIN;
+	/* no reply is pending, thus being readable means EOF or an error */
+	if (poll(&pfd, 1, 0) <= 0)
+		return;
+	gflog_notice(GFARM_MSG_UNFIXED,
+	    "connection to gfmd is closed, reconnecting");
+	free_gfm_server();
+	if (connect_gfm_server() != GFARM_ERR_NO_ERROR)
+		fatal(GFARM_MSG_UNFIXED, "die");
+}
+
+/* reset the state for the client, before serving the next one */
+static void
+worker_end_session(struct gfp_xdr *client)
+{
+	gfarm_error_t e;
+
+	close_all_fd();
+	if (replication_local_fd != REPLICATION_LOCAL_FD_CLOSED) {
+		close(replication_local_fd);
+		replication_local_fd = REPLICATION_LOCAL_FD_CLOSED;
+	}
+	if (gfm_server != NULL && gfm_client_process_is_set(gfm_server) &&
+	    (e = gfm_client_process_free(gfm_server)) != GFARM_ERR_NO_ERROR) {
+		gflog_notice(GFARM_MSG_UNFIXED,
+		    "gfm_client_process_free: %s", gfarm_error_string(e));
+		/* the next client will use a new connection */
+		free_gfm_server();
+	}
+	if (credential_exported != NULL)
+		gfp_xdr_delete_credential(credential_exported, 0);
+	credential_exported = NULL;
+	fd_usable_to_gfmd = 1;
+	client_failover_count = 0;
+	free(username);
+	username = NULL;
+	gfp_xdr_free(client);
+	gflog_notice(GFARM_MSG_UNFIXED, "disconnected");
+}
+
+static void
+worker_exited(pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < gfarm_spool_server_worker_processes; i++) {
+		if (workers[i].pid == pid) {
+			if (!workers[i].busy)
+				workers_idle--;
+			workers[i].pid = 0;
+			return;
+		}
+	}
+}
+
+/* called from cleanup() of the master, thus must be async-signal-safe */
+static void
+workers_retire(void)
+{
+	int i;
+
+	if (workers == NULL)
+		return;
+	for (i = 0; i < gfarm_spool_server_worker_processes; i++) {
+		if (workers[i].pid != 0)
+			kill(workers[i].pid, SIGUSR1);
+	}
+}
+
 static int got_sigchld;
 void
 sigchld_handler(int sig)
@@ -3639,6 +4052,8 @@ clear_child(void)
 		if (pid == -1 || pid == 0)
 			break;
 		gfarm_iostat_clear_id(pid, 0);
+		if (workers != NULL)
+			worker_exited(pid);
 	}
 }
 
@@ -3656,8 +4071,11 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 	enum gfarm_auth_id_type peer_type;
 	enum gfarm_auth_method auth_method;
 
-	if ((e = connect_gfm_server()) != GFARM_ERR_NO_ERROR)
-		fatal(GFARM_MSG_1003361, "die");
+	if (worker_slot == -1 || gfm_server == NULL) {
+		if ((e = connect_gfm_server()) != GFARM_ERR_NO_ERROR)
+			fatal(GFARM_MSG_1003361, "die");
+	} else
+		worker_check_gfm_server();
 
 	if (client_name == NULL) { /* i.e. not UNIX domain socket case */
 		char *s;
@@ -3707,6 +4125,15 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 	    client_name, client_addr,
 	    gfarm_auth_uid_to_global_username, gfm_server,
 	    &peer_type, &username, &auth_method);
+	if (e != GFARM_ERR_NO_ERROR && worker_slot != -1) {
+		/* the worker continues to serve other clients */
+		gflog_notice(GFARM_MSG_UNFIXED, "%s: gfarm_authorize: %s",
+		    client_name, gfarm_error_string(e));
+		gfp_xdr_free(client);
+		if (client_name != canonical_self_name)
+			free(client_name);
+		return;
+	}
 	if (e != GFARM_ERR_NO_ERROR)
 		fatal(GFARM_MSG_1000555, "%s: gfarm_authorize: %s",
 		    client_name, gfarm_error_string(e));
@@ -3738,6 +4165,14 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 				gflog_notice(GFARM_MSG_UNFIXED,
 				    "receiving rpc header from a client: %s",
 				    gfarm_error_string(e));
+			if (worker_slot != -1) {
+				worker_end_session(client);
+				gflog_set_auxiliary_info(NULL);
+				free(aux);
+				if (client_name != canonical_self_name)
+					free(client_name);
+				return;
+			}
 			/*
 			 * XXX FIXME update metadata of all opened
 			 * file descriptor before exit.
@@ -3771,6 +4206,8 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 			gfs_server_close(client, xid, size); break;
 		case GFS_PROTO_PREAD:
 			gfs_server_pread(client, xid, size); break;
+		case GFS_PROTO_BULKREAD:
+			gfs_server_bulkread(client, xid, size); break;
 		case GFS_PROTO_PWRITE:
 			gfs_server_pwrite(client, xid, size); break;
 		case GFS_PROTO_WRITE:
@@ -3864,6 +4301,10 @@ start_server(int accepting_sock,
 		close(accepting->tcp_sock);
 		for (i = 0; i < accepting->udp_socks_count; i++)
 			close(accepting->udp_socks[i]);
+		if (worker_pipe[0] != -1) {
+			close(worker_pipe[0]);
+			close(worker_pipe[1]);
+		}
 
 		server(client, client_name, client_addr);
 		/*NOTREACHED*/
@@ -3883,6 +4324,195 @@ start_server(int accepting_sock,
 #endif
 }
 
+/* SIGUSR1 from the master at its termination */
+static void
+worker_retire_handler(int signo)
+{
+	int i;
+
+	/* let a new gfsd bind the address, even while serving a client */
+	close(accepting.tcp_sock);
+	for (i = 0; i < accepting.local_socks_count; i++)
+		close(accepting.local_socks[i].sock);
+	worker_retiring = 1;
+	if (!worker_in_session)
+		_exit(0);
+}
+
+static void
+worker_serve(int client, char *client_name, struct sockaddr *client_addr)
+{
+	/* O_NONBLOCK of the accepting socket may be inherited */
+	if (fcntl(client, F_SETFL,
+	    fcntl(client, F_GETFL, NULL) & ~O_NONBLOCK) == -1)
+		gflog_warning_errno(GFARM_MSG_UNFIXED, "client ~O_NONBLOCK");
+	worker_report(1);
+	server(client, client_name, client_addr);
+	worker_report(0);
+}
+
+static void
+worker_main(struct accepting_sockets *accepting,
+	struct sockaddr_in *self_sockaddr_array)
+{
+	struct sockaddr_in client_addr;
+	struct sockaddr_un client_local_addr;
+	socklen_t addr_size;
+	struct sigaction sa;
+	struct timeval timeout;
+	fd_set requests;
+	int i, max_fd, client;
+
+	close(worker_pipe[0]);
+	for (i = 0; i < accepting->udp_socks_count; i++)
+		close(accepting->udp_socks[i]);
+
+	sa.sa_handler = worker_retire_handler;
+	if (sigemptyset(&sa.sa_mask) == -1)
+		fatal_errno(GFARM_MSG_UNFIXED, "sigemptyset");
+	sa.sa_flags = 0;
+	if (sigaction(SIGUSR1, &sa, NULL) == -1)
+		fatal_errno(GFARM_MSG_UNFIXED, "sigaction(SIGUSR1)");
+
+	/* the connection is shared with the master, leave it as is */
+	gfm_server = NULL;
+	if (connect_gfm_server() != GFARM_ERR_NO_ERROR)
+		fatal(GFARM_MSG_UNFIXED, "die");
+
+	max_fd = accepting->tcp_sock;
+	for (i = 0; i < accepting->local_socks_count; i++) {
+		if (max_fd < accepting->local_socks[i].sock)
+			max_fd = accepting->local_socks[i].sock;
+	}
+	for (;;) {
+		if (worker_retiring || getppid() != master_gfsd_pid) {
+			gflog_debug(GFARM_MSG_UNFIXED, "worker exits");
+			exit(0);
+		}
+		FD_ZERO(&requests);
+		FD_SET(accepting->tcp_sock, &requests);
+		for (i = 0; i < accepting->local_socks_count; i++)
+			FD_SET(accepting->local_socks[i].sock, &requests);
+		timeout.tv_sec = WORKER_PARENT_CHECK_INTERVAL;
+		timeout.tv_usec = 0;
+		if (select(max_fd + 1, &requests, NULL, NULL, &timeout) <= 0)
+			continue; /* other workers may have accepted */
+
+		worker_in_session = 1;
+		if (FD_ISSET(accepting->tcp_sock, &requests)) {
+			addr_size = sizeof(client_addr);
+			client = accept(accepting->tcp_sock,
+			    (struct sockaddr *)&client_addr, &addr_size);
+			if (client >= 0)
+				worker_serve(client, NULL,
+				    (struct sockaddr *)&client_addr);
+		}
+		for (i = 0; i < accepting->local_socks_count; i++) {
+			if (!FD_ISSET(accepting->local_socks[i].sock,
+			    &requests))
+				continue;
+			addr_size = sizeof(client_local_addr);
+			client = accept(accepting->local_socks[i].sock,
+			    (struct sockaddr *)&client_local_addr, &addr_size);
+			if (client >= 0)
+				worker_serve(client, canonical_self_name,
+				    (struct sockaddr *)&self_sockaddr_array[i]);
+		}
+		worker_in_session = 0;
+	}
+}
+
+static void
+workers_init(struct accepting_sockets *accepting)
+{
+	int i;
+
+	GFARM_MALLOC_ARRAY(workers, gfarm_spool_server_worker_processes);
+	if (workers == NULL)
+		accepting_fatal(GFARM_MSG_UNFIXED, "workers: %s",
+		    gfarm_error_string(GFARM_ERR_NO_MEMORY));
+	for (i = 0; i < gfarm_spool_server_worker_processes; i++) {
+		workers[i].pid = 0;
+		workers[i].busy = 0;
+		workers[i].started = 0;
+	}
+	if (pipe(worker_pipe) == -1)
+		accepting_fatal_errno(GFARM_MSG_UNFIXED, "pipe");
+	if (fcntl(worker_pipe[0], F_SETFL, O_NONBLOCK) == -1)
+		gflog_warning_errno(GFARM_MSG_UNFIXED,
+		    "worker pipe O_NONBLOCK");
+
+	/* accepting sockets are selected by multiple processes */
+	for (i = 0; i < accepting->local_socks_count; i++) {
+		if (fcntl(accepting->local_socks[i].sock, F_SETFL,
+		    fcntl(accepting->local_socks[i].sock, F_GETFL, NULL) |
+		    O_NONBLOCK) == -1)
+			gflog_warning_errno(GFARM_MSG_UNFIXED,
+			    "accepting local socket O_NONBLOCK");
+	}
+}
+
+static void
+workers_spawn(struct accepting_sockets *accepting,
+	struct sockaddr_in *self_sockaddr_array)
+{
+	int i;
+	pid_t pid;
+	time_t now = time(NULL);
+	struct gfarm_iostat_items *statp;
+
+	for (i = 0; i < gfarm_spool_server_worker_processes; i++) {
+		/* don't respawn too quickly, if workers die at once */
+		if (workers[i].pid != 0 ||
+		    now < workers[i].started + WORKER_RESPAWN_INTERVAL)
+			continue;
+		statp = gfarm_iostat_find_space(0);
+		switch ((pid = fork())) {
+		case 0:
+			worker_slot = i;
+			if (statp) {
+				gfarm_iostat_set_id(statp,
+				    (gfarm_uint64_t)getpid());
+				gfarm_iostat_set_local_ip(statp);
+			}
+			worker_main(accepting, self_sockaddr_array);
+			/*NOTREACHED*/
+		case -1:
+			gflog_warning_errno(GFARM_MSG_UNFIXED, "fork");
+			if (statp)
+				gfarm_iostat_clear_ip(statp);
+			return;
+		default:
+			if (statp)
+				gfarm_iostat_set_id(statp,
+				    (gfarm_uint64_t)pid);
+			workers[i].pid = pid;
+			workers[i].busy = 0;
+			workers[i].started = now;
+			workers_idle++;
+			break;
+		}
+	}
+}
+
+static void
+workers_receive_reports(void)
+{
+	struct worker_report r;
+	struct worker *w;
+
+	while (read(worker_pipe[0], &r, sizeof(r)) == sizeof(r)) {
+		if (r.slot < 0 || r.slot >= gfarm_spool_server_worker_processes)
+			continue;
+		w = &workers[r.slot];
+		/* the worker may have already exited */
+		if (w->pid != r.pid || w->busy == r.busy)
+			continue;
+		w->busy = r.busy;
+		workers_idle += r.busy ? -1 : 1;
+	}
+}
+
 /* XXX FIXME: add protocol magic number and transaction ID */
 void
 datagram_server(int sock)
@@ -4310,6 +4940,10 @@ back_channel_server(void)
 				e = gfs_async_server_fhremove(
 				    bc_conn, xid, size);
 				break;
+			case GFS_PROTO_FHREMOVE_BATCH:
+				e = gfs_async_server_fhremove_batch(
+				    bc_conn, xid, size);
+				break;
 			case GFS_PROTO_STATUS:
 				e = gfs_async_server_status(
 				    bc_conn, xid, size);
@@ -4613,6 +5247,7 @@ main(int argc, char **argv)
 	int table_size, self_addresses_count, ch, i, nfound, max_fd, p;
 	struct sigaction sa;
 	fd_set requests;
+	struct timeval timeout;
 	struct stat sb;
 	int spool_check_level = 0;
 	int is_root = geteuid() == 0;
@@ -4899,6 +5534,11 @@ main(int argc, char **argv)
 		if (max_fd < accepting.udp_socks[i])
 			max_fd = accepting.udp_socks[i];
 	}
+	if (gfarm_spool_server_worker_processes > 0) {
+		workers_init(&accepting);
+		if (max_fd < worker_pipe[0])
+			max_fd = worker_pipe[0];
+	}
 	if (max_fd >= FD_SETSIZE)
 		accepting_fatal(GFARM_MSG_1000597,
 		    "too big socket file descriptor: %d", max_fd);
@@ -4971,13 +5611,29 @@ main(int argc, char **argv)
 		    "accepting TCP socket O_NONBLOCK");
 
 	for (;;) {
+		if (workers != NULL) {
+			if (got_sigchld)
+				clear_child();
+			workers_spawn(&accepting, self_sockaddr_array);
+		}
 		FD_ZERO(&requests);
-		FD_SET(accepting.tcp_sock, &requests);
-		for (i = 0; i < accepting.local_socks_count; i++)
-			FD_SET(accepting.local_socks[i].sock, &requests);
+		/* while a worker is idle, leave accepting to the workers */
+		if (workers_idle == 0) {
+			FD_SET(accepting.tcp_sock, &requests);
+			for (i = 0; i < accepting.local_socks_count; i++)
+				FD_SET(accepting.local_socks[i].sock,
+				    &requests);
+		}
 		for (i = 0; i < accepting.udp_socks_count; i++)
 			FD_SET(accepting.udp_socks[i], &requests);
-		nfound = select(max_fd + 1, &requests, NULL, NULL, NULL);
+		if (workers != NULL) {
+			FD_SET(worker_pipe[0], &requests);
+			/* to notice workers which exited while idle */
+			timeout.tv_sec = WORKER_RESPAWN_INTERVAL;
+			timeout.tv_usec = 0;
+		}
+		nfound = select(max_fd + 1, &requests, NULL, NULL,
+		    workers != NULL ? &timeout : NULL);
 		if (nfound <= 0) {
 			if (got_sigchld)
 				clear_child();
@@ -5005,6 +5661,8 @@ main(int argc, char **argv)
 			if (FD_ISSET(accepting.udp_socks[i], &requests))
 				datagram_server(accepting.udp_socks[i]);
 		}
+		if (workers != NULL && FD_ISSET(worker_pipe[0], &requests))
+			workers_receive_reports();
 	}
 	/*NOTREACHED*/
 #ifdef __GNUC__ /* to shut up warning */
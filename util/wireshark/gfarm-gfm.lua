@@ -116,6 +116,8 @@ local gfm_command_names = {
    [120] = 'GFM_PROTO_SEEK', 
    [121] = 'GFM_PROTO_GETDIRENTSPLUS', 
    [122] = 'GFM_PROTO_GETDIRENTSPLUSXATTR', 
+   [123] = 'GFM_PROTO_REMOVE_RECURSIVE', 
+   [124] = 'GFM_PROTO_FIND', 
    [128] = 'GFM_PROTO_REOPEN', 
    [129] = 'GFM_PROTO_CLOSE_READ', 
    [130] = 'GFM_PROTO_CLOSE_WRITE', 
@@ -139,6 +141,7 @@ local gfm_command_names = {
    [176] = 'GFM_PROTO_HOSTNAME_SET', 
    [177] = 'GFM_PROTO_SCHEDULE_HOST_DOMAIN', 
    [178] = 'GFM_PROTO_STATFS', 
+   [179] = 'GFM_PROTO_GIANT_LOCK_STAT_GET', 
    [192] = 'GFM_PROTO_REPLICA_LIST_BY_NAME', 
    [193] = 'GFM_PROTO_REPLICA_LIST_BY_HOST', 
    [194] = 'GFM_PROTO_REPLICA_REMOVE_BY_HOST', 